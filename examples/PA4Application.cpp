@@ -1,12 +1,20 @@
 #include "PA4Application.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <limits>
+#include "MeshCache.hpp"
 #include "ObjLoader.hpp"
 #include "utils.hpp"
 
-PA4Application::RenderObject::RenderObject(const std::shared_ptr<Program> & program, const glm::mat4 & modelWorld) : m_program(program), m_mw(modelWorld)
+namespace
+{
+const double uploadBudget = 0.004; ///< time spent in the asset uploads per frame, in seconds
+} // namespace
+
+PA4Application::RenderObject::RenderObject(const std::shared_ptr<Program> & program, const glm::mat4 & modelWorld) : m_program(program), m_mw(modelWorld), m_center(0), m_radius(0)
 {
   if (part >= 3) {
     m_colormap = std::unique_ptr<Sampler>(new Sampler(0));
@@ -65,32 +73,70 @@ std::unique_ptr<PA4Application::RenderObject> PA4Application::RenderObject::crea
   vao->setIBO(ibo);
 
   glm::vec3 diffuse(1);
-  object->m_parts.emplace_back(vao, program, diffuse, texture);
+  object->m_parts.emplace_back(vao, ibo.size() / 3, program, diffuse, texture);
 
   return object;
 }
 
-void PA4Application::RenderObject::draw()
+void PA4Application::RenderObject::selectLods(const glm::mat4 & proj, const glm::mat4 & view, float viewportHeight, bool enabled)
 {
-  update();
-  if (m_colormap) {
-    m_colormap->bind();
+  float pixelsPerUnit = std::numeric_limits<float>::infinity();
+  if (enabled and m_radius > 0) {
+    pixelsPerUnit = MeshSimplifier::pixelsPerUnit(proj, view * m_mw, m_center, m_radius, viewportHeight);
   }
   for (auto & part : m_parts) {
-    part.draw(m_colormap.get());
+    part.selectLod(pixelsPerUnit);
   }
-  if (m_colormap) {
-    m_colormap->unbind();
+}
+
+void PA4Application::RenderObject::cull(const glm::mat4 & proj, const glm::mat4 & view, bool enabled)
+{
+  glm::mat4 modelView = view * m_mw;
+  MeshletCuller culler(proj * modelView, glm::vec3(glm::inverse(modelView) * glm::vec4(0, 0, 0, 1)));
+  for (auto & part : m_parts) {
+    part.cull(enabled ? &culler : nullptr);
+  }
+}
+
+size_t PA4Application::RenderObject::nbTriangles() const
+{
+  size_t nbTriangles = 0;
+  for (const auto & part : m_parts) {
+    nbTriangles += part.nbTriangles();
+  }
+  return nbTriangles;
+}
+
+void PA4Application::RenderObject::submit(RenderQueue & queue, const glm::mat4 & view)
+{
+  update();
+  const float depth = -(view * m_mw * glm::vec4(m_center, 1)).z;
+  for (const auto & part : m_parts) {
+    part.submit(queue, m_colormap.get(), depth);
   }
 }
 
 std::unique_ptr<PA4Application::RenderObject> PA4Application::RenderObject::createWavefrontInstance(const std::shared_ptr<Program> & program, const std::string & objname, const glm::mat4 & modelWorld)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(program, modelWorld));
-  object->loadWavefront(objname);
+  for (auto & step : object->loadWavefront(objname)) {
+    step();
+  }
   return object;
 }
 
+void PA4Application::RenderObject::loadWavefrontInstance(AssetLoader & assets, const std::shared_ptr<Program> & program, const std::string & objname, const glm::mat4 & modelWorld,
+                                                         const std::function<void(std::unique_ptr<RenderObject>)> & ready)
+{
+  // the object (and its sampler) is created on the GL thread, but only handed over once its last step is run
+  std::shared_ptr<std::unique_ptr<RenderObject>> object(new std::unique_ptr<RenderObject>(new RenderObject(program, modelWorld)));
+  assets.load([object, objname, ready]() {
+    std::vector<AssetLoader::UploadStep> steps = (*object)->loadWavefront(objname);
+    steps.push_back([object, ready]() { ready(std::move(*object)); });
+    return steps;
+  });
+}
+
 std::vector<GLubyte> PA4Application::RenderObject::makeCheckerBoard()
 {
   std::vector<GLubyte> checkerboard;
@@ -113,47 +159,80 @@ std::vector<GLubyte> PA4Application::RenderObject::makeCheckerBoard()
   return checkerboard;
 }
 
-void PA4Application::RenderObject::loadWavefront(const std::string & objname)
+std::vector<AssetLoader::UploadStep> PA4Application::RenderObject::loadWavefront(const std::string & objname)
 {
-  ObjLoader objLoader(objname);
-  const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vextexPositions = objLoader.vertexPositions();
-  const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
+  // the CPU side work is done here, the steps only make GL calls
+  ObjLoader::Options options;
+  options.nbLods = 4;
+  options.meshlets = true;
+  options.cacheDirectory = MeshCache::defaultDirectory();
+  std::shared_ptr<const ObjLoader> objLoader = std::make_shared<ObjLoader>(objname, options);
+  const std::vector<glm::vec3> & vextexPositions = objLoader->vertexPositions();
+  // bounding sphere, for the selection of the levels of detail
+  if (not vextexPositions.empty()) {
+    glm::vec3 lower = vextexPositions[0];
+    glm::vec3 upper = vextexPositions[0];
+    for (const glm::vec3 & position : vextexPositions) {
+      lower = glm::min(lower, position);
+      upper = glm::max(upper, position);
+    }
+    m_center = 0.5f * (lower + upper);
+    for (const glm::vec3 & position : vextexPositions) {
+      m_radius = std::max(m_radius, glm::distance(m_center, position));
+    }
+  }
+  std::vector<AssetLoader::UploadStep> steps;
   // set up the VBOs of the master VAO
-  std::shared_ptr<VAO> vao(new VAO(2));
-  vao->setVBO(0, vextexPositions);
-  vao->setVBO(1, vertexUVs);
-  size_t nbParts = objLoader.nbIBOs();
+  steps.push_back([this, objLoader]() {
+    m_vao.reset(new VAO(2));
+    m_vao->setVBO(0, objLoader->vertexPositions());
+    m_vao->setVBO(1, objLoader->vertexUVs());
+    m_colormap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_colormap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    m_colormap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    m_colormap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+  });
+  // one step per part, so that the textures are spread over several frames
+  size_t nbParts = objLoader->nbIBOs();
   for (size_t k = 0; k < nbParts; k++) {
-    const std::vector<uint> & ibo = objLoader.ibo(k);
-    if (ibo.size() == 0) {
+    if (objLoader->ibo(k).size() == 0) {
       continue;
     }
-    std::shared_ptr<VAO> vaoSlave;
-    vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
-    const SimpleMaterial & material = materials[k];
-    Image<> colorMap = objLoader.image(material.diffuseTexName);
-    std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-    texture->setData(colorMap);
-    m_parts.push_back(RenderObjectPart(vaoSlave, m_program, material.diffuse, texture));
+    steps.push_back([this, objLoader, k]() {
+      const std::vector<uint> & ibo = objLoader->ibo(k);
+      std::shared_ptr<VAO> vaoSlave;
+      vaoSlave = m_vao->makeSlaveVAO();
+      vaoSlave->setIBO(ibo);
+      const SimpleMaterial & material = objLoader->materials()[k];
+      Image<> colorMap = objLoader->image(material.diffuseTexName);
+      std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
+      texture->setData(colorMap);
+      m_parts.push_back(RenderObjectPart(vaoSlave, ibo.size() / 3, m_program, material.diffuse, texture));
+      m_parts.back().setMeshlets(objLoader->meshlets(k));
+      for (unsigned int l = 1; l < objLoader->nbLods(k); l++) {
+        std::shared_ptr<VAO> vaoLod = m_vao->makeSlaveVAO();
+        vaoLod->setIBO(objLoader->lodIbo(k, l));
+        m_parts.back().addLod(vaoLod, objLoader->lodIbo(k, l).size() / 3, objLoader->lodError(k, l));
+      }
+    });
   }
-  m_colormap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_colormap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_colormap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_colormap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+  return steps;
 }
 
 unsigned int PA4Application::part;
 
 PA4Application::PA4Application(int windowWidth, int windowHeight)
-    : Application(windowWidth, windowHeight), m_program(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl")), m_currentTime(0), m_deltaTime(0)
+    : Application(windowWidth, windowHeight), m_program(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl")), m_currentTime(0), m_deltaTime(0), m_viewportHeight(windowHeight),
+      m_useLods(true), m_useCulling(true), m_statisticsTime(0), m_statisticsFrames(0), m_statisticsTriangles(0), m_statisticsIssued(0), m_statisticsSkipped(0), m_statisticsRenderTime(0),
+      m_firstFrame(true), m_sortDraws(true)
 {
   GLFWwindow * window = glfwGetCurrentContext();
   glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
   resize(window, windowWidth, windowHeight);
   computeView(true);
   glEnable(GL_DEPTH_TEST);
+  // the objects are left bound after use, the render queue binding the state of its draws when it changes (see GLState)
+  GLState::setUnbindToZero(false);
   glm::mat4 mw(1);
   mw = glm::translate(mw, {0, 1.1, 0});
   mw = glm::scale(mw, glm::vec3(50, 50, 0.1));
@@ -163,10 +242,12 @@ PA4Application::PA4Application(int windowWidth, int windowHeight)
     mw = glm::mat4(1);
     mw = glm::rotate(mw, -pi / 2, {1, 0, 0});
     mw = glm::scale(mw, glm::vec3(0.25));
-    m_objects.push_back(RenderObject::createWavefrontInstance(m_program, "meshes/Tron/TronLightCycle.obj", mw));
+    // the meshes are loaded in the background, and appear once uploaded (see update)
+    auto addObject = [this](std::unique_ptr<RenderObject> object) { m_objects.push_back(std::move(object)); };
+    RenderObject::loadWavefrontInstance(m_assets, m_program, "meshes/Tron/TronLightCycle.obj", mw, addObject);
     mw = glm::mat4(1);
     mw = glm::translate(mw, {0, -3, 0});
-    m_objects.push_back(RenderObject::createWavefrontInstance(m_program, "meshes/capsule.obj", mw));
+    RenderObject::loadWavefrontInstance(m_assets, m_program, "meshes/capsule.obj", mw, addObject);
   }
 }
 
@@ -185,7 +266,12 @@ void PA4Application::usage(std::string & shortDescription, std::string & synopsi
                 "  The following key bindings are available to interact with thi application:\n"
                 "     <up> / <down>    increase / decrease latitude angle of the camera position\n"
                 "     <left> / <right> increase / decrease longitude angle of the camera position\n"
-                "     R                reset the view\n";
+                "     R                reset the view\n"
+                "     L                toggle the levels of detail (frame statistics are printed every 2 seconds)\n"
+                "     C                toggle the meshlet culling\n"
+                "     S                toggle the sort of the draws by state (GL calls are counted in the frame statistics)\n"
+                "  The meshes are loaded in the background, the upload statistics being printed once they are all drawn.\n"
+                "  The processed meshes are cached in $XDG_CACHE_HOME/glitter or ~/.cache/glitter (see MeshCache).\n";
 }
 
 void PA4Application::renderFrame()
@@ -193,9 +279,16 @@ void PA4Application::renderFrame()
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT);
   glClear(GL_DEPTH_BUFFER_BIT);
+  const double start = glfwGetTime();
+  m_queue.clear();
   for (auto & object : m_objects) {
-    object->draw();
+    object->submit(m_queue, m_view);
+  }
+  if (m_sortDraws) {
+    m_queue.sort();
   }
+  m_queue.execute();
+  m_statisticsRenderTime += glfwGetTime() - start;
 }
 
 void PA4Application::update()
@@ -204,6 +297,43 @@ void PA4Application::update()
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
 
+  // uploads of the loaded meshes, within a budget so that the frame rate does not drop while they are loaded
+  if (m_firstFrame) {
+    std::cout << "[assets] first frame after " << 1000 * m_currentTime << " ms" << std::endl;
+    m_firstFrame = false;
+  }
+  if (m_assets.upload(uploadBudget) > 0 and m_assets.pending() == 0) {
+    std::cout << "[assets] ";
+    m_assets.statistics().print(std::cout);
+    std::cout << std::endl;
+  }
+
+  // levels of detail, and frame statistics to compare them with the full resolution
+  m_statisticsTime += m_deltaTime;
+  m_statisticsFrames++;
+  m_statisticsIssued += GLState::frameCounters().totalIssued();
+  m_statisticsSkipped += GLState::frameCounters().totalSkipped();
+  for (auto & object : m_objects) {
+    object->selectLods(m_proj, m_view, m_viewportHeight, m_useLods);
+    object->cull(m_proj, m_view, m_useCulling);
+    m_statisticsTriangles += object->nbTriangles();
+  }
+  if (m_statisticsTime >= 2) {
+    std::cout << (m_useLods ? "[LODs" : "[full") << (m_useCulling ? ", culled] " : "] ") << 1000 * m_statisticsTime / m_statisticsFrames << " ms/frame, " << size_t(m_statisticsTriangles / m_statisticsFrames)
+              << " triangles/frame, " << 1e-6 * m_statisticsTriangles / m_statisticsTime << " Mtriangles/s, " << size_t(m_statisticsIssued / m_statisticsFrames) << " GL binds/frame ("
+              << size_t(m_statisticsSkipped / m_statisticsFrames) << " skipped), " << 1000 * m_statisticsRenderTime / m_statisticsFrames << " ms/frame of renderFrame CPU time"
+              << std::endl;
+    std::cout << (m_sortDraws ? "[sorted] " : "[unsorted] ");
+    m_queue.statistics().print(std::cout);
+    std::cout << std::endl;
+    m_statisticsTime = 0;
+    m_statisticsFrames = 0;
+    m_statisticsTriangles = 0;
+    m_statisticsIssued = 0;
+    m_statisticsSkipped = 0;
+    m_statisticsRenderTime = 0;
+  }
+
   m_program->bind();
   m_program->setUniform("V", m_view);
   m_program->setUniform("P", m_proj);
@@ -254,44 +384,102 @@ void PA4Application::resize(GLFWwindow * window, int framebufferWidth, int frame
   PA4Application & app = *static_cast<PA4Application *>(glfwGetWindowUserPointer(window));
   float aspect = framebufferWidth / float(framebufferHeight);
   app.m_proj = glm::perspective(120.f, aspect, 0.1f, 100.f);
+  app.m_viewportHeight = framebufferHeight;
   glViewport(0, 0, framebufferWidth, framebufferHeight);
 }
 
-void PA4Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/, int /*action*/, int /*mods*/)
+void PA4Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/, int action, int /*mods*/)
 {
   PA4Application & app = *static_cast<PA4Application *>(glfwGetWindowUserPointer(window));
   switch (key) {
   case 'R':
     app.computeView(true);
     break;
+  case 'L':
+    if (action == GLFW_PRESS) {
+      app.m_useLods = not app.m_useLods;
+    }
+    break;
+  case 'C':
+    if (action == GLFW_PRESS) {
+      app.m_useCulling = not app.m_useCulling;
+    }
+    break;
+  case 'S':
+    if (action == GLFW_PRESS) {
+      app.m_sortDraws = not app.m_sortDraws;
+    }
+    break;
   }
 }
 
-PA4Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, const glm::vec3 & diffuse, std::shared_ptr<Texture> texture)
-    : m_vao(vao), m_program(program), m_diffuse(diffuse), m_texture(texture)
+PA4Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, size_t nbTriangles, std::shared_ptr<Program> program, const glm::vec3 & diffuse,
+                                                   std::shared_ptr<Texture> texture)
+    : m_lods(1, vao), m_lodTriangles(1, nbTriangles), m_lodErrors(1, 0.f), m_lod(0), m_culled(false), m_program(program), m_modelWorld(program->uniform("M")),
+      m_diffuseColor(program->uniform("diffuseColor")), m_colorSampler(program->uniform("colorSampler")), m_mw(1), m_diffuse(diffuse), m_texture(texture)
 {
 }
 
-void PA4Application::RenderObjectPart::draw(Sampler * colormap)
+void PA4Application::RenderObjectPart::submit(RenderQueue & queue, const Sampler * colormap, float depth) const
 {
-  m_program->bind();
-  m_program->setUniform("diffuseColor", m_diffuse);
-  if (colormap) {
-    colormap->attachTexture(*m_texture);
-    colormap->attachToProgram(*m_program, "colorSampler", Sampler::DoNotBind);
+  RenderQueue::Packet packet(this, m_program.get(), m_culled ? m_lods[0].get() : m_lods[m_lod].get(), depth);
+  // the texture on unit 0, with the sampler of the object (the default sampling parameters of the texture if none)
+  packet.textures[0] = m_texture.get();
+  packet.samplers[0] = colormap;
+  queue.submit(packet);
+}
+
+void PA4Application::RenderObjectPart::draw() const
+{
+  // the program is shared by all the objects: the uniforms are set by each draw
+  m_program->setUniform(m_modelWorld, m_mw);
+  m_program->setUniform(m_diffuseColor, m_diffuse);
+  m_program->setUniform(m_colorSampler, 0);
+  if (m_culled) {
+    m_lods[0]->draw(m_firsts, m_counts);
   } else {
-    const int unit = 0;
-    glActiveTexture(GL_TEXTURE0 + unit);
-    m_texture->bind();
-    m_program->setUniform("colorSampler", unit);
+    m_lods[m_lod]->draw();
   }
-  m_vao->draw();
-  m_program->unbind();
 }
 
 void PA4Application::RenderObjectPart::update(const glm::mat4 & mw)
 {
-  m_program->bind();
-  m_program->setUniform("M", mw);
-  m_program->unbind();
+  m_mw = mw;
+}
+
+void PA4Application::RenderObjectPart::addLod(std::shared_ptr<VAO> vao, size_t nbTriangles, float error)
+{
+  m_lods.push_back(vao);
+  m_lodTriangles.push_back(nbTriangles);
+  m_lodErrors.push_back(error);
+}
+
+void PA4Application::RenderObjectPart::selectLod(float pixelsPerUnit)
+{
+  m_lod = MeshSimplifier::selectLevel(m_lodErrors, pixelsPerUnit);
+}
+
+void PA4Application::RenderObjectPart::setMeshlets(const std::vector<MeshletBuilder::Meshlet> & meshlets)
+{
+  m_meshlets = meshlets;
+}
+
+void PA4Application::RenderObjectPart::cull(const MeshletCuller * culler)
+{
+  m_culled = culler and m_lod == 0 and not m_meshlets.empty();
+  if (m_culled) {
+    culler->ranges(m_meshlets, m_firsts, m_counts);
+  }
+}
+
+size_t PA4Application::RenderObjectPart::nbTriangles() const
+{
+  if (m_culled) {
+    size_t nbIndices = 0;
+    for (uint count : m_counts) {
+      nbIndices += count;
+    }
+    return nbIndices / 3;
+  }
+  return m_lodTriangles[m_lod];
 }
@@ -1,8 +1,12 @@
 #ifndef __PA4_APPLICATION_H__
 #define __PA4_APPLICATION_H__
+#include <functional>
 #include <memory>
 struct GLFWwindow;
 #include "Application.hpp"
+#include "AssetLoader.hpp"
+#include "MeshletCuller.hpp"
+#include "RenderQueue.hpp"
 #include "glApi.hpp"
 
 class PA4Application : public Application {
@@ -23,19 +27,36 @@ private:
   void computeView(bool reset = false);
 
 private:
-  class RenderObjectPart {
+  class RenderObjectPart : public RenderQueue::Drawable {
   public:
     RenderObjectPart() = delete;
     RenderObjectPart(const RenderObjectPart &) = delete;
     RenderObjectPart(RenderObjectPart &&) = default;
 
-    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, const glm::vec3 & diffuse, std::shared_ptr<Texture> texture);
-    void draw(Sampler * colormap);
+    RenderObjectPart(std::shared_ptr<VAO> vao, size_t nbTriangles, std::shared_ptr<Program> program, const glm::vec3 & diffuse, std::shared_ptr<Texture> texture);
+    void addLod(std::shared_ptr<VAO> vao, size_t nbTriangles, float error);
+    void selectLod(float pixelsPerUnit);
+    void setMeshlets(const std::vector<MeshletBuilder::Meshlet> & meshlets);
+    void cull(const MeshletCuller * culler);
+    size_t nbTriangles() const;
+    void submit(RenderQueue & queue, const Sampler * colormap, float depth) const;
+    void draw() const override;
     void update(const glm::mat4 & mw);
 
   private:
-    std::shared_ptr<VAO> m_vao;
+    std::vector<std::shared_ptr<VAO>> m_lods;        ///< levels of detail, level 0 being the full resolution
+    std::vector<size_t> m_lodTriangles;              ///< number of triangles of each level
+    std::vector<float> m_lodErrors;                  ///< geometric error of each level (object space)
+    size_t m_lod;                                    ///< the level drawn
+    std::vector<MeshletBuilder::Meshlet> m_meshlets; ///< meshlets of the full resolution level
+    std::vector<uint> m_firsts;                      ///< first index of the visible ranges of the full resolution level
+    std::vector<uint> m_counts;                      ///< number of indices of the visible ranges of the full resolution level
+    bool m_culled;                                   ///< true if only the visible ranges are drawn
     std::shared_ptr<Program> m_program;
+    Program::Uniform m_modelWorld;                   ///< M uniform of m_program
+    Program::Uniform m_diffuseColor;                 ///< diffuseColor uniform of m_program
+    Program::Uniform m_colorSampler;                 ///< colorSampler uniform of m_program
+    glm::mat4 m_mw;                                  ///< modelWorld matrix of the object, set by update
     glm::vec3 m_diffuse;
     std::shared_ptr<Texture> m_texture;
   };
@@ -61,23 +82,62 @@ private:
     static std::unique_ptr<RenderObject> createWavefrontInstance(const std::shared_ptr<Program> & program, const std::string & objname, const glm::mat4 & modelWorld);
 
     /**
-     * @brief Draw this RenderObject
+     * @brief creates an instance from a wavefront file and modelWorld matrix, the file being loaded in the background
+     * @param assets the asset loader, whose upload steps create the GL objects
+     * @param program the GLSL program
+     * @param objname the filename of the wavefront file
+     * @param modelWorld the matrix transform between the object (a.k.a model) space and the world space
+     * @param ready called on the GL thread with the created RenderObject, once it is completely uploaded
+     */
+    static void loadWavefrontInstance(AssetLoader & assets, const std::shared_ptr<Program> & program, const std::string & objname, const glm::mat4 & modelWorld,
+                                      const std::function<void(std::unique_ptr<RenderObject>)> & ready);
+
+    /**
+     * @brief submits the draws of the parts of this RenderObject
+     * @param queue the render queue of the frame
+     * @param view the worldView matrix, for the depth of the draws
+     */
+    void submit(RenderQueue & queue, const glm::mat4 & view);
+
+    /**
+     * @brief selects the level of detail of each part from its projected error
+     * @param proj the projection matrix
+     * @param view the worldView matrix
+     * @param viewportHeight the viewport height in pixels
+     * @param enabled if false, the full resolution is selected
+     */
+    void selectLods(const glm::mat4 & proj, const glm::mat4 & view, float viewportHeight, bool enabled);
+
+    /**
+     * @brief culls the meshlets of the parts drawn at full resolution
+     * @param proj the projection matrix
+     * @param view the worldView matrix
+     * @param enabled if false, all the triangles are drawn
+     */
+    void cull(const glm::mat4 & proj, const glm::mat4 & view, bool enabled);
+
+    /**
+     * @brief number of triangles drawn by this RenderObject
      */
-    void draw();
+    size_t nbTriangles() const;
 
     /**
-     * @brief update the program M uniform variable
+     * @brief update the modelWorld matrix of the parts (the M uniform variable being set by their draws)
      */
     void update();
 
   private:
     RenderObject(const std::shared_ptr<Program> & program, const glm::mat4 & modelWorld);
-    void loadWavefront(const std::string & objname);
+    /// @brief loads a wavefront file, without any GL call, and returns the steps creating the GL objects
+    std::vector<AssetLoader::UploadStep> loadWavefront(const std::string & objname);
     static std::vector<GLubyte> makeCheckerBoard();
 
   private:
     std::shared_ptr<Program> m_program;
-    glm::mat4 m_mw; ///< modelWorld matrix
+    glm::mat4 m_mw;             ///< modelWorld matrix
+    glm::vec3 m_center;         ///< bounding sphere center (object space)
+    float m_radius;             ///< bounding sphere radius (object space)
+    std::shared_ptr<VAO> m_vao; ///< master VAO, holding the VBOs shared by the parts
     std::vector<RenderObjectPart> m_parts;
     std::unique_ptr<Sampler> m_colormap;
   };
@@ -91,6 +151,19 @@ private:
   float m_eyeTheta;                                     ///< Camera position latitude angle
   float m_currentTime;                                  ///< elapsed time since first frame
   float m_deltaTime;                                    ///< elapsed time since last frame
+  float m_viewportHeight;                               ///< viewport height in pixels
+  bool m_useLods;                                       ///< Toggles the levels of detail
+  bool m_useCulling;                                    ///< Toggles the meshlet culling
+  float m_statisticsTime;                               ///< elapsed time since the last frame statistics
+  unsigned int m_statisticsFrames;                      ///< frames since the last frame statistics
+  double m_statisticsTriangles;                         ///< triangles drawn since the last frame statistics
+  double m_statisticsIssued;                            ///< GL binding calls issued since the last frame statistics
+  double m_statisticsSkipped;                           ///< GL binding calls dropped since the last frame statistics
+  double m_statisticsRenderTime;                        ///< CPU time of renderFrame since the last frame statistics
+  bool m_firstFrame;                                    ///< true until the first frame is updated
+  AssetLoader m_assets;                                 ///< loads the meshes in the background
+  RenderQueue m_queue;                                  ///< the draws of the frame
+  bool m_sortDraws;                                     ///< Toggles the sort of the render queue
 };
 
 #endif // !defined(__PA4_APPLICATION_H__)
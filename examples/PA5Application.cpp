@@ -2,14 +2,56 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "PA5Application.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <limits>
+#include "GlitterMesh.hpp"
+#include "MeshCache.hpp"
 #include "ObjLoader.hpp"
+#include "VertexQuantizer.hpp"
 #include "stb_image.h"
 #include "utils.hpp"
 
-PA5Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld)
+namespace
+{
+const double uploadBudget = 0.004; ///< time spent in the asset uploads per frame, in seconds
+const uint cameraBinding = 0;      ///< binding point of the Camera uniform block
+const uint lightsBinding = 1;      ///< binding point of the Lights uniform block
+
+/// The Camera uniform block of shaders/simplemat.*.glsl
+struct CameraBlock {
+  glm::mat4 V;                     ///< world view matrix
+  glm::mat4 P;                     ///< projection matrix
+  glm::vec4 positionCameraInWorld; ///< camera center in world space
+};
+
+/// A directional light of the Lights uniform block
+struct DirLight {
+  glm::vec3 direction; ///< direction in world space
+  float padding0;
+  glm::vec3 intensity; ///< intensity of each channel
+  float padding1;
+};
+
+/// The Lights uniform block of shaders/simplemat.f.glsl
+struct LightsBlock {
+  DirLight lightsInWorld[3]; ///< lights in world space
+};
+} // namespace
+
+STD140_BLOCK(CameraBlock);
+STD140_MEMBER(CameraBlock, V);
+STD140_MEMBER(CameraBlock, P);
+STD140_MEMBER(CameraBlock, positionCameraInWorld);
+STD140_BLOCK(DirLight);
+STD140_MEMBER(DirLight, direction);
+STD140_MEMBER(DirLight, intensity);
+STD140_BLOCK(LightsBlock);
+STD140_MEMBER(LightsBlock, lightsInWorld);
+
+PA5Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld), m_center(0), m_radius(0)
 {
   m_diffusemap = std::unique_ptr<Sampler>(new Sampler(0));
   m_normalmap = std::unique_ptr<Sampler>(new Sampler(1));
@@ -60,46 +102,80 @@ std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::crea
   vao->setVBO(3, vertexTangents);
   vao->setIBO(ibo);
 
-  object->m_parts.emplace_back(vao, program, texture, ntexture, stexture);
+  object->m_parts.emplace_back(vao, ibo.size() / 3, program, texture, ntexture, stexture);
   return object;
 }
 
-void PA5Application::RenderObject::draw()
+void PA5Application::RenderObject::selectLods(const glm::mat4 & proj, const glm::mat4 & view, float viewportHeight, bool enabled)
 {
-  m_diffusemap->bind();
-  m_normalmap->bind();
-  m_specularmap->bind();
+  float pixelsPerUnit = std::numeric_limits<float>::infinity();
+  if (enabled and m_radius > 0) {
+    pixelsPerUnit = MeshSimplifier::pixelsPerUnit(proj, view * m_mw, m_center, m_radius, viewportHeight);
+  }
   for (auto & part : m_parts) {
-    part.draw(m_diffusemap.get(), m_normalmap.get(), m_specularmap.get());
+    part.selectLod(pixelsPerUnit);
   }
-  m_diffusemap->unbind();
-  m_normalmap->unbind();
-  m_specularmap->unbind();
 }
 
-void PA5Application::RenderObject::update(const glm::mat4 & proj, const glm::mat4 & view)
+void PA5Application::RenderObject::cull(const glm::mat4 & proj, const glm::mat4 & view, bool enabled)
 {
+  glm::mat4 modelView = view * m_mw;
+  MeshletCuller culler(proj * modelView, glm::vec3(glm::inverse(modelView) * glm::vec4(0, 0, 0, 1)));
   for (auto & part : m_parts) {
-    part.update(proj, view, m_mw, displayNormals);
+    part.cull(enabled ? &culler : nullptr);
+  }
+}
+
+size_t PA5Application::RenderObject::nbTriangles() const
+{
+  size_t nbTriangles = 0;
+  for (const auto & part : m_parts) {
+    nbTriangles += part.nbTriangles();
+  }
+  return nbTriangles;
+}
+
+void PA5Application::RenderObject::submit(RenderQueue & queue, const glm::mat4 & view)
+{
+  const float depth = -(view * m_mw * glm::vec4(m_center, 1)).z;
+  for (const auto & part : m_parts) {
+    part.submit(queue, m_diffusemap.get(), m_normalmap.get(), m_specularmap.get(), depth);
+  }
+}
+
+void PA5Application::RenderObject::update()
+{
+  for (auto & part : m_parts) {
+    part.update(m_mw, displayNormals);
   }
 }
 
 std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
-  object->loadWavefront(objname);
+  for (auto & step : object->loadWavefront(objname)) {
+    step();
+  }
   return object;
 }
 
+void PA5Application::RenderObject::loadWavefrontInstance(AssetLoader & assets, const std::string & objname, const glm::mat4 & modelWorld,
+                                                         const std::function<void(std::unique_ptr<RenderObject>)> & ready)
+{
+  // the object (and its samplers) is created on the GL thread, but only handed over once its last step is run
+  std::shared_ptr<std::unique_ptr<RenderObject>> object(new std::unique_ptr<RenderObject>(new RenderObject(modelWorld)));
+  assets.load([object, objname, ready]() {
+    std::vector<AssetLoader::UploadStep> steps = (*object)->loadWavefront(objname);
+    steps.push_back([object, ready]() { ready(std::move(*object)); });
+    return steps;
+  });
+}
+
 void PA5Application::RenderObject::setProgramMaterial(std::shared_ptr<Program> & program, const SimpleMaterial & material) const
 {
+  program->bindUniformBlock("Camera", cameraBinding);
+  program->bindUniformBlock("Lights", lightsBinding);
   program->bind();
-  program->setUniform("lightsInWorld[0].direction", glm::normalize(glm::vec3(0, -1, 1)));
-  program->setUniform("lightsInWorld[0].intensity", glm::vec3(0.7, 0.7, 0.7));
-  program->setUniform("lightsInWorld[1].direction", glm::normalize(glm::vec3(0, 1, 0.5)));
-  program->setUniform("lightsInWorld[1].intensity", glm::vec3(0.5, 0.5, 0.5));
-  program->setUniform("lightsInWorld[2].direction", glm::normalize(glm::vec3(-1, 0, 1)));
-  program->setUniform("lightsInWorld[2].intensity", glm::vec3(0.6, 0.6, 0.6));
   program->setUniform("material.ambient", material.ambient);
   program->setUniform("material.diffuse", material.diffuse);
   program->setUniform("material.specular", material.specular);
@@ -110,67 +186,161 @@ void PA5Application::RenderObject::setProgramMaterial(std::shared_ptr<Program> &
   program->unbind();
 }
 
-void PA5Application::RenderObject::loadWavefront(const std::string & objname)
+std::vector<AssetLoader::UploadStep> PA5Application::RenderObject::loadWavefront(const std::string & objname)
+{
+  // .glitter v2 files are mapped, their arrays being sent to the GPU without intermediate copies
+  std::string filename = absolutename(objname);
+  if (endsWith(filename, ".glitter") and GlitterFile::isGlitterFile(filename)) {
+    std::shared_ptr<GlitterMesh> mesh(new GlitterMesh);
+    if (not mesh->open(filename)) {
+      exit(1);
+    }
+    return uploadSteps<GlitterMesh>(mesh);
+  }
+  ObjLoader::Options options;
+  options.nbLods = 4;
+  options.meshlets = true;
+  options.cacheDirectory = MeshCache::defaultDirectory();
+  return uploadSteps<ObjLoader>(std::make_shared<ObjLoader>(objname, options));
+}
+
+template <typename Mesh> std::vector<AssetLoader::UploadStep> PA5Application::RenderObject::uploadSteps(std::shared_ptr<const Mesh> mesh)
 {
-  ObjLoader objLoader(objname);
-  const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vertexPositions = objLoader.vertexPositions();
-  const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
-  std::vector<glm::vec3> vertexNormals = objLoader.vertexNormals();
-  std::vector<glm::vec3> vertexTangents = objLoader.vertexTangents();
+  // the CPU side work (bounding sphere, vertex encoding) is done here, the steps only make GL calls
+  std::vector<AssetLoader::UploadStep> steps;
+  Span<glm::vec3> vertexPositions = mesh->vertexPositions();
+  Span<glm::vec2> vertexUVs = mesh->vertexUVs();
+  Span<glm::vec3> vertexNormals = mesh->vertexNormals();
+  Span<glm::vec3> vertexTangents = mesh->vertexTangents();
+  // bounding sphere, for the selection of the levels of detail
+  if (not vertexPositions.empty()) {
+    glm::vec3 lower = vertexPositions[0];
+    glm::vec3 upper = vertexPositions[0];
+    for (const glm::vec3 & position : vertexPositions) {
+      lower = glm::min(lower, position);
+      upper = glm::max(upper, position);
+    }
+    m_center = 0.5f * (lower + upper);
+    for (const glm::vec3 & position : vertexPositions) {
+      m_radius = std::max(m_radius, glm::distance(m_center, position));
+    }
+  }
   // set up the VBOs of the master VAO
-  std::shared_ptr<VAO> vao(new VAO(4));
-  vao->setVBO(0, vertexPositions);
-  vao->setVBO(1, vertexUVs);
-  vao->setVBO(2, vertexNormals);
-  vao->setVBO(3, vertexTangents);
-  size_t nbParts = objLoader.nbIBOs();
+  VertexQuantizer quantizer(vertexPositions);
+  if (compactVertices and interleavedVertices) {
+    // 16-bit tangents keep the stride on a multiple of 4 bytes
+    typedef InterleavedLayout<glm::u16vec4, Half2, glm::i16vec2, glm::i16vec2> CompactLayout;
+    std::shared_ptr<std::vector<unsigned char>> vertices(new std::vector<unsigned char>(CompactLayout::interleave(
+        quantizer.encodePositions(vertexPositions), VertexQuantizer::encodeUVs(vertexUVs), VertexQuantizer::encodeDirections16(vertexNormals), VertexQuantizer::encodeDirections16(vertexTangents))));
+    steps.push_back([this, vertices]() {
+      m_vao.reset(new VAO(4));
+      m_vao->setInterleavedVBO<CompactLayout>(0, *vertices);
+    });
+  } else if (interleavedVertices) {
+    std::shared_ptr<std::vector<unsigned char>> vertices(new std::vector<unsigned char>(mesh->interleavedVertices()));
+    steps.push_back([this, vertices]() {
+      m_vao.reset(new VAO(4));
+      m_vao->setInterleavedVBO<ObjLoader::VertexLayout>(0, *vertices);
+    });
+  } else if (compactVertices) {
+    // 18 bytes per vertex instead of 44 (8-bit tangents are enough for normal mapping)
+    std::shared_ptr<std::vector<glm::u16vec4>> positions(new std::vector<glm::u16vec4>(quantizer.encodePositions(vertexPositions)));
+    std::shared_ptr<std::vector<Half2>> uvs(new std::vector<Half2>(VertexQuantizer::encodeUVs(vertexUVs)));
+    std::shared_ptr<std::vector<glm::i16vec2>> normals(new std::vector<glm::i16vec2>(VertexQuantizer::encodeDirections16(vertexNormals)));
+    std::shared_ptr<std::vector<glm::i8vec2>> tangents(new std::vector<glm::i8vec2>(VertexQuantizer::encodeDirections8(vertexTangents)));
+    steps.push_back([this, positions, uvs, normals, tangents]() {
+      m_vao.reset(new VAO(4));
+      m_vao->setVBO(0, *positions);
+      m_vao->setVBO(1, *uvs);
+      m_vao->setVBO(2, *normals);
+      m_vao->setVBO(3, *tangents);
+    });
+  } else {
+    steps.push_back([this, mesh]() {
+      m_vao.reset(new VAO(4));
+      m_vao->setVBO(0, mesh->vertexPositions());
+      m_vao->setVBO(1, mesh->vertexUVs());
+      m_vao->setVBO(2, mesh->vertexNormals());
+      m_vao->setVBO(3, mesh->vertexTangents());
+    });
+  }
+  steps.push_back([this]() {
+    m_diffusemap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_diffusemap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    m_diffusemap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    m_diffusemap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+    m_normalmap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_normalmap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    m_normalmap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    m_normalmap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+    m_specularmap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    m_specularmap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    m_specularmap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    m_specularmap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+  });
+  // one step per part, so that the textures of a large mesh are spread over several frames
+  size_t nbParts = mesh->nbIBOs();
   for (size_t k = 0; k < nbParts; k++) {
-    const std::vector<uint> & ibo = objLoader.ibo(k);
-    if (ibo.size() == 0) {
+    if (mesh->compactIbo(k).size() == 0) {
       continue;
     }
-    std::shared_ptr<VAO> vaoSlave;
-    vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
-
-    std::shared_ptr<Program> program(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
-    const SimpleMaterial & material = materials[k];
-    setProgramMaterial(program, material);
-    Image<> colorMap = objLoader.image(material.diffuseTexName);
-    std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-    texture->setData(colorMap);
-    Image<> normalMap = objLoader.image(material.normalTexName);
-    std::shared_ptr<Texture> ntexture(new Texture(GL_TEXTURE_2D));
-    ntexture->setData(normalMap);
-    Image<> specularMap = objLoader.image(material.specularTexName);
-    std::shared_ptr<Texture> stexture(new Texture(GL_TEXTURE_2D));
-    stexture->setData(specularMap);
-    m_parts.emplace_back(vaoSlave, program, texture, ntexture, stexture);
+    steps.push_back([this, mesh, k, quantizer]() {
+      auto ibo = mesh->compactIbo(k);
+      std::shared_ptr<VAO> vaoSlave;
+      vaoSlave = m_vao->makeSlaveVAO();
+      vaoSlave->setIBO(ibo);
+
+      std::shared_ptr<Program> program(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
+      const SimpleMaterial & material = mesh->materials()[k];
+      setProgramMaterial(program, material);
+      if (compactVertices) {
+        program->bind();
+        program->setUniform("positionOffset", quantizer.positionOffset());
+        program->setUniform("positionScale", quantizer.positionScale());
+        program->setUniform("octahedralDirections", true);
+        program->unbind();
+      }
+      Image<> colorMap = mesh->image(material.diffuseTexName);
+      std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
+      texture->setData(colorMap);
+      Image<> normalMap = mesh->image(material.normalTexName);
+      std::shared_ptr<Texture> ntexture(new Texture(GL_TEXTURE_2D));
+      ntexture->setData(normalMap);
+      Image<> specularMap = mesh->image(material.specularTexName);
+      std::shared_ptr<Texture> stexture(new Texture(GL_TEXTURE_2D));
+      stexture->setData(specularMap);
+      m_parts.emplace_back(vaoSlave, ibo.size() / 3, program, texture, ntexture, stexture);
+      m_parts.back().setMeshlets(mesh->meshlets(k));
+      for (unsigned int l = 1; l < mesh->nbLods(k); l++) {
+        std::shared_ptr<VAO> vaoLod = m_vao->makeSlaveVAO();
+        vaoLod->setIBO(mesh->lodIbo(k, l));
+        m_parts.back().addLod(vaoLod, mesh->lodIbo(k, l).size() / 3, mesh->lodError(k, l));
+      }
+    });
   }
-  m_diffusemap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_diffusemap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_diffusemap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_diffusemap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
-  m_normalmap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_normalmap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_normalmap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_normalmap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
-  m_specularmap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_specularmap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_specularmap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_specularmap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+  return steps;
 }
 
 bool PA5Application::displayNormals;
+bool PA5Application::compactVertices;
+bool PA5Application::interleavedVertices;
 
-PA5Application::PA5Application(int windowWidth, int windowHeight) : Application(windowWidth, windowHeight), m_currentTime(0), m_deltaTime(0)
+PA5Application::PA5Application(int windowWidth, int windowHeight) : Application(windowWidth, windowHeight), m_currentTime(0), m_deltaTime(0), m_viewportHeight(windowHeight),
+      m_useLods(true), m_useCulling(true), m_statisticsTime(0), m_statisticsFrames(0), m_statisticsTriangles(0), m_statisticsIssued(0), m_statisticsSkipped(0), m_statisticsRenderTime(0),
+      m_firstFrame(true), m_camera(cameraBinding, sizeof(CameraBlock)), m_lights(lightsBinding, sizeof(LightsBlock), 1), m_sortDraws(true)
 {
   GLFWwindow * window = glfwGetCurrentContext();
   glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
   resize(window, windowWidth, windowHeight);
   computeView(true);
   glEnable(GL_DEPTH_TEST);
+  // the objects are left bound after use, their next binds being dropped when redundant (see GLState)
+  GLState::setUnbindToZero(false);
+  LightsBlock lights;
+  lights.lightsInWorld[0] = {glm::normalize(glm::vec3(0, -1, 1)), 0, glm::vec3(0.7, 0.7, 0.7), 0};
+  lights.lightsInWorld[1] = {glm::normalize(glm::vec3(0, 1, 0.5)), 0, glm::vec3(0.5, 0.5, 0.5), 0};
+  lights.lightsInWorld[2] = {glm::normalize(glm::vec3(-1, 0, 1)), 0, glm::vec3(0.6, 0.6, 0.6), 0};
+  m_lights.update(lights);
   glm::mat4 mw(1);
   mw = glm::translate(mw, {0, 1.1, 0});
   mw = glm::scale(mw, glm::vec3(50, 50, 0.1));
@@ -181,13 +351,15 @@ PA5Application::PA5Application(int windowWidth, int windowHeight) : Application(
   mw = glm::rotate(mw, -pi / 2, {1, 0, 0});
   mw = glm::rotate(mw, -5 * pi / 6, {0, 1, 0});
   mw = glm::scale(mw, glm::vec3(0.25));
-  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Tron/TronLightCycle.obj", mw));
-  // m_objects.push_back(RenderObject::createWavefrontInstance("tmp/tron.glitter", mw)); // TODO : Check this
+  // the meshes are loaded in the background, and appear once uploaded (see update)
+  auto addObject = [this](std::unique_ptr<RenderObject> object) { m_objects.push_back(std::move(object)); };
+  RenderObject::loadWavefrontInstance(m_assets, "meshes/Tron/TronLightCycle.obj", mw, addObject);
+  // RenderObject::loadWavefrontInstance(m_assets, "tmp/tron.glitter", mw, addObject); // TODO : Check this
   mw = glm::mat4(1);
   mw = glm::translate(mw, {2, 1, -0.1});
   mw = glm::rotate(mw, pi, {1, 0, 0});
-  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Pallet/Bswap_HPBake_Planks.obj", mw));
-  // m_objects.push_back(RenderObject::createWavefrontInstance("tmp/pallet.glitter", mw)); // TODO : Check this
+  RenderObject::loadWavefrontInstance(m_assets, "meshes/Pallet/Bswap_HPBake_Planks.obj", mw, addObject);
+  // RenderObject::loadWavefrontInstance(m_assets, "tmp/pallet.glitter", mw, addObject); // TODO : Check this
 }
 
 void PA5Application::setCallbacks()
@@ -200,12 +372,20 @@ void PA5Application::setCallbacks()
 void PA5Application::usage(std::string & shortDescription, std::string & synopsis, std::string & description)
 {
   shortDescription = "Application for programming assignment 4";
-  synopsis = "pa4";
+  synopsis = "pa5 [compact] [interleaved]";
   description = "  An application for texture mapping.\n"
                 "  The following key bindings are available to interact with thi application:\n"
                 "     <up> / <down>    increase / decrease latitude angle of the camera position\n"
                 "     <left> / <right> increase / decrease longitude angle of the camera position\n"
-                "     R                reset the view\n";
+                "     R                reset the view\n"
+                "     L                toggle the levels of detail (frame statistics are printed every 2 seconds)\n"
+                "     C                toggle the meshlet culling\n"
+                "     S                toggle the sort of the draws by state\n"
+                "     B                toggle the unbinds of the OpenGL objects after use (GL calls are counted in the frame statistics)\n"
+                "  The meshes are loaded in the background, the upload statistics being printed once they are all drawn.\n"
+                "  The processed meshes are cached in $XDG_CACHE_HOME/glitter or ~/.cache/glitter (see MeshCache).\n"
+                "  With the 'compact' argument, the meshes are drawn from quantized vertex attributes.\n"
+                "  With the 'interleaved' argument, the vertex attributes are interleaved in a single VBO.\n";
 }
 
 void PA5Application::renderFrame()
@@ -213,9 +393,16 @@ void PA5Application::renderFrame()
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT);
   glClear(GL_DEPTH_BUFFER_BIT);
+  const double start = glfwGetTime();
+  m_queue.clear();
   for (auto & object : m_objects) {
-    object->draw();
+    object->submit(m_queue, m_view);
+  }
+  if (m_sortDraws) {
+    m_queue.sort();
   }
+  m_queue.execute();
+  m_statisticsRenderTime += glfwGetTime() - start;
 }
 
 void PA5Application::update()
@@ -223,9 +410,48 @@ void PA5Application::update()
   float prevTime = m_currentTime;
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
+
+  // uploads of the loaded meshes, within a budget so that the frame rate does not drop while they are loaded
+  if (m_firstFrame) {
+    std::cout << "[assets] first frame after " << 1000 * m_currentTime << " ms" << std::endl;
+    m_firstFrame = false;
+  }
+  if (m_assets.upload(uploadBudget) > 0 and m_assets.pending() == 0) {
+    std::cout << "[assets] ";
+    m_assets.statistics().print(std::cout);
+    std::cout << std::endl;
+  }
+
+  // levels of detail, and frame statistics to compare them with the full resolution
+  m_statisticsTime += m_deltaTime;
+  m_statisticsFrames++;
+  m_statisticsIssued += GLState::frameCounters().totalIssued();
+  m_statisticsSkipped += GLState::frameCounters().totalSkipped();
+  for (auto & object : m_objects) {
+    object->selectLods(m_proj, m_view, m_viewportHeight, m_useLods);
+    object->cull(m_proj, m_view, m_useCulling);
+    m_statisticsTriangles += object->nbTriangles();
+  }
+  if (m_statisticsTime >= 2) {
+    std::cout << (m_useLods ? "[LODs" : "[full") << (m_useCulling ? ", culled] " : "] ") << 1000 * m_statisticsTime / m_statisticsFrames << " ms/frame, " << size_t(m_statisticsTriangles / m_statisticsFrames)
+              << " triangles/frame, " << 1e-6 * m_statisticsTriangles / m_statisticsTime << " Mtriangles/s, " << size_t(m_statisticsIssued / m_statisticsFrames) << " GL binds/frame ("
+              << size_t(m_statisticsSkipped / m_statisticsFrames) << " skipped" << (GLState::unbindsToZero() ? ", unbinding), " : "), ") << 1000 * m_statisticsRenderTime / m_statisticsFrames
+              << " ms/frame of renderFrame CPU time" << std::endl;
+    std::cout << (m_sortDraws ? "[sorted] " : "[unsorted] ");
+    m_queue.statistics().print(std::cout);
+    std::cout << std::endl;
+    m_statisticsTime = 0;
+    m_statisticsFrames = 0;
+    m_statisticsTriangles = 0;
+    m_statisticsIssued = 0;
+    m_statisticsSkipped = 0;
+    m_statisticsRenderTime = 0;
+  }
   continuousKey();
+  // the camera is uploaded once for all the programs
+  m_camera.update(CameraBlock{m_view, m_proj, glm::inverse(m_view) * glm::vec4(0, 0, 0, 1)});
   for (auto & object : m_objects) {
-    object->update(m_proj, m_view);
+    object->update();
   }
 }
 
@@ -270,6 +496,7 @@ void PA5Application::resize(GLFWwindow * window, int framebufferWidth, int frame
   PA5Application & app = *static_cast<PA5Application *>(glfwGetWindowUserPointer(window));
   float aspect = framebufferWidth / float(framebufferHeight);
   app.m_proj = glm::perspective(120.f, aspect, 0.1f, 100.f);
+  app.m_viewportHeight = framebufferHeight;
   glViewport(0, 0, framebufferWidth, framebufferHeight);
 }
 
@@ -280,6 +507,26 @@ void PA5Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/,
   case 'R':
     app.computeView(true);
     break;
+  case 'L':
+    if (action == GLFW_PRESS) {
+      app.m_useLods = not app.m_useLods;
+    }
+    break;
+  case 'C':
+    if (action == GLFW_PRESS) {
+      app.m_useCulling = not app.m_useCulling;
+    }
+    break;
+  case 'S':
+    if (action == GLFW_PRESS) {
+      app.m_sortDraws = not app.m_sortDraws;
+    }
+    break;
+  case 'B':
+    if (action == GLFW_PRESS) {
+      GLState::setUnbindToZero(not GLState::unbindsToZero());
+    }
+    break;
   case 'N':
     if (action == GLFW_PRESS or action == GLFW_RELEASE) {
       displayNormals = not displayNormals;
@@ -288,33 +535,81 @@ void PA5Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/,
   }
 }
 
-PA5Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture,
-                                                   std::shared_ptr<Texture> stexture)
-    : m_vao(vao), m_program(program), m_diffuseTexture(texture), m_normalTexture(ntexture), m_specularTexture(stexture)
+PA5Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, size_t nbTriangles, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture,
+                                                   std::shared_ptr<Texture> ntexture, std::shared_ptr<Texture> stexture)
+    : m_lods(1, vao), m_lodTriangles(1, nbTriangles), m_lodErrors(1, 0.f), m_lod(0), m_culled(false), m_program(program), m_modelWorld(program->uniform("M")),
+      m_displayNormals(program->uniform("displayNormals")), m_diffuseTexture(texture), m_normalTexture(ntexture), m_specularTexture(stexture)
 {
 }
 
-void PA5Application::RenderObjectPart::draw(Sampler * colormap, Sampler * normalmap, Sampler * specularmap)
+void PA5Application::RenderObjectPart::submit(RenderQueue & queue, const Sampler * colormap, const Sampler * normalmap, const Sampler * specularmap, float depth) const
 {
-  m_program->bind();
-  colormap->attachTexture(*m_diffuseTexture);
-  normalmap->attachTexture(*m_normalTexture);
-  specularmap->attachTexture(*m_specularTexture);
-  m_vao->draw();
-  m_program->unbind();
+  RenderQueue::Packet packet(this, m_program.get(), m_culled ? m_lods[0].get() : m_lods[m_lod].get(), depth);
+  // the units of the samplers of the object (see setProgramMaterial)
+  packet.textures[0] = m_diffuseTexture.get();
+  packet.samplers[0] = colormap;
+  packet.textures[1] = m_normalTexture.get();
+  packet.samplers[1] = normalmap;
+  packet.textures[2] = m_specularTexture.get();
+  packet.samplers[2] = specularmap;
+  queue.submit(packet);
+}
+
+void PA5Application::RenderObjectPart::draw() const
+{
+  // the uniforms of the program are set by update
+  if (m_culled) {
+    m_lods[0]->draw(m_firsts, m_counts);
+  } else {
+    m_lods[m_lod]->draw();
+  }
 }
 
-void PA5Application::RenderObjectPart::update(const glm::mat4 & proj, const glm::mat4 & view, const glm::mat4 & mw, bool displayNormals)
+void PA5Application::RenderObjectPart::update(const glm::mat4 & mw, bool displayNormals)
 {
   m_program->bind();
-  m_program->setUniform("M", mw);
-  m_program->setUniform("V", view);
-  m_program->setUniform("P", proj);
-  m_program->setUniform("positionCameraInWorld", glm::vec3(glm::inverse(view) * glm::vec4(0, 0, 0, 1)));
+  m_program->setUniform(m_modelWorld, mw);
   if (displayNormals) {
-    m_program->setUniform("displayNormals", 1);
+    m_program->setUniform(m_displayNormals, 1);
   } else {
-    m_program->setUniform("displayNormals", 0);
+    m_program->setUniform(m_displayNormals, 0);
   }
   m_program->unbind();
 }
+
+void PA5Application::RenderObjectPart::addLod(std::shared_ptr<VAO> vao, size_t nbTriangles, float error)
+{
+  m_lods.push_back(vao);
+  m_lodTriangles.push_back(nbTriangles);
+  m_lodErrors.push_back(error);
+}
+
+void PA5Application::RenderObjectPart::selectLod(float pixelsPerUnit)
+{
+  m_lod = MeshSimplifier::selectLevel(m_lodErrors, pixelsPerUnit);
+}
+
+void PA5Application::RenderObjectPart::setMeshlets(Span<MeshletBuilder::Meshlet> meshlets)
+{
+  m_meshlets = meshlets.toVector();
+}
+
+void PA5Application::RenderObjectPart::cull(const MeshletCuller * culler)
+{
+  m_culled = culler and m_lod == 0 and not m_meshlets.empty();
+  if (m_culled) {
+    culler->ranges(m_meshlets, m_firsts, m_counts);
+  }
+}
+
+size_t PA5Application::RenderObjectPart::nbTriangles() const
+{
+  if (m_culled) {
+    size_t nbIndices = 0;
+    for (uint count : m_counts) {
+      nbIndices += count;
+    }
+    return nbIndices / 3;
+  }
+  return m_lodTriangles[m_lod];
+}
@@ -1,8 +1,12 @@
 #ifndef __PA5_APPLICATION_H__
 #define __PA5_APPLICATION_H__
+#include <functional>
 #include <memory>
 struct GLFWwindow;
 #include "Application.hpp"
+#include "AssetLoader.hpp"
+#include "MeshletCuller.hpp"
+#include "RenderQueue.hpp"
 #include "glApi.hpp"
 
 // forward declarations
@@ -15,7 +19,9 @@ public:
   static void usage(std::string & shortDescritpion, std::string & synopsis, std::string & description);
 
 public:
-  static bool displayNormals; ///< Toggles normal display
+  static bool displayNormals;      ///< Toggles normal display
+  static bool compactVertices;     ///< Uploads quantized vertex attributes (see VertexQuantizer)
+  static bool interleavedVertices; ///< Uploads the vertex attributes in a single interleaved VBO
 
 private:
   void renderFrame() override;
@@ -26,18 +32,34 @@ private:
   void computeView(bool reset = false);
 
 private:
-  class RenderObjectPart {
+  class RenderObjectPart : public RenderQueue::Drawable {
   public:
     RenderObjectPart() = delete;
     RenderObjectPart(const RenderObjectPart &) = delete;
     RenderObjectPart(RenderObjectPart &&) = default;
-    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture, std::shared_ptr<Texture> stexture);
-    void draw(Sampler * colormap, Sampler * normalmap, Sampler * specularmap);
-    void update(const glm::mat4 & proj, const glm::mat4 & view, const glm::mat4 & mw, bool displayNormals);
+    RenderObjectPart(std::shared_ptr<VAO> vao, size_t nbTriangles, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture,
+                     std::shared_ptr<Texture> stexture);
+    void addLod(std::shared_ptr<VAO> vao, size_t nbTriangles, float error);
+    void selectLod(float pixelsPerUnit);
+    void setMeshlets(Span<MeshletBuilder::Meshlet> meshlets);
+    void cull(const MeshletCuller * culler);
+    size_t nbTriangles() const;
+    void submit(RenderQueue & queue, const Sampler * colormap, const Sampler * normalmap, const Sampler * specularmap, float depth) const;
+    void draw() const override;
+    void update(const glm::mat4 & mw, bool displayNormals);
 
   private:
-    std::shared_ptr<VAO> m_vao;
+    std::vector<std::shared_ptr<VAO>> m_lods;        ///< levels of detail, level 0 being the full resolution
+    std::vector<size_t> m_lodTriangles;              ///< number of triangles of each level
+    std::vector<float> m_lodErrors;                  ///< geometric error of each level (object space)
+    size_t m_lod;                                    ///< the level drawn
+    std::vector<MeshletBuilder::Meshlet> m_meshlets; ///< meshlets of the full resolution level
+    std::vector<uint> m_firsts;                      ///< first index of the visible ranges of the full resolution level
+    std::vector<uint> m_counts;                      ///< number of indices of the visible ranges of the full resolution level
+    bool m_culled;                                   ///< true if only the visible ranges are drawn
     std::shared_ptr<Program> m_program;
+    Program::Uniform m_modelWorld;                   ///< M uniform of m_program (the uniforms set by update are resolved once)
+    Program::Uniform m_displayNormals;               ///< displayNormals uniform of m_program
     std::shared_ptr<Texture> m_diffuseTexture;
     std::shared_ptr<Texture> m_normalTexture;
     std::shared_ptr<Texture> m_specularTexture;
@@ -62,6 +84,15 @@ private:
      */
     static std::unique_ptr<RenderObject> createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld);
 
+    /**
+     * @brief creates an instance from a wavefront file and modelWorld matrix, the file being loaded in the background
+     * @param assets the asset loader, whose upload steps create the GL objects
+     * @param objname the filename of the wavefront file
+     * @param modelWorld the matrix transform between the object (a.k.a model) space and the world space
+     * @param ready called on the GL thread with the created RenderObject, once it is completely uploaded
+     */
+    static void loadWavefrontInstance(AssetLoader & assets, const std::string & objname, const glm::mat4 & modelWorld, const std::function<void(std::unique_ptr<RenderObject>)> & ready);
+
     /**
      * @brief Sets all uniform variables related to material and lighting
      * @param program
@@ -72,23 +103,52 @@ private:
     void setProgramMaterial(std::shared_ptr<Program> & program, const SimpleMaterial & material) const;
 
     /**
-     * @brief Draw this RenderObject
+     * @brief submits the draws of the parts of this RenderObject
+     * @param queue the render queue of the frame
+     * @param view the worldView matrix, for the depth of the draws
      */
-    void draw();
+    void submit(RenderQueue & queue, const glm::mat4 & view);
 
     /**
-     * @brief update the program MVP uniform variable
+     * @brief selects the level of detail of each part from its projected error
      * @param proj the projection matrix
      * @param view the worldView matrix
+     * @param viewportHeight the viewport height in pixels
+     * @param enabled if false, the full resolution is selected
+     */
+    void selectLods(const glm::mat4 & proj, const glm::mat4 & view, float viewportHeight, bool enabled);
+
+    /**
+     * @brief culls the meshlets of the parts drawn at full resolution
+     * @param proj the projection matrix
+     * @param view the worldView matrix
+     * @param enabled if false, all the triangles are drawn
+     */
+    void cull(const glm::mat4 & proj, const glm::mat4 & view, bool enabled);
+
+    /**
+     * @brief number of triangles drawn by this RenderObject
+     */
+    size_t nbTriangles() const;
+
+    /**
+     * @brief update the uniform variables of the programs of the parts
+     *
+     * The camera ones are shared by all the programs (see PA5Application::update).
      */
-    void update(const glm::mat4 & proj, const glm::mat4 & view);
+    void update();
 
   private:
     RenderObject(const glm::mat4 & modelWorld);
-    void loadWavefront(const std::string & objname);
+    /// @brief loads a wavefront (or .glitter) file, without any GL call, and returns the steps creating the GL objects
+    std::vector<AssetLoader::UploadStep> loadWavefront(const std::string & objname);
+    template <typename Mesh> std::vector<AssetLoader::UploadStep> uploadSteps(std::shared_ptr<const Mesh> mesh);
 
   private:
-    glm::mat4 m_mw; ///< modelWorld matrix
+    glm::mat4 m_mw;             ///< modelWorld matrix
+    glm::vec3 m_center;         ///< bounding sphere center (object space)
+    float m_radius;             ///< bounding sphere radius (object space)
+    std::shared_ptr<VAO> m_vao; ///< master VAO, holding the VBOs shared by the parts
     std::vector<RenderObjectPart> m_parts;
     std::unique_ptr<Sampler> m_diffusemap;
     std::unique_ptr<Sampler> m_normalmap;
@@ -103,6 +163,21 @@ private:
   float m_eyeTheta;                                     ///< Camera position latitude angle
   float m_currentTime;                                  ///< elapsed time since first frame
   float m_deltaTime;                                    ///< elapsed time since last frame
+  float m_viewportHeight;                               ///< viewport height in pixels
+  bool m_useLods;                                       ///< Toggles the levels of detail
+  bool m_useCulling;                                    ///< Toggles the meshlet culling
+  float m_statisticsTime;                               ///< elapsed time since the last frame statistics
+  unsigned int m_statisticsFrames;                      ///< frames since the last frame statistics
+  double m_statisticsTriangles;                         ///< triangles drawn since the last frame statistics
+  double m_statisticsIssued;                            ///< GL binding calls issued since the last frame statistics
+  double m_statisticsSkipped;                           ///< GL binding calls dropped since the last frame statistics
+  double m_statisticsRenderTime;                        ///< CPU time of renderFrame since the last frame statistics
+  bool m_firstFrame;                                    ///< true until the first frame is updated
+  AssetLoader m_assets;                                 ///< loads the meshes in the background
+  UniformBuffer m_camera;                               ///< the Camera uniform block, updated every frame
+  UniformBuffer m_lights;                               ///< the Lights uniform block, updated once
+  RenderQueue m_queue;                                  ///< the draws of the frame
+  bool m_sortDraws;                                     ///< Toggles the sort of the render queue
 };
 
 #endif // !defined(__PA5_APPLICATION_H__)
@@ -92,6 +92,12 @@ int main(int argc, char * argv[])
     app = new PA4Application(640, 480);
   } else if (!strcmp(argv[1], "pa5")) {
     PA5Application::displayNormals = false;
+    PA5Application::compactVertices = false;
+    PA5Application::interleavedVertices = false;
+    for (int k = 2; k < argc; k++) {
+      PA5Application::compactVertices = PA5Application::compactVertices or !strcmp(argv[k], "compact");
+      PA5Application::interleavedVertices = PA5Application::interleavedVertices or !strcmp(argv[k], "interleaved");
+    }
     app = new PA5Application(640, 480);
   }
   app->setCallbacks();
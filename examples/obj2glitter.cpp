@@ -1,21 +1,468 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "GlitterMesh.hpp"
+#include "MeshCache.hpp"
 #include "ObjLoader.hpp"
 #include "Serialize.hpp"
 #include "utils.hpp"
 
 void printUsage(int /* argc */, char * argv[])
 {
-  std::cout << "Usage: " << argv[0] << " file.obj file.glitter\n";
+  std::cout << "Usage: " << argv[0] << " [--optimize none|cache|overdraw] [--lods N] [--meshlets] [--compress] file.obj file.glitter\n"
+            << "       " << argv[0] << " [options] [--jobs N] [--force] [--report report.json] directory|manifest outputDirectory\n\n"
+            << "--optimize reorders the triangles for the GPU vertex cache (cache, the default),\n"
+            << "           and additionally sorts them to reduce overdraw (overdraw).\n"
+            << "--lods     generates up to N levels of detail per material (0, the default, for none).\n"
+            << "--meshlets partitions the triangles into meshlets, with bounds for culling.\n"
+            << "--compress compresses the chunks of the file, which are then decoded at loading instead of being mapped.\n\n"
+            << "Batch mode (the output not being a .glitter file): every .obj file of a directory (recursively),\n"
+            << "or every file listed in a manifest, is converted into the output directory, under the same relative name.\n"
+            << "A manifest lists one wavefront file per line, relative to the manifest, optionally followed by its\n"
+            << ".glitter file, relative to the output directory (the names have no spaces, the empty lines and the\n"
+            << "lines starting with # are skipped).\n"
+            << "--jobs     number of assets converted in parallel (the number of cores by default).\n"
+            << "--force    converts all the assets: by default, the ones whose inputs (.obj, material libraries, textures)\n"
+            << "           and options are the same as at their last conversion are skipped (see the .glitter.deps files).\n"
+            << "--report   writes the timings and sizes of every asset in a JSON file.\n";
+}
+
+void printStatistics(const char * label, const IndexOptimizer::Statistics & statistics)
+{
+  std::cout << std::left << std::setw(10) << label << std::right << std::fixed << std::setprecision(3) << "ACMR " << statistics.acmr << "  ATVR " << statistics.atvr << "  ("
+            << statistics.nbTriangles << " triangles, " << statistics.nbVertices << " vertices, FIFO " << IndexOptimizer::defaultCacheSize << ")\n";
+}
+
+/// @brief peak resident memory of the process, in bytes (0 if unknown)
+size_t peakMemory()
+{
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    }
+  }
+#endif
+  return 0;
+}
+
+/// @brief size of a file in bytes (0 if it cannot be read)
+size_t fileSize(const std::string & filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+  return file ? size_t(file.tellg()) : 0;
+}
+
+/// The processing applied to the meshes
+struct Settings {
+  IndexOptimizer::Order order; ///< the order of the triangles
+  unsigned int nbLods;         ///< number of levels of detail
+  bool meshlets;               ///< whether the meshlets are built
+  bool compressed;             ///< whether the chunks are compressed
+
+  /// @brief the settings, as recorded in the dependency files (a changed setting triggers a new conversion)
+  std::string signature() const
+  {
+    std::ostringstream signature;
+    signature << "obj2glitter order " << order << " lods " << nbLods << " meshlets " << meshlets << " compressed " << compressed;
+    return signature.str();
+  }
+};
+
+/// @brief generates the levels of detail, optimizes the indices and builds the meshlets, printing statistics if @p verbose
+void process(ObjLoader & objLoader, const Settings & settings, bool verbose)
+{
+  if (settings.nbLods > 0) {
+    // generated before the index optimization, so that the levels are reordered as well
+    objLoader.generateLods(settings.nbLods);
+    for (size_t k = 0; k < objLoader.nbIBOs() and verbose; k++) {
+      std::cout << "material " << k << ":";
+      for (unsigned int l = 0; l < objLoader.nbLods(k); l++) {
+        std::cout << " " << objLoader.lodIbo(k, l).size() / 3;
+      }
+      std::cout << " triangles\n";
+    }
+  }
+  if (settings.order != IndexOptimizer::FileOrder) {
+    if (verbose) {
+      printStatistics("before", objLoader.cacheStatistics());
+    }
+    objLoader.optimizeIndices(settings.order);
+    if (verbose) {
+      printStatistics("after", objLoader.cacheStatistics());
+    }
+  }
+  if (settings.meshlets) {
+    // built last, as the index optimization reorders the triangles
+    objLoader.buildMeshlets();
+    if (verbose) {
+      printStatistics("meshlets", objLoader.cacheStatistics());
+    }
+  }
+}
+
+/// The outcome of the conversion of an asset (plain values, sent back by the conversion process)
+struct Measures {
+  /// The outcomes
+  enum Status
+  {
+    Converted, ///< the asset was converted
+    Skipped,   ///< the asset was up to date
+    Failed     ///< the asset could not be converted
+  };
+
+  int status;               ///< the Status
+  double checkTime;         ///< time spent hashing the inputs to find whether the asset is up to date, in seconds
+  double loadTime;          ///< time spent parsing the wavefront file, in seconds
+  double processTime;       ///< time spent generating the levels of detail, optimizing the indices and building the meshlets, in seconds
+  double saveTime;          ///< time spent writing the .glitter file, in seconds
+  std::uint64_t inputSize;  ///< size of the wavefront file, in bytes
+  std::uint64_t outputSize; ///< size of the .glitter file, in bytes
+  std::uint64_t nbVertices; ///< number of vertices (0 if skipped)
+  std::uint64_t nbIndices;  ///< number of indices of the full resolution IBOs (0 if skipped)
+  std::uint64_t peakMemory; ///< peak resident memory of the conversion, in bytes (0 if unknown)
+};
+
+/// An asset of the batch mode
+struct Conversion {
+  std::string input;  ///< the wavefront file
+  std::string output; ///< the .glitter file
+  Measures measures;  ///< the outcome of the conversion
+};
+
+/// @brief converts an asset, unless it is up to date (and @p force is not set)
+Measures convert(const Conversion & conversion, const Settings & settings, bool force)
+{
+  typedef std::chrono::steady_clock Clock;
+  Measures measures = {Measures::Failed, 0, 0, 0, 0, fileSize(conversion.input), 0, 0, 0, 0};
+  const std::string dependencies = conversion.output + ".deps";
+  Clock::time_point start = Clock::now();
+  const std::string key = MeshCache::key(conversion.input, settings.signature());
+  if (key.empty()) {
+    std::cerr << "Unable to read file: " << conversion.input << std::endl;
+    return measures;
+  }
+  const bool upToDate = not force and fileExists(conversion.output) and MeshCache::checkDependencies(dependencies, key);
+  measures.checkTime = std::chrono::duration<double>(Clock::now() - start).count();
+  if (upToDate) {
+    measures.status = Measures::Skipped;
+    measures.outputSize = fileSize(conversion.output);
+    return measures;
+  }
+
+  start = Clock::now();
+  ObjLoader objLoader(conversion.input);
+  measures.loadTime = std::chrono::duration<double>(Clock::now() - start).count();
+  start = Clock::now();
+  process(objLoader, settings, false);
+  measures.processTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+  // written under a temporary name, so that an interrupted conversion never leaves a partial file
+  start = Clock::now();
+  const std::string temporary = conversion.output + ".tmp";
+  if (not makeDirectories(basename(conversion.output)) or not GlitterMesh::save(temporary, objLoader, settings.compressed) or
+      std::rename(temporary.c_str(), conversion.output.c_str()) != 0 or not MeshCache::writeDependencies(dependencies, key, objLoader.sourceFiles())) {
+    std::cerr << "Unable to write file: " << conversion.output << std::endl;
+    std::remove(temporary.c_str());
+    return measures;
+  }
+  measures.saveTime = std::chrono::duration<double>(Clock::now() - start).count();
+  measures.status = Measures::Converted;
+  measures.outputSize = fileSize(conversion.output);
+  measures.nbVertices = objLoader.vertexPositions().size();
+  for (size_t k = 0; k < objLoader.nbIBOs(); k++) {
+    measures.nbIndices += objLoader.ibo(k).size();
+  }
+  return measures;
+}
+
+/// @brief the .glitter name of a wavefront file, in the output directory
+std::string outputName(const std::string & outputDirectory, const std::string & relativeInput)
+{
+  std::string name = relativeInput;
+  if (endsWith(name, ".obj")) {
+    name.resize(name.size() - 4);
+  }
+  return outputDirectory + "/" + name + ".glitter";
+}
+
+/// @brief adds the wavefront files of a directory and of its subdirectories, in name order
+void listDirectory(const std::string & directory, const std::string & relative, const std::string & outputDirectory, std::vector<Conversion> & conversions)
+{
+#ifndef _WIN32
+  std::vector<std::string> names;
+  if (DIR * handle = opendir((directory + relative).c_str())) {
+    while (dirent * entry = readdir(handle)) {
+      if (entry->d_name[0] != '.') {
+        names.push_back(entry->d_name);
+      }
+    }
+    closedir(handle);
+  }
+  std::sort(names.begin(), names.end());
+  for (const std::string & name : names) {
+    struct stat status;
+    if (stat((directory + relative + name).c_str(), &status) != 0) {
+      continue;
+    }
+    if (S_ISDIR(status.st_mode)) {
+      listDirectory(directory, relative + name + "/", outputDirectory, conversions);
+    } else if (endsWith(name, ".obj")) {
+      Conversion conversion = {directory + relative + name, outputName(outputDirectory, relative + name), Measures()};
+      conversions.push_back(conversion);
+    }
+  }
+#else
+  (void)directory, (void)relative, (void)outputDirectory, (void)conversions;
+  std::cerr << "Directories are not supported on Windows, use a manifest" << std::endl;
+#endif
+}
+
+/// @brief adds the wavefront files listed in a manifest, false if it cannot be read
+bool readManifest(const std::string & manifest, const std::string & outputDirectory, std::vector<Conversion> & conversions)
+{
+  std::ifstream file(manifest.c_str());
+  if (not file) {
+    std::cerr << "Unable to read file: " << manifest << std::endl;
+    return false;
+  }
+  const std::string directory = basename(manifest);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string input, output;
+    if (not(fields >> input) or input[0] == '#') {
+      continue;
+    }
+    Conversion conversion = {(input[0] == '/') ? input : directory + input, outputName(outputDirectory, input), Measures()};
+    if (fields >> output) {
+      conversion.output = outputDirectory + "/" + output;
+    }
+    conversions.push_back(conversion);
+  }
+  return true;
+}
+
+/// @brief prints the outcome of the conversion of an asset on one line
+void printConversion(size_t index, size_t count, const Conversion & conversion)
+{
+  static const char * statusNames[] = {"converted", "skipped  ", "FAILED   "};
+  const Measures & measures = conversion.measures;
+  std::cout << "[" << index + 1 << "/" << count << "] " << statusNames[measures.status] << " " << conversion.input;
+  if (measures.status == Measures::Converted) {
+    std::cout << std::fixed << std::setprecision(3) << " (" << measures.loadTime + measures.processTime + measures.saveTime << " s, " << std::setprecision(1)
+              << measures.outputSize / 1048576.0 << " MB)";
+  }
+  std::cout << std::endl;
+}
+
+/**
+ * @brief converts the assets, at most @p nbJobs at a time
+ *
+ * Each asset is converted in a child process, sending back its measures through a pipe: the
+ * conversions do not share any memory, the peak memory of each one can be measured, and an
+ * asset that cannot be loaded (ObjLoader exits on ill-formed files) only fails itself.
+ */
+void convertAll(std::vector<Conversion> & conversions, const Settings & settings, bool force, unsigned int nbJobs)
+{
+#ifndef _WIN32
+  struct Job {
+    pid_t pid;    ///< the conversion process
+    int fd;       ///< the read end of its pipe
+    size_t index; ///< the converted asset
+  };
+  std::vector<Job> jobs;
+  size_t next = 0;
+  size_t done = 0;
+  while (done < conversions.size()) {
+    while (jobs.size() < nbJobs and next < conversions.size()) {
+      int fds[2];
+      if (pipe(fds) != 0) {
+        break;
+      }
+      std::cout.flush();
+      pid_t pid = fork();
+      if (pid == 0) {
+        close(fds[0]);
+        Measures measures = convert(conversions[next], settings, force);
+        measures.peakMemory = peakMemory();
+        ssize_t written = ::write(fds[1], &measures, sizeof(measures));
+        _exit(written == sizeof(measures) ? 0 : 1);
+      }
+      close(fds[1]);
+      if (pid < 0) {
+        close(fds[0]);
+        break;
+      }
+      Job job = {pid, fds[0], next++};
+      jobs.push_back(job);
+    }
+    if (jobs.empty()) {
+      // no process could be started: the remaining assets are converted here
+      conversions[next].measures = convert(conversions[next], settings, force);
+      printConversion(done++, conversions.size(), conversions[next++]);
+      continue;
+    }
+    pid_t pid = wait(nullptr);
+    std::vector<Job>::iterator job = std::find_if(jobs.begin(), jobs.end(), [pid](const Job & job) { return job.pid == pid; });
+    if (job == jobs.end()) {
+      continue;
+    }
+    Measures & measures = conversions[job->index].measures;
+    if (read(job->fd, &measures, sizeof(measures)) != ssize_t(sizeof(measures))) {
+      measures = Measures();
+      measures.status = Measures::Failed;
+    }
+    close(job->fd);
+    printConversion(done++, conversions.size(), conversions[job->index]);
+    jobs.erase(job);
+  }
+#else
+  (void)nbJobs;
+  for (size_t k = 0; k < conversions.size(); k++) {
+    conversions[k].measures = convert(conversions[k], settings, force);
+    printConversion(k, conversions.size(), conversions[k]);
+  }
+#endif
+}
+
+/// @brief a JSON string
+std::string quoted(const std::string & text)
+{
+  std::ostringstream out;
+  out << '"';
+  for (char c : text) {
+    if (c == '"' or c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+/// @brief writes the measures of all the assets in a JSON file, false if it cannot be written
+bool writeReport(const std::string & filename, const std::vector<Conversion> & conversions, const Settings & settings, unsigned int nbJobs, double duration)
+{
+  static const char * statusNames[] = {"converted", "skipped", "failed"};
+  std::ofstream file(filename.c_str());
+  file << std::setprecision(6) << "{\n  \"settings\": " << quoted(settings.signature()) << ",\n  \"jobs\": " << nbJobs << ",\n  \"seconds\": " << duration << ",\n  \"assets\": [";
+  for (size_t k = 0; k < conversions.size(); k++) {
+    const Measures & measures = conversions[k].measures;
+    file << (k ? "," : "") << "\n    {\"input\": " << quoted(conversions[k].input) << ", \"output\": " << quoted(conversions[k].output) << ", \"status\": \""
+         << statusNames[measures.status] << "\", \"check_seconds\": " << measures.checkTime << ", \"load_seconds\": " << measures.loadTime
+         << ", \"process_seconds\": " << measures.processTime << ", \"save_seconds\": " << measures.saveTime << ", \"input_bytes\": " << measures.inputSize
+         << ", \"output_bytes\": " << measures.outputSize << ", \"vertices\": " << measures.nbVertices << ", \"triangles\": " << measures.nbIndices / 3
+         << ", \"peak_memory_bytes\": " << measures.peakMemory << "}";
+  }
+  file << "\n  ]\n}\n";
+  if (not file) {
+    std::cerr << "Unable to write file: " << filename << std::endl;
+    return false;
+  }
+  return true;
 }
 
 int main(int argc, char * argv[])
 {
-  if (argc != 3) {
+  Settings settings = {IndexOptimizer::VertexCacheOrder, 0, false, false};
+  unsigned int nbJobs = std::max(1u, std::thread::hardware_concurrency());
+  bool force = false;
+  std::string report;
+  std::vector<const char *> filenames;
+  for (int k = 1; k < argc; k++) {
+    if (!strcmp(argv[k], "--optimize") and k + 1 < argc) {
+      std::string name = argv[++k];
+      if (name == "none") {
+        settings.order = IndexOptimizer::FileOrder;
+      } else if (name == "cache") {
+        settings.order = IndexOptimizer::VertexCacheOrder;
+      } else if (name == "overdraw") {
+        settings.order = IndexOptimizer::OverdrawOrder;
+      } else {
+        printUsage(argc, argv);
+        return 1;
+      }
+    } else if (!strcmp(argv[k], "--lods") and k + 1 < argc) {
+      settings.nbLods = std::atoi(argv[++k]);
+    } else if (!strcmp(argv[k], "--meshlets")) {
+      settings.meshlets = true;
+    } else if (!strcmp(argv[k], "--compress")) {
+      settings.compressed = true;
+    } else if (!strcmp(argv[k], "--jobs") and k + 1 < argc) {
+      nbJobs = std::max(1, std::atoi(argv[++k]));
+    } else if (!strcmp(argv[k], "--force")) {
+      force = true;
+    } else if (!strcmp(argv[k], "--report") and k + 1 < argc) {
+      report = argv[++k];
+    } else {
+      filenames.push_back(argv[k]);
+    }
+  }
+  if (filenames.size() != 2) {
     printUsage(argc, argv);
     return 0;
   }
-  ObjLoader objLoader(argv[1]);
-  objLoader.saveBinaryFile(argv[2]);
+
+  if (endsWith(filenames[1], ".glitter")) {
+    ObjLoader objLoader(filenames[0]);
+    process(objLoader, settings, true);
+    objLoader.saveBinaryFile(filenames[1], 2, settings.compressed);
+    if (size_t peak = peakMemory()) {
+      std::cout << "peak memory " << std::fixed << std::setprecision(1) << peak / 1048576.0 << " MB\n";
+    }
+    return 0;
+  }
+
+  // batch mode (the inputs are resolved as by ObjLoader)
+  const std::string input = absolutename(filenames[0]);
+  const std::string outputDirectory = filenames[1];
+  std::vector<Conversion> conversions;
+#ifndef _WIN32
+  struct stat status;
+  const bool directory = stat(input.c_str(), &status) == 0 and S_ISDIR(status.st_mode);
+#else
+  const bool directory = false;
+#endif
+  if (directory) {
+    listDirectory(input + "/", "", outputDirectory, conversions);
+  } else if (not readManifest(input, outputDirectory, conversions)) {
+    return 1;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  convertAll(conversions, settings, force, nbJobs);
+  const double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  size_t counts[3] = {0, 0, 0};
+  for (const Conversion & conversion : conversions) {
+    counts[conversion.measures.status]++;
+  }
+  std::cout << counts[Measures::Converted] << " converted, " << counts[Measures::Skipped] << " up to date, " << counts[Measures::Failed] << " failed in " << std::fixed
+            << std::setprecision(2) << duration << " s (" << nbJobs << " jobs)\n";
+  if (not report.empty() and not writeReport(report, conversions, settings, nbJobs, duration)) {
+    return 1;
+  }
+  return counts[Measures::Failed] ? 1 : 0;
 }
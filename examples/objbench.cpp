@@ -0,0 +1,1747 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "CompactIndices.hpp"
+#include "GLState.hpp"
+#include "GlitterMesh.hpp"
+#include "MeshCache.hpp"
+#include "ObjLoader.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshletCuller.hpp"
+#include "ObjParser.hpp"
+#include "RenderQueue.hpp"
+#include "Serialize.hpp"
+#include "TangentGenerator.hpp"
+#include "VertexQuantizer.hpp"
+#include "VertexWelder.hpp"
+#include "glApi.hpp"
+#include "utils.hpp"
+#include <GLFW/glfw3.h>
+
+/// The meshes bundled with the repository, used when no file is given on the command line
+static const std::vector<std::string> bundledMeshes = {
+    "meshes/capsule.obj",
+    "meshes/Tron/TronLightCycle.obj",
+    "meshes/Pallet/Bswap_HPBake_Planks.obj",
+    "meshes/normalMappedCube/cube.obj",
+};
+
+/// Timing statistics over several runs (in milliseconds)
+struct Timings {
+  double min;
+  double mean;
+};
+
+/// Runs @p function @p repeat times and returns the timing statistics
+template <typename Function> Timings measure(unsigned int repeat, const Function & function)
+{
+  Timings timings = {1e30, 0};
+  for (unsigned int k = 0; k < repeat; k++) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto stop = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double, std::milli>(stop - start).count();
+    timings.min = std::min(timings.min, elapsed);
+    timings.mean += elapsed / repeat;
+  }
+  return timings;
+}
+
+size_t triangleCount(const ObjLoader & loader)
+{
+  size_t count = 0;
+  for (size_t k = 0; k < loader.nbIBOs(); k++) {
+    count += loader.ibo(k).size() / 3;
+  }
+  return count;
+}
+
+void printUsage(int /* argc */, char * argv[])
+{
+  std::cout << "Usage: " << argv[0] << " <command> [--repeat N] [--synthetic MB] [--floats M] [file.obj ...]\n\n"
+            << "The following commands are available:\n"
+            << "  parse       compare the load time of the native and the tinyobjloader wavefront parsers\n"
+            << "  threads     scaling of the native parser with 1, 2, 4, 8 and 16 threads\n"
+            << "  weld        compare the spatial hash welder with the legacy (unordered_map based) one\n"
+            << "  tangents    compare the scalar, SSE and AVX2 tangent kernels with the legacy implementation\n"
+            << "  indices     vertex cache statistics (ACMR, ATVR) and cost of the index orders\n"
+            << "  lods        levels of detail: triangles, geometric errors and simplification time\n"
+            << "  meshlets    meshlet sizes, build time, and culling rate and cost from viewpoints around the mesh\n"
+            << "  quantize    memory of the compact vertex formats, encoding time and decoding errors\n"
+            << "  layout      vertex fetch of separate (SoA) and interleaved (AoS) attributes: simulated cache misses and CPU gather time\n"
+            << "  indexwidth  memory of 32-bit and narrowed IBOs (see CompactIndices), .glitter file sizes and index read throughput\n"
+            << "  glitter     load time and resident memory of the .glitter v1 reader, the v2 reader and the v2 memory mapping (full, geometry only, checksummed)\n"
+            << "  compress    .glitter chunk compression: ratio, and load time with a cold and a warm page cache, with 1 and all threads\n"
+            << "  cache       load time without the mesh cache, on a miss (parsing and insertion), on a hit, and time to read the files of a hit\n"
+            << "  io          load time of the version 1 .glitter files with each byte source (stream, file descriptor, mmap, io_uring)\n"
+            << "  serialize   byte swapping (per value and bulk) and serialization (per value stream calls, buffered, bulk) of --floats millions of floats (100 by default)\n"
+            << "  uniforms    CPU cost of setting a uniform: lookup at each call (legacy), by name, with a resolved handle; and of the camera upload: in each program or in a uniform buffer (needs an OpenGL 4.1 context)\n"
+            << "  state       GL binding calls issued and skipped, and CPU time of a frame of PA5 parts, without the GLState cache, with it, and with lazy unbinds (needs an OpenGL 4.1 context)\n"
+            << "  queue       CPU time and GL calls of a frame of many mesh instances, drawn in submission order and sorted by state (see RenderQueue, needs an OpenGL 4.1 context)\n"
+            << "  instancing  CPU time of a frame of the visible pieces of NxNxN Rubik's cubes: a draw per piece, and a single instanced draw, the matrices being streamed or not (needs an OpenGL 4.1 context)\n\n"
+            << "When no file is given, the meshes bundled in the repository are used.\n"
+            << "--synthetic generates (and benchmarks) a grid mesh of roughly the given size in megabytes.\n";
+}
+
+/// parse command: load time of each wavefront parser
+void benchParse(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(10) << "parser" << std::right << std::setw(10) << "vertices" << std::setw(11) << "triangles" << std::setw(11) << "min (ms)"
+            << std::setw(11) << "mean (ms)" << std::setw(9) << "speedup" << "\n";
+  for (const std::string & filename : filenames) {
+    const ObjLoader::Options::Parser parsers[] = {ObjLoader::Options::TinyObjParser, ObjLoader::Options::NativeParser};
+    const char * parserNames[] = {"tinyobj", "native"};
+    double reference = 0;
+    for (int p = 0; p < 2; p++) {
+      ObjLoader::Options options;
+      options.parser = parsers[p];
+      size_t nbVertices = 0;
+      size_t nbTriangles = 0;
+      Timings timings = measure(repeat, [&]() {
+        ObjLoader loader(filename, options);
+        nbVertices = loader.vertexPositions().size();
+        nbTriangles = triangleCount(loader);
+      });
+      if (p == 0) {
+        reference = timings.min;
+      }
+      std::cout << std::left << std::setw(40) << filename << std::setw(10) << parserNames[p] << std::right << std::setw(10) << nbVertices << std::setw(11) << nbTriangles << std::fixed
+                << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << std::setw(8) << reference / timings.min << "x\n";
+    }
+  }
+}
+
+/// Writes a grid mesh of roughly @p megabytes MB, with several material runs, and returns its name
+std::string makeSyntheticMesh(unsigned int megabytes)
+{
+  // about 150 bytes of text per grid vertex (v + vt + vn + 2 faces)
+  const size_t side = static_cast<size_t>(std::sqrt(megabytes * 1e6 / 150.)) + 2;
+  std::string filename = "/tmp/objbench_synthetic.obj";
+  std::ofstream file(filename.c_str());
+  file << "mtllib objbench_synthetic.mtl\n";
+  for (size_t i = 0; i < side; i++) {
+    for (size_t j = 0; j < side; j++) {
+      float x = i / float(side - 1);
+      float y = j / float(side - 1);
+      file << "v " << x << " " << y << " " << 0.1f * std::sin(10 * x) * std::cos(10 * y) << "\n";
+      file << "vt " << x << " " << y << "\n";
+      file << "vn 0 0 1\n";
+    }
+  }
+  for (size_t i = 0; i + 1 < side; i++) {
+    file << "usemtl material" << (i % 4) << "\n";
+    for (size_t j = 0; j + 1 < side; j++) {
+      size_t a = i * side + j + 1;
+      size_t b = a + side;
+      file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " " << b + 1 << "/" << b + 1 << "/" << b + 1 << " " << a + 1 << "/" << a + 1 << "/" << a + 1 << "\n";
+    }
+  }
+  std::ofstream mtl("/tmp/objbench_synthetic.mtl");
+  for (int k = 0; k < 4; k++) {
+    mtl << "newmtl material" << k << "\nKd " << k / 4. << " 0.5 0.5\n";
+  }
+  return filename;
+}
+
+template <typename T> bool sameContent(const std::vector<T> & a, const std::vector<T> & b)
+{
+  return a.size() == b.size() and (a.empty() or !memcmp(a.data(), b.data(), a.size() * sizeof(T)));
+}
+
+/// threads command: scaling of the native parser
+void benchThreads(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  const unsigned int threadCounts[] = {1, 2, 4, 8, 16};
+  std::cout << std::left << std::setw(40) << "mesh" << std::right << std::setw(8) << "threads" << std::setw(13) << "parse (ms)" << std::setw(9) << "speedup" << std::setw(12) << "load (ms)"
+            << std::setw(9) << "speedup" << std::setw(11) << "identical" << "\n";
+  for (const std::string & filename : filenames) {
+    std::string absolutePath = absolutename(filename);
+    std::string rootDir = basename(absolutePath);
+    ObjParser reference;
+    reference.parseFile(absolutePath, rootDir, 1);
+    double parseReference = 0;
+    double loadReference = 0;
+    for (unsigned int nbThreads : threadCounts) {
+      bool identical = true;
+      Timings parseTimings = measure(repeat, [&]() {
+        ObjParser parser;
+        parser.parseFile(absolutePath, rootDir, nbThreads);
+        identical = identical and sameContent(parser.positions(), reference.positions()) and sameContent(parser.colors(), reference.colors()) and
+                    sameContent(parser.uvs(), reference.uvs()) and sameContent(parser.normals(), reference.normals()) and sameContent(parser.corners(), reference.corners()) and
+                    sameContent(parser.triangleMaterials(), reference.triangleMaterials());
+      });
+      ObjLoader::Options options;
+      options.nbThreads = nbThreads;
+      Timings loadTimings = measure(repeat, [&]() { ObjLoader loader(filename, options); });
+      if (nbThreads == 1) {
+        parseReference = parseTimings.min;
+        loadReference = loadTimings.min;
+      }
+      std::cout << std::left << std::setw(40) << filename << std::right << std::setw(8) << nbThreads << std::fixed << std::setprecision(2) << std::setw(13) << parseTimings.min << std::setw(8)
+                << parseReference / parseTimings.min << "x" << std::setw(12) << loadTimings.min << std::setw(8) << loadReference / loadTimings.min << "x" << std::setw(11)
+                << (identical ? "yes" : "NO") << "\n";
+    }
+  }
+}
+
+/// The vertex welding performed by ObjLoader before VertexWelder, kept as a reference
+struct LegacyPackedVertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec3 tangent;
+  glm::vec4 color;
+  glm::vec2 uv;
+
+  bool operator==(const LegacyPackedVertex & other) const
+  {
+    return is_near(position, other.position) and is_near(normal, other.normal) and is_near(tangent, other.tangent) and is_near(uv, other.uv) and is_near(color, other.color);
+  }
+
+  static bool is_near(float v1, float v2, float epsilon = 1e-2) { return fabs(v1 - v2) < epsilon; }
+
+  static bool is_near(const glm::vec2 & vecA, const glm::vec2 & vecB) { return is_near(vecA[0], vecB[0]) and is_near(vecA[1], vecB[1]); }
+
+  static bool is_near(const glm::vec3 & vecA, const glm::vec3 & vecB) { return is_near(vecA[0], vecB[0]) and is_near(vecA[1], vecB[1]) and is_near(vecA[2], vecB[2]); }
+
+  static bool is_near(const glm::vec4 & vecA, const glm::vec4 & vecB)
+  {
+    const float epsilon = 1 / 256.f;
+    return is_near(vecA[0], vecB[0], epsilon) and is_near(vecA[1], vecB[1], epsilon) and is_near(vecA[2], vecB[2], epsilon) and is_near(vecA[3], vecB[3], epsilon);
+  }
+};
+
+struct LegacyPackedVertexHash {
+  std::size_t operator()(const LegacyPackedVertex & v) const
+  {
+    std::size_t hashes[] = {std::hash<float>()(v.position.x), std::hash<float>()(v.position.y), std::hash<float>()(v.position.z), std::hash<float>()(v.normal.x),  std::hash<float>()(v.normal.y),
+                            std::hash<float>()(v.normal.z),   std::hash<float>()(v.tangent.x),  std::hash<float>()(v.tangent.y),  std::hash<float>()(v.tangent.z), std::hash<float>()(v.color.x),
+                            std::hash<float>()(v.color.y),    std::hash<float>()(v.color.z),    std::hash<float>()(v.color.w),    std::hash<float>()(v.uv.x),      std::hash<float>()(v.uv.y)};
+    std::size_t seed = 0;
+    for (std::size_t h : hashes) {
+      // from boost::hash_combine
+      seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+  }
+};
+
+size_t legacyWeld(const ObjLoader & loader, std::vector<unsigned int> & remap)
+{
+  const size_t nbVertices = loader.vertexPositions().size();
+  std::unordered_map<LegacyPackedVertex, unsigned int, LegacyPackedVertexHash> uniqueVertexIndices;
+  uniqueVertexIndices.reserve(nbVertices);
+  remap.resize(nbVertices);
+  for (size_t k = 0; k < nbVertices; k++) {
+    LegacyPackedVertex vertex = {loader.vertexPositions()[k], loader.vertexNormals()[k], loader.vertexTangents()[k], loader.vertexColors()[k], loader.vertexUVs()[k]};
+    auto it = uniqueVertexIndices.find(vertex);
+    if (it != uniqueVertexIndices.end()) {
+      remap[k] = it->second;
+    } else {
+      unsigned int index = uniqueVertexIndices.size();
+      uniqueVertexIndices[vertex] = index;
+      remap[k] = index;
+    }
+  }
+  return uniqueVertexIndices.size();
+}
+
+/// number of triangles of @p loader collapsed (i.e. with a repeated vertex) by a welding @p remap
+size_t collapsedTriangles(const ObjLoader & loader, const std::vector<unsigned int> & remap)
+{
+  size_t count = 0;
+  for (size_t k = 0; k < loader.nbIBOs(); k++) {
+    const std::vector<unsigned int> & ibo = loader.ibo(k);
+    for (size_t t = 0; t + 2 < ibo.size(); t += 3) {
+      unsigned int a = remap[ibo[t]];
+      unsigned int b = remap[ibo[t + 1]];
+      unsigned int c = remap[ibo[t + 2]];
+      count += (a == b or b == c or c == a);
+    }
+  }
+  return count;
+}
+
+/// weld command: welded vertex counts and timings of both welders
+void benchWeld(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(13) << "welder" << std::right << std::setw(10) << "corners" << std::setw(10) << "welded" << std::setw(11) << "collapsed" << std::setw(11) << "min (ms)"
+            << std::setw(11) << "mean (ms)" << std::setw(9) << "speedup" << "\n";
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.weldVertices = false;
+    ObjLoader loader(filename, options);
+    const size_t nbCorners = loader.vertexPositions().size();
+    std::vector<unsigned int> remap;
+
+    size_t legacyCount = 0;
+    Timings legacyTimings = measure(repeat, [&]() { legacyCount = legacyWeld(loader, remap); });
+    std::cout << std::left << std::setw(40) << filename << std::setw(13) << "legacy" << std::right << std::setw(10) << nbCorners << std::setw(10) << legacyCount << std::setw(11) << collapsedTriangles(loader, remap) << std::fixed
+              << std::setprecision(2) << std::setw(11) << legacyTimings.min << std::setw(11) << legacyTimings.mean << std::setw(8) << 1. << "x\n";
+
+    VertexWelder welder;
+    size_t count = 0;
+    Timings timings = measure(repeat, [&]() {
+      count = welder.weld(loader.vertexPositions(), loader.vertexNormals(), loader.vertexTangents(), loader.vertexColors(), loader.vertexUVs(), remap);
+    });
+    std::cout << std::left << std::setw(40) << filename << std::setw(13) << "spatial hash" << std::right << std::setw(10) << nbCorners << std::setw(10) << count << std::setw(11) << collapsedTriangles(loader, remap) << std::fixed
+              << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << std::setw(8) << legacyTimings.min / timings.min << "x\n";
+  }
+}
+
+/// The tangent computation performed by ObjLoader before TangentGenerator, kept as a reference
+void legacyTangents(const ObjLoader & loader, std::vector<glm::vec3> & tangents)
+{
+  const std::vector<glm::vec3> & positions = loader.vertexPositions();
+  const std::vector<glm::vec3> & normals = loader.vertexNormals();
+  const std::vector<glm::vec2> & uvs = loader.vertexUVs();
+  glm::vec3 tangent;
+  tangents.clear();
+  for (unsigned int i = 0; i < positions.size(); i += 3) {
+    glm::vec2 deltaUV1 = uvs[i + 1] - uvs[i];
+    glm::vec2 deltaUV2 = uvs[i + 2] - uvs[i];
+    float detDenom = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+    if (detDenom != 0) {
+      glm::vec3 deltaPos1 = positions[i + 1] - positions[i];
+      glm::vec3 deltaPos2 = positions[i + 2] - positions[i];
+      float r = 1.0f / detDenom;
+      tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+    }
+    tangents.push_back(tangent);
+    tangents.push_back(tangent);
+    tangents.push_back(tangent);
+  }
+  for (unsigned int i = 0; i < positions.size(); i += 1) {
+    glm::vec3 & t = tangents[i];
+    t = glm::normalize(t - normals[i] * glm::dot(normals[i], t));
+  }
+}
+
+/// largest component-wise difference between @p a and @p b
+float maxDeviation(const std::vector<glm::vec3> & a, const std::vector<glm::vec3> & b)
+{
+  float deviation = 0;
+  for (size_t k = 0; k < a.size(); k++) {
+    for (int c = 0; c < 3; c++) {
+      deviation = std::max(deviation, std::fabs(a[k][c] - b[k][c]));
+    }
+  }
+  return deviation;
+}
+
+/// tangents command: timings of the tangent kernels
+void benchTangents(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(16) << "kernel" << std::right << std::setw(10) << "corners" << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)"
+            << std::setw(9) << "speedup" << std::setw(13) << "deviation" << "\n";
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.weldVertices = false;
+    ObjLoader loader(filename, options);
+    const size_t nbCorners = loader.vertexPositions().size();
+    std::vector<glm::vec3> tangents;
+    Timings legacyTimings = measure(repeat, [&]() { legacyTangents(loader, tangents); });
+    std::cout << std::left << std::setw(40) << filename << std::setw(16) << "legacy" << std::right << std::setw(10) << nbCorners << std::fixed << std::setprecision(2) << std::setw(11)
+              << legacyTimings.min << std::setw(11) << legacyTimings.mean << std::setw(8) << 1. << "x" << std::setw(13) << "-" << "\n";
+
+    // deviations are measured against the scalar kernel
+    std::vector<glm::vec3> reference;
+    TangentGenerator(TangentGenerator::FaceTangents, TangentGenerator::ScalarIsa).compute(loader.vertexPositions(), loader.vertexNormals(), loader.vertexUVs(), loader.vertexColors(), reference);
+    const TangentGenerator::Isa isas[] = {TangentGenerator::ScalarIsa, TangentGenerator::SSEIsa, TangentGenerator::AVX2Isa};
+    for (int mode = 0; mode < 2; mode++) {
+      for (TangentGenerator::Isa isa : isas) {
+        if (not TangentGenerator::supported(isa)) {
+          continue;
+        }
+        TangentGenerator generator(mode == 0 ? TangentGenerator::FaceTangents : TangentGenerator::VertexTangents, isa);
+        Timings timings = measure(repeat, [&]() { generator.compute(loader.vertexPositions(), loader.vertexNormals(), loader.vertexUVs(), loader.vertexColors(), tangents); });
+        std::string name = std::string(mode == 0 ? "face " : "vertex ") + TangentGenerator::isaName(isa);
+        std::cout << std::left << std::setw(40) << filename << std::setw(16) << name << std::right << std::setw(10) << nbCorners << std::fixed << std::setprecision(2) << std::setw(11)
+                  << timings.min << std::setw(11) << timings.mean << std::setw(8) << legacyTimings.min / timings.min << "x" << std::scientific << std::setprecision(2) << std::setw(13)
+                  << maxDeviation(tangents, reference) << "\n";
+      }
+    }
+  }
+}
+
+/// indices command: vertex cache efficiency of the index orders
+void benchIndices(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(10) << "order" << std::right << std::setw(11) << "triangles" << std::setw(8) << "ACMR" << std::setw(8) << "ATVR"
+            << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << "\n";
+  const IndexOptimizer::Order orders[] = {IndexOptimizer::FileOrder, IndexOptimizer::VertexCacheOrder, IndexOptimizer::OverdrawOrder};
+  const char * orderNames[] = {"file", "cache", "overdraw"};
+  for (const std::string & filename : filenames) {
+    ObjLoader loader(filename);
+    std::vector<std::vector<unsigned int>> reference;
+    for (size_t k = 0; k < loader.nbIBOs(); k++) {
+      reference.push_back(loader.ibo(k));
+    }
+    const size_t nbVertices = loader.vertexPositions().size();
+    for (int o = 0; o < 3; o++) {
+      std::vector<std::vector<unsigned int>> ibos;
+      Timings timings = measure(repeat, [&]() {
+        ibos = reference;
+        if (orders[o] == IndexOptimizer::FileOrder) {
+          return;
+        }
+        for (auto & ibo : ibos) {
+          std::vector<size_t> deadEnds;
+          IndexOptimizer::optimizeVertexCache(ibo, nbVertices, IndexOptimizer::defaultCacheSize, &deadEnds);
+          if (orders[o] == IndexOptimizer::OverdrawOrder) {
+            IndexOptimizer::optimizeOverdraw(ibo, deadEnds, loader.vertexPositions());
+          }
+        }
+        std::vector<unsigned int> remap;
+        IndexOptimizer::optimizeVertexFetch(ibos, nbVertices, remap);
+      });
+      IndexOptimizer::Statistics statistics = IndexOptimizer::analyze(ibos, nbVertices);
+      std::cout << std::left << std::setw(40) << filename << std::setw(10) << orderNames[o] << std::right << std::setw(11) << statistics.nbTriangles << std::fixed << std::setprecision(3)
+                << std::setw(8) << statistics.acmr << std::setw(8) << statistics.atvr << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << "\n";
+    }
+  }
+}
+
+/// lods command: levels of detail generated for each IBO
+void benchLods(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::right << std::setw(6) << "level" << std::setw(11) << "triangles" << std::setw(9) << "ratio" << std::setw(12) << "error"
+            << std::setw(14) << "error/radius" << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << "\n";
+  for (const std::string & filename : filenames) {
+    ObjLoader loader(filename);
+    const std::vector<glm::vec3> & positions = loader.vertexPositions();
+    glm::vec3 lower(1e30f), upper(-1e30f);
+    for (const glm::vec3 & p : positions) {
+      lower = glm::min(lower, p);
+      upper = glm::max(upper, p);
+    }
+    const float radius = 0.5f * glm::length(upper - lower);
+    std::vector<std::vector<MeshSimplifier::Level>> chains(loader.nbIBOs());
+    Timings timings = measure(repeat, [&]() {
+      MeshSimplifier simplifier(positions);
+      for (size_t k = 0; k < loader.nbIBOs(); k++) {
+        chains[k] = simplifier.buildChain(loader.ibo(k), 6);
+      }
+    });
+    // levels are summed over the IBOs, the error being the largest one
+    const size_t fullTriangles = triangleCount(loader);
+    for (unsigned int l = 0;; l++) {
+      size_t nbTriangles = 0;
+      float error = 0;
+      bool any = (l == 0);
+      for (size_t k = 0; k < loader.nbIBOs(); k++) {
+        const std::vector<MeshSimplifier::Level> & chain = chains[k];
+        if (l == 0 or chain.empty()) {
+          nbTriangles += loader.ibo(k).size() / 3;
+        } else {
+          const MeshSimplifier::Level & level = chain[std::min<size_t>(l, chain.size()) - 1];
+          any = any or l <= chain.size();
+          nbTriangles += level.ibo.size() / 3;
+          error = std::max(error, level.error);
+        }
+      }
+      if (not any) {
+        break;
+      }
+      std::cout << std::left << std::setw(40) << filename << std::right << std::setw(6) << l << std::setw(11) << nbTriangles << std::fixed << std::setprecision(3) << std::setw(9)
+                << nbTriangles / double(std::max<size_t>(1, fullTriangles)) << std::scientific << std::setprecision(2) << std::setw(12) << error << std::setw(14) << error / radius;
+      if (l == 0) {
+        std::cout << std::fixed << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean;
+      }
+      std::cout << "\n";
+    }
+  }
+}
+
+/// meshlets command: meshlet statistics, and culling from viewpoints around the mesh
+void benchMeshlets(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::right << std::setw(10) << "meshlets" << std::setw(10) << "vertices" << std::setw(11) << "triangles" << std::setw(8) << "ACMR"
+            << std::setw(11) << "build (ms)" << std::setw(10) << "visible" << std::setw(9) << "ranges" << std::setw(11) << "cull (us)" << "\n";
+  const unsigned int nbViews = 32;
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.indexOrder = IndexOptimizer::VertexCacheOrder;
+    ObjLoader loader(filename, options);
+    const std::vector<glm::vec3> & positions = loader.vertexPositions();
+    std::vector<std::vector<unsigned int>> ibos;
+    std::vector<std::vector<MeshletBuilder::Meshlet>> meshlets(loader.nbIBOs());
+    Timings timings = measure(repeat, [&]() {
+      ibos.clear();
+      for (size_t k = 0; k < loader.nbIBOs(); k++) {
+        ibos.push_back(loader.ibo(k));
+        meshlets[k] = MeshletBuilder::build(ibos.back(), positions);
+      }
+    });
+    size_t nbMeshlets = 0, nbVertices = 0, nbTriangles = 0;
+    for (const auto & list : meshlets) {
+      for (const MeshletBuilder::Meshlet & meshlet : list) {
+        nbMeshlets++;
+        nbVertices += meshlet.nbVertices;
+        nbTriangles += meshlet.nbTriangles;
+      }
+    }
+
+    // viewpoints on a circle around the mesh, with a 60 degrees field of view
+    glm::vec3 lower(1e30f), upper(-1e30f);
+    for (const glm::vec3 & p : positions) {
+      lower = glm::min(lower, p);
+      upper = glm::max(upper, p);
+    }
+    const glm::vec3 center = 0.5f * (lower + upper);
+    const float radius = std::max(1e-6f, 0.5f * glm::length(upper - lower));
+    const glm::mat4 proj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.01f * radius, 100 * radius);
+    size_t nbVisible = 0, nbRanges = 0;
+    double cullTime = 0;
+    std::vector<unsigned int> firsts, counts;
+    for (unsigned int v = 0; v < nbViews; v++) {
+      float angle = 2 * glm::pi<float>() * v / nbViews;
+      glm::vec3 eye = center + 1.5f * radius * glm::vec3(std::cos(angle), 0.3f, std::sin(angle));
+      glm::mat4 view = glm::lookAt(eye, center + 0.5f * radius * glm::vec3(std::sin(angle), 0, -std::cos(angle)), glm::vec3(0, 1, 0));
+      MeshletCuller culler(proj * view, eye);
+      cullTime += measure(repeat, [&]() {
+                    for (size_t k = 0; k < meshlets.size(); k++) {
+                      culler.ranges(meshlets[k], firsts, counts);
+                    }
+                  }).min;
+      for (size_t k = 0; k < meshlets.size(); k++) {
+        culler.ranges(meshlets[k], firsts, counts);
+        nbRanges += firsts.size();
+        for (unsigned int count : counts) {
+          nbVisible += count / 3;
+        }
+      }
+    }
+    IndexOptimizer::Statistics statistics = IndexOptimizer::analyze(ibos, positions.size());
+    std::cout << std::left << std::setw(40) << filename << std::right << std::setw(10) << nbMeshlets << std::fixed << std::setprecision(1) << std::setw(10)
+              << nbVertices / double(std::max<size_t>(1, nbMeshlets)) << std::setw(11) << nbTriangles / double(std::max<size_t>(1, nbMeshlets)) << std::setprecision(3) << std::setw(8)
+              << statistics.acmr << std::setprecision(2) << std::setw(11) << timings.min << std::setprecision(1) << std::setw(9)
+              << 100. * nbVisible / std::max<size_t>(1, nbViews * nbTriangles) << "%" << std::setw(9) << nbRanges / double(nbViews) << std::setw(11) << 1000 * cullTime / nbViews << "\n";
+  }
+}
+
+/// quantize command: compact vertex formats
+void benchQuantize(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(7) << "dirs" << std::right << std::setw(10) << "vertices" << std::setw(11) << "float (KB)" << std::setw(13)
+            << "compact (KB)" << std::setw(7) << "ratio" << std::setw(11) << "min (ms)" << std::setw(11) << "position" << std::setw(10) << "normal" << std::setw(10) << "tangent"
+            << std::setw(10) << "uv" << std::setw(10) << "color" << "\n";
+  const size_t floatSize = 2 * sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec4) + sizeof(glm::vec2);
+  const VertexQuantizer::DirectionFormat formats[] = {VertexQuantizer::Octahedral16, VertexQuantizer::Octahedral8};
+  const char * formatNames[] = {"16-bit", "8-bit"};
+  for (const std::string & filename : filenames) {
+    ObjLoader loader(filename);
+    const size_t nbVertices = loader.vertexPositions().size();
+    for (int f = 0; f < 2; f++) {
+      VertexQuantizer quantizer(loader.vertexPositions());
+      Timings timings = measure(repeat, [&]() {
+        quantizer.encodePositions(loader.vertexPositions());
+        if (formats[f] == VertexQuantizer::Octahedral16) {
+          VertexQuantizer::encodeDirections16(loader.vertexNormals());
+          VertexQuantizer::encodeDirections16(loader.vertexTangents());
+        } else {
+          VertexQuantizer::encodeDirections8(loader.vertexNormals());
+          VertexQuantizer::encodeDirections8(loader.vertexTangents());
+        }
+        VertexQuantizer::encodeUVs(loader.vertexUVs());
+        VertexQuantizer::encodeColors(loader.vertexColors());
+      });
+      VertexQuantizer::Errors errors =
+          quantizer.measure(loader.vertexPositions(), loader.vertexNormals(), loader.vertexTangents(), loader.vertexUVs(), loader.vertexColors(), formats[f]);
+      const size_t compactSize = VertexQuantizer::vertexSize(formats[f]);
+      std::cout << std::left << std::setw(40) << filename << std::setw(7) << formatNames[f] << std::right << std::setw(10) << nbVertices << std::fixed << std::setprecision(1)
+                << std::setw(11) << nbVertices * floatSize / 1024. << std::setw(13) << nbVertices * compactSize / 1024. << std::setprecision(2) << std::setw(7)
+                << floatSize / double(compactSize) << std::setw(11) << timings.min << std::scientific << std::setprecision(1) << std::setw(11) << errors.position << std::fixed
+                << std::setprecision(3) << std::setw(9) << errors.normal << "d" << std::setw(9) << errors.tangent << "d" << std::scientific << std::setprecision(1) << std::setw(10)
+                << errors.uv << std::setw(10) << errors.color << "\n";
+    }
+  }
+  std::cout << "position: largest error relative to the bounding box diagonal, normal/tangent: largest angle in degrees, uv/color: largest component error\n";
+}
+
+/**
+ * @brief Direct-mapped cache of 64-byte lines, a rough model of the vertex fetch cache
+ */
+class FetchCache {
+public:
+  FetchCache() : m_tags(256, ~size_t(0)), m_misses(0) {}
+
+  /// @brief reads @p size bytes at @p address
+  void read(const void * address, size_t size)
+  {
+    size_t first = reinterpret_cast<size_t>(address) >> 6;
+    size_t last = (reinterpret_cast<size_t>(address) + size - 1) >> 6;
+    for (size_t line = first; line <= last; line++) {
+      size_t & tag = m_tags[line % m_tags.size()];
+      if (tag != line) {
+        tag = line;
+        m_misses++;
+      }
+    }
+  }
+
+  /// @brief number of lines loaded so far
+  size_t misses() const
+  {
+    return m_misses;
+  }
+
+private:
+  std::vector<size_t> m_tags; ///< the line cached in each slot
+  size_t m_misses;            ///< number of lines loaded
+};
+
+/// layout command: vertex fetch of separate and interleaved attributes
+void benchLayout(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(7) << "order" << std::setw(13) << "layout" << std::right << std::setw(11) << "indices" << std::setw(14)
+            << "lines/vertex" << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << "\n";
+  const IndexOptimizer::Order orders[] = {IndexOptimizer::FileOrder, IndexOptimizer::VertexCacheOrder};
+  const char * orderNames[] = {"file", "cache"};
+  const GLuint stride = ObjLoader::VertexLayout::stride;
+  for (const std::string & filename : filenames) {
+    for (int o = 0; o < 2; o++) {
+      ObjLoader::Options options;
+      options.indexOrder = orders[o];
+      ObjLoader loader(filename, options);
+      const std::vector<glm::vec3> & positions = loader.vertexPositions();
+      const std::vector<glm::vec2> & uvs = loader.vertexUVs();
+      const std::vector<glm::vec3> & normals = loader.vertexNormals();
+      const std::vector<glm::vec3> & tangents = loader.vertexTangents();
+      const std::vector<unsigned char> vertices = loader.interleavedVertices();
+      const std::vector<AttributeFormat> formats = ObjLoader::VertexLayout::formats();
+      size_t nbIndices = 0;
+      for (size_t k = 0; k < loader.nbIBOs(); k++) {
+        nbIndices += loader.ibo(k).size();
+      }
+
+      // the gather of all the attributes of each index, summed so that it is not optimized out
+      volatile float sum = 0;
+      auto fetchSeparate = [&](FetchCache * cache) {
+        glm::vec3 accumulator(0);
+        for (size_t k = 0; k < loader.nbIBOs(); k++) {
+          for (unsigned int index : loader.ibo(k)) {
+            accumulator += positions[index] + normals[index] + tangents[index] + glm::vec3(uvs[index], 0);
+            if (cache) {
+              cache->read(&positions[index], sizeof(glm::vec3));
+              cache->read(&uvs[index], sizeof(glm::vec2));
+              cache->read(&normals[index], sizeof(glm::vec3));
+              cache->read(&tangents[index], sizeof(glm::vec3));
+            }
+          }
+        }
+        sum = accumulator.x + accumulator.y + accumulator.z;
+      };
+      auto fetchInterleaved = [&](FetchCache * cache) {
+        glm::vec3 accumulator(0);
+        for (size_t k = 0; k < loader.nbIBOs(); k++) {
+          for (unsigned int index : loader.ibo(k)) {
+            const unsigned char * vertex = vertices.data() + size_t(index) * stride;
+            glm::vec3 position, normal, tangent;
+            glm::vec2 uv;
+            std::memcpy(&position, vertex + formats[0].offset, sizeof(glm::vec3));
+            std::memcpy(&uv, vertex + formats[1].offset, sizeof(glm::vec2));
+            std::memcpy(&normal, vertex + formats[2].offset, sizeof(glm::vec3));
+            std::memcpy(&tangent, vertex + formats[3].offset, sizeof(glm::vec3));
+            accumulator += position + normal + tangent + glm::vec3(uv, 0);
+            if (cache) {
+              cache->read(vertex, stride);
+            }
+          }
+        }
+        sum = accumulator.x + accumulator.y + accumulator.z;
+      };
+
+      FetchCache separateCache, interleavedCache;
+      fetchSeparate(&separateCache);
+      fetchInterleaved(&interleavedCache);
+      Timings separateTimings = measure(repeat, [&]() { fetchSeparate(nullptr); });
+      Timings interleavedTimings = measure(repeat, [&]() { fetchInterleaved(nullptr); });
+      for (size_t v = 0; v < positions.size(); v++) {
+        const unsigned char * vertex = vertices.data() + v * stride;
+        if (std::memcmp(vertex + formats[0].offset, &positions[v], sizeof(glm::vec3)) or std::memcmp(vertex + formats[1].offset, &uvs[v], sizeof(glm::vec2))
+            or std::memcmp(vertex + formats[2].offset, &normals[v], sizeof(glm::vec3)) or std::memcmp(vertex + formats[3].offset, &tangents[v], sizeof(glm::vec3))) {
+          std::cerr << "layout: the interleaved vertex " << v << " differs from the separate attributes\n";
+          break;
+        }
+      }
+      const char * layoutNames[] = {"separate", "interleaved"};
+      const FetchCache * caches[] = {&separateCache, &interleavedCache};
+      const Timings * timings[] = {&separateTimings, &interleavedTimings};
+      for (int l = 0; l < 2; l++) {
+        std::cout << std::left << std::setw(40) << filename << std::setw(7) << orderNames[o] << std::setw(13) << layoutNames[l] << std::right << std::setw(11) << nbIndices
+                  << std::fixed << std::setprecision(3) << std::setw(14) << caches[l]->misses() / double(std::max<size_t>(1, nbIndices)) << std::setprecision(2) << std::setw(11)
+                  << timings[l]->min << std::setw(11) << timings[l]->mean << "\n";
+      }
+    }
+  }
+  std::cout << "lines/vertex: 64-byte lines loaded per index by a 16 KB direct-mapped cache\n";
+}
+
+/// @brief sum of the vertices referenced by indices, read as the vertex fetch would do
+template <typename T> unsigned int sumIndices(const std::vector<T> & indices, unsigned int baseVertex)
+{
+  unsigned int sum = 0;
+  for (T index : indices) {
+    sum += baseVertex + index;
+  }
+  return sum;
+}
+
+/// indexwidth command: narrowed IBOs
+void benchIndexWidth(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::right << std::setw(7) << "parts" << std::setw(7) << "8-bit" << std::setw(8) << "16-bit" << std::setw(8) << "32-bit"
+            << std::setw(11) << "u32 (KB)" << std::setw(13) << "compact (KB)" << std::setw(12) << "file ratio" << std::setw(11) << "u32 (ms)" << std::setw(13) << "compact (ms)"
+            << std::setw(12) << "Gindices/s" << "\n";
+  for (const std::string & filename : filenames) {
+    ObjLoader loader(filename);
+    std::vector<CompactIndices> compacts;
+    size_t nbIndices = 0;
+    size_t widths[5] = {0, 0, 0, 0, 0};
+    size_t compactSize = 0;
+    for (size_t k = 0; k < loader.nbIBOs(); k++) {
+      compacts.push_back(loader.compactIbo(k));
+      nbIndices += compacts.back().size();
+      widths[compacts.back().indexSize()]++;
+      compactSize += compacts.back().size() * compacts.back().indexSize();
+      if (compacts.back().expand() != loader.ibo(k)) {
+        std::cerr << "indexwidth: the narrowed IBO " << k << " differs from the original one\n";
+      }
+    }
+
+    // a .glitter file with 32-bit indices only, for comparison
+    std::vector<std::vector<unsigned int>> ibos;
+    for (size_t k = 0; k < loader.nbIBOs(); k++) {
+      ibos.push_back(loader.ibo(k));
+    }
+    loader.saveBinaryFile("/tmp/objbench_indices.glitter");
+    std::ifstream compactFile("/tmp/objbench_indices.glitter", std::ios::binary | std::ios::ate);
+    const double compactFileSize = double(compactFile.tellg());
+    const double fileSize = compactFileSize - compactSize + 4. * nbIndices;
+
+    volatile unsigned int sum = 0;
+    Timings wideTimings = measure(repeat, [&]() {
+      for (const auto & ibo : ibos) {
+        sum += sumIndices(ibo, 0);
+      }
+    });
+    Timings compactTimings = measure(repeat, [&]() {
+      for (const CompactIndices & indices : compacts) {
+        sum += sumIndices(indices.indices8(), indices.baseVertex()) + sumIndices(indices.indices16(), indices.baseVertex()) + sumIndices(indices.indices32(), indices.baseVertex());
+      }
+    });
+    std::cout << std::left << std::setw(40) << filename << std::right << std::setw(7) << loader.nbIBOs() << std::setw(7) << widths[1] << std::setw(8) << widths[2] << std::setw(8)
+              << widths[4] << std::fixed << std::setprecision(1) << std::setw(11) << 4. * nbIndices / 1024. << std::setw(13) << compactSize / 1024. << std::setprecision(3)
+              << std::setw(12) << compactFileSize / fileSize << std::setw(11) << wideTimings.min << std::setw(13) << compactTimings.min << std::setprecision(2) << std::setw(12)
+              << nbIndices / (1e6 * std::max(1e-6, compactTimings.min)) << "\n";
+  }
+  std::cout << "file ratio: size of the .glitter file with narrowed indices relative to 32-bit indices\n";
+}
+
+/// @brief a field of /proc/self/status (in KB), 0 if unavailable
+size_t statusField(const std::string & field)
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, field.size(), field) == 0) {
+      return std::strtoul(line.c_str() + field.size() + 1, nullptr, 10);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief runs a function in a child process
+ * @return the growth of the peak resident memory of the child during the function (in KB), 0 if unavailable
+ */
+template <typename Function> size_t residentGrowth(const Function & function)
+{
+#ifdef __linux__
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return 0;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    // the pages freed by the parent would otherwise be reused without being counted
+    malloc_trim(0);
+    size_t before = statusField("VmRSS:");
+    function();
+    size_t growth = statusField("VmHWM:") - before;
+    ssize_t written = ::write(fds[1], &growth, sizeof(growth));
+    _exit(written == sizeof(growth) ? 0 : 1);
+  }
+  close(fds[1]);
+  size_t growth = 0;
+  if (pid < 0 or ::read(fds[0], &growth, sizeof(growth)) != sizeof(growth)) {
+    growth = 0;
+  }
+  close(fds[0]);
+  if (pid > 0) {
+    waitpid(pid, nullptr, 0);
+  }
+  return growth;
+#else
+  function();
+  return 0;
+#endif
+}
+
+/// @brief sum of the bytes of an array, so that every page is read
+template <typename T> unsigned int touch(Span<T> values)
+{
+  const unsigned char * bytes = reinterpret_cast<const unsigned char *>(values.data());
+  unsigned int sum = 0;
+  for (size_t k = 0; k < values.size() * sizeof(T); k += 64) {
+    sum += bytes[k];
+  }
+  return sum;
+}
+
+/// @brief reads all the arrays of a mesh, as the GPU upload would do (the images are skipped if @p images is false)
+template <typename Mesh> unsigned int touchMesh(const Mesh & mesh, bool images = true)
+{
+  unsigned int sum = touch<glm::vec3>(mesh.vertexPositions()) + touch<glm::vec4>(mesh.vertexColors()) + touch<glm::vec2>(mesh.vertexUVs()) + touch<glm::vec3>(mesh.vertexNormals())
+                     + touch<glm::vec3>(mesh.vertexTangents());
+  for (size_t k = 0; k < mesh.nbIBOs(); k++) {
+    for (unsigned int l = 0; l < mesh.nbLods(k); l++) {
+      sum += mesh.lodIbo(k, l).size();
+    }
+    sum += touch<MeshletBuilder::Meshlet>(mesh.meshlets(k));
+  }
+  for (const std::string & name : images ? mesh.imageNames() : std::vector<std::string>()) {
+    Image<> image = mesh.image(name);
+    sum += touch(Span<unsigned char>(image.data, size_t(image.width) * image.height * image.depth * image.channels));
+  }
+  return sum;
+}
+
+/// glitter command: .glitter readers
+void benchGlitter(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(10) << "reader" << std::right << std::setw(11) << "file (KB)" << std::setw(11) << "min (ms)" << std::setw(11)
+            << "mean (ms)" << std::setw(11) << "RSS (KB)" << "\n";
+  const char * readerNames[] = {"v1", "v2", "v2 mmap", "v2 geom", "v2 crc"};
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.nbLods = 4;
+    options.meshlets = true;
+    ObjLoader loader(filename, options);
+    const std::string v1Name = "/tmp/objbench_v1.glitter";
+    const std::string v2Name = "/tmp/objbench_v2.glitter";
+    loader.saveBinaryFile(v1Name, 1);
+    loader.saveBinaryFile(v2Name, 2);
+    for (int r = 0; r < 5; r++) {
+      const std::string & glitterName = r == 0 ? v1Name : v2Name;
+      volatile unsigned int sum = 0;
+      auto load = [&]() {
+        if (r < 2) {
+          ObjLoader glitterLoader(glitterName);
+          sum = touchMesh(glitterLoader);
+        } else {
+          // full load, geometry only (the pixel chunks are never read), or full load with all the checksums checked
+          GlitterMesh mesh;
+          if (mesh.open(glitterName)) {
+            sum = touchMesh(mesh, r != 3) + (r == 4 and mesh.file().verify());
+          }
+        }
+      };
+      Timings timings = measure(repeat, load);
+      size_t rss = residentGrowth(load);
+      std::ifstream file(glitterName, std::ios::binary | std::ios::ate);
+      std::cout << std::left << std::setw(40) << filename << std::setw(10) << readerNames[r] << std::right << std::fixed << std::setprecision(1) << std::setw(11)
+                << file.tellg() / 1024. << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << std::setw(11) << rss << "\n";
+    }
+  }
+  std::cout << "warm page cache; every array is read once after loading (but the images by geom); RSS: growth of the peak resident memory during the load\n";
+}
+
+/// @brief evicts a file from the page cache, false if unavailable
+bool dropFromCache(const std::string & filename)
+{
+#ifdef __linux__
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  // the pages must be clean to be evicted
+  bool dropped = fdatasync(fd) == 0 and posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  close(fd);
+  return dropped;
+#else
+  (void)filename;
+  return false;
+#endif
+}
+
+/// compress command: .glitter chunk compression
+void benchCompress(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(14) << "file" << std::right << std::setw(11) << "size (KB)" << std::setw(8) << "ratio" << std::setw(11) << "save (ms)"
+            << std::setw(11) << "cold (ms)" << std::setw(11) << "warm (ms)" << "\n";
+  bool cold = true;
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.nbLods = 4;
+    options.meshlets = true;
+    ObjLoader loader(filename, options);
+    const std::string rawName = "/tmp/objbench_raw.glitter";
+    const std::string compressedName = "/tmp/objbench_compressed.glitter";
+    Timings rawSave = measure(repeat, [&]() { loader.saveBinaryFile(rawName, 2, false); });
+    Timings compressedSave = measure(repeat, [&]() { loader.saveBinaryFile(compressedName, 2, true); });
+    std::ifstream rawFile(rawName, std::ios::binary | std::ios::ate);
+    const double rawSize = double(rawFile.tellg());
+    const char * names[] = {"raw", "lz 1 thread", "lz threads"};
+    for (int f = 0; f < 3; f++) {
+      const std::string & glitterName = f == 0 ? rawName : compressedName;
+      volatile unsigned int sum = 0;
+      auto load = [&]() {
+        GlitterMesh mesh;
+        if (mesh.open(glitterName, f == 1 ? 1 : 0)) {
+          sum = touchMesh(mesh);
+        }
+      };
+      Timings coldTimings = measure(repeat, [&]() {
+        cold = dropFromCache(glitterName) and cold;
+        load();
+      });
+      Timings warmTimings = measure(repeat, load);
+      std::ifstream file(glitterName, std::ios::binary | std::ios::ate);
+      const double size = double(file.tellg());
+      std::cout << std::left << std::setw(40) << filename << std::setw(14) << names[f] << std::right << std::fixed << std::setprecision(1) << std::setw(11) << size / 1024.
+                << std::setprecision(2) << std::setw(8) << rawSize / size << std::setw(11) << (f == 0 ? rawSave : compressedSave).min << std::setw(11) << coldTimings.min << std::setw(11)
+                << warmTimings.min << "\n";
+    }
+  }
+  std::cout << "min times; every array is read once after loading; cold: the file is evicted from the page cache before each load" << (cold ? "" : " (unavailable here, cold = warm)")
+            << "\n";
+}
+
+/// @brief reads a whole file, returns its size
+size_t readFile(const std::string & filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  std::vector<char> buffer(1 << 20);
+  size_t size = 0;
+  while (file.read(buffer.data(), buffer.size()) or file.gcount() > 0) {
+    size += size_t(file.gcount());
+  }
+  return size;
+}
+
+/// cache command: mesh cache
+void benchCache(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(10) << "load" << std::right << std::setw(11) << "read (KB)" << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)"
+            << "\n";
+#ifdef __linux__
+  const std::string directory = "/tmp/objbench_cache";
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.nbLods = 4;
+    options.meshlets = true;
+    auto cacheFiles = [&]() {
+      std::vector<std::string> files;
+      if (DIR * cache = opendir(directory.c_str())) {
+        while (dirent * file = readdir(cache)) {
+          if (file->d_name[0] != '.') {
+            files.push_back(directory + "/" + file->d_name);
+          }
+        }
+        closedir(cache);
+      }
+      return files;
+    };
+    // a hit reads the .obj file (its key), the dependencies (their hash), and maps the entry
+    auto hitFiles = [&]() {
+      std::vector<std::string> files = {absolutename(filename)};
+      for (const std::string & name : cacheFiles()) {
+        files.push_back(name);
+        if (endsWith(name, ".deps")) {
+          std::ifstream dependencies(name.c_str());
+          std::string line;
+          while (std::getline(dependencies, line)) {
+            files.push_back(line.substr(line.find(' ') + 1));
+          }
+        }
+      }
+      return files;
+    };
+    for (const std::string & name : cacheFiles()) {
+      std::remove(name.c_str());
+    }
+    const char * loadNames[] = {"no cache", "miss", "hit", "read"};
+    for (int l = 0; l < 4; l++) {
+      volatile unsigned int sum = 0;
+      size_t bytes = 0;
+      std::vector<std::string> files = hitFiles();
+      Timings timings = measure(repeat, [&]() {
+        if (l == 1) {
+          for (const std::string & name : cacheFiles()) {
+            std::remove(name.c_str());
+          }
+        }
+        if (l == 3) {
+          bytes = 0;
+          for (const std::string & name : files) {
+            bytes += readFile(name);
+          }
+          return;
+        }
+        ObjLoader::Options loadOptions = options;
+        loadOptions.cacheDirectory = l == 0 ? std::string() : directory;
+        ObjLoader loader(filename, loadOptions);
+        sum = touchMesh(loader);
+      });
+      std::cout << std::left << std::setw(40) << filename << std::setw(10) << loadNames[l] << std::right << std::fixed << std::setprecision(1) << std::setw(11) << bytes / 1024.
+                << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << "\n";
+    }
+  }
+  std::cout << "warm page cache; every array is read once after loading; read: the files read by a hit (.obj, dependencies, entry)\n";
+  std::cout << "cache statistics: ";
+  MeshCache::statistics().print(std::cout);
+  std::cout << "\n";
+#else
+  (void)filenames;
+  (void)repeat;
+  std::cout << "unavailable on this platform\n";
+#endif
+}
+
+/// io command: the sources reading the version 1 .glitter files
+void benchIo(const std::vector<std::string> & filenames, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(40) << "mesh" << std::setw(10) << "source" << std::right << std::setw(11) << "file (KB)" << std::setw(11) << "warm (ms)" << std::setw(11) << "cold (ms)"
+            << std::setw(11) << "drain GB/s" << "\n";
+  bool cold = true;
+  bool asynchronous = true;
+  for (const std::string & filename : filenames) {
+    ObjLoader::Options options;
+    options.nbLods = 4;
+    options.meshlets = true;
+    const std::string glitterName = "/tmp/objbench_v1.glitter";
+    ObjLoader(filename, options).saveBinaryFile(glitterName, 1);
+    std::ifstream file(glitterName, std::ios::binary | std::ios::ate);
+    const double size = double(file.tellg());
+    const ObjLoader::Options::Input inputs[] = {ObjLoader::Options::StreamInput, ObjLoader::Options::FileInput, ObjLoader::Options::MappedInput, ObjLoader::Options::UringInput};
+    const char * inputNames[] = {"stream", "fd", "mmap", "io_uring"};
+    for (int i = 0; i < 4; i++) {
+      options.input = inputs[i];
+      volatile unsigned int sum = 0;
+      auto load = [&]() {
+        ObjLoader loader(glitterName, options);
+        sum = touchMesh(loader);
+      };
+      Timings warmTimings = measure(repeat, load);
+      Timings coldTimings = measure(repeat, [&]() {
+        cold = dropFromCache(glitterName) and cold;
+        load();
+      });
+      // the bytes alone, read through BufferedReader by 4 KB
+      Timings drainTimings = measure(repeat, [&]() {
+        std::ifstream stream;
+        std::unique_ptr<ByteSource> source;
+        if (i == 0) {
+          stream.open(glitterName.c_str(), std::ios::binary);
+          source.reset(new StreamSource(stream));
+        } else if (i == 1) {
+          source.reset(new FileSource(glitterName));
+        } else if (i == 2) {
+          source.reset(new MappedSource(glitterName));
+        } else {
+          source.reset(new UringSource(glitterName));
+        }
+        BufferedReader reader(*source);
+        char block[4096];
+        unsigned int blockSum = 0;
+        while (reader.read(block, sizeof(block))) {
+          blockSum += block[0];
+        }
+        sum = blockSum;
+      });
+      std::cout << std::left << std::setw(40) << filename << std::setw(10) << inputNames[i] << std::right << std::fixed << std::setprecision(1) << std::setw(11) << size / 1024.
+                << std::setprecision(2) << std::setw(11) << warmTimings.min << std::setw(11) << coldTimings.min << std::setw(11) << size / (1e6 * drainTimings.min) << "\n";
+    }
+    asynchronous = UringSource(glitterName).isAsynchronous() and asynchronous;
+    std::remove(glitterName.c_str());
+  }
+  std::cout << "min times of the v1 .glitter loads (every array is read once after loading); cold: the file is evicted from the page cache before each load"
+            << (cold ? "" : " (unavailable here, cold = warm)") << "; drain: the bytes alone, warm\n";
+  std::cout << "io_uring: " << (asynchronous ? "available" : "unavailable, read as by fd") << "\n";
+}
+
+/// @brief the former per value byte swap of Serialize.cpp (masks and shifts)
+void legacySwap(float & value)
+{
+  glm::int32 & intValue = reinterpret_cast<glm::int32 &>(value);
+  glm::int32 v = intValue;
+  intValue = 0;
+  intValue |= (v & 0xFF000000) >> 24;
+  intValue |= (v & 0x00FF0000) >> 8;
+  intValue |= (v & 0x0000FF00) << 8;
+  intValue |= (v & 0x000000FF) << 24;
+}
+
+/// serialize command: byte swapping and serialization of floats
+void benchSerialize(size_t nbFloats, unsigned int repeat)
+{
+  std::cout << std::left << std::setw(10) << "operation" << std::setw(24) << "path" << std::right << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << std::setw(9) << "GB/s"
+            << "\n";
+  std::vector<float> values(nbFloats);
+  for (size_t k = 0; k < nbFloats; k++) {
+    values[k] = float(k) * 0.25f;
+  }
+  const double bytes = double(nbFloats) * sizeof(float);
+  auto print = [&](const char * operation, const char * path, const Timings & timings) {
+    std::cout << std::left << std::setw(10) << operation << std::setw(24) << path << std::right << std::fixed << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11)
+              << timings.mean << std::setw(9) << bytes / (1e6 * timings.min) << "\n";
+  };
+
+  // both paths swap the values repeat times: an even number of swaps leaves them as they were
+  print("swap", "per value (legacy)", measure(repeat, [&]() {
+          for (float & value : values) {
+            legacySwap(value);
+          }
+        }));
+  print("swap", "swapBytes", measure(repeat, [&]() { swapBytes(values.data(), values.size(), sizeof(float)); }));
+
+  // the swapped paths are the ones of big-endian hosts, forced here
+  const std::string filename = "/tmp/objbench_serialize.bin";
+  const char * paths[] = {"per value stream calls", "per value buffered", "bulk", "bulk swapped"};
+  for (int p = 0; p < 4; p++) {
+    print("write", paths[p], measure(repeat, [&]() {
+            std::ofstream stream(filename.c_str(), std::ios::binary);
+            if (p == 0) {
+              for (const float & value : values) {
+                stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+              }
+              return;
+            }
+            StreamSink sink(stream);
+            BufferedWriter writer(sink);
+            if (p == 1) {
+              for (const float & value : values) {
+                write(value, writer);
+              }
+            } else {
+              writer.write(values.data(), values.size() * sizeof(float), p == 2 ? 1 : sizeof(float));
+            }
+          }));
+  }
+  for (int p = 0; p < 4; p++) {
+    std::vector<float> read(nbFloats);
+    print("read", paths[p], measure(repeat, [&]() {
+            std::ifstream stream(filename.c_str(), std::ios::binary);
+            if (p == 0) {
+              for (float & value : read) {
+                stream.read(reinterpret_cast<char *>(&value), sizeof(value));
+              }
+              return;
+            }
+            StreamSource source(stream);
+            BufferedReader reader(source);
+            if (p == 1) {
+              for (float & value : read) {
+                ::read(value, reader);
+              }
+            } else {
+              reader.read(read.data(), read.size() * sizeof(float), p == 2 ? 1 : sizeof(float));
+            }
+          }));
+    // the file holds swapped values (written last)
+    if (p != 3) {
+      swapBytes(read.data(), read.size(), sizeof(float));
+    }
+    if (read != values) {
+      std::cout << "  the values read differ from the values written!\n";
+    }
+  }
+  std::remove(filename.c_str());
+  std::cout << "warm page cache; swapped: the bytes are swapped on the way, as on big-endian hosts; GB/s: of floats\n";
+}
+
+/// glUniform call for the types of the uniforms command
+void legacyUniform(int location, int value)
+{
+  glUniform1i(location, value);
+}
+
+void legacyUniform(int location, const glm::vec3 & value)
+{
+  glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void legacyUniform(int location, const glm::mat4 & value)
+{
+  glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+/// The former Program::setUniform: a location query and a query of the bound program at each call
+template <typename T> void legacySetUniform(GLuint program, const std::string & name, const T & value)
+{
+  int location = glGetUniformLocation(program, name.c_str());
+  int currentProgram;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+  if (location != -1 and GLuint(currentProgram) == program) {
+    legacyUniform(location, value);
+  }
+}
+
+/// The Camera uniform block of shaders/simplemat.*.glsl (see PA5Application)
+struct CameraBlock {
+  glm::mat4 V;                     ///< world view matrix
+  glm::mat4 P;                     ///< projection matrix
+  glm::vec4 positionCameraInWorld; ///< camera center in world space
+};
+STD140_BLOCK(CameraBlock);
+STD140_MEMBER(CameraBlock, V);
+STD140_MEMBER(CameraBlock, P);
+STD140_MEMBER(CameraBlock, positionCameraInWorld);
+
+/// @brief makes current the OpenGL 4.1 context of a hidden window, for the commands needing one (null if it could not be created)
+GLFWwindow * createContext()
+{
+  if (not glfwInit()) {
+    std::cerr << "Could not initialize GLFW\n";
+    return nullptr;
+  }
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  GLFWwindow * window = glfwCreateWindow(64, 64, "objbench", NULL, NULL);
+  if (window == NULL) {
+    std::cerr << "Could not create an OpenGL 4.1 context\n";
+    glfwTerminate();
+    return nullptr;
+  }
+  glfwMakeContextCurrent(window);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    std::cerr << "Could not initialize GLEW\n";
+    glfwTerminate();
+    return nullptr;
+  }
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << "\n";
+  return window;
+}
+
+/// uniforms command: CPU cost of setting uniforms (M, V, P, a color and a sampler), and of uploading the camera to many programs
+void benchUniforms(unsigned int repeat)
+{
+  GLFWwindow * window = createContext();
+  if (window == NULL) {
+    return;
+  }
+
+  const unsigned int nbFrames = 100000;
+  {
+    Program program("shaders/texture.v.glsl", "shaders/texture.f.glsl");
+    GLint currentProgram = 0;
+    program.bind();
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    const GLuint id = GLuint(currentProgram);
+
+    const glm::mat4 mw(1), view(2), proj(3);
+    const glm::vec3 color(1, 2, 3);
+    const Program::Uniform uniforms[] = {program.uniform("M"), program.uniform("V"), program.uniform("P"), program.uniform("diffuseColor"), program.uniform("colorSampler")};
+    const int nbUniforms = 5;
+
+    std::cout << std::left << std::setw(30) << "path" << std::right << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << std::setw(15) << "ns / uniform"
+              << "\n";
+    auto print = [&](const char * path, const Timings & timings) {
+      std::cout << std::left << std::setw(30) << path << std::right << std::fixed << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << std::setw(15)
+                << 1e6 * timings.min / (double(nbFrames) * nbUniforms) << "\n";
+    };
+    print("lookup at each call (legacy)", measure(repeat, [&]() {
+            for (unsigned int k = 0; k < nbFrames; k++) {
+              legacySetUniform(id, "M", mw);
+              legacySetUniform(id, "V", view);
+              legacySetUniform(id, "P", proj);
+              legacySetUniform(id, "diffuseColor", color);
+              legacySetUniform(id, "colorSampler", int(k & 1));
+            }
+          }));
+    print("by name", measure(repeat, [&]() {
+            for (unsigned int k = 0; k < nbFrames; k++) {
+              program.setUniform("M", mw);
+              program.setUniform("V", view);
+              program.setUniform("P", proj);
+              program.setUniform("diffuseColor", color);
+              program.setUniform("colorSampler", int(k & 1));
+            }
+          }));
+    print("resolved handles", measure(repeat, [&]() {
+            for (unsigned int k = 0; k < nbFrames; k++) {
+              program.setUniform(uniforms[0], mw);
+              program.setUniform(uniforms[1], view);
+              program.setUniform(uniforms[2], proj);
+              program.setUniform(uniforms[3], color);
+              program.setUniform(uniforms[4], int(k & 1));
+            }
+          }));
+    print("glUniform only", measure(repeat, [&]() {
+            const int locations[] = {glGetUniformLocation(id, "M"), glGetUniformLocation(id, "V"), glGetUniformLocation(id, "P"), glGetUniformLocation(id, "diffuseColor"),
+                                     glGetUniformLocation(id, "colorSampler")};
+            for (unsigned int k = 0; k < nbFrames; k++) {
+              legacyUniform(locations[0], mw);
+              legacyUniform(locations[1], view);
+              legacyUniform(locations[2], proj);
+              legacyUniform(locations[3], color);
+              legacyUniform(locations[4], int(k & 1));
+            }
+          }));
+    program.unbind();
+    glFinish();
+  }
+  std::cout << "per frame: M, V, P, diffuseColor and colorSampler, " << nbFrames << " frames\n\n";
+
+  // the camera of a frame: set in each program, or uploaded once in the uniform buffer shared by the programs
+  std::cout << std::left << std::setw(30) << "camera upload" << std::right << std::setw(10) << "programs" << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << std::setw(14) << "us / frame"
+            << "\n";
+  const unsigned int nbCameraFrames = 10000;
+  {
+    const unsigned int nbPrograms[] = {1, 16, 256};
+    std::vector<std::unique_ptr<Program>> programs;
+    std::vector<Program::Uniform> views, projections;
+    UniformBuffer subData(0, sizeof(CameraBlock), 3, UniformBuffer::SubData);
+    UniformBuffer mapRange(1, sizeof(CameraBlock), 3, UniformBuffer::MapRange);
+    for (unsigned int n : nbPrograms) {
+      while (programs.size() < n) {
+        programs.emplace_back(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl"));
+        views.push_back(programs.back()->uniform("V"));
+        projections.push_back(programs.back()->uniform("P"));
+      }
+      auto print = [&](const char * path, const Timings & timings) {
+        std::cout << std::left << std::setw(30) << path << std::right << std::setw(10) << n << std::fixed << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean
+                  << std::setw(14) << 1e3 * timings.min / nbCameraFrames << "\n";
+      };
+      CameraBlock camera = {glm::mat4(1), glm::mat4(2), glm::vec4(1, 2, 3, 1)};
+      print("V and P in each program", measure(repeat, [&]() {
+              for (unsigned int k = 0; k < nbCameraFrames; k++) {
+                camera.positionCameraInWorld.x = float(k);
+                for (unsigned int p = 0; p < n; p++) {
+                  programs[p]->bind();
+                  programs[p]->setUniform(views[p], camera.V);
+                  programs[p]->setUniform(projections[p], camera.P);
+                  programs[p]->unbind();
+                }
+              }
+              glFinish();
+            }));
+      print("uniform buffer (SubData)", measure(repeat, [&]() {
+              for (unsigned int k = 0; k < nbCameraFrames; k++) {
+                camera.positionCameraInWorld.x = float(k);
+                subData.update(camera);
+              }
+              glFinish();
+            }));
+      print("uniform buffer (MapRange)", measure(repeat, [&]() {
+              for (unsigned int k = 0; k < nbCameraFrames; k++) {
+                camera.positionCameraInWorld.x = float(k);
+                mapRange.update(camera);
+              }
+              glFinish();
+            }));
+    }
+  }
+  std::cout << nbCameraFrames << " frames, the programs being bound for the camera only in the first path (they are bound anyway to draw)\n";
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+/// state command: GL binding calls and CPU time of a frame drawing parts as PA5Application does, with and without the GLState cache
+void benchState(unsigned int repeat)
+{
+  GLFWwindow * window = createContext();
+  if (window == NULL) {
+    return;
+  }
+
+  const unsigned int nbParts = 1024, nbPrograms = 8, nbTextures = 16, nbFrames = 200;
+  {
+    // parts of a few objects: the consecutive parts share their program, and some of their textures
+    std::vector<std::unique_ptr<Program>> programs;
+    std::vector<Program::Uniform> modelWorlds;
+    for (unsigned int k = 0; k < nbPrograms; k++) {
+      programs.emplace_back(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl"));
+      modelWorlds.push_back(programs.back()->uniform("M"));
+    }
+    std::vector<std::unique_ptr<Texture>> textures;
+    std::vector<GLubyte> texels(4 * 4 * 4, 255);
+    for (unsigned int k = 0; k < nbTextures; k++) {
+      textures.emplace_back(new Texture(GL_TEXTURE_2D));
+      textures.back()->setData(Image<GLubyte>(texels.data(), 4, 4, 4));
+    }
+    const std::vector<glm::vec3> positions = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+    const std::vector<glm::vec2> uvs = {{0, 0}, {1, 0}, {0, 1}};
+    std::vector<std::unique_ptr<VAO>> vaos;
+    for (unsigned int k = 0; k < nbParts; k++) {
+      vaos.emplace_back(new VAO(2));
+      vaos.back()->setVBO(0, Span<glm::vec3>(positions));
+      vaos.back()->setVBO(1, Span<glm::vec2>(uvs));
+      vaos.back()->setIBO(std::vector<uint>{0, 1, 2});
+    }
+    Sampler colormap(0), normalmap(1), specularmap(2);
+    for (auto & program : programs) {
+      colormap.attachToProgram(*program, "colorSampler", Sampler::BindUnbind);
+    }
+    // PA5Application::update then PA5Application::renderFrame
+    auto frame = [&]() {
+      for (unsigned int k = 0; k < nbParts; k++) {
+        const unsigned int p = k * nbPrograms / nbParts;
+        programs[p]->bind();
+        programs[p]->setUniform(modelWorlds[p], glm::mat4(float(k)));
+        programs[p]->unbind();
+      }
+      colormap.bind();
+      normalmap.bind();
+      specularmap.bind();
+      for (unsigned int k = 0; k < nbParts; k++) {
+        const unsigned int p = k * nbPrograms / nbParts;
+        Program & program = *programs[p];
+        program.bind();
+        colormap.attachTexture(*textures[(k / 4) % nbTextures]);
+        normalmap.attachTexture(*textures[(k / 16) % nbTextures]);
+        specularmap.attachTexture(*textures[p]);
+        vaos[k]->draw();
+        program.unbind();
+      }
+      colormap.unbind();
+      normalmap.unbind();
+      specularmap.unbind();
+    };
+
+    std::cout << std::left << std::setw(26) << "bindings" << std::right << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << std::setw(14) << "us / frame" << std::setw(14)
+              << "issued/frame" << std::setw(15) << "skipped/frame"
+              << "\n";
+    glEnable(GL_RASTERIZER_DISCARD);
+    struct Mode {
+      const char * name;
+      bool caching;
+      bool unbindToZero;
+    };
+    const Mode modes[] = {{"no cache", false, true}, {"cache, unbind to zero", true, true}, {"cache, lazy unbinds", true, false}};
+    for (const Mode & mode : modes) {
+      GLState::setCaching(mode.caching);
+      GLState::setUnbindToZero(mode.unbindToZero);
+      frame();
+      glFinish();
+      GLState::newFrame();
+      frame();
+      GLState::newFrame();
+      const GLState::Counters counters = GLState::frameCounters();
+      Timings timings = measure(repeat, [&]() {
+        for (unsigned int k = 0; k < nbFrames; k++) {
+          frame();
+          GLState::newFrame();
+        }
+        glFinish();
+      });
+      std::cout << std::left << std::setw(26) << mode.name << std::right << std::fixed << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11) << timings.mean << std::setw(14)
+                << 1e3 * timings.min / nbFrames << std::setw(14) << counters.totalIssued() << std::setw(15) << counters.totalSkipped() << "\n";
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+    GLState::setCaching(true);
+    GLState::setUnbindToZero(true);
+  }
+  std::cout << nbParts << " parts (a draw each), " << nbPrograms << " programs, 3 textures per part among " << nbTextures << ", " << nbFrames
+            << " frames; the rasterizer is disabled, issued and skipped: glUseProgram, glBind* and glActiveTexture calls\n";
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+/// The draw of a part of a mesh instance, for the queue command
+struct QueueDraw : public RenderQueue::Drawable {
+  const Program * program;     ///< the program of the material of the part, bound by the queue
+  Program::Uniform modelWorld; ///< its M uniform
+  glm::mat4 mw;                ///< modelWorld matrix of the instance
+  const VAO * vao;             ///< the primitives of the part
+
+  void draw() const override
+  {
+    program->setUniform(modelWorld, mw);
+    vao->draw();
+  }
+};
+
+/// queue command: a frame of mesh instances, their parts being drawn in submission order (instance by instance) or sorted by state
+void benchQueue(unsigned int repeat)
+{
+  GLFWwindow * window = createContext();
+  if (window == NULL) {
+    return;
+  }
+
+  const unsigned int nbMeshes = 16, nbPartsPerMesh = 16, nbInstancesPerMesh = 16, nbMaterials = 64, nbPrograms = 16, nbTextures = 32, nbFrames = 100;
+  const unsigned int nbParts = nbMeshes * nbPartsPerMesh * nbInstancesPerMesh;
+  {
+    // the materials: a program (shared by several materials, as the shaders of the material types) and 3 textures
+    std::vector<std::unique_ptr<Program>> programs;
+    std::vector<Program::Uniform> modelWorlds;
+    for (unsigned int k = 0; k < nbPrograms; k++) {
+      programs.emplace_back(new Program("shaders/texture.v.glsl", "shaders/texture.f.glsl"));
+      modelWorlds.push_back(programs.back()->uniform("M"));
+    }
+    std::vector<std::unique_ptr<Texture>> textures;
+    std::vector<GLubyte> texels(4 * 4 * 4, 255);
+    for (unsigned int k = 0; k < nbTextures; k++) {
+      textures.emplace_back(new Texture(GL_TEXTURE_2D));
+      textures.back()->setData(Image<GLubyte>(texels.data(), 4, 4, 4));
+    }
+    Sampler colormap(0), normalmap(1), specularmap(2);
+    // the parts of the meshes, shared by their instances
+    const std::vector<glm::vec3> positions = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+    const std::vector<glm::vec2> uvs = {{0, 0}, {1, 0}, {0, 1}};
+    std::vector<std::unique_ptr<VAO>> vaos;
+    for (unsigned int k = 0; k < nbMeshes * nbPartsPerMesh; k++) {
+      vaos.emplace_back(new VAO(2));
+      vaos.back()->setVBO(0, Span<glm::vec3>(positions));
+      vaos.back()->setVBO(1, Span<glm::vec2>(uvs));
+      vaos.back()->setIBO(std::vector<uint>{0, 1, 2});
+    }
+    std::vector<QueueDraw> draws(nbParts);
+    std::vector<RenderQueue::Packet> packets;
+    for (unsigned int instance = 0; instance < nbMeshes * nbInstancesPerMesh; instance++) {
+      const unsigned int mesh = instance % nbMeshes;
+      const float depth = 1 + float((instance * 7919) % 1000) / 10;
+      for (unsigned int k = 0; k < nbPartsPerMesh; k++) {
+        const unsigned int part = mesh * nbPartsPerMesh + k, material = part % nbMaterials, program = material % nbPrograms;
+        QueueDraw & draw = draws[packets.size()];
+        draw.program = programs[program].get();
+        draw.modelWorld = modelWorlds[program];
+        draw.mw = glm::mat4(float(instance));
+        draw.vao = vaos[part].get();
+        RenderQueue::Packet packet(&draw, draw.program, draw.vao, depth);
+        packet.textures[0] = textures[material % nbTextures].get();
+        packet.samplers[0] = &colormap;
+        packet.textures[1] = textures[(material / 2) % nbTextures].get();
+        packet.samplers[1] = &normalmap;
+        packet.textures[2] = textures[(material / 4) % nbTextures].get();
+        packet.samplers[2] = &specularmap;
+        packets.push_back(packet);
+      }
+    }
+
+    std::cout << std::left << std::setw(12) << "order" << std::right << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)" << std::setw(12) << "us / frame" << std::setw(13)
+              << "sort (us)" << std::setw(14) << "issued/frame" << std::setw(15) << "skipped/frame" << std::setw(10) << "programs" << std::setw(10) << "textures" << std::setw(7) << "VAOs"
+              << "\n";
+    glEnable(GL_RASTERIZER_DISCARD);
+    GLState::setUnbindToZero(false);
+    RenderQueue queue;
+    for (bool sorted : {false, true}) {
+      double sortTime = 0;
+      auto frame = [&]() {
+        queue.clear();
+        for (const RenderQueue::Packet & packet : packets) {
+          queue.submit(packet);
+        }
+        if (sorted) {
+          auto start = std::chrono::steady_clock::now();
+          queue.sort();
+          sortTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        queue.execute();
+      };
+      frame();
+      glFinish();
+      GLState::newFrame();
+      frame();
+      GLState::newFrame();
+      const GLState::Counters counters = GLState::frameCounters();
+      const RenderQueue::Statistics statistics = queue.statistics();
+      sortTime = 0;
+      Timings timings = measure(repeat, [&]() {
+        for (unsigned int k = 0; k < nbFrames; k++) {
+          frame();
+          GLState::newFrame();
+        }
+        glFinish();
+      });
+      std::cout << std::left << std::setw(12) << (sorted ? "sorted" : "submission") << std::right << std::fixed << std::setprecision(2) << std::setw(11) << timings.min << std::setw(11)
+                << timings.mean << std::setw(12) << 1e3 * timings.min / nbFrames << std::setw(13) << 1e6 * sortTime / (repeat * nbFrames) << std::setw(14) << counters.totalIssued()
+                << std::setw(15) << counters.totalSkipped() << std::setw(10) << statistics.programChanges << std::setw(10) << statistics.textureChanges << std::setw(7)
+                << statistics.vaoChanges << "\n";
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+    GLState::setUnbindToZero(true);
+  }
+  std::cout << nbParts << " draws: " << nbMeshes * nbInstancesPerMesh << " instances of " << nbMeshes << " meshes of " << nbPartsPerMesh << " parts, " << nbMaterials << " materials ("
+            << nbPrograms << " programs, 3 textures among " << nbTextures << "), " << nbFrames << " frames; the rasterizer is disabled, the unbinds are lazy (see GLState)\n";
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+/// instancing command: the pieces on the surface of a NxNxN Rubik's cube, drawn one by one (as RubikRenderer did) or by a single instanced draw
+void benchInstancing(unsigned int repeat)
+{
+  GLFWwindow * window = createContext();
+  if (window == NULL) {
+    return;
+  }
+
+  const unsigned int nbFrames = 10;
+  {
+    Program perPiece("shaders/texture.v.glsl", "shaders/texture.f.glsl");
+    const Program::Uniform modelWorld = perPiece.uniform("M");
+    Program instanced("rubik/rubik.v.glsl", "rubik/rubik.f.glsl");
+    const std::vector<glm::vec3> positions = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+    const std::vector<glm::vec3> colors = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+    std::cout << std::left << std::setw(8) << "size" << std::setw(9) << "pieces" << std::setw(22) << "draws" << std::right << std::setw(11) << "min (ms)" << std::setw(11) << "mean (ms)"
+              << std::setw(14) << "us / frame"
+              << "\n";
+    glEnable(GL_RASTERIZER_DISCARD);
+    GLState::setUnbindToZero(false);
+    for (unsigned int size : {10u, 30u, 100u}) {
+      // the pieces of the surface (see RubikRenderer::createTheVAO)
+      std::vector<glm::mat4> matrices;
+      const float center = (size - 1) / 2.f;
+      for (unsigned int i = 0; i < size; i++) {
+        for (unsigned int j = 0; j < size; j++) {
+          for (unsigned int k = 0; k < size; k++) {
+            auto isInside = [&](unsigned int c) { return c > 0 and c < size - 1; };
+            if (not(isInside(i) and isInside(j) and isInside(k))) {
+              matrices.push_back(glm::translate<float>(glm::scale(glm::mat4(1), glm::vec3(2.f / size)), {i - center, j - center, k - center}));
+            }
+          }
+        }
+      }
+      VAO vao(6);
+      vao.setVBO(0, Span<glm::vec3>(positions));
+      vao.setVBO(1, Span<glm::vec3>(colors));
+      vao.setIBO(std::vector<uint>{0, 1, 2});
+      vao.setInstanceVBO(2, matrices);
+
+      auto print = [&](const char * name, const Timings & timings) {
+        std::cout << std::left << std::setw(8) << size << std::setw(9) << matrices.size() << std::setw(22) << name << std::right << std::fixed << std::setprecision(2) << std::setw(11)
+                  << timings.min << std::setw(11) << timings.mean << std::setw(14) << 1e3 * timings.min / nbFrames << "\n";
+      };
+      print("a draw per piece", measure(repeat, [&]() {
+              for (unsigned int f = 0; f < nbFrames; f++) {
+                perPiece.bind();
+                for (const glm::mat4 & mw : matrices) {
+                  perPiece.setUniform(modelWorld, mw);
+                  vao.draw();
+                }
+                perPiece.unbind();
+              }
+              glFinish();
+            }));
+      print("instanced, streamed", measure(repeat, [&]() {
+              for (unsigned int f = 0; f < nbFrames; f++) {
+                instanced.bind();
+                vao.setInstanceVBO(2, matrices);
+                vao.drawInstanced(GLsizei(matrices.size()));
+                instanced.unbind();
+              }
+              glFinish();
+            }));
+      print("instanced, unchanged", measure(repeat, [&]() {
+              for (unsigned int f = 0; f < nbFrames; f++) {
+                instanced.bind();
+                vao.drawInstanced(GLsizei(matrices.size()));
+                instanced.unbind();
+              }
+              glFinish();
+            }));
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+    GLState::setUnbindToZero(true);
+  }
+  std::cout << nbFrames << " frames of one-triangle pieces (the cost of a draw, not of the rounded cubes); the rasterizer is disabled, the interior pieces are not drawn\n";
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc < 2 or !strcmp(argv[1], "help")) {
+    printUsage(argc, argv);
+    return 0;
+  }
+  std::string command = argv[1];
+  unsigned int repeat = 5;
+  size_t nbFloats = 100000000;
+  std::vector<std::string> filenames;
+  for (int k = 2; k < argc; k++) {
+    if (!strcmp(argv[k], "--repeat") and k + 1 < argc) {
+      repeat = std::max(1, atoi(argv[++k]));
+    } else if (!strcmp(argv[k], "--floats") and k + 1 < argc) {
+      nbFloats = size_t(std::max(1, atoi(argv[++k]))) * 1000000;
+    } else if (!strcmp(argv[k], "--synthetic") and k + 1 < argc) {
+      filenames.push_back(makeSyntheticMesh(std::max(1, atoi(argv[++k]))));
+    } else {
+      filenames.push_back(argv[k]);
+    }
+  }
+  if (filenames.empty()) {
+    filenames = bundledMeshes;
+  }
+
+  if (command == "parse") {
+    benchParse(filenames, repeat);
+  } else if (command == "threads") {
+    benchThreads(filenames, repeat);
+  } else if (command == "weld") {
+    benchWeld(filenames, repeat);
+  } else if (command == "tangents") {
+    benchTangents(filenames, repeat);
+  } else if (command == "indices") {
+    benchIndices(filenames, repeat);
+  } else if (command == "lods") {
+    benchLods(filenames, repeat);
+  } else if (command == "meshlets") {
+    benchMeshlets(filenames, repeat);
+  } else if (command == "quantize") {
+    benchQuantize(filenames, repeat);
+  } else if (command == "layout") {
+    benchLayout(filenames, repeat);
+  } else if (command == "indexwidth") {
+    benchIndexWidth(filenames, repeat);
+  } else if (command == "glitter") {
+    benchGlitter(filenames, repeat);
+  } else if (command == "compress") {
+    benchCompress(filenames, repeat);
+  } else if (command == "cache") {
+    benchCache(filenames, repeat);
+  } else if (command == "io") {
+    benchIo(filenames, repeat);
+  } else if (command == "serialize") {
+    benchSerialize(nbFloats, repeat);
+  } else if (command == "uniforms") {
+    benchUniforms(repeat);
+  } else if (command == "state") {
+    benchState(repeat);
+  } else if (command == "queue") {
+    benchQueue(repeat);
+  } else if (command == "instancing") {
+    benchInstancing(repeat);
+  } else {
+    printUsage(argc, argv);
+    return 1;
+  }
+  return 0;
+}
@@ -3,7 +3,9 @@
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-StartMenuStage::StartMenuStage()
+unsigned int StartMenuStage::cubeSize = 3;
+
+StartMenuStage::StartMenuStage() : m_renderer(cubeSize)
 {
   m_renderer.deform(true);
   int width, height;
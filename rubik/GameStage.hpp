@@ -43,6 +43,8 @@ public:
 
   std::unique_ptr<GameStage> nextStage() const override;
 
+  static unsigned int cubeSize; ///< number of pieces along an edge of the cube of the start menu (the game playing a 3x3x3 cube)
+
 private:
   std::unique_ptr<TextPrinter> m_text;
   RubikRenderer m_renderer;
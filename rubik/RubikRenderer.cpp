@@ -1,5 +1,6 @@
 #include "RubikRenderer.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <functional>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/ext.hpp>
@@ -59,7 +60,8 @@ std::shared_ptr<VAO> makeParamSurf(DiscreteLinRange rgPhi, DiscreteLinRange rgTh
     }
   }
 
-  std::shared_ptr<VAO> vao(new VAO(2));
+  // the modelWorld matrix of each instance takes the anchor points 2 to 5 (see RubikRenderer::renderFrame)
+  std::shared_ptr<VAO> vao(new VAO(6));
   vao->setVBO(0, positions);
   vao->setVBO(1, colors);
   vao->setIBO(ibo);
@@ -81,8 +83,11 @@ std::shared_ptr<VAO> RubikRenderer::InstancedVAO::makeARoundedCube(unsigned int
   return makeParamSurf(DiscreteLinRange(nbPhi, 0, 2 * pi), DiscreteLinRange(nbTheta, 0, pi), posFunc, true, false);
 }
 
-RubikRenderer::RubikRenderer() : m_program("rubik/rubik.v.glsl", "rubik/rubik.f.glsl"), m_view(1), m_currentTime(0), m_deltaTime(0)
+RubikRenderer::RubikRenderer(unsigned int size)
+    : m_size(size), m_instancesChanged(true), m_program("rubik/rubik.v.glsl", "rubik/rubik.f.glsl"), m_viewProj(m_program.uniform("VP")), m_time(m_program.uniform("time")), m_view(1),
+      m_currentTime(0), m_deltaTime(0)
 {
+  assert(size > 0);
   GLFWwindow * window = glfwGetCurrentContext();
   int windowWidth, windowHeight;
   glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
@@ -93,22 +98,35 @@ RubikRenderer::RubikRenderer() : m_program("rubik/rubik.v.glsl", "rubik/rubik.f.
 
 void RubikRenderer::createTheVAO()
 {
-  m_vao = InstancedVAO::makeARoundedCube(50, 50);
-  for (int x = -1; x <= 1; x++) {
-    for (int y = -1; y <= 1; y++) {
-      for (int z = -1; z <= 1; z++) {
+  // the smaller the pieces, the coarser their tessellation (50 for the 3x3x3 cube)
+  const unsigned int tessellation = std::max(8u, 150 / m_size);
+  m_vao = InstancedVAO::makeARoundedCube(tessellation, tessellation);
+  m_vaos.resize(m_size * m_size * m_size);
+  const float center = (m_size - 1) / 2.f;
+  for (unsigned int i = 0; i < m_size; i++) {
+    for (unsigned int j = 0; j < m_size; j++) {
+      for (unsigned int k = 0; k < m_size; k++) {
         glm::mat4 mw(1);
-        mw = glm::scale(mw, glm::vec3(2.f / 3.f / sqrt(3)));
-        mw = glm::translate<float>(mw, {x, y, z});
+        mw = glm::scale(mw, glm::vec3(2.f / m_size / sqrt(3)));
+        mw = glm::translate<float>(mw, {i - center, j - center, k - center});
         mw = glm::scale(mw, glm::vec3(1.025));
-        unsigned int cnt = static_cast<unsigned int>(RubikPiece(x, y, z));
-        if (x == 0 and y == 0 and z == 0) {
+        // the index of RubikPiece(i - 1, j - 1, k - 1) for the 3x3x3 cube
+        unsigned int cnt = (i * m_size + j) * m_size + k;
+        auto isInside = [&](unsigned int c) { return c > 0 and c < m_size - 1; };
+        if (isInside(i) and isInside(j) and isInside(k)) {
           m_vaos[cnt] = InstancedVAO::createInstance(nullptr, mw);
+        } else {
+          m_vaos[cnt] = InstancedVAO::createInstance(m_vao, mw);
         }
-        m_vaos[cnt] = InstancedVAO::createInstance(m_vao, mw);
       }
     }
   }
+  m_instancesChanged = true;
+}
+
+unsigned int RubikRenderer::size() const
+{
+  return m_size;
 }
 
 void RubikRenderer::initGLState() const
@@ -167,10 +185,18 @@ void RubikRenderer::renderFrame()
   const float pi = glm::pi<float>();
   view = glm::rotate(glm::mat4(1), pi / 7, {0, 1, 0});
   view = glm::rotate(glm::mat4(1), -pi / 4, {1, 0, 0}) * view * m_view;
-  for (const auto & vao : m_vaos) {
-    vao->updateProgram(m_program, m_proj, view);
-    vao->draw();
+  m_program.setUniform(m_viewProj, m_proj * view);
+  if (m_instancesChanged) {
+    m_instances.clear();
+    for (const auto & vao : m_vaos) {
+      if (vao->isVisible()) {
+        m_instances.push_back(vao->modelWorld());
+      }
+    }
+    m_vao->setInstanceVBO(2, m_instances);
+    m_instancesChanged = false;
   }
+  m_vao->drawInstanced(GLsizei(m_instances.size()));
   m_program.unbind();
 }
 
@@ -189,11 +215,14 @@ void RubikRenderer::update()
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
   m_program.bind();
-  m_program.setUniform("time", m_currentTime);
+  m_program.setUniform(m_time, m_currentTime);
   m_program.unbind();
   m_viewAnim.update(m_deltaTime);
   for (auto & vao : m_vaos) {
-    vao->update(m_deltaTime);
+    if (vao->isLocked()) {
+      vao->update(m_deltaTime);
+      m_instancesChanged = true;
+    }
   }
 }
 
@@ -210,6 +239,7 @@ void RubikRenderer::resetView()
 
 void RubikRenderer::launchFaceRotation(const RubikFace & face, const std::array<uint, 9> & pieces)
 {
+  assert(m_size == 3);
   const float pi = glm::pi<float>();
   glm::vec3 axis = -face.n;
   for (uint piece : pieces) {
@@ -235,16 +265,14 @@ std::shared_ptr<RubikRenderer::InstancedVAO> RubikRenderer::InstancedVAO::create
   return std::shared_ptr<InstancedVAO>(new InstancedVAO(vao, modelWorld));
 }
 
-void RubikRenderer::InstancedVAO::draw(GLenum mode) const
+bool RubikRenderer::InstancedVAO::isVisible() const
 {
-  if (m_vao) {
-    m_vao->draw(mode);
-  }
+  return m_vao != nullptr;
 }
 
-void RubikRenderer::InstancedVAO::updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view) const
+const glm::mat4 & RubikRenderer::InstancedVAO::modelWorld() const
 {
-  prog.setUniform("MVP", proj * view * m_mw);
+  return m_mw;
 }
 
 void RubikRenderer::InstancedVAO::launchRotation(const glm::vec3 & axis, float angle)
@@ -1,17 +1,27 @@
 #ifndef __RUBIK_RENDERER_H__
 #define __RUBIK_RENDERER_H__
 
+#include <vector>
 #include "glApi.hpp"
 
 // forward declarations
 struct GLFWwindow;
 struct RubikFace;
 
-/// A class to handle the rendering of the Rubik's cube
+/**
+ * @brief A class to handle the rendering of the Rubik's cube
+ *
+ * All the pieces share a single VAO, drawn in one instanced draw call: their
+ * modelWorld matrices are per-instance attributes, streamed when some pieces
+ * have moved. The interior pieces, which cannot be seen, are not drawn.
+ */
 class RubikRenderer {
 public:
-  /// Default constructor
-  RubikRenderer();
+  /**
+   * @brief Constructor
+   * @param size the number of pieces along an edge of the cube (the face rotations requiring a 3x3x3 cube)
+   */
+  explicit RubikRenderer(unsigned int size = 3);
 
   /// OpenGL state initialization
   void initGLState() const;
@@ -19,6 +29,9 @@ public:
   /// Creates a unique vao for all the pieces and instanciates them
   void createTheVAO();
 
+  /// the number of pieces along an edge of the cube
+  unsigned int size() const;
+
   /// Handles window resizing
   void resize(GLFWwindow * window, int framebufferWidth, int framebufferHeight);
 
@@ -28,7 +41,7 @@ public:
   /// Resets the view to its default configuration
   void resetView();
 
-  /// Starts the rotation animation of a face
+  /// Starts the rotation animation of a face (of a 3x3x3 cube)
   void launchFaceRotation(const RubikFace & face, const std::array<uint, 9> & pieces);
 
   /// Updates all time dependent members
@@ -78,24 +91,17 @@ private:
 
     /**
      * @brief creates an instance from a vao and modelView matrix
-     * @param vao  the VAO to be instanciated
+     * @param vao  the VAO to be instanciated (null: the instance is not drawn)
      * @param modelWorld the matrix transform between the object (a.k.a model) space and the camera (a.k.a view) space
      * @return the created InstancedVAO as a smart pointer
      */
     static std::shared_ptr<InstancedVAO> createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld);
 
-    /**
-     * @brief Draw this VAO
-     */
-    void draw(GLenum mode = GL_TRIANGLES) const;
+    /// Denotes if the instance is drawn
+    bool isVisible() const;
 
-    /**
-     * @brief update the program MVP uniform variable
-     * @param prog the target program
-     * @param proj the projection matrix
-     * @param view the worldView matrix
-     */
-    void updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view = glm::mat4(1)) const;
+    /// The modelWorld matrix of the instance, its per-instance attribute
+    const glm::mat4 & modelWorld() const;
 
     /// Launches a rotation animation.
     void launchRotation(const glm::vec3 & axis, float angle);
@@ -118,13 +124,18 @@ private:
   };
 
 private:
-  std::shared_ptr<InstancedVAO> m_vaos[27]; ///< List of instanced VAOs (VAO + modelView matrix)
-  std::shared_ptr<VAO> m_vao;               ///< a unique VAO (shared by all instanced one)
-  Program m_program;                        ///< A GLSL progam
-  glm::mat4 m_proj;                         ///< Projection matrix
-  glm::mat4 m_view;                         ///< worldView matrix
-  float m_currentTime;                      ///< elapsed time since first frame
-  float m_deltaTime;                        ///< elapsed
-  RotateAnimation m_viewAnim;               ///< the view rotation animation
+  unsigned int m_size;                               ///< number of pieces along an edge of the cube
+  std::vector<std::shared_ptr<InstancedVAO>> m_vaos; ///< List of instanced VAOs (VAO + modelView matrix), one per piece
+  std::shared_ptr<VAO> m_vao;                        ///< a unique VAO (shared by all instanced one)
+  std::vector<glm::mat4> m_instances;                ///< modelWorld matrices of the visible pieces, as streamed to m_vao
+  bool m_instancesChanged;                           ///< true if some pieces have moved since m_instances was streamed
+  Program m_program;                                 ///< A GLSL progam
+  Program::Uniform m_viewProj;                       ///< VP uniform variable of m_program
+  Program::Uniform m_time;                           ///< time uniform variable of m_program
+  glm::mat4 m_proj;                                  ///< Projection matrix
+  glm::mat4 m_view;                                  ///< worldView matrix
+  float m_currentTime;                               ///< elapsed time since first frame
+  float m_deltaTime;                                 ///< elapsed
+  RotateAnimation m_viewAnim;                        ///< the view rotation animation
 };
 #endif // !defined(__RUBIK_RENDERER_H__)
@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 // matrix and vectors
@@ -8,12 +9,22 @@
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "GameStage.hpp"
 #include "RubikApplication.hpp"
 #include "glApi.hpp"
 #include "termcolor/termcolor.hpp"
 
-int main(int /*argc*/, char * /*argv*/ [])
+int main(int argc, char * argv[])
 {
+  if (argc > 1) {
+    // the size of the cube of the start menu, e.g. 100 for 100x100x100 pieces
+    int size = atoi(argv[1]);
+    if (size < 1) {
+      std::cerr << "invalid cube size: " << argv[1] << std::endl;
+      return 1;
+    }
+    StartMenuStage::cubeSize = size;
+  }
   RubikApplication app;
   app.setCallbacks();
   app.mainLoop();
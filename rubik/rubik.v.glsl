@@ -1,15 +1,16 @@
 #version 410
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexColors;
+layout(location = 2) in mat4 modelWorld; // per instance (the locations 2 to 5)
 uniform float time;
-uniform mat4 MVP;
+uniform mat4 VP;
 out vec4 color;
 uniform bool deform;
 
 void main()
 {
   vec4 positionH = vec4(vertexPosition, 1);
-  gl_Position = MVP * positionH;
+  gl_Position = VP * modelWorld * positionH;
   float r = length(gl_Position.xyz);
   if (deform) {
     gl_Position.xyz *= (1 + 0.2 * (r - 0.4) * cos(3 * time)) / 1.2;
@@ -17,8 +17,17 @@ struct DirLight {
   vec3 intensity;
 };
 
-uniform DirLight lightsInWorld[3];  ///< lights in world space
-uniform vec3 positionCameraInWorld; ///< camera center in worldSpace
+// lights in world space, uploaded once for all the programs (see PA5Application::PA5Application)
+layout(std140) uniform Lights {
+  DirLight lightsInWorld[3];
+};
+
+// camera, uploaded once per frame for all the programs (see PA5Application::update)
+layout(std140) uniform Camera {
+  mat4 V;                     ///< world view matrix
+  mat4 P;                     ///< projection matrix
+  vec4 positionCameraInWorld; ///< camera center in world space
+};
 
 // Material properties uniforms
 struct Material {
@@ -114,7 +123,7 @@ void main()
   vec3 specular = material.specular * texture(material.specularmap, uv).rgb;
   vec3 lambert = vec3(0);
   vec3 phong = vec3(0);
-  vec3 directionToCamera = normalize(positionCameraInWorld - geomInWorld.position.xyz / geomInWorld.position.w);
+  vec3 directionToCamera = normalize(positionCameraInWorld.xyz - geomInWorld.position.xyz / geomInWorld.position.w);
   for (int k = 0; k < 3; k++) {
     lambert += computeLightLambert(lightsInWorld[k], microNormal, diffuse);
     phong += computeLightSpecular(lightsInWorld[k], microNormal, directionToCamera, specular, material.shininess);
@@ -8,8 +8,18 @@ layout(location = 3) in vec3 vertexTangent;
 
 // uniforms
 uniform mat4 M; ///< model world matrix
-uniform mat4 V; ///< world view matrix
-uniform mat4 P; ///< projection matrix
+
+// camera, uploaded once per frame for all the programs (see PA5Application::update)
+layout(std140) uniform Camera {
+  mat4 V;                     ///< world view matrix
+  mat4 P;                     ///< projection matrix
+  vec4 positionCameraInWorld; ///< camera center in world space
+};
+
+// compact vertex formats (see VertexQuantizer), the defaults matching float32 attributes
+uniform vec3 positionOffset = vec3(0);     ///< positions are decoded as positionOffset + positionScale * vertexPosition
+uniform vec3 positionScale = vec3(1);      ///< extent of the bounding box of the quantized positions
+uniform bool octahedralDirections = false; ///< normals and tangents are octahedral coordinates (in vertexNormal.xy and vertexTangent.xy)
 
 struct Geometry {
   vec4 position;  ///< homogeneous position in world space
@@ -36,12 +46,26 @@ vec3 transformNormal(const in mat4 modelWorld, const in vec3 normalInObject)
   return normalMatrix * vec3(normalInObject);
 }
 
+/**
+ * @brief decodes an octahedral encoded unit vector
+ * @param coordinates the coordinates in the [-1, 1] square
+ */
+vec3 octahedralDecode(const in vec2 coordinates)
+{
+  vec3 n = vec3(coordinates, 1 - abs(coordinates.x) - abs(coordinates.y));
+  float t = max(-n.z, 0);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+  return normalize(n);
+}
+
 void main()
 {
-  geomInWorld.position = M * vec4(vertexPosition, 1);
+  vec3 normal = octahedralDirections ? octahedralDecode(vertexNormal.xy) : vertexNormal;
+  vec3 tangent = octahedralDirections ? octahedralDecode(vertexTangent.xy) : vertexTangent;
+  geomInWorld.position = M * vec4(positionOffset + positionScale * vertexPosition, 1);
   gl_Position = P * V * geomInWorld.position;
-  geomInWorld.normal = transformNormal(M, vertexNormal);
-  geomInWorld.tangent = normalize(mat3(M) * vertexTangent);
+  geomInWorld.normal = transformNormal(M, normal);
+  geomInWorld.tangent = normalize(mat3(M) * tangent);
   geomInWorld.bitangent = cross(geomInWorld.normal, geomInWorld.tangent);
   uv = vertexUV;
 }
@@ -2,6 +2,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "GLState.hpp"
 #include "utils.hpp"
 
 Application::Application(int windowWidth, int windowHeight, const char * title)
@@ -26,6 +27,7 @@ void Application::mainLoop()
     renderFrame();
     // swap back and front buffers
     glfwSwapBuffers(window);
+    GLState::newFrame();
     glfwPollEvents();
   }
 }
@@ -0,0 +1,98 @@
+#include "AssetLoader.hpp"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+void AssetLoader::Statistics::print(std::ostream & out) const
+{
+  static const char * bucketNames[nbBuckets] = {"<1ms", "<2ms", "<4ms", "<8ms", "<16ms", ">=16ms"};
+  out << nbSteps << " upload steps in " << nbUploads << " frames, " << 1000 * totalDuration << " ms in total, longest " << 1000 * maxDuration << " ms (";
+  for (unsigned int b = 0; b < nbBuckets; b++) {
+    out << (b ? ", " : "") << bucketNames[b] << " " << histogram[b];
+  }
+  out << ")";
+  if (completionTime > 0) {
+    out << ", all assets ready after " << 1000 * completionTime << " ms";
+  }
+}
+
+AssetLoader::AssetLoader(unsigned int nbThreads) : m_pending(0), m_statistics(), m_start(Clock::now()), m_pool(nbThreads) {}
+
+void AssetLoader::load(const LoadStage & load)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending++;
+  }
+  m_pool.submit([this, load]() {
+    LoadedAsset asset = {std::vector<UploadStep>(), 0};
+    // a failed asset is still handed over (without steps), so that it is counted as uploaded
+    try {
+      asset.steps = load();
+    } catch (const std::exception & e) {
+      std::cerr << "AssetLoader: an asset failed to load: " << e.what() << std::endl;
+    } catch (...) {
+      std::cerr << "AssetLoader: an asset failed to load" << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // an asset without upload step still has to be counted as uploaded
+    if (asset.steps.empty()) {
+      asset.steps.push_back(UploadStep());
+    }
+    m_loaded.push_back(std::move(asset));
+  });
+}
+
+size_t AssetLoader::upload(double budget)
+{
+  const Clock::time_point start = Clock::now();
+  size_t nbSteps = 0;
+  double elapsed = 0;
+  while (nbSteps == 0 or elapsed < budget) {
+    // the step is run outside of the lock, so that the workers are never blocked by an upload
+    // (the workers only append assets, so the front one is only modified here)
+    UploadStep step;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_loaded.empty()) {
+        break;
+      }
+      step = std::move(m_loaded.front().steps[m_loaded.front().next++]);
+    }
+    if (step) {
+      step();
+    }
+    nbSteps++;
+    elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_loaded.front().next == m_loaded.front().steps.size()) {
+      m_loaded.pop_front();
+      if (--m_pending == 0) {
+        m_statistics.completionTime = std::chrono::duration<double>(Clock::now() - m_start).count();
+      }
+    }
+  }
+  if (nbSteps > 0) {
+    m_statistics.nbUploads++;
+    m_statistics.nbSteps += nbSteps;
+    m_statistics.maxDuration = std::max(m_statistics.maxDuration, elapsed);
+    m_statistics.totalDuration += elapsed;
+    unsigned int bucket = 0;
+    while (bucket + 1 < Statistics::nbBuckets and elapsed >= 0.001 * (1 << bucket)) {
+      bucket++;
+    }
+    m_statistics.histogram[bucket]++;
+  }
+  return nbSteps;
+}
+
+size_t AssetLoader::pending() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pending;
+}
+
+const AssetLoader::Statistics & AssetLoader::statistics() const
+{
+  return m_statistics;
+}
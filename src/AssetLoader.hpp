@@ -0,0 +1,100 @@
+#ifndef __GLITTER_ASSETLOADER_H__
+#define __GLITTER_ASSETLOADER_H__
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+#include "ThreadPool.hpp"
+
+/**
+ * @brief Loads assets in the background, and hands them over to the GL thread within a time budget
+ *
+ * An asset is loaded in two stages:
+ *	+ on a worker thread, the files are parsed and decoded into CPU side
+ *	  objects (ObjLoader, GlitterMesh, images...), no GL call being allowed
+ *	+ on the GL thread, the upload steps returned by the first stage create
+ *	  the GL objects (VAO, Texture...), a few steps per frame (see upload),
+ *	  so that the frames keep being drawn while the assets are uploaded
+ *
+ * The steps of an asset are run in order, and the assets are uploaded in the
+ * order their loading stages complete. The last step of an asset typically
+ * adds it to the scene, so that it appears once it is complete.
+ *
+ * The upload durations are gathered in a histogram, to measure the stalls
+ * caused by the uploads (see statistics).
+ *
+ * A loading stage throwing an exception is reported on std::cerr, its asset
+ * being uploaded without steps. The destruction waits for the assets being
+ * loaded, their upload steps being dropped.
+ */
+class AssetLoader {
+public:
+  /// A step of the upload of an asset, run on the GL thread
+  typedef std::function<void()> UploadStep;
+
+  /// A loading stage, run on a worker thread, returning the upload steps of the asset
+  typedef std::function<std::vector<UploadStep>()> LoadStage;
+
+  /// @brief Upload statistics
+  struct Statistics {
+    static const unsigned int nbBuckets = 6; ///< number of buckets of the histogram
+
+    size_t nbUploads;            ///< number of calls to upload that ran at least one step
+    size_t nbSteps;              ///< number of steps run
+    double maxDuration;          ///< longest upload, in seconds
+    double totalDuration;        ///< total upload time, in seconds
+    double completionTime;       ///< time between the construction and the end of the upload of the last asset, in seconds (0 if none)
+    size_t histogram[nbBuckets]; ///< number of uploads lasting less than 1, 2, 4, 8 and 16 ms, and more
+
+    /// @brief prints the statistics on one line
+    void print(std::ostream & out) const;
+  };
+
+  /**
+   * @brief Constructor
+   * @param nbThreads number of worker threads (the hardware concurrency if 0)
+   */
+  explicit AssetLoader(unsigned int nbThreads = 0);
+
+  AssetLoader(const AssetLoader &) = delete;
+  AssetLoader & operator=(const AssetLoader &) = delete;
+
+  /**
+   * @brief queues an asset
+   * @param load the loading stage, run on a worker thread
+   */
+  void load(const LoadStage & load);
+
+  /**
+   * @brief runs the upload steps of the loaded assets, on the calling (GL) thread
+   * @param budget the time budget, in seconds: no step is started once it is exceeded, but one step at least is run when one is ready
+   * @return the number of steps run
+   */
+  size_t upload(double budget);
+
+  /// @brief number of assets not completely uploaded yet
+  size_t pending() const;
+
+  /// @brief the upload statistics
+  const Statistics & statistics() const;
+
+private:
+  /// The upload steps of a loaded asset
+  struct LoadedAsset {
+    std::vector<UploadStep> steps; ///< the upload steps
+    size_t next;                   ///< the next step to be run
+  };
+
+  typedef std::chrono::steady_clock Clock;
+
+  mutable std::mutex m_mutex;       ///< protects the loaded assets and the number of pending assets
+  std::deque<LoadedAsset> m_loaded; ///< loaded assets, in completion order of their loading stage
+  size_t m_pending;                 ///< number of assets not completely uploaded
+  Statistics m_statistics;          ///< upload statistics
+  Clock::time_point m_start;        ///< construction time
+  ThreadPool m_pool;                ///< worker threads (destroyed first, as they use the members above)
+};
+
+#endif // !defined(__GLITTER_ASSETLOADER_H__)
@@ -2,78 +2,213 @@
 #define __ATTRIBUTE_PROPERTIES_HPP
 
 #include <GL/glew.h>
+#include <cassert>
+#include <cstring>
 #include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <vector>
+#include "Span.hpp"
+
+/// A pair of half floats (IEEE 754 binary16), see glm::packHalf1x16
+struct Half2 {
+  glm::uint16 x; ///< first component
+  glm::uint16 y; ///< second component
+};
 
 /// Traits structure for attribute properties
 template <typename T> struct AttributeProperties {
-  static const GLenum typeEnum;   ///< The OpenGL enum representing the type of attributes
-  static const GLuint components; ///< the number of components per attribute
+  static const GLenum typeEnum;      ///< The OpenGL enum representing the type of attributes
+  static const GLuint components;    ///< the number of components per attribute
+  static const GLboolean normalized; ///< whether integer components are mapped to [0, 1] (unsigned) or [-1, 1] (signed)
 };
 
 /// Traits structure for attribute properties (char specialization)
 template <> struct AttributeProperties<char> {
-  static const GLenum typeEnum = GL_BYTE; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 1;     ///< the number of components per attribute
+  static const GLenum typeEnum = GL_BYTE;       ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 1;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (unsigned char specialization)
 template <> struct AttributeProperties<unsigned char> {
   static const GLenum typeEnum = GL_UNSIGNED_BYTE; ///< The OpenGL enum representing the type of attribute components
   static const GLuint components = 1;              ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE;    ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (short specialization)
 template <> struct AttributeProperties<short> {
-  static const GLenum typeEnum = GL_SHORT; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 1;      ///< the number of components per attribute
+  static const GLenum typeEnum = GL_SHORT;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 1;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (unsigned short specialization)
 template <> struct AttributeProperties<unsigned short> {
   static const GLenum typeEnum = GL_UNSIGNED_SHORT; ///< The OpenGL enum representing the type of attribute components
   static const GLuint components = 1;               ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE;     ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (int specialization)
 template <> struct AttributeProperties<int> {
-  static const GLenum typeEnum = GL_INT; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 1;    ///< the number of components per attribute
+  static const GLenum typeEnum = GL_INT;        ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 1;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (unsigned int specialization)
 template <> struct AttributeProperties<unsigned int> {
   static const GLenum typeEnum = GL_UNSIGNED_INT; ///< The OpenGL enum representing the type of attribute components
   static const GLuint components = 1;             ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE;   ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (float specialization)
 template <> struct AttributeProperties<float> {
-  static const GLenum typeEnum = GL_FLOAT; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 1;      ///< the number of components per attribute
+  static const GLenum typeEnum = GL_FLOAT;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 1;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (double specialization)
 template <> struct AttributeProperties<double> {
-  static const GLenum typeEnum = GL_DOUBLE; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 1;       ///< the number of components per attribute
+  static const GLenum typeEnum = GL_DOUBLE;     ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 1;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (glm::vec2 specialization)
 template <> struct AttributeProperties<glm::vec2> {
-  static const GLenum typeEnum = GL_FLOAT; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 2;      ///< the number of components per attribute
+  static const GLenum typeEnum = GL_FLOAT;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 2;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (glm::vec3 specialization)
 template <> struct AttributeProperties<glm::vec3> {
-  static const GLenum typeEnum = GL_FLOAT; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 3;      ///< the number of components per attribute
+  static const GLenum typeEnum = GL_FLOAT;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 3;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
 };
 
 /// Traits structure for attribute properties (glm::vec4 specialization)
 template <> struct AttributeProperties<glm::vec4> {
-  static const GLenum typeEnum = GL_FLOAT; ///< The OpenGL enum representing the type of attribute components
-  static const GLuint components = 4;      ///< the number of components per attribute
+  static const GLenum typeEnum = GL_FLOAT;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 4;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are not normalized
+};
+
+/// Traits structure for attribute properties (glm::u8vec4 specialization, e.g. RGBA8 colors)
+template <> struct AttributeProperties<glm::u8vec4> {
+  static const GLenum typeEnum = GL_UNSIGNED_BYTE; ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 4;              ///< the number of components per attribute
+  static const GLboolean normalized = GL_TRUE;     ///< components are mapped to [0, 1]
+};
+
+/// Traits structure for attribute properties (glm::i8vec2 specialization, e.g. octahedral directions)
+template <> struct AttributeProperties<glm::i8vec2> {
+  static const GLenum typeEnum = GL_BYTE;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 2;          ///< the number of components per attribute
+  static const GLboolean normalized = GL_TRUE; ///< components are mapped to [-1, 1]
+};
+
+/// Traits structure for attribute properties (glm::i16vec2 specialization, e.g. octahedral directions)
+template <> struct AttributeProperties<glm::i16vec2> {
+  static const GLenum typeEnum = GL_SHORT;     ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 2;          ///< the number of components per attribute
+  static const GLboolean normalized = GL_TRUE; ///< components are mapped to [-1, 1]
+};
+
+/// Traits structure for attribute properties (glm::u16vec4 specialization, e.g. positions relative to a bounding box)
+template <> struct AttributeProperties<glm::u16vec4> {
+  static const GLenum typeEnum = GL_UNSIGNED_SHORT; ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 4;               ///< the number of components per attribute
+  static const GLboolean normalized = GL_TRUE;      ///< components are mapped to [0, 1]
+};
+
+/// Traits structure for attribute properties (Half2 specialization, e.g. uvs)
+template <> struct AttributeProperties<Half2> {
+  static const GLenum typeEnum = GL_HALF_FLOAT; ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 2;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_FALSE; ///< components are floating point values
+};
+
+/// Format of an attribute in an interleaved vertex
+struct AttributeFormat {
+  GLenum typeEnum;      ///< The OpenGL enum representing the type of attribute components
+  GLuint components;    ///< the number of components per attribute
+  GLboolean normalized; ///< whether integer components are normalized
+  GLuint offset;        ///< offset of the attribute in the vertex (in bytes)
+};
+
+/**
+ * @brief Compile-time description of an interleaved vertex
+ *
+ * The attributes are packed in order, without padding, so that a vertex
+ * takes InterleavedLayout::stride bytes. Most GPUs fetch faster when all
+ * the offsets and the stride are multiples of 4 bytes, which is obtained by
+ * ordering the attributes by decreasing size.
+ *
+ * @see VAO::setInterleavedVBO
+ */
+template <typename... Attributes> struct InterleavedLayout;
+
+/// Interleaved layout without attributes (end of the recursion)
+template <> struct InterleavedLayout<> {
+  static const GLuint nbAttributes = 0; ///< the number of attributes
+  static const GLuint stride = 0;       ///< the size of a vertex (in bytes)
+
+  /// @brief appends the format of the attributes, starting at a given offset
+  static void formats(std::vector<AttributeFormat> &, GLuint) {}
+
+  /// @brief copies the attributes of a vertex
+  static void copy(unsigned char *, size_t) {}
+};
+
+/// Interleaved layout of the attributes First, Others...
+template <typename First, typename... Others> struct InterleavedLayout<First, Others...> {
+  static const GLuint nbAttributes = 1 + sizeof...(Others);                          ///< the number of attributes
+  static const GLuint stride = sizeof(First) + InterleavedLayout<Others...>::stride; ///< the size of a vertex (in bytes)
+
+  /// @brief the format of each attribute
+  static std::vector<AttributeFormat> formats()
+  {
+    std::vector<AttributeFormat> result;
+    formats(result, 0);
+    return result;
+  }
+
+  /// @brief appends the format of the attributes, starting at a given offset
+  static void formats(std::vector<AttributeFormat> & result, GLuint offset)
+  {
+    AttributeFormat format = {AttributeProperties<First>::typeEnum, AttributeProperties<First>::components, AttributeProperties<First>::normalized, offset};
+    result.push_back(format);
+    InterleavedLayout<Others...>::formats(result, offset + sizeof(First));
+  }
+
+  /**
+   * @brief interleaves attribute arrays
+   * @param first the values of the first attribute
+   * @param others the values of the other attributes (of the same size)
+   * @return the vertices, stride bytes each
+   */
+  static std::vector<unsigned char> interleave(Span<First> first, Span<Others>... others)
+  {
+    std::vector<unsigned char> vertices(first.size() * stride);
+    for (size_t k = 0; k < first.size(); k++) {
+      copy(vertices.data() + k * stride, k, first, others...);
+    }
+    return vertices;
+  }
+
+  /// @brief copies the attributes of a vertex
+  static void copy(unsigned char * vertex, size_t k, Span<First> first, Span<Others>... others)
+  {
+    assert(k < first.size() && "InterleavedLayout::interleave(): attribute arrays of different sizes");
+    std::memcpy(vertex, first.data() + k, sizeof(First));
+    InterleavedLayout<Others...>::copy(vertex + sizeof(First), k, others...);
+  }
 };
 
 #endif // __ATTRIBUTE_PROPERTIES_HPP
@@ -0,0 +1,558 @@
+#include "ByteStreams.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef GLITTER_IO_URING
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace
+{
+// the file descriptor calls (the POSIX names are deprecated on Windows)
+int openFile(const std::string & filename, bool output)
+{
+#ifdef _WIN32
+  return output ? _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE) : _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  return output ? ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) : ::open(filename.c_str(), O_RDONLY);
+#endif
+}
+
+/// @brief reads up to @p size bytes (less at the end of the file), negative on failure
+long long readFile(int fd, char * data, size_t size)
+{
+  size_t done = 0;
+  while (done < size) {
+    // at most 1 GB per call, the limit of some systems
+    const size_t chunk = std::min<size_t>(size - done, 1 << 30);
+#ifdef _WIN32
+    long long n = _read(fd, data + done, unsigned(chunk));
+#else
+    long long n = ::read(fd, data + done, chunk);
+    if (n < 0 and errno == EINTR) {
+      continue;
+    }
+#endif
+    if (n < 0) {
+      return n;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += size_t(n);
+  }
+  return (long long)done;
+}
+
+bool writeFile(int fd, const char * data, size_t size)
+{
+  while (size > 0) {
+    const size_t chunk = std::min<size_t>(size, 1 << 30);
+#ifdef _WIN32
+    long long n = _write(fd, data, unsigned(chunk));
+#else
+    long long n = ::write(fd, data, chunk);
+    if (n < 0 and errno == EINTR) {
+      continue;
+    }
+#endif
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+void closeFile(int fd)
+{
+#ifdef _WIN32
+  _close(fd);
+#else
+  ::close(fd);
+#endif
+}
+} // namespace
+
+size_t ByteSource::read(char * data, size_t size)
+{
+  size_t done = 0;
+  const char * window;
+  while (done < size) {
+    size_t n = next(window, size - done);
+    if (n == 0) {
+      break;
+    }
+    std::memcpy(data + done, window, n);
+    done += n;
+  }
+  return done;
+}
+
+bool ByteSource::skip(size_t size)
+{
+  const char * window;
+  while (size > 0) {
+    size_t n = next(window, size);
+    if (n == 0) {
+      return false;
+    }
+    size -= n;
+  }
+  return true;
+}
+
+StreamSink::StreamSink(std::ostream & stream) : m_stream(stream) {}
+
+bool StreamSink::write(const char * data, size_t size)
+{
+  return bool(m_stream.write(data, std::streamsize(size)));
+}
+
+StreamSource::StreamSource(std::istream & stream, size_t capacity) : m_stream(stream), m_buffer(std::max<size_t>(capacity, 1)) {}
+
+size_t StreamSource::next(const char *& data, size_t maximum)
+{
+  m_stream.read(m_buffer.data(), std::streamsize(std::min(maximum, m_buffer.size())));
+  data = m_buffer.data();
+  return size_t(m_stream.gcount());
+}
+
+size_t StreamSource::read(char * data, size_t size)
+{
+  m_stream.read(data, std::streamsize(size));
+  return size_t(m_stream.gcount());
+}
+
+bool StreamSource::skip(size_t size)
+{
+  return bool(m_stream.seekg(std::streamoff(size), std::ios::cur));
+}
+
+bool MemorySink::write(const char * data, size_t size)
+{
+  m_bytes.insert(m_bytes.end(), data, data + size);
+  return true;
+}
+
+const std::vector<char> & MemorySink::bytes() const
+{
+  return m_bytes;
+}
+
+MemorySource::MemorySource(const char * data, size_t size) : m_data(data), m_size(size), m_position(0) {}
+
+MemorySource::MemorySource() : m_data(nullptr), m_size(0), m_position(0) {}
+
+size_t MemorySource::next(const char *& data, size_t maximum)
+{
+  size_t n = std::min(maximum, m_size - m_position);
+  data = m_data + m_position;
+  m_position += n;
+  return n;
+}
+
+bool MemorySource::skip(size_t size)
+{
+  if (size > m_size - m_position) {
+    m_position = m_size;
+    return false;
+  }
+  m_position += size;
+  return true;
+}
+
+FileSink::FileSink(const std::string & filename) : m_fd(openFile(filename, true)) {}
+
+FileSink::~FileSink()
+{
+  if (m_fd >= 0) {
+    closeFile(m_fd);
+  }
+}
+
+bool FileSink::isOpen() const
+{
+  return m_fd >= 0;
+}
+
+bool FileSink::write(const char * data, size_t size)
+{
+  return m_fd >= 0 and writeFile(m_fd, data, size);
+}
+
+FileSource::FileSource(const std::string & filename, size_t capacity) : m_fd(openFile(filename, false)), m_buffer(std::max<size_t>(capacity, 1)) {}
+
+FileSource::~FileSource()
+{
+  if (m_fd >= 0) {
+    closeFile(m_fd);
+  }
+}
+
+bool FileSource::isOpen() const
+{
+  return m_fd >= 0;
+}
+
+size_t FileSource::next(const char *& data, size_t maximum)
+{
+  data = m_buffer.data();
+  long long n = m_fd >= 0 ? readFile(m_fd, m_buffer.data(), std::min(maximum, m_buffer.size())) : -1;
+  return n > 0 ? size_t(n) : 0;
+}
+
+size_t FileSource::read(char * data, size_t size)
+{
+  long long n = m_fd >= 0 ? readFile(m_fd, data, size) : -1;
+  return n > 0 ? size_t(n) : 0;
+}
+
+bool FileSource::skip(size_t size)
+{
+  if (m_fd < 0) {
+    return false;
+  }
+  // seeking does not check the end of the file
+#ifdef _WIN32
+  const long long position = _lseeki64(m_fd, 0, SEEK_CUR);
+  const long long target = std::min(_lseeki64(m_fd, 0, SEEK_END), position + (long long)size);
+  return position >= 0 and _lseeki64(m_fd, target, SEEK_SET) == target and target == position + (long long)size;
+#else
+  struct stat status;
+  off_t position = lseek(m_fd, 0, SEEK_CUR);
+  if (position < 0 or fstat(m_fd, &status) != 0) {
+    return ByteSource::skip(size);
+  }
+  const off_t target = std::min<off_t>(status.st_size, position + off_t(size));
+  return lseek(m_fd, target, SEEK_SET) == target and target == position + off_t(size);
+#endif
+}
+
+MappedSource::MappedSource(const std::string & filename) : m_open(false)
+{
+#ifdef _WIN32
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  if (file) {
+    m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_open = true;
+  }
+#else
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd < 0 or fstat(fd, &status) != 0) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return;
+  }
+  // an empty file cannot be mapped, but is a valid (empty) source
+  m_size = size_t(status.st_size);
+  void * mapping = m_size ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    m_size = 0;
+    return;
+  }
+  if (mapping) {
+    // read once, front to back
+    madvise(mapping, m_size, MADV_SEQUENTIAL);
+  }
+  m_data = static_cast<const char *>(mapping);
+  m_open = true;
+#endif
+}
+
+MappedSource::~MappedSource()
+{
+#ifndef _WIN32
+  if (m_data) {
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+#endif
+}
+
+bool MappedSource::isOpen() const
+{
+  return m_open;
+}
+
+#ifdef GLITTER_IO_URING
+/**
+ * The rings shared with the kernel (mapped from the io_uring file descriptor)
+ * and the blocks: block b of the file is read in slot b % nbSlots, the slot of
+ * a consumed block being reused for the block nbSlots blocks further.
+ */
+struct UringSource::Ring {
+  int fd;                 ///< the io_uring file descriptor
+  void * sqMapping;       ///< the submission ring
+  size_t sqMappingSize;   ///< size of the submission ring
+  void * cqMapping;       ///< the completion ring (the submission ring if the kernel maps both at once)
+  size_t cqMappingSize;   ///< size of the completion ring
+  io_uring_sqe * sqes;    ///< the submission entries
+  size_t sqesSize;        ///< size of the submission entries
+  unsigned int * sqTail;  ///< tail of the submission ring (written here)
+  unsigned int * sqMask;  ///< mask of the indices of the submission ring
+  unsigned int * sqArray; ///< the submitted entries
+  unsigned int * cqHead;  ///< head of the completion ring (written here)
+  unsigned int * cqTail;  ///< tail of the completion ring (written by the kernel)
+  unsigned int * cqMask;  ///< mask of the indices of the completion ring
+  io_uring_cqe * cqes;    ///< the completion entries
+
+  size_t blockSize;               ///< size of a block
+  unsigned int nbSlots;           ///< number of blocks read at once
+  std::unique_ptr<char[]> blocks; ///< the block of each slot, one after the other (not initialized)
+  std::vector<iovec> vectors;     ///< the read vector of each slot
+  std::vector<long long> results; ///< the bytes read in each slot (negative on failure)
+  std::vector<bool> pending;      ///< the slots being read
+  unsigned int nbPending;         ///< number of slots being read
+  std::uint64_t fileSize;         ///< size of the file
+  std::uint64_t block;            ///< the block being consumed
+  bool loaded;                    ///< true if the block being consumed was read
+  size_t position;                ///< number of bytes consumed in the block
+  size_t available;               ///< number of bytes of the block
+
+  Ring() : fd(-1), sqMapping(MAP_FAILED), sqMappingSize(0), cqMapping(MAP_FAILED), cqMappingSize(0), sqes(nullptr), sqesSize(0), nbPending(0) {}
+
+  ~Ring()
+  {
+    // the kernel writes to the blocks until the reads complete
+    while (nbPending > 0 and reap(true)) {
+    }
+    if (sqes) {
+      munmap(sqes, sqesSize);
+    }
+    if (cqMapping != MAP_FAILED and cqMapping != sqMapping) {
+      munmap(cqMapping, cqMappingSize);
+    }
+    if (sqMapping != MAP_FAILED) {
+      munmap(sqMapping, sqMappingSize);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  /// @brief creates the rings, false if io_uring is unavailable
+  bool setup(unsigned int depth)
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = int(syscall(__NR_io_uring_setup, depth, &params));
+    if (fd < 0) {
+      return false;
+    }
+    sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMapping = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+#endif
+    if (singleMapping) {
+      sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+    }
+    sqMapping = mmap(nullptr, sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqMapping == MAP_FAILED) {
+      return false;
+    }
+    cqMapping = singleMapping ? sqMapping : mmap(nullptr, cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cqMapping == MAP_FAILED) {
+      return false;
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void * sqesMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqesMapping == MAP_FAILED) {
+      return false;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqesMapping);
+    char * sq = static_cast<char *>(sqMapping);
+    char * cq = static_cast<char *>(cqMapping);
+    sqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  /// @brief queues the read of a block in its slot (nothing past the end of the file), false on failure
+  bool submit(int fileFd, std::uint64_t b)
+  {
+    const std::uint64_t offset = b * blockSize;
+    if (offset >= fileSize) {
+      return true;
+    }
+    const unsigned int slot = unsigned(b % nbSlots);
+    vectors[slot].iov_base = blocks.get() + slot * blockSize;
+    vectors[slot].iov_len = size_t(std::min<std::uint64_t>(blockSize, fileSize - offset));
+    const unsigned int tail = *sqTail;
+    const unsigned int index = tail & *sqMask;
+    io_uring_sqe & sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = fileFd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(&vectors[slot]);
+    sqe.len = 1;
+    sqe.off = offset;
+    sqe.user_data = slot;
+    sqArray[index] = index;
+    // the entry must be visible before the tail
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pending[slot] = true;
+    nbPending++;
+    while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) < 0) {
+      if (errno != EINTR) {
+        pending[slot] = false;
+        nbPending--;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// @brief collects the completed reads, waiting for one if @p wait, false on failure
+  bool reap(bool wait)
+  {
+    unsigned int head = *cqHead;
+    if (wait and head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 and errno != EINTR) {
+        return false;
+      }
+    }
+    while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe & cqe = cqes[head & *cqMask];
+      const unsigned int slot = unsigned(cqe.user_data);
+      results[slot] = cqe.res;
+      pending[slot] = false;
+      nbPending--;
+      head++;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return true;
+  }
+};
+#else
+struct UringSource::Ring {};
+#endif
+
+UringSource::UringSource(const std::string & filename, size_t blockSize, unsigned int depth) : FileSource(filename)
+{
+#ifdef GLITTER_IO_URING
+  struct stat status;
+  if (m_fd < 0 or fstat(m_fd, &status) != 0) {
+    return;
+  }
+  m_ring.reset(new Ring());
+  Ring & ring = *m_ring;
+  ring.fileSize = std::uint64_t(status.st_size);
+  // the blocks are fitted to the small files, as touching fresh memory costs as much as reading it
+  ring.blockSize = size_t(std::max<std::uint64_t>(std::min<std::uint64_t>(blockSize, ring.fileSize), 1));
+  ring.nbSlots = unsigned(std::max<std::uint64_t>(std::min<std::uint64_t>(depth, (ring.fileSize + ring.blockSize - 1) / ring.blockSize), 1));
+  ring.blocks.reset(new char[ring.nbSlots * ring.blockSize]);
+  ring.vectors.resize(ring.nbSlots);
+  ring.results.assign(ring.nbSlots, 0);
+  ring.pending.assign(ring.nbSlots, false);
+  ring.block = 0;
+  ring.loaded = false;
+  ring.position = ring.available = 0;
+  if (not ring.setup(ring.nbSlots)) {
+    m_ring.reset();
+    return;
+  }
+  for (unsigned int b = 0; b < ring.nbSlots; b++) {
+    if (not ring.submit(m_fd, b)) {
+      // nothing was read yet, the file is read synchronously
+      m_ring.reset();
+      return;
+    }
+  }
+#else
+  (void)blockSize;
+  (void)depth;
+#endif
+}
+
+UringSource::~UringSource() {}
+
+bool UringSource::isAsynchronous() const
+{
+  return bool(m_ring);
+}
+
+size_t UringSource::next(const char *& data, size_t maximum)
+{
+#ifdef GLITTER_IO_URING
+  if (m_ring) {
+    Ring & ring = *m_ring;
+    if (ring.loaded and ring.position == ring.available) {
+      // the slot of the consumed block reads the block nbSlots blocks further
+      if (not ring.submit(m_fd, ring.block + ring.nbSlots)) {
+        return 0;
+      }
+      ring.block++;
+      ring.loaded = false;
+    }
+    if (not ring.loaded) {
+      const std::uint64_t offset = ring.block * ring.blockSize;
+      const unsigned int slot = unsigned(ring.block % ring.nbSlots);
+      if (offset >= ring.fileSize) {
+        return 0;
+      }
+      while (ring.pending[slot]) {
+        if (not ring.reap(true)) {
+          return 0;
+        }
+      }
+      const size_t expected = ring.vectors[slot].iov_len;
+      long long n = ring.results[slot];
+      if (n >= 0 and size_t(n) < expected) {
+        // a short read (the file may have been truncated): the rest is read synchronously
+        long long rest = pread(m_fd, ring.blocks.get() + slot * ring.blockSize + n, expected - size_t(n), off_t(offset) + n);
+        n = rest < 0 ? rest : n + rest;
+      }
+      if (n <= 0) {
+        return 0;
+      }
+      ring.loaded = true;
+      ring.position = 0;
+      ring.available = size_t(n);
+    }
+    const size_t n = std::min(maximum, ring.available - ring.position);
+    data = ring.blocks.get() + (ring.block % ring.nbSlots) * ring.blockSize + ring.position;
+    ring.position += n;
+    return n;
+  }
+#endif
+  return FileSource::next(data, maximum);
+}
+
+size_t UringSource::read(char * data, size_t size)
+{
+  // the blocks read ahead are copied
+  return m_ring ? ByteSource::read(data, size) : FileSource::read(data, size);
+}
+
+bool UringSource::skip(size_t size)
+{
+  return m_ring ? ByteSource::skip(size) : FileSource::skip(size);
+}
@@ -0,0 +1,201 @@
+#ifndef __GLITTER_BYTESTREAMS_H__
+#define __GLITTER_BYTESTREAMS_H__
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A destination of bytes, written by BufferedWriter (see Serialize.hpp)
+ *
+ * The writes are large (a buffer of BufferedWriter at a time, or a whole
+ * array): a sink does not need to buffer them.
+ */
+class ByteSink {
+public:
+  virtual ~ByteSink() {}
+
+  /// @brief writes bytes, false on failure
+  virtual bool write(const char * data, size_t size) = 0;
+};
+
+/**
+ * @brief An origin of bytes, read by BufferedReader (see Serialize.hpp)
+ *
+ * A source hands out its bytes by windows (see next), so that the sources
+ * holding the whole content in memory are read without copy, the other ones
+ * filling a buffer of their own.
+ */
+class ByteSource {
+public:
+  virtual ~ByteSource() {}
+
+  /**
+   * @brief the next bytes of the source
+   * @param data set to the bytes, valid until the next call
+   * @param maximum the maximal number of bytes
+   * @return the number of bytes, 0 at the end of the source (or on failure)
+   */
+  virtual size_t next(const char *& data, size_t maximum) = 0;
+
+  /**
+   * @brief reads bytes directly to their destination (for large reads)
+   * @return the number of bytes read, less than @p size at the end of the source
+   */
+  virtual size_t read(char * data, size_t size);
+
+  /// @brief skips bytes, false if the source ended before
+  virtual bool skip(size_t size);
+};
+
+/// A sink writing to a standard stream
+class StreamSink : public ByteSink {
+public:
+  explicit StreamSink(std::ostream & stream);
+  bool write(const char * data, size_t size) override;
+
+private:
+  std::ostream & m_stream; ///< the output stream
+};
+
+/// A source reading from a standard stream
+class StreamSource : public ByteSource {
+public:
+  /// @brief Constructor, @p capacity being the size of the buffer
+  explicit StreamSource(std::istream & stream, size_t capacity = 1 << 16);
+  size_t next(const char *& data, size_t maximum) override;
+  size_t read(char * data, size_t size) override;
+  bool skip(size_t size) override;
+
+private:
+  std::istream & m_stream;    ///< the input stream
+  std::vector<char> m_buffer; ///< the window handed out by next
+};
+
+/// A sink appending to a buffer in memory
+class MemorySink : public ByteSink {
+public:
+  bool write(const char * data, size_t size) override;
+
+  /// @brief the bytes written
+  const std::vector<char> & bytes() const;
+
+private:
+  std::vector<char> m_bytes; ///< the bytes written
+};
+
+/// A source reading from memory, without copy (the bytes must outlive the source)
+class MemorySource : public ByteSource {
+public:
+  MemorySource(const char * data, size_t size);
+  size_t next(const char *& data, size_t maximum) override;
+  bool skip(size_t size) override;
+
+protected:
+  MemorySource();
+
+protected:
+  const char * m_data; ///< the bytes
+  size_t m_size;       ///< number of bytes
+  size_t m_position;   ///< number of bytes consumed
+};
+
+/**
+ * @brief A sink writing to a file descriptor, by write calls (the buffering is done by BufferedWriter)
+ *
+ * The file is created, or truncated, by the constructor and closed by the destructor.
+ */
+class FileSink : public ByteSink {
+public:
+  explicit FileSink(const std::string & filename);
+  ~FileSink() override;
+
+  FileSink(const FileSink &) = delete;
+  FileSink & operator=(const FileSink &) = delete;
+
+  /// @brief false if the file could not be created
+  bool isOpen() const;
+
+  bool write(const char * data, size_t size) override;
+
+private:
+  int m_fd; ///< the file descriptor (negative if the file could not be created)
+};
+
+/// A source reading a file descriptor, by blocks (the large reads going directly to their destination)
+class FileSource : public ByteSource {
+public:
+  /// @brief Constructor, @p capacity being the size of a block
+  explicit FileSource(const std::string & filename, size_t capacity = 1 << 16);
+  ~FileSource() override;
+
+  FileSource(const FileSource &) = delete;
+  FileSource & operator=(const FileSource &) = delete;
+
+  /// @brief false if the file could not be opened
+  bool isOpen() const;
+
+  size_t next(const char *& data, size_t maximum) override;
+  size_t read(char * data, size_t size) override;
+  bool skip(size_t size) override;
+
+protected:
+  int m_fd;                   ///< the file descriptor (negative if the file could not be opened)
+  std::vector<char> m_buffer; ///< the window handed out by next
+};
+
+/**
+ * @brief A source mapping a whole file in memory, read without copy
+ * @note there is no mapping on Windows: the file is read at once
+ */
+class MappedSource : public MemorySource {
+public:
+  explicit MappedSource(const std::string & filename);
+  ~MappedSource() override;
+
+  MappedSource(const MappedSource &) = delete;
+  MappedSource & operator=(const MappedSource &) = delete;
+
+  /// @brief false if the file could not be mapped
+  bool isOpen() const;
+
+private:
+  bool m_open; ///< true if the file is mapped
+#ifdef _WIN32
+  std::vector<char> m_buffer; ///< the whole file (no mapping)
+#endif
+};
+
+/**
+ * @brief A source reading a file sequentially with io_uring, several blocks being read ahead
+ *
+ * The reads of the next blocks are queued in one system call and run while
+ * the current block is consumed. Without io_uring (other systems, builds
+ * without GLITTER_IO_URING, or kernels refusing it), the file is read as by
+ * FileSource.
+ */
+class UringSource : public FileSource {
+public:
+  /**
+   * @brief Constructor
+   * @param filename the file
+   * @param blockSize the size of a read
+   * @param depth the number of blocks read ahead
+   */
+  explicit UringSource(const std::string & filename, size_t blockSize = 1 << 20, unsigned int depth = 4);
+  ~UringSource() override;
+
+  /// @brief true if the reads go through io_uring
+  bool isAsynchronous() const;
+
+  size_t next(const char *& data, size_t maximum) override;
+  size_t read(char * data, size_t size) override;
+  bool skip(size_t size) override;
+
+private:
+  struct Ring;
+  std::unique_ptr<Ring> m_ring; ///< the io_uring queues and the blocks (null without io_uring)
+};
+
+#endif // !defined(__GLITTER_BYTESTREAMS_H__)
@@ -0,0 +1,319 @@
+#include "ChunkCodec.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "ThreadPool.hpp"
+
+namespace
+{
+const size_t minMatch = 4;        ///< shortest match
+const size_t maxOffset = 65535;   ///< farthest match (16-bit offsets)
+const unsigned int hashBits = 14; ///< log2 of the size of the match finder table
+const size_t lastLiterals = 8;    ///< the last bytes of a block are always literals (no match search past the end)
+const size_t tileSize = 1024;     ///< number of values shuffled at once
+
+/// @brief hash of the 4 bytes at @p p
+inline std::uint32_t hash4(const unsigned char * p)
+{
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return (value * 2654435761u) >> (32 - hashBits);
+}
+
+/// @brief appends a length larger than 14 (or 15) as a sequence of 255 bytes ended by a smaller one
+void writeLength(size_t length, std::vector<unsigned char> & output)
+{
+  for (; length >= 255; length -= 255) {
+    output.push_back(255);
+  }
+  output.push_back(static_cast<unsigned char>(length));
+}
+
+/// @brief reads an extended length, false if the input is exhausted
+bool readLength(const unsigned char *& input, const unsigned char * end, size_t & length)
+{
+  unsigned char byte;
+  do {
+    if (input == end) {
+      return false;
+    }
+    byte = *input++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/// @brief appends a sequence: a token, literals, then a match (if @p matchLength is not null)
+void writeSequence(const unsigned char * literals, size_t nbLiterals, size_t offset, size_t matchLength, std::vector<unsigned char> & output)
+{
+  size_t encodedMatch = matchLength ? matchLength - minMatch : 0;
+  unsigned char token = static_cast<unsigned char>((std::min<size_t>(nbLiterals, 15) << 4) | std::min<size_t>(encodedMatch, 15));
+  output.push_back(token);
+  if (nbLiterals >= 15) {
+    writeLength(nbLiterals - 15, output);
+  }
+  output.insert(output.end(), literals, literals + nbLiterals);
+  if (matchLength) {
+    output.push_back(static_cast<unsigned char>(offset & 0xFF));
+    output.push_back(static_cast<unsigned char>(offset >> 8));
+    if (encodedMatch >= 15) {
+      writeLength(encodedMatch - 15, output);
+    }
+  }
+}
+
+void writeUint32(std::uint32_t value, std::vector<unsigned char> & output)
+{
+  for (int b = 0; b < 4; b++) {
+    output.push_back(static_cast<unsigned char>(value >> (8 * b)));
+  }
+}
+
+std::uint32_t readUint32(const unsigned char * input)
+{
+  return std::uint32_t(input[0]) | std::uint32_t(input[1]) << 8 | std::uint32_t(input[2]) << 16 | std::uint32_t(input[3]) << 24;
+}
+
+/// @brief unshuffle of the strides of the vertex attributes and indices, written value by value (the loop over the bytes being unrolled)
+template <unsigned int Stride> void unshuffleValues(const unsigned char * shuffled, size_t nbValues, unsigned char * data)
+{
+  for (size_t k = 0; k < nbValues; k++) {
+    for (unsigned int b = 0; b < Stride; b++) {
+      data[k * Stride + b] = shuffled[b * nbValues + k];
+    }
+  }
+}
+} // namespace
+
+const size_t ChunkCodec::blockSize; // bound to references (std::min)
+
+void ChunkCodec::encode(const void * data, size_t size, unsigned int filters, unsigned int stride, std::vector<unsigned char> & encoded, ThreadPool * pool)
+{
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  std::vector<unsigned char> filtered;
+  if ((filters & Shuffle) and stride > 1) {
+    filtered.resize(size);
+    shuffle(bytes, size, stride, filtered.data());
+    bytes = filtered.data();
+  }
+  // the blocks are independent: they are compressed apart, then concatenated
+  const size_t nbBlocks = (size + blockSize - 1) / blockSize;
+  std::vector<std::vector<unsigned char>> blocks(nbBlocks);
+  auto encodeBlock = [&](size_t b) {
+    size_t blockBytes = std::min(blockSize, size - b * blockSize);
+    const unsigned char * input = bytes + b * blockSize;
+    std::vector<unsigned char> block;
+    if (filters & Delta) {
+      block.resize(blockBytes);
+      unsigned char previous = 0;
+      for (size_t k = 0; k < blockBytes; k++) {
+        block[k] = input[k] - previous;
+        previous = input[k];
+      }
+      input = block.data();
+    }
+    compress(input, blockBytes, blocks[b]);
+  };
+  if (pool and nbBlocks > 1) {
+    pool->parallelFor(nbBlocks, encodeBlock);
+  } else {
+    for (size_t b = 0; b < nbBlocks; b++) {
+      encodeBlock(b);
+    }
+  }
+  encoded.clear();
+  writeUint32(std::uint32_t(nbBlocks), encoded);
+  for (const std::vector<unsigned char> & block : blocks) {
+    writeUint32(std::uint32_t(block.size()), encoded);
+  }
+  for (const std::vector<unsigned char> & block : blocks) {
+    encoded.insert(encoded.end(), block.begin(), block.end());
+  }
+}
+
+bool ChunkCodec::decode(Span<unsigned char> encoded, unsigned int filters, unsigned int stride, std::vector<unsigned char> & decoded)
+{
+  std::vector<Span<unsigned char>> blocks;
+  if (not splitBlocks(encoded, decoded.size(), blocks)) {
+    return false;
+  }
+  const bool shuffled = (filters & Shuffle) and stride > 1;
+  std::vector<unsigned char> filtered(shuffled ? decoded.size() : 0);
+  unsigned char * output = shuffled ? filtered.data() : decoded.data();
+  for (size_t b = 0; b < blocks.size(); b++) {
+    if (not decodeBlock(blocks[b], filters, output + b * blockSize, std::min(blockSize, decoded.size() - b * blockSize))) {
+      return false;
+    }
+  }
+  if (shuffled) {
+    unshuffle(filtered.data(), decoded.size(), stride, decoded.data());
+  }
+  return true;
+}
+
+bool ChunkCodec::splitBlocks(Span<unsigned char> encoded, size_t size, std::vector<Span<unsigned char>> & blocks)
+{
+  blocks.clear();
+  if (encoded.size() < 4) {
+    return false;
+  }
+  const size_t nbBlocks = readUint32(encoded.data());
+  if (nbBlocks != (size + blockSize - 1) / blockSize or encoded.size() < 4 + 4 * nbBlocks) {
+    return false;
+  }
+  size_t offset = 4 + 4 * nbBlocks;
+  for (size_t b = 0; b < nbBlocks; b++) {
+    size_t blockBytes = readUint32(encoded.data() + 4 + 4 * b);
+    if (blockBytes > encoded.size() - offset) {
+      return false;
+    }
+    blocks.push_back(Span<unsigned char>(encoded.data() + offset, blockBytes));
+    offset += blockBytes;
+  }
+  return offset == encoded.size();
+}
+
+bool ChunkCodec::decodeBlock(Span<unsigned char> block, unsigned int filters, unsigned char * decoded, size_t size)
+{
+  if (not decompress(block, decoded, size)) {
+    return false;
+  }
+  if (filters & Delta) {
+    for (size_t k = 1; k < size; k++) {
+      decoded[k] += decoded[k - 1];
+    }
+  }
+  return true;
+}
+
+void ChunkCodec::shuffle(const unsigned char * data, size_t size, unsigned int stride, unsigned char * shuffled)
+{
+  // tiled, so that the values of a tile stay in the cache while their planes are written
+  const size_t nbValues = size / stride;
+  for (size_t first = 0; first < nbValues; first += tileSize) {
+    const size_t last = std::min(first + tileSize, nbValues);
+    for (unsigned int b = 0; b < stride; b++) {
+      unsigned char * plane = shuffled + b * nbValues;
+      for (size_t k = first; k < last; k++) {
+        plane[k] = data[k * stride + b];
+      }
+    }
+  }
+  std::memcpy(shuffled + nbValues * stride, data + nbValues * stride, size - nbValues * stride);
+}
+
+void ChunkCodec::unshuffle(const unsigned char * shuffled, size_t size, unsigned int stride, unsigned char * data)
+{
+  const size_t nbValues = size / stride;
+  switch (stride) {
+  case 2:
+    unshuffleValues<2>(shuffled, nbValues, data);
+    break;
+  case 3:
+    unshuffleValues<3>(shuffled, nbValues, data);
+    break;
+  case 4:
+    unshuffleValues<4>(shuffled, nbValues, data);
+    break;
+  case 8:
+    unshuffleValues<8>(shuffled, nbValues, data);
+    break;
+  case 12:
+    unshuffleValues<12>(shuffled, nbValues, data);
+    break;
+  case 16:
+    unshuffleValues<16>(shuffled, nbValues, data);
+    break;
+  default:
+    for (size_t first = 0; first < nbValues; first += tileSize) {
+      const size_t last = std::min(first + tileSize, nbValues);
+      for (unsigned int b = 0; b < stride; b++) {
+        const unsigned char * plane = shuffled + b * nbValues;
+        for (size_t k = first; k < last; k++) {
+          data[k * stride + b] = plane[k];
+        }
+      }
+    }
+  }
+  std::memcpy(data + nbValues * stride, shuffled + nbValues * stride, size - nbValues * stride);
+}
+
+void ChunkCodec::compress(const unsigned char * data, size_t size, std::vector<unsigned char> & compressed)
+{
+  // greedy parsing, the match candidate being the last position with the same hash
+  std::vector<std::uint32_t> table(size_t(1) << hashBits, 0);
+  size_t anchor = 0;
+  size_t position = 0;
+  while (size > lastLiterals and position < size - lastLiterals) {
+    std::uint32_t & slot = table[hash4(data + position)];
+    size_t candidate = slot;
+    slot = std::uint32_t(position);
+    if (candidate >= position or position - candidate > maxOffset or std::memcmp(data + candidate, data + position, minMatch)) {
+      position++;
+      continue;
+    }
+    size_t length = minMatch;
+    while (position + length < size - lastLiterals and data[candidate + length] == data[position + length]) {
+      length++;
+    }
+    writeSequence(data + anchor, position - anchor, position - candidate, length, compressed);
+    // the positions inside the match are not hashed, but the one before its end
+    table[hash4(data + position + length - 2)] = std::uint32_t(position + length - 2);
+    position += length;
+    anchor = position;
+  }
+  writeSequence(data + anchor, size - anchor, 0, 0, compressed);
+}
+
+bool ChunkCodec::decompress(Span<unsigned char> compressed, unsigned char * data, size_t size)
+{
+  const unsigned char * input = compressed.data();
+  const unsigned char * inputEnd = input + compressed.size();
+  size_t position = 0;
+  while (input < inputEnd) {
+    unsigned char token = *input++;
+    size_t nbLiterals = token >> 4;
+    if (nbLiterals == 15 and not readLength(input, inputEnd, nbLiterals)) {
+      return false;
+    }
+    if (nbLiterals > size_t(inputEnd - input) or nbLiterals > size - position) {
+      return false;
+    }
+    std::memcpy(data + position, input, nbLiterals);
+    input += nbLiterals;
+    position += nbLiterals;
+    if (input == inputEnd) {
+      break; // the last sequence has no match
+    }
+    if (inputEnd - input < 2) {
+      return false;
+    }
+    size_t offset = size_t(input[0]) | size_t(input[1]) << 8;
+    input += 2;
+    size_t length = token & 15;
+    if (length == 15 and not readLength(input, inputEnd, length)) {
+      return false;
+    }
+    length += minMatch;
+    if (offset == 0 or offset > position or length > size - position) {
+      return false;
+    }
+    unsigned char * output = data + position;
+    const unsigned char * match = output - offset;
+    if (offset >= 8 and size - position >= length + 8) {
+      // copy by 8 bytes, possibly past the end of the match (but not of the block)
+      for (size_t k = 0; k < length; k += 8) {
+        std::memcpy(output + k, match + k, 8);
+      }
+    } else if (offset >= length) {
+      std::memcpy(output, match, length);
+    } else {
+      // overlapping match (a repeated pattern)
+      for (size_t k = 0; k < length; k++) {
+        output[k] = match[k];
+      }
+    }
+    position += length;
+  }
+  return position == size;
+}
@@ -0,0 +1,99 @@
+#ifndef __GLITTER_CHUNKCODEC_H__
+#define __GLITTER_CHUNKCODEC_H__
+#include <cstddef>
+#include <vector>
+#include "Span.hpp"
+
+// forward declarations
+class ThreadPool;
+
+/**
+ * @brief Lossless compression of the chunks of .glitter files
+ *
+ * A chunk is encoded in the following passes:
+ *	+ byte shuffle (optional): the bytes of the values are regrouped by their
+ *	  position in the value (all the first bytes, then all the second ones...),
+ *	  so that the slowly varying bytes of a float stream (sign, exponent, high
+ *	  mantissa) are stored next to each other
+ *	+ the shuffled bytes are split into independent blocks of blockSize bytes
+ *	+ delta (optional): each byte of a block is replaced by its difference
+ *	  with the previous one, turning smooth sequences into runs of small values
+ *	+ LZ77 compression of each block, in a byte-oriented format close to the
+ *	  one of LZ4 (literal runs and matches of at least 4 bytes in a 64 KB
+ *	  window), which favours the decoding speed over the ratio
+ *
+ * The encoded chunk is the number of blocks (uint32), the encoded size of
+ * each block (uint32), then the blocks. The blocks being independent, the
+ * blocks of all the chunks of a file are decoded in parallel (see
+ * GlitterFile::open): decodeBlock on each block, then unshuffle on each chunk.
+ */
+class ChunkCodec {
+public:
+  /// The filters applied before the compression
+  enum Filter
+  {
+    NoFilter = 0,     ///< the bytes are compressed as they are
+    Shuffle = 1 << 0, ///< byte shuffle of the values
+    Delta = 1 << 1    ///< byte delta within each block
+  };
+
+  /// @brief number of bytes of a block (but the last one of a chunk)
+  static const size_t blockSize = 256 * 1024;
+
+  /**
+   * @brief encodes a chunk
+   * @param data the bytes of the chunk
+   * @param size the number of bytes of the chunk
+   * @param filters combination of Filter
+   * @param stride size of a value in bytes, for the byte shuffle
+   * @param encoded the encoded chunk
+   * @param pool if not null, the blocks are compressed in parallel by its threads
+   */
+  static void encode(const void * data, size_t size, unsigned int filters, unsigned int stride, std::vector<unsigned char> & encoded, ThreadPool * pool = nullptr);
+
+  /**
+   * @brief decodes a chunk (single-threaded)
+   * @param encoded the encoded chunk
+   * @param filters the filters given at encoding
+   * @param stride the stride given at encoding
+   * @param decoded the decoded chunk, already sized to the number of bytes of the chunk
+   * @return false if the encoded chunk is ill-formed
+   */
+  static bool decode(Span<unsigned char> encoded, unsigned int filters, unsigned int stride, std::vector<unsigned char> & decoded);
+
+  /**
+   * @brief splits an encoded chunk into its encoded blocks
+   * @param encoded the encoded chunk
+   * @param size the number of bytes of the decoded chunk
+   * @param blocks the encoded blocks, the decoded block b starting at byte b * blockSize of the (shuffled) chunk
+   * @return false if the encoded chunk is ill-formed
+   */
+  static bool splitBlocks(Span<unsigned char> encoded, size_t size, std::vector<Span<unsigned char>> & blocks);
+
+  /**
+   * @brief decodes a block, the delta filter included
+   * @param block the encoded block
+   * @param filters the filters given at encoding
+   * @param decoded the decoded block
+   * @param size the number of bytes of the decoded block
+   * @return false if the encoded block is ill-formed
+   */
+  static bool decodeBlock(Span<unsigned char> block, unsigned int filters, unsigned char * decoded, size_t size);
+
+  /// @brief byte shuffle of @p size bytes made of values of @p stride bytes (the trailing bytes are kept as they are)
+  static void shuffle(const unsigned char * data, size_t size, unsigned int stride, unsigned char * shuffled);
+
+  /// @brief inverse of shuffle
+  static void unshuffle(const unsigned char * shuffled, size_t size, unsigned int stride, unsigned char * data);
+
+  /// @brief LZ77 compression of a block, appended to @p compressed
+  static void compress(const unsigned char * data, size_t size, std::vector<unsigned char> & compressed);
+
+  /**
+   * @brief LZ77 decompression of a block
+   * @return false if the compressed block is ill-formed or does not decode to exactly @p size bytes
+   */
+  static bool decompress(Span<unsigned char> compressed, unsigned char * data, size_t size);
+};
+
+#endif // !defined(__GLITTER_CHUNKCODEC_H__)
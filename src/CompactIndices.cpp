@@ -0,0 +1,111 @@
+#include "CompactIndices.hpp"
+#include <algorithm>
+
+namespace
+{
+/// @brief rebased copy of the indices in a narrower type
+template <typename T> std::vector<T> narrow(const std::vector<unsigned int> & ibo, unsigned int baseVertex)
+{
+  std::vector<T> indices(ibo.size());
+  for (size_t k = 0; k < ibo.size(); k++) {
+    indices[k] = T(ibo[k] - baseVertex);
+  }
+  return indices;
+}
+
+/// @brief appends the rebased values of narrowed indices
+template <typename T> void expandIndices(const unsigned char * bytes, size_t count, unsigned int baseVertex, std::vector<unsigned int> & ibo)
+{
+  const T * indices = reinterpret_cast<const T *>(bytes);
+  for (size_t k = 0; k < count; k++) {
+    ibo.push_back(baseVertex + indices[k]);
+  }
+}
+} // namespace
+
+std::vector<unsigned int> IndexSpan::expand() const
+{
+  std::vector<unsigned int> ibo;
+  ibo.reserve(size());
+  if (indexSize == 1) {
+    expandIndices<glm::uint8>(bytes.data(), size(), baseVertex, ibo);
+  } else if (indexSize == 2) {
+    expandIndices<glm::uint16>(bytes.data(), size(), baseVertex, ibo);
+  } else {
+    expandIndices<glm::uint32>(bytes.data(), size(), baseVertex, ibo);
+  }
+  return ibo;
+}
+
+CompactIndices::CompactIndices() : m_indexSize(2), m_baseVertex(0) {}
+
+CompactIndices::CompactIndices(const std::vector<unsigned int> & ibo, bool allowBytes) : m_indexSize(4), m_baseVertex(0)
+{
+  if (ibo.empty()) {
+    m_indexSize = 2;
+    return;
+  }
+  auto range = std::minmax_element(ibo.begin(), ibo.end());
+  const unsigned int span = *range.second - *range.first;
+  if (allowBytes and span < 256) {
+    m_indexSize = 1;
+    m_baseVertex = *range.first;
+    m_indices8 = narrow<glm::uint8>(ibo, m_baseVertex);
+  } else if (span < 65536) {
+    m_indexSize = 2;
+    m_baseVertex = *range.first;
+    m_indices16 = narrow<glm::uint16>(ibo, m_baseVertex);
+  } else {
+    m_indices32 = ibo;
+  }
+}
+
+unsigned int CompactIndices::indexSize() const
+{
+  return m_indexSize;
+}
+
+unsigned int CompactIndices::baseVertex() const
+{
+  return m_baseVertex;
+}
+
+size_t CompactIndices::size() const
+{
+  return m_indices8.size() + m_indices16.size() + m_indices32.size();
+}
+
+const std::vector<glm::uint8> & CompactIndices::indices8() const
+{
+  return m_indices8;
+}
+
+const std::vector<glm::uint16> & CompactIndices::indices16() const
+{
+  return m_indices16;
+}
+
+const std::vector<glm::uint32> & CompactIndices::indices32() const
+{
+  return m_indices32;
+}
+
+std::vector<unsigned int> CompactIndices::expand() const
+{
+  return view().expand();
+}
+
+IndexSpan CompactIndices::view() const
+{
+  IndexSpan span;
+  span.indexSize = m_indexSize;
+  span.baseVertex = m_baseVertex;
+  if (m_indexSize == 1) {
+    span.bytes = Span<unsigned char>(m_indices8.data(), m_indices8.size());
+  } else if (m_indexSize == 2) {
+    span.bytes = Span<unsigned char>(reinterpret_cast<const unsigned char *>(m_indices16.data()), 2 * m_indices16.size());
+  } else {
+    span.bytes = Span<unsigned char>(reinterpret_cast<const unsigned char *>(m_indices32.data()), 4 * m_indices32.size());
+  }
+  return span;
+}
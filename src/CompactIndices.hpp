@@ -0,0 +1,84 @@
+#ifndef __GLITTER_COMPACTINDICES_H__
+#define __GLITTER_COMPACTINDICES_H__
+#include <glm/gtc/type_precision.hpp>
+#include <vector>
+#include "Span.hpp"
+
+/**
+ * @brief A read-only view of narrowed indices
+ *
+ * @see CompactIndices::view, GlitterMesh::compactIbo
+ */
+struct IndexSpan {
+  unsigned int indexSize;    ///< size of an index (1, 2 or 4 bytes)
+  unsigned int baseVertex;   ///< vertex added to each index
+  Span<unsigned char> bytes; ///< the indices
+
+  /// @brief number of indices
+  size_t size() const
+  {
+    return bytes.size() / indexSize;
+  }
+
+  /// @brief the 32-bit indices, base vertex included
+  std::vector<unsigned int> expand() const;
+};
+
+/**
+ * @brief An IBO stored with the narrowest index type addressing its vertices
+ *
+ * The indices are rebased on the smallest vertex they reference (the base
+ * vertex, added back at draw time by glDrawElementsBaseVertex), so that a
+ * part referencing less than 65536 consecutive vertices of a large shared
+ * vertex array still uses 16-bit indices.
+ *
+ * 8-bit indices are only used when explicitly allowed, since many GPUs
+ * convert them to 16-bit indices on the CPU side of the driver.
+ *
+ * @see VAO::setIBO
+ */
+class CompactIndices {
+public:
+  /// @brief Constructor of an empty IBO
+  CompactIndices();
+
+  /**
+   * @brief Constructor
+   * @param ibo the 32-bit indices
+   * @param allowBytes if true, 8-bit indices are used for less than 256 vertices
+   */
+  CompactIndices(const std::vector<unsigned int> & ibo, bool allowBytes = false);
+
+  /// @brief size of an index (1, 2 or 4 bytes)
+  unsigned int indexSize() const;
+
+  /// @brief vertex added to each index
+  unsigned int baseVertex() const;
+
+  /// @brief number of indices
+  size_t size() const;
+
+  /// @brief 8-bit indices (empty unless indexSize() is 1)
+  const std::vector<glm::uint8> & indices8() const;
+
+  /// @brief 16-bit indices (empty unless indexSize() is 2)
+  const std::vector<glm::uint16> & indices16() const;
+
+  /// @brief 32-bit indices (empty unless indexSize() is 4)
+  const std::vector<glm::uint32> & indices32() const;
+
+  /// @brief the 32-bit indices, base vertex included
+  std::vector<unsigned int> expand() const;
+
+  /// @brief a view of the indices
+  IndexSpan view() const;
+
+private:
+  unsigned int m_indexSize;             ///< size of an index (in bytes)
+  unsigned int m_baseVertex;            ///< vertex added to each index
+  std::vector<glm::uint8> m_indices8;   ///< 8-bit indices
+  std::vector<glm::uint16> m_indices16; ///< 16-bit indices
+  std::vector<glm::uint32> m_indices32; ///< 32-bit indices
+};
+
+#endif // !defined(__GLITTER_COMPACTINDICES_H__)
@@ -0,0 +1,298 @@
+#include "GLState.hpp"
+#include <algorithm>
+
+namespace
+{
+const GLuint unknown = GLuint(-1); ///< binding of a stale cache entry (no object has this name)
+const GLuint maxUnits = 32;        ///< number of texture units cached (the others are not)
+
+/// The buffer targets cached
+const GLenum bufferTargets[] = {GL_ARRAY_BUFFER,      GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER,  GL_COPY_READ_BUFFER,    GL_COPY_WRITE_BUFFER,
+                                GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER,  GL_TEXTURE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER};
+const size_t nbBufferTargets = sizeof(bufferTargets) / sizeof(bufferTargets[0]);
+
+/// The texture targets cached
+const GLenum textureTargets[] = {GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_1D_ARRAY, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_RECTANGLE};
+const size_t nbTextureTargets = sizeof(textureTargets) / sizeof(textureTargets[0]);
+
+/// The cached bindings, and the counters
+struct State {
+  GLuint program;                                   ///< current program
+  GLuint vertexArray;                               ///< bound vertex array
+  GLuint buffers[nbBufferTargets];                  ///< buffer bound to each target
+  GLuint activeUnit;                                ///< active texture unit
+  GLuint textures[maxUnits][nbTextureTargets];      ///< texture bound to each target of each unit
+  GLuint samplers[maxUnits];                        ///< sampler bound to each unit
+  bool unbindToZero;                                ///< false if the unbinds are lazy
+  bool caching;                                     ///< false if all the calls are issued
+  GLState::Counters current;                        ///< calls of the current frame
+  GLState::Counters last;                           ///< calls of the last frame
+
+  /// @brief the initial bindings of a context
+  State() : program(0), vertexArray(0), activeUnit(0), unbindToZero(true), caching(true), current(), last()
+  {
+    std::fill(buffers, buffers + nbBufferTargets, 0);
+    std::fill(&textures[0][0], &textures[0][0] + maxUnits * nbTextureTargets, 0);
+    std::fill(samplers, samplers + maxUnits, 0);
+  }
+};
+
+State & state()
+{
+  static State s;
+  return s;
+}
+
+/// @brief index of a target in a list, @p size if it is not there
+size_t targetIndex(const GLenum * targets, size_t size, GLenum target)
+{
+  return std::find(targets, targets + size, target) - targets;
+}
+
+/// @brief updates a cache entry, true if the call must be issued (the entry being null for the uncached bindings)
+bool update(GLuint * entry, GLuint value, GLState::Binding binding)
+{
+  State & s = state();
+  if (entry and s.caching and *entry == value) {
+    s.current.skipped[binding]++;
+    return false;
+  }
+  if (entry) {
+    *entry = value;
+  }
+  s.current.issued[binding]++;
+  return true;
+}
+
+/// @brief the cache entry of the buffer bound to a target (null if the target is not cached)
+GLuint * bufferEntry(GLenum target)
+{
+  const size_t index = targetIndex(bufferTargets, nbBufferTargets, target);
+  return index < nbBufferTargets ? &state().buffers[index] : nullptr;
+}
+
+/// @brief the cache entry of the texture bound to a target of the active unit (null if it is not cached)
+GLuint * textureEntry(GLenum target)
+{
+  State & s = state();
+  const size_t index = targetIndex(textureTargets, nbTextureTargets, target);
+  return index < nbTextureTargets and s.activeUnit < maxUnits ? &s.textures[s.activeUnit][index] : nullptr;
+}
+
+/// @brief resets the entries bound to a deleted object
+void reset(GLuint * first, GLuint * last, GLuint object)
+{
+  std::replace(first, last, object, GLuint(0));
+}
+} // namespace
+
+size_t GLState::Counters::totalIssued() const
+{
+  size_t total = 0;
+  for (int k = 0; k < NbBindings; k++) {
+    total += issued[k];
+  }
+  return total;
+}
+
+size_t GLState::Counters::totalSkipped() const
+{
+  size_t total = 0;
+  for (int k = 0; k < NbBindings; k++) {
+    total += skipped[k];
+  }
+  return total;
+}
+
+void GLState::useProgram(GLuint program)
+{
+  if (update(&state().program, program, ProgramBinding)) {
+    glUseProgram(program);
+  }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray)
+{
+  if (update(&state().vertexArray, vertexArray, VertexArrayBinding)) {
+    glBindVertexArray(vertexArray);
+    // the element array buffer binding belongs to the vertex array
+    *bufferEntry(GL_ELEMENT_ARRAY_BUFFER) = unknown;
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+  if (update(bufferEntry(target), buffer, BufferBinding)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+  // the indexed bindings are not cached
+  update(nullptr, buffer, BufferBinding);
+  glBindBufferRange(target, index, buffer, offset, size);
+  GLuint * entry = bufferEntry(target);
+  if (entry) {
+    *entry = buffer;
+  }
+}
+
+void GLState::activeTexture(GLuint unit)
+{
+  if (update(&state().activeUnit, unit, ActiveTextureBinding)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+  if (update(textureEntry(target), texture, TextureBinding)) {
+    glBindTexture(target, texture);
+  }
+}
+
+void GLState::bindSampler(GLuint unit, GLuint sampler)
+{
+  if (update(unit < maxUnits ? &state().samplers[unit] : nullptr, sampler, SamplerBinding)) {
+    glBindSampler(unit, sampler);
+  }
+}
+
+void GLState::unbindProgram()
+{
+  if (state().unbindToZero) {
+    useProgram(0);
+  } else {
+    state().current.skipped[ProgramBinding]++;
+  }
+}
+
+void GLState::unbindVertexArray()
+{
+  if (state().unbindToZero) {
+    bindVertexArray(0);
+  } else {
+    state().current.skipped[VertexArrayBinding]++;
+  }
+}
+
+void GLState::unbindBuffer(GLenum target)
+{
+  if (state().unbindToZero) {
+    bindBuffer(target, 0);
+  } else {
+    state().current.skipped[BufferBinding]++;
+  }
+}
+
+void GLState::unbindTexture(GLenum target)
+{
+  if (state().unbindToZero) {
+    bindTexture(target, 0);
+  } else {
+    state().current.skipped[TextureBinding]++;
+  }
+}
+
+void GLState::unbindSampler(GLuint unit)
+{
+  if (state().unbindToZero) {
+    bindSampler(unit, 0);
+  } else {
+    state().current.skipped[SamplerBinding]++;
+  }
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+  // a stale entry may hide the program being current
+  if (state().program == program or state().program == unknown) {
+    useProgram(0);
+  }
+  glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArray(GLuint vertexArray)
+{
+  glDeleteVertexArrays(1, &vertexArray);
+  State & s = state();
+  if (s.vertexArray == vertexArray) {
+    s.vertexArray = 0;
+    *bufferEntry(GL_ELEMENT_ARRAY_BUFFER) = unknown;
+  }
+}
+
+void GLState::deleteBuffer(GLuint buffer)
+{
+  glDeleteBuffers(1, &buffer);
+  State & s = state();
+  reset(s.buffers, s.buffers + nbBufferTargets, buffer);
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+  glDeleteTextures(1, &texture);
+  State & s = state();
+  reset(&s.textures[0][0], &s.textures[0][0] + maxUnits * nbTextureTargets, texture);
+}
+
+void GLState::deleteSampler(GLuint sampler)
+{
+  glDeleteSamplers(1, &sampler);
+  State & s = state();
+  reset(s.samplers, s.samplers + maxUnits, sampler);
+}
+
+GLuint GLState::program()
+{
+  return state().program;
+}
+
+bool GLState::unbindsToZero()
+{
+  return state().unbindToZero;
+}
+
+void GLState::setUnbindToZero(bool unbind)
+{
+  state().unbindToZero = unbind;
+}
+
+bool GLState::isCaching()
+{
+  return state().caching;
+}
+
+void GLState::setCaching(bool caching)
+{
+  state().caching = caching;
+}
+
+void GLState::invalidate()
+{
+  State & s = state();
+  s.program = unknown;
+  s.vertexArray = unknown;
+  s.activeUnit = unknown;
+  std::fill(s.buffers, s.buffers + nbBufferTargets, unknown);
+  std::fill(&s.textures[0][0], &s.textures[0][0] + maxUnits * nbTextureTargets, unknown);
+  std::fill(s.samplers, s.samplers + maxUnits, unknown);
+}
+
+void GLState::newFrame()
+{
+  State & s = state();
+  s.last = s.current;
+  s.current = Counters();
+}
+
+const GLState::Counters & GLState::frameCounters()
+{
+  return state().last;
+}
+
+const GLState::Counters & GLState::currentCounters()
+{
+  return state().current;
+}
@@ -0,0 +1,121 @@
+#ifndef __GLSTATE_HPP
+#define __GLSTATE_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+
+/**
+ * @brief CPU-side cache of the OpenGL bindings of the current context
+ *
+ * The wrappers of glApi.hpp bind their objects through this cache, which
+ * drops the calls binding what is already bound: the program, the vertex
+ * array, the buffer of each target, the active texture unit, the texture
+ * of each target of each unit and the sampler of each unit.
+ *
+ * The unbind calls of the wrappers (OGLStateObject::unbind) restore the
+ * zero bindings, unless they are made lazy (see setUnbindToZero): the
+ * objects are then left bound, which makes their next bind free. In that
+ * mode, code relying on the default bindings (e.g. no sampler on a texture
+ * unit) must bind them explicitly.
+ *
+ * The GL calls bypassing this cache (glBind*, glUseProgram, glActiveTexture)
+ * make it stale: they must be followed by invalidate.
+ *
+ * The issued and skipped calls are counted, by frame (see newFrame).
+ */
+class GLState {
+public:
+  /// The cached kinds of bindings
+  enum Binding
+  {
+    ProgramBinding,       ///< glUseProgram
+    VertexArrayBinding,   ///< glBindVertexArray
+    BufferBinding,        ///< glBindBuffer, glBindBufferRange
+    ActiveTextureBinding, ///< glActiveTexture
+    TextureBinding,       ///< glBindTexture
+    SamplerBinding,       ///< glBindSampler
+    NbBindings
+  };
+
+  /// Numbers of calls, by kind of binding
+  struct Counters {
+    size_t issued[NbBindings];  ///< calls sent to OpenGL
+    size_t skipped[NbBindings]; ///< redundant calls, and lazy unbinds, dropped
+
+    /// @brief number of calls sent to OpenGL
+    size_t totalIssued() const;
+
+    /// @brief number of calls dropped
+    size_t totalSkipped() const;
+  };
+
+  /// @brief makes the current program
+  static void useProgram(GLuint program);
+
+  /// @brief binds a vertex array (the element array buffer binding following it)
+  static void bindVertexArray(GLuint vertexArray);
+
+  /// @brief binds a buffer to a target
+  static void bindBuffer(GLenum target, GLuint buffer);
+
+  /// @brief binds a range of a buffer to an indexed target (and the buffer to the target, as OpenGL does)
+  static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+  /// @brief selects the active texture unit (0 for GL_TEXTURE0)
+  static void activeTexture(GLuint unit);
+
+  /// @brief binds a texture to a target of the active texture unit
+  static void bindTexture(GLenum target, GLuint texture);
+
+  /// @brief binds a sampler to a texture unit
+  static void bindSampler(GLuint unit, GLuint sampler);
+
+  /*
+   * The unbind calls of the wrappers, binding 0 unless the unbinds are lazy
+   */
+  static void unbindProgram();
+  static void unbindVertexArray();
+  static void unbindBuffer(GLenum target);
+  static void unbindTexture(GLenum target);
+  static void unbindSampler(GLuint unit);
+
+  /*
+   * The deletions of objects, resetting their bindings as OpenGL does (a
+   * current program is released before being deleted, so that its name is
+   * not reused while it is still current)
+   */
+  static void deleteProgram(GLuint program);
+  static void deleteVertexArray(GLuint vertexArray);
+  static void deleteBuffer(GLuint buffer);
+  static void deleteTexture(GLuint texture);
+  static void deleteSampler(GLuint sampler);
+
+  /// @brief the current program (as set through this cache)
+  static GLuint program();
+
+  /// @brief true if the unbind calls restore the zero bindings (the default)
+  static bool unbindsToZero();
+
+  /// @brief makes the unbind calls restore the zero bindings (true), or do nothing (false)
+  static void setUnbindToZero(bool unbind);
+
+  /// @brief true if the redundant calls are dropped (the default)
+  static bool isCaching();
+
+  /// @brief drops the redundant calls (true), or issues all the calls (false, e.g. to rule the cache out when debugging)
+  static void setCaching(bool caching);
+
+  /// @brief forgets the cached bindings, after GL calls bypassing the cache
+  static void invalidate();
+
+  /// @brief ends the counting of a frame (see frameCounters)
+  static void newFrame();
+
+  /// @brief the calls of the last complete frame
+  static const Counters & frameCounters();
+
+  /// @brief the calls since the last frame
+  static const Counters & currentCounters();
+};
+
+#endif // !defined(__GLSTATE_HPP)
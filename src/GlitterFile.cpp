@@ -0,0 +1,409 @@
+#include "GlitterFile.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "ChunkCodec.hpp"
+#include "ThreadPool.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char magic[16] = "GLITTER_BIN_V2\n";              ///< first bytes of the file (with the null terminator)
+const std::uint32_t version = 2;                        ///< version of the layout
+const size_t headerSize = 64;                           ///< size of the header, the table of chunks following it
+const size_t alignment = 64;                            ///< alignment of the chunks
+const size_t entrySize = 4 + 4 + 8 + 8 + 4 + 4 + 8;     ///< size of an entry of the table of chunks
+const size_t checksumEntrySize = 4 + 4 + 8 + 8 + 4 + 4; ///< size of an entry of the files without decoded size
+const size_t legacyEntrySize = 4 + 4 + 8 + 8;           ///< size of an entry of the first v2 files (no flags nor checksum)
+const unsigned int filterShift = 8;                     ///< position of the ChunkCodec filters in the chunk flags
+const unsigned int strideShift = 16;                    ///< position of the stride in the chunk flags
+#ifdef IS_BIG_ENDIAN
+const char byteOrder = 'B'; ///< byte order of the host
+#else
+const char byteOrder = 'L'; ///< byte order of the host
+#endif
+
+/// @brief smallest multiple of the chunk alignment not lower than @p offset
+size_t align(size_t offset)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/// @brief table of the CRC-32 of the bytes (reflected 0xEDB88320 polynomial)
+struct Crc32Table {
+  std::uint32_t values[256];
+
+  Crc32Table()
+  {
+    for (std::uint32_t n = 0; n < 256; n++) {
+      std::uint32_t c = n;
+      for (int k = 0; k < 8; k++) {
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      values[n] = c;
+    }
+  }
+};
+
+/// @brief writes zeros after a chunk of @p size bytes, up to the next multiple of the chunk alignment
+void pad(std::ostream & file, size_t size)
+{
+  static const char zeros[alignment] = {0};
+  file.write(zeros, align(size) - size);
+}
+} // namespace
+
+GlitterFile::Writer::Writer(const std::string & filename, bool compressed, unsigned int nbThreads)
+    : m_filename(filename), m_file(filename.c_str(), std::ios::binary), m_offset(headerSize), m_compressed(compressed)
+{
+  if (m_compressed) {
+    m_pool.reset(new ThreadPool(nbThreads));
+  }
+  // blank header, written by close
+  const char blank[headerSize] = {0};
+  m_file.write(blank, headerSize);
+}
+
+GlitterFile::Writer::~Writer()
+{
+  if (m_file.is_open()) {
+    close();
+  }
+}
+
+void GlitterFile::Writer::addBytes(const char * fourcc, unsigned int index, const void * data, size_t size, unsigned int filters, unsigned int stride)
+{
+  assert(stride > 0 and stride < 256 && "GlitterFile::Writer::addBytes(): the stride is stored on 8 bits");
+  if (not m_file) {
+    return;
+  }
+  // compression: the filters are dropped when they do not help (exact repetitions of whole
+  // values, as in unwelded vertex arrays, are hidden by the byte shuffle), and the chunks
+  // that do not shrink are stored as they are
+  std::vector<unsigned char> encoded;
+  unsigned int usedFilters = 0;
+  if (m_compressed) {
+    ChunkCodec::encode(data, size, ChunkCodec::NoFilter, 1, encoded, m_pool.get());
+    if (filters != ChunkCodec::NoFilter) {
+      std::vector<unsigned char> filtered;
+      ChunkCodec::encode(data, size, filters, stride, filtered, m_pool.get());
+      if (filtered.size() < encoded.size()) {
+        encoded.swap(filtered);
+        usedFilters = filters;
+      }
+    }
+    if (encoded.size() >= size) {
+      encoded.clear();
+    }
+  }
+  Span<unsigned char> stored = encoded.empty() ? Span<unsigned char>(static_cast<const unsigned char *>(data), size) : Span<unsigned char>(encoded);
+
+  Entry entry;
+  std::memcpy(entry.fourcc, fourcc, 4);
+  entry.index = index;
+  entry.offset = m_offset;
+  entry.size = stored.size();
+  entry.flags = Checksummed;
+  if (not encoded.empty()) {
+    entry.flags |= Compressed | usedFilters << filterShift | stride << strideShift;
+  }
+  entry.checksum = crc32(stored.data(), stored.size());
+  entry.rawSize = size;
+  m_entries.push_back(entry);
+
+  m_file.write(reinterpret_cast<const char *>(stored.data()), stored.size());
+  pad(m_file, entry.size);
+  m_offset = align(m_offset + entry.size);
+}
+
+bool GlitterFile::Writer::close()
+{
+  // table of chunks, after the last one
+  const std::uint64_t tableOffset = m_offset;
+  for (const Entry & entry : m_entries) {
+    m_file.write(entry.fourcc, 4);
+    m_file.write(reinterpret_cast<const char *>(&entry.index), sizeof(entry.index));
+    m_file.write(reinterpret_cast<const char *>(&entry.offset), sizeof(entry.offset));
+    m_file.write(reinterpret_cast<const char *>(&entry.size), sizeof(entry.size));
+    m_file.write(reinterpret_cast<const char *>(&entry.flags), sizeof(entry.flags));
+    m_file.write(reinterpret_cast<const char *>(&entry.checksum), sizeof(entry.checksum));
+    m_file.write(reinterpret_cast<const char *>(&entry.rawSize), sizeof(entry.rawSize));
+  }
+
+  // header, back-patched once the table is complete
+  unsigned char header[headerSize] = {0};
+  const std::uint32_t nbChunks = std::uint32_t(m_entries.size());
+  const std::uint32_t tableEntrySize = entrySize;
+  std::memcpy(header, magic, sizeof(magic));
+  std::memcpy(header + 16, &version, sizeof(version));
+  std::memcpy(header + 20, &nbChunks, sizeof(nbChunks));
+  std::memcpy(header + 24, &tableOffset, sizeof(tableOffset));
+  std::memcpy(header + 32, &tableEntrySize, sizeof(tableEntrySize));
+  header[36] = byteOrder;
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<const char *>(header), headerSize);
+  const bool written = bool(m_file);
+  m_file.close();
+  if (not written) {
+    std::cerr << "GlitterFile: unable to write " << m_filename << "\n";
+  }
+  return written;
+}
+
+GlitterFile::GlitterFile() : m_data(nullptr), m_size(0) {}
+
+GlitterFile::~GlitterFile()
+{
+  close();
+}
+
+bool GlitterFile::isGlitterFile(const std::string & filename)
+{
+  char buffer[sizeof(magic)] = {0};
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  file.read(buffer, sizeof(buffer));
+  return file and not std::memcmp(buffer, magic, sizeof(magic));
+}
+
+bool GlitterFile::open(const std::string & filename, unsigned int nbThreads)
+{
+  close();
+#ifdef _WIN32
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  if (not file) {
+    std::cerr << "GlitterFile: unable to open " << filename << "\n";
+    return false;
+  }
+  m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+#else
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd < 0 or fstat(fd, &status) != 0) {
+    std::cerr << "GlitterFile: unable to open " << filename << "\n";
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return false;
+  }
+  m_size = size_t(status.st_size);
+  void * mapping = m_size ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "GlitterFile: unable to map " << filename << "\n";
+    m_size = 0;
+    return false;
+  }
+  m_data = static_cast<const unsigned char *>(mapping);
+#endif
+
+  // header and table of chunks
+  std::uint32_t fileVersion, nbChunks, tableEntrySize;
+  std::uint64_t tableOffset;
+  if (m_size < headerSize or std::memcmp(m_data, magic, sizeof(magic))) {
+    std::cerr << "GlitterFile: " << filename << " is not a .glitter v2 file\n";
+    close();
+    return false;
+  }
+  // the first v2 files were written on little-endian hosts only, without byte order nor entry size
+  char fileByteOrder = m_data[36] ? char(m_data[36]) : 'L';
+  if (fileByteOrder != byteOrder) {
+    std::cerr << "GlitterFile: " << filename << " was written on a host of the other byte order\n";
+    close();
+    return false;
+  }
+  std::memcpy(&fileVersion, m_data + 16, sizeof(fileVersion));
+  std::memcpy(&nbChunks, m_data + 20, sizeof(nbChunks));
+  std::memcpy(&tableOffset, m_data + 24, sizeof(tableOffset));
+  std::memcpy(&tableEntrySize, m_data + 32, sizeof(tableEntrySize));
+  if (tableEntrySize == 0) {
+    tableEntrySize = legacyEntrySize;
+  }
+  if (fileVersion != version or tableEntrySize < legacyEntrySize or tableOffset > m_size or (m_size - tableOffset) / tableEntrySize < nbChunks) {
+    std::cerr << "GlitterFile: " << filename << " has an unsupported version or a truncated table of chunks\n";
+    close();
+    return false;
+  }
+  m_entries.resize(nbChunks);
+  for (std::uint32_t k = 0; k < nbChunks; k++) {
+    const unsigned char * entry = m_data + tableOffset + size_t(k) * tableEntrySize;
+    std::memcpy(m_entries[k].fourcc, entry, 4);
+    std::memcpy(&m_entries[k].index, entry + 4, sizeof(m_entries[k].index));
+    std::memcpy(&m_entries[k].offset, entry + 8, sizeof(m_entries[k].offset));
+    std::memcpy(&m_entries[k].size, entry + 16, sizeof(m_entries[k].size));
+    m_entries[k].flags = 0;
+    m_entries[k].checksum = 0;
+    m_entries[k].rawSize = m_entries[k].size;
+    // entries written by later versions may be larger: the extra fields are skipped
+    if (tableEntrySize >= checksumEntrySize) {
+      std::memcpy(&m_entries[k].flags, entry + 24, sizeof(m_entries[k].flags));
+      std::memcpy(&m_entries[k].checksum, entry + 28, sizeof(m_entries[k].checksum));
+    }
+    if (tableEntrySize >= entrySize) {
+      std::memcpy(&m_entries[k].rawSize, entry + 32, sizeof(m_entries[k].rawSize));
+    }
+    if (m_entries[k].offset > m_size or m_entries[k].size > m_size - m_entries[k].offset) {
+      std::cerr << "GlitterFile: " << filename << " is truncated\n";
+      close();
+      return false;
+    }
+    // the decoded size of a compressed chunk is bounded by the number of blocks it can hold (4 bytes each at least, see ChunkCodec::splitBlocks)
+    const Entry & stored = m_entries[k];
+    if ((stored.flags & Compressed) ? stored.size < 4 or stored.rawSize > (stored.size - 4) / 4 * ChunkCodec::blockSize : stored.rawSize != stored.size) {
+      std::cerr << "GlitterFile: " << filename << " has an inconsistent table of chunks\n";
+      close();
+      return false;
+    }
+  }
+  if (not decodeChunks(nbThreads)) {
+    std::cerr << "GlitterFile: " << filename << " has corrupted or ill-formed compressed chunks\n";
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool GlitterFile::hasChunk(const char * fourcc, unsigned int index) const
+{
+  return findEntry(fourcc, index) != nullptr;
+}
+
+const std::vector<GlitterFile::Entry> & GlitterFile::entries() const
+{
+  return m_entries;
+}
+
+bool GlitterFile::verify(const char * fourcc, unsigned int index) const
+{
+  const Entry * entry = findEntry(fourcc, index);
+  if (not entry) {
+    return false;
+  }
+  return not(entry->flags & Checksummed) or crc32(m_data + entry->offset, size_t(entry->size)) == entry->checksum;
+}
+
+bool GlitterFile::verify() const
+{
+  for (const Entry & entry : m_entries) {
+    if (not verify(entry.fourcc, entry.index)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t GlitterFile::size() const
+{
+  return m_size;
+}
+
+std::uint32_t GlitterFile::crc32(const void * data, size_t size)
+{
+  static const Crc32Table table;
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  std::uint32_t crc = 0xFFFFFFFFu;
+  for (size_t k = 0; k < size; k++) {
+    crc = table.values[(crc ^ bytes[k]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+const GlitterFile::Entry * GlitterFile::findEntry(const char * fourcc, unsigned int index) const
+{
+  for (const Entry & entry : m_entries) {
+    if (not std::memcmp(entry.fourcc, fourcc, 4) and entry.index == index) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+const unsigned char * GlitterFile::chunkBytes(const char * fourcc, unsigned int index, size_t & size) const
+{
+  const Entry * entry = findEntry(fourcc, index);
+  if (not entry) {
+    size = 0;
+    return nullptr;
+  }
+  size = size_t(entry->rawSize);
+  return entry->flags & Compressed ? m_decoded[entry - m_entries.data()].data() : m_data + entry->offset;
+}
+
+bool GlitterFile::decodeChunks(unsigned int nbThreads)
+{
+  // a decoding task per block, so that the large chunks are decoded by several threads as well
+  struct Block {
+    Span<unsigned char> encoded; ///< the encoded block
+    unsigned int filters;        ///< ChunkCodec::Filter of the chunk
+    unsigned char * decoded;     ///< the decoded block
+    size_t size;                 ///< size of the decoded block
+  };
+  std::vector<Block> blocks;
+  std::vector<size_t> shuffled;
+  std::vector<std::vector<unsigned char>> filtered(m_entries.size());
+  m_decoded.assign(m_entries.size(), std::vector<unsigned char>());
+  for (size_t k = 0; k < m_entries.size(); k++) {
+    const Entry & entry = m_entries[k];
+    if (not(entry.flags & Compressed)) {
+      continue;
+    }
+    // the compressed chunks are read whole anyway: the corrupted ones are refused before being decoded
+    if ((entry.flags & Checksummed) and crc32(m_data + entry.offset, size_t(entry.size)) != entry.checksum) {
+      return false;
+    }
+    const unsigned int filters = (entry.flags >> filterShift) & 0xFF;
+    const unsigned int stride = (entry.flags >> strideShift) & 0xFF;
+    std::vector<Span<unsigned char>> encodedBlocks;
+    if (not ChunkCodec::splitBlocks(Span<unsigned char>(m_data + entry.offset, size_t(entry.size)), size_t(entry.rawSize), encodedBlocks)) {
+      return false;
+    }
+    m_decoded[k].resize(size_t(entry.rawSize));
+    unsigned char * decoded = m_decoded[k].data();
+    if ((filters & ChunkCodec::Shuffle) and stride > 1) {
+      filtered[k].resize(size_t(entry.rawSize));
+      decoded = filtered[k].data();
+      shuffled.push_back(k);
+    }
+    for (size_t b = 0; b < encodedBlocks.size(); b++) {
+      Block block = {encodedBlocks[b], filters, decoded + b * ChunkCodec::blockSize, std::min(ChunkCodec::blockSize, size_t(entry.rawSize) - b * ChunkCodec::blockSize)};
+      blocks.push_back(block);
+    }
+  }
+  if (blocks.empty()) {
+    return true;
+  }
+  ThreadPool pool(nbThreads);
+  std::vector<char> valid(blocks.size());
+  pool.parallelFor(blocks.size(), [&](size_t b) { valid[b] = ChunkCodec::decodeBlock(blocks[b].encoded, blocks[b].filters, blocks[b].decoded, blocks[b].size); });
+  if (std::find(valid.begin(), valid.end(), 0) != valid.end()) {
+    return false;
+  }
+  pool.parallelFor(shuffled.size(), [&](size_t s) {
+    const size_t k = shuffled[s];
+    ChunkCodec::unshuffle(filtered[k].data(), filtered[k].size(), (m_entries[k].flags >> strideShift) & 0xFF, m_decoded[k].data());
+  });
+  return true;
+}
+
+void GlitterFile::close()
+{
+#ifdef _WIN32
+  m_buffer.clear();
+#else
+  if (m_data) {
+    munmap(const_cast<unsigned char *>(m_data), m_size);
+  }
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_entries.clear();
+  m_decoded.clear();
+}
@@ -0,0 +1,194 @@
+#ifndef __GLITTER_GLITTERFILE_H__
+#define __GLITTER_GLITTERFILE_H__
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Span.hpp"
+
+// forward declarations
+class ThreadPool;
+
+/**
+ * @brief The .glitter v2 container: a table of 64-byte aligned chunks, read through a memory mapping
+ *
+ * The file layout is the following (in the byte order of the writer):
+ *	+ a 64-byte header: the magic string (16 bytes), the version (uint32),
+ *	  the number of chunks (uint32), the offset of the table (uint64), the
+ *	  size of a table entry (uint32) and the byte order ('L' or 'B')
+ *	+ the chunks, each one starting on a multiple of 64 bytes
+ *	+ the table of chunks, one 40-byte entry per chunk: its four character
+ *	  code, its index among the chunks of the same code (uint32), its offset
+ *	  and its stored size in bytes (uint64), its flags and its CRC-32 of the
+ *	  stored bytes (uint32), and its decoded size in bytes (uint64)
+ *
+ * The table is written last, so that the chunks are streamed to the file as
+ * they are produced (see Writer): the files written before stored it right
+ * after the header, which the reader still accepts, as any table offset.
+ *
+ * A chunk is a raw array of values, so that the reader hands out spans
+ * pointing straight into the mapping (no allocation, no copy): the pages are
+ * only read from the disk when the values are first accessed, for instance
+ * by Buffer::setData. Any chunk can thus be read on its own, and a partial
+ * load (the geometry without the textures, a single material) only touches
+ * the bytes it uses. For the same reason, the checksums are not checked at
+ * opening but on demand (see verify), and the files written on a host of the
+ * other byte order are refused rather than swapped.
+ *
+ * The chunks may also be compressed (see ChunkCodec), trading the zero-copy
+ * access for smaller files when the storage is the bottleneck: the compressed
+ * chunks are decoded into heap buffers at opening, in parallel, the spans of
+ * the stored chunks still pointing into the mapping. Being read whole, they
+ * are checked against their checksums first: a corrupted one fails open.
+ *
+ * The first v2 files (a null entry size in the header) have 24-byte entries,
+ * without flags nor checksum, and the following ones 32-byte entries, without
+ * decoded size: they are still read.
+ *
+ * @see GlitterMesh for the chunks of a mesh
+ */
+class GlitterFile {
+public:
+  /// Flags of a chunk
+  enum ChunkFlag
+  {
+    Checksummed = 1 << 0, ///< the checksum of the entry is valid
+    Compressed = 1 << 1   ///< the chunk is encoded by ChunkCodec, its filters (bits 8 to 15) and its stride (bits 16 to 23) being stored in the flags
+  };
+
+  /// An entry of the table of chunks
+  struct Entry {
+    char fourcc[4];         ///< four character code
+    std::uint32_t index;    ///< index among the chunks of the same code
+    std::uint64_t offset;   ///< offset of the chunk in the file
+    std::uint64_t size;     ///< size of the chunk in bytes
+    std::uint32_t flags;    ///< combination of ChunkFlag
+    std::uint32_t checksum; ///< CRC-32 of the stored chunk
+    std::uint64_t rawSize;  ///< size of the decoded chunk in bytes
+  };
+
+  /**
+   * @brief Writes a .glitter v2 file, chunk by chunk
+   *
+   * Each chunk is written (and compressed) as soon as it is added, so that its
+   * values may be released right after: the writer only holds the table of
+   * chunks, which is appended by close, the header being then back-patched
+   * with its offset. Until then, the header is left blank, so that an
+   * interrupted writing leaves a file refused by the reader.
+   */
+  class Writer {
+  public:
+    /**
+     * @brief Constructor, creating the file
+     * @param filename the name of the file
+     * @param compressed if true, the chunks are compressed (the ones that do not shrink being stored as they are)
+     * @param nbThreads number of threads compressing the blocks of a chunk (the hardware concurrency if 0)
+     */
+    explicit Writer(const std::string & filename, bool compressed = false, unsigned int nbThreads = 0);
+
+    Writer(const Writer &) = delete;
+    Writer & operator=(const Writer &) = delete;
+
+    /// @brief Destructor, closing the file if needed
+    ~Writer();
+
+    /**
+     * @brief writes a chunk
+     * @param fourcc the four character code of the chunk
+     * @param index the index of the chunk among the chunks of the same code
+     * @param values the content of the chunk
+     * @param filters the ChunkCodec::Filter applied before the compression, if any, the byte shuffle being performed on the values
+     */
+    template <typename T> void add(const char * fourcc, unsigned int index, Span<T> values, unsigned int filters = 0)
+    {
+      addBytes(fourcc, index, values.data(), values.size() * sizeof(T), filters, sizeof(T));
+    }
+
+    /// @brief writes a chunk of raw bytes, made of values of @p stride bytes
+    void addBytes(const char * fourcc, unsigned int index, const void * data, size_t size, unsigned int filters = 0, unsigned int stride = 1);
+
+    /**
+     * @brief writes the table of chunks and the header, and closes the file
+     * @return false if the file could not be written (an error message is printed)
+     */
+    bool close();
+
+  private:
+    std::string m_filename;             ///< the name of the file
+    std::ofstream m_file;               ///< the file, closed once the table is written
+    std::uint64_t m_offset;             ///< current end of the file
+    std::vector<Entry> m_entries;       ///< the entries of the chunks written
+    bool m_compressed;                  ///< whether the chunks are compressed
+    std::unique_ptr<ThreadPool> m_pool; ///< threads compressing the blocks (null if not compressed)
+  };
+
+  GlitterFile();
+  GlitterFile(const GlitterFile &) = delete;
+  GlitterFile & operator=(const GlitterFile &) = delete;
+  ~GlitterFile();
+
+  /// @brief checks whether a file starts with the .glitter v2 magic string
+  static bool isGlitterFile(const std::string & filename);
+
+  /**
+   * @brief Maps a .glitter v2 file
+   * @param filename the name of the file
+   * @param nbThreads number of threads decoding the compressed chunks (the hardware concurrency if 0)
+   * @return false if the file could not be mapped or is ill-formed (an error message is printed)
+   */
+  bool open(const std::string & filename, unsigned int nbThreads = 0);
+
+  /// @brief unmaps the file (the spans handed out are no longer valid)
+  void close();
+
+  /// @brief checks whether the file has a given chunk
+  bool hasChunk(const char * fourcc, unsigned int index = 0) const;
+
+  /**
+   * @brief getter for the content of a chunk
+   * @param fourcc the four character code of the chunk
+   * @param index the index of the chunk among the chunks of the same code
+   * @return the values of the chunk, empty if the chunk does not exist
+   */
+  template <typename T> Span<T> chunk(const char * fourcc, unsigned int index = 0) const
+  {
+    size_t size;
+    const unsigned char * data = chunkBytes(fourcc, index, size);
+    return Span<T>(reinterpret_cast<const T *>(data), size / sizeof(T));
+  }
+
+  /// @brief the table of chunks, in file order
+  const std::vector<Entry> & entries() const;
+
+  /**
+   * @brief checks the checksum of a chunk (the whole chunk is read)
+   * @return false if the chunk does not exist or is corrupted, true if it matches its checksum or has none
+   */
+  bool verify(const char * fourcc, unsigned int index = 0) const;
+
+  /// @brief checks the checksums of all the chunks (the whole file is read)
+  bool verify() const;
+
+  /// @brief size of the mapping in bytes
+  size_t size() const;
+
+  /// @brief CRC-32 (the zlib one) of some bytes
+  static std::uint32_t crc32(const void * data, size_t size);
+
+private:
+  const Entry * findEntry(const char * fourcc, unsigned int index) const;
+  const unsigned char * chunkBytes(const char * fourcc, unsigned int index, size_t & size) const;
+  bool decodeChunks(unsigned int nbThreads);
+
+private:
+  const unsigned char * m_data;                      ///< the mapped file
+  size_t m_size;                                     ///< size of the mapped file
+  std::vector<Entry> m_entries;                      ///< table of chunks
+  std::vector<std::vector<unsigned char>> m_decoded; ///< decoded chunks (empty for the stored ones)
+#ifdef _WIN32
+  std::vector<unsigned char> m_buffer; ///< the whole file (no mapping)
+#endif
+};
+
+#endif // !defined(__GLITTER_GLITTERFILE_H__)
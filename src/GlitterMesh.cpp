@@ -0,0 +1,248 @@
+#include "GlitterMesh.hpp"
+#include <iostream>
+#include "ChunkCodec.hpp"
+#include "ObjLoader.hpp"
+#include "Serialize.hpp"
+
+static_assert(sizeof(MeshletBuilder::Meshlet) == 14 * sizeof(float), "GlitterMesh: the meshlets are stored as they are laid out in memory");
+
+bool GlitterMesh::save(const std::string & filename, const ObjLoader & loader, bool compressed)
+{
+  // the filters only matter for compressed files, and are only kept where they help
+  const unsigned int vertexFilters = ChunkCodec::Shuffle | ChunkCodec::Delta;
+  GlitterFile::Writer writer(filename, compressed);
+
+  // materials and image descriptions
+  MemorySink metaSink;
+  BufferedWriter meta(metaSink);
+  std::vector<std::string> names = loader.imageNames();
+  std::uint64_t count = names.size();
+  write(count, meta);
+  for (const std::string & name : names) {
+    Image<> image = loader.image(name);
+    write(name, meta);
+    write(glm::int32(image.width), meta);
+    write(glm::int32(image.height), meta);
+    write(glm::int32(image.depth), meta);
+    write(glm::int32(image.channels), meta);
+  }
+  count = loader.materials().size();
+  write(count, meta);
+  for (const SimpleMaterial & material : loader.materials()) {
+    write(material.name, meta);
+    write(material.ambient, meta);
+    write(material.diffuse, meta);
+    write(material.specular, meta);
+    write(material.shininess, meta);
+    write(material.diffuseTexName, meta);
+    write(material.normalTexName, meta);
+    write(material.specularTexName, meta);
+  }
+  meta.flush();
+  writer.addBytes("META", 0, metaSink.bytes().data(), metaSink.bytes().size());
+
+  writer.add("VPOS", 0, Span<glm::vec3>(loader.vertexPositions()), vertexFilters);
+  writer.add("VCOL", 0, Span<glm::vec4>(loader.vertexColors()), vertexFilters);
+  writer.add("VUV0", 0, Span<glm::vec2>(loader.vertexUVs()), vertexFilters);
+  writer.add("VNRM", 0, Span<glm::vec3>(loader.vertexNormals()), vertexFilters);
+  writer.add("VTAN", 0, Span<glm::vec3>(loader.vertexTangents()), vertexFilters);
+
+  // IBOs and their levels of detail, narrowed one at a time
+  for (size_t k = 0, chunk = 0; k < loader.nbIBOs(); k++) {
+    std::vector<IndexHeader> headers;
+    for (unsigned int l = 0; l < loader.nbLods(k); l++, chunk++) {
+      CompactIndices indices(loader.lodIbo(k, l));
+      IndexSpan span = indices.view();
+      IndexHeader header = {span.indexSize, span.baseVertex, l == 0 ? 0.f : loader.lodError(k, l), glm::uint32(chunk)};
+      headers.push_back(header);
+      writer.addBytes("INDX", chunk, span.bytes.data(), span.bytes.size(), ChunkCodec::Shuffle | ChunkCodec::Delta, span.indexSize);
+    }
+    writer.add("IHDR", k, Span<IndexHeader>(headers));
+    writer.add("MSHL", k, Span<MeshletBuilder::Meshlet>(loader.meshlets(k)));
+  }
+
+  for (size_t i = 0; i < names.size(); i++) {
+    Image<> image = loader.image(names[i]);
+    // the channels are split into planes, the delta then acting as the PNG sub filter
+    writer.addBytes("PIXL", i, image.data, size_t(image.width) * image.height * image.depth * image.channels, ChunkCodec::Shuffle | ChunkCodec::Delta, image.channels);
+  }
+  return writer.close();
+}
+
+bool GlitterMesh::open(const std::string & filename, unsigned int nbThreads)
+{
+  close();
+  if (not m_file.open(filename, nbThreads)) {
+    return false;
+  }
+  // the other chunks are only checked on demand (see GlitterFile::verify), as they may never be read
+  if (not m_file.verify("META")) {
+    std::cerr << "GlitterMesh: the META chunk of " << filename << " is missing or corrupted\n";
+    close();
+    return false;
+  }
+  Span<char> metaBytes = m_file.chunk<char>("META");
+  MemorySource metaSource(metaBytes.data(), metaBytes.size());
+  BufferedReader meta(metaSource);
+  std::uint64_t count = 0;
+  read(count, meta);
+  // an image, as a material, takes several bytes of the chunk
+  if (not meta.good() or count > metaBytes.size()) {
+    std::cerr << "GlitterMesh: the META chunk of " << filename << " is truncated\n";
+    close();
+    return false;
+  }
+  for (std::uint64_t i = 0; i < count; i++) {
+    std::string name;
+    glm::int32 width, height, depth, channels;
+    read(name, meta);
+    read(width, meta);
+    read(height, meta);
+    read(depth, meta);
+    read(channels, meta);
+    if (not meta.good()) {
+      std::cerr << "GlitterMesh: the META chunk of " << filename << " is truncated\n";
+      close();
+      return false;
+    }
+    Span<unsigned char> pixels = m_file.chunk<unsigned char>("PIXL", i);
+    if (pixels.size() != size_t(width) * height * depth * channels) {
+      std::cerr << "GlitterMesh: the image " << name << " of " << filename << " is truncated\n";
+      close();
+      return false;
+    }
+    // the pixels are not modified by Texture::setData
+    m_images[name] = Image<>(const_cast<unsigned char *>(pixels.data()), width, height, depth, channels);
+  }
+  read(count, meta);
+  if (not meta.good() or count > metaBytes.size()) {
+    std::cerr << "GlitterMesh: the META chunk of " << filename << " is truncated\n";
+    close();
+    return false;
+  }
+  m_materials.resize(count);
+  for (SimpleMaterial & material : m_materials) {
+    read(material.name, meta);
+    read(material.ambient, meta);
+    read(material.diffuse, meta);
+    read(material.specular, meta);
+    read(material.shininess, meta);
+    read(material.diffuseTexName, meta);
+    read(material.normalTexName, meta);
+    read(material.specularTexName, meta);
+  }
+  if (not meta.good()) {
+    std::cerr << "GlitterMesh: the META chunk of " << filename << " is truncated\n";
+    close();
+    return false;
+  }
+  return true;
+}
+
+void GlitterMesh::close()
+{
+  m_file.close();
+  m_materials.clear();
+  m_images.clear();
+}
+
+Span<glm::vec3> GlitterMesh::vertexPositions() const
+{
+  return m_file.chunk<glm::vec3>("VPOS");
+}
+
+Span<glm::vec4> GlitterMesh::vertexColors() const
+{
+  return m_file.chunk<glm::vec4>("VCOL");
+}
+
+Span<glm::vec2> GlitterMesh::vertexUVs() const
+{
+  return m_file.chunk<glm::vec2>("VUV0");
+}
+
+Span<glm::vec3> GlitterMesh::vertexNormals() const
+{
+  return m_file.chunk<glm::vec3>("VNRM");
+}
+
+Span<glm::vec3> GlitterMesh::vertexTangents() const
+{
+  return m_file.chunk<glm::vec3>("VTAN");
+}
+
+std::vector<unsigned char> GlitterMesh::interleavedVertices() const
+{
+  return ObjLoader::VertexLayout::interleave(vertexPositions(), vertexUVs(), vertexNormals(), vertexTangents());
+}
+
+size_t GlitterMesh::nbIBOs() const
+{
+  size_t count = 0;
+  while (m_file.hasChunk("IHDR", count)) {
+    count++;
+  }
+  return count;
+}
+
+IndexSpan GlitterMesh::compactIbo(unsigned int materialIndex) const
+{
+  return lodIbo(materialIndex, 0);
+}
+
+size_t GlitterMesh::nbLods(unsigned int materialIndex) const
+{
+  return m_file.chunk<IndexHeader>("IHDR", materialIndex).size();
+}
+
+IndexSpan GlitterMesh::lodIbo(unsigned int materialIndex, unsigned int level) const
+{
+  const IndexHeader & header = indexHeader(materialIndex, level);
+  IndexSpan span;
+  span.indexSize = header.indexSize;
+  span.baseVertex = header.baseVertex;
+  span.bytes = m_file.chunk<unsigned char>("INDX", header.chunk);
+  return span;
+}
+
+float GlitterMesh::lodError(unsigned int materialIndex, unsigned int level) const
+{
+  return indexHeader(materialIndex, level).error;
+}
+
+Span<MeshletBuilder::Meshlet> GlitterMesh::meshlets(unsigned int materialIndex) const
+{
+  return m_file.chunk<MeshletBuilder::Meshlet>("MSHL", materialIndex);
+}
+
+const std::vector<SimpleMaterial> & GlitterMesh::materials() const
+{
+  return m_materials;
+}
+
+Image<> GlitterMesh::image(const std::string & name) const
+{
+  auto searchRes = m_images.find(name);
+  return searchRes != m_images.end() ? searchRes->second : Image<>();
+}
+
+std::vector<std::string> GlitterMesh::imageNames() const
+{
+  std::vector<std::string> names;
+  for (const auto & namedImage : m_images) {
+    names.push_back(namedImage.first);
+  }
+  return names;
+}
+
+const GlitterFile & GlitterMesh::file() const
+{
+  return m_file;
+}
+
+const GlitterMesh::IndexHeader & GlitterMesh::indexHeader(unsigned int materialIndex, unsigned int level) const
+{
+  Span<IndexHeader> headers = m_file.chunk<IndexHeader>("IHDR", materialIndex);
+  assert(level < headers.size() && "GlitterMesh: no such level of detail");
+  return headers[level];
+}
@@ -0,0 +1,132 @@
+#ifndef __GLITTER_GLITTERMESH_H__
+#define __GLITTER_GLITTERMESH_H__
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CompactIndices.hpp"
+#include "GlitterFile.hpp"
+#include "Image.hpp"
+#include "MeshletBuilder.hpp"
+#include "SimpleMaterial.hpp"
+#include "Span.hpp"
+
+// forward declarations
+class ObjLoader;
+
+/**
+ * @brief A zero-copy view of a mesh stored in a .glitter v2 file
+ *
+ * The getters mirror the ones of ObjLoader, but the vertex attributes, the
+ * IBOs, the meshlets and the image pixels are spans pointing straight into
+ * the memory-mapped file: they are valid as long as the GlitterMesh lives,
+ * and can be sent to the GPU (VAO::setVBO, VAO::setIBO, Texture::setData)
+ * without any intermediate heap copy. Only the materials and the image
+ * descriptions are decoded at opening, as well as the compressed chunks of
+ * compressed files, which then point into heap buffers owned by the file.
+ *
+ * The chunks of a mesh are the following:
+ *	+ META: the materials and the image descriptions (Serialize.hpp encoding)
+ *	+ VPOS, VCOL, VUV0, VNRM, VTAN: the vertex attributes
+ *	+ IHDR (one per IBO): the index size, base vertex and geometric error of
+ *	  each level of detail of the IBO, the full resolution being level 0
+ *	+ INDX (one per level of detail of each IBO): the narrowed indices (see CompactIndices)
+ *	+ MSHL (one per IBO): the meshlets
+ *	+ PIXL (one per image): the pixels
+ */
+class GlitterMesh {
+public:
+  GlitterMesh() = default;
+  GlitterMesh(const GlitterMesh &) = delete;
+  GlitterMesh & operator=(const GlitterMesh &) = delete;
+
+  /**
+   * @brief Writes the content of a loader in a .glitter v2 file
+   * @param filename the name of the file
+   * @param loader the mesh to be written
+   * @param compressed if true, the chunks are compressed (see ChunkCodec), the vertex attributes being shuffled and delta coded first
+   * @return false if the file could not be written (an error message is printed)
+   */
+  static bool save(const std::string & filename, const ObjLoader & loader, bool compressed = false);
+
+  /**
+   * @brief Maps a .glitter v2 file
+   * @param filename the name of the file
+   * @param nbThreads number of threads decoding the compressed chunks (the hardware concurrency if 0)
+   * @return false if the file could not be mapped or is ill-formed (an error message is printed)
+   */
+  bool open(const std::string & filename, unsigned int nbThreads = 0);
+
+  /// @brief unmaps the file and forgets its materials and images (the spans handed out are no longer valid)
+  void close();
+
+  /// @brief getter for vertex positions
+  Span<glm::vec3> vertexPositions() const;
+
+  /// @brief getter for vertex colors
+  Span<glm::vec4> vertexColors() const;
+
+  /// @brief getter for vertex uvs
+  Span<glm::vec2> vertexUVs() const;
+
+  /// @brief getter for vertex normals
+  Span<glm::vec3> vertexNormals() const;
+
+  /// @brief getter for vertex tangents
+  Span<glm::vec3> vertexTangents() const;
+
+  /// @brief interleaved vertex attributes, laid out as ObjLoader::VertexLayout (this one is a copy)
+  std::vector<unsigned char> interleavedVertices() const;
+
+  /// @brief number of IBOs
+  size_t nbIBOs() const;
+
+  /// @brief getter for a given IBO
+  IndexSpan compactIbo(unsigned int materialIndex = 0) const;
+
+  /// @brief number of levels of detail of a given IBO, including the full resolution (level 0)
+  size_t nbLods(unsigned int materialIndex = 0) const;
+
+  /// @brief getter for a level of detail of a given IBO
+  IndexSpan lodIbo(unsigned int materialIndex, unsigned int level) const;
+
+  /// @brief getter for the geometric error of a level of detail (object space distance)
+  float lodError(unsigned int materialIndex, unsigned int level) const;
+
+  /// @brief getter for the meshlets of a given IBO (empty if they were not built)
+  Span<MeshletBuilder::Meshlet> meshlets(unsigned int materialIndex = 0) const;
+
+  /// @brief getter for the materials
+  const std::vector<SimpleMaterial> & materials() const;
+
+  /**
+   * @brief getter for an image referenced in the materials
+   * @param name an alias for the image
+   * @return the image (an empty one if the name is unknown), whose pixels are read-only
+   */
+  Image<> image(const std::string & name) const;
+
+  /// @brief names of the images
+  std::vector<std::string> imageNames() const;
+
+  /// @brief the underlying container
+  const GlitterFile & file() const;
+
+private:
+  /// Header of a level of detail, as stored in the IHDR chunks
+  struct IndexHeader {
+    glm::uint32 indexSize;  ///< size of an index (1, 2 or 4 bytes)
+    glm::uint32 baseVertex; ///< vertex added to each index
+    glm::float32 error;     ///< geometric error (0 for the full resolution)
+    glm::uint32 chunk;      ///< index of the INDX chunk
+  };
+
+  const IndexHeader & indexHeader(unsigned int materialIndex, unsigned int level) const;
+
+private:
+  GlitterFile m_file;                                ///< the mapped file
+  std::vector<SimpleMaterial> m_materials;           ///< materials
+  std::unordered_map<std::string, Image<>> m_images; ///< images, pointing into the mapping
+};
+
+#endif // !defined(__GLITTER_GLITTERMESH_H__)
@@ -0,0 +1,251 @@
+#include "IndexOptimizer.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+/**
+ * @brief FIFO cache simulation with time stamps
+ *
+ * The time is incremented at each miss, so that a vertex is in the cache iff
+ * less than cacheSize vertices were inserted since its own insertion.
+ */
+class FifoCache {
+public:
+  FifoCache(size_t nbVertices, unsigned int cacheSize) : m_stamps(nbVertices, 0), m_time(cacheSize + 1), m_cacheSize(cacheSize) {}
+
+  /// @brief accesses a vertex, returns true on cache hits
+  bool access(unsigned int vertex)
+  {
+    if (m_time - m_stamps[vertex] <= m_cacheSize) {
+      return true;
+    }
+    m_stamps[vertex] = m_time++;
+    return false;
+  }
+
+  /// @brief empties the cache
+  void flush() { m_time += m_cacheSize; }
+
+private:
+  std::vector<unsigned int> m_stamps;
+  unsigned int m_time;
+  unsigned int m_cacheSize;
+};
+} // namespace
+
+IndexOptimizer::Statistics IndexOptimizer::analyze(const std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices, unsigned int cacheSize)
+{
+  Statistics statistics = {0, 0, 0, 0, 0};
+  FifoCache cache(nbVertices, cacheSize);
+  std::vector<bool> referenced(nbVertices, false);
+  for (const std::vector<unsigned int> & ibo : ibos) {
+    cache.flush();
+    statistics.nbTriangles += ibo.size() / 3;
+    for (unsigned int index : ibo) {
+      statistics.nbMisses += not cache.access(index);
+      if (not referenced[index]) {
+        referenced[index] = true;
+        statistics.nbVertices++;
+      }
+    }
+  }
+  statistics.acmr = statistics.nbTriangles ? double(statistics.nbMisses) / statistics.nbTriangles : 0;
+  statistics.atvr = statistics.nbVertices ? double(statistics.nbMisses) / statistics.nbVertices : 0;
+  return statistics;
+}
+
+void IndexOptimizer::optimizeVertexCache(std::vector<unsigned int> & ibo, size_t nbVertices, unsigned int cacheSize, std::vector<size_t> * deadEnds)
+{
+  const size_t nbTriangles = ibo.size() / 3;
+  if (deadEnds) {
+    deadEnds->clear();
+  }
+  if (nbTriangles == 0) {
+    return;
+  }
+
+  // vertex to triangles adjacency, and number of triangles not emitted yet per vertex
+  std::vector<unsigned int> offsets(nbVertices + 1, 0);
+  for (size_t k = 0; k < 3 * nbTriangles; k++) {
+    offsets[ibo[k] + 1]++;
+  }
+  std::vector<unsigned int> live(nbVertices);
+  for (size_t v = 0; v < nbVertices; v++) {
+    live[v] = offsets[v + 1];
+    offsets[v + 1] += offsets[v];
+  }
+  std::vector<unsigned int> adjacency(3 * nbTriangles);
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t k = 0; k < 3 * nbTriangles; k++) {
+    adjacency[fill[ibo[k]]++] = k / 3;
+  }
+
+  std::vector<unsigned int> stamps(nbVertices, 0);
+  unsigned int time = cacheSize + 1;
+  std::vector<bool> emitted(nbTriangles, false);
+  std::vector<unsigned int> deadEndStack;
+  std::vector<unsigned int> candidates;
+  std::vector<unsigned int> output;
+  output.reserve(3 * nbTriangles);
+  size_t cursor = 0; // restart position in the input, once the dead-end stack is exhausted
+
+  const long none = -1;
+  long fanning = ibo[0];
+  while (fanning != none) {
+    // emits all the remaining triangles around the fanning vertex
+    candidates.clear();
+    for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+      unsigned int triangle = adjacency[a];
+      if (emitted[triangle]) {
+        continue;
+      }
+      emitted[triangle] = true;
+      for (int c = 0; c < 3; c++) {
+        unsigned int v = ibo[3 * triangle + c];
+        output.push_back(v);
+        deadEndStack.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - stamps[v] > cacheSize) {
+          stamps[v] = time++;
+        }
+      }
+    }
+
+    // the next fanning vertex is the one with remaining triangles that stays the longest in the cache
+    long next = none;
+    long bestPriority = -1;
+    for (unsigned int v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+      long priority = 0;
+      if (time - stamps[v] + 2 * live[v] <= cacheSize) {
+        priority = time - stamps[v];
+      }
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        next = v;
+      }
+    }
+
+    if (next == none) {
+      // dead-end: most recently referenced vertices first, then the input order
+      while (next == none and not deadEndStack.empty()) {
+        unsigned int v = deadEndStack.back();
+        deadEndStack.pop_back();
+        if (live[v] > 0) {
+          next = v;
+        }
+      }
+      while (next == none and cursor < 3 * nbTriangles) {
+        unsigned int v = ibo[cursor++];
+        if (live[v] > 0) {
+          next = v;
+        }
+      }
+      if (deadEnds and next != none) {
+        deadEnds->push_back(output.size() / 3);
+      }
+    }
+    fanning = next;
+  }
+  ibo.swap(output);
+}
+
+void IndexOptimizer::optimizeOverdraw(std::vector<unsigned int> & ibo, const std::vector<size_t> & deadEnds, const std::vector<glm::vec3> & positions, unsigned int cacheSize,
+                                      float threshold)
+{
+  const size_t nbTriangles = ibo.size() / 3;
+  if (nbTriangles == 0) {
+    return;
+  }
+  FifoCache cache(positions.size(), cacheSize);
+  size_t nbMisses = 0;
+  for (size_t k = 0; k < 3 * nbTriangles; k++) {
+    nbMisses += not cache.access(ibo[k]);
+  }
+  const double targetAcmr = threshold * double(nbMisses) / nbTriangles;
+
+  // clusters start at the dead-ends where the current cluster, drawn from an empty cache, is efficient enough
+  std::vector<size_t> clusters(1, 0);
+  size_t clusterMisses = 0;
+  size_t deadEnd = 0;
+  cache.flush();
+  for (size_t t = 0; t < nbTriangles; t++) {
+    while (deadEnd < deadEnds.size() and deadEnds[deadEnd] < t) {
+      deadEnd++;
+    }
+    if (deadEnd < deadEnds.size() and deadEnds[deadEnd] == t and t > clusters.back() and clusterMisses <= targetAcmr * (t - clusters.back())) {
+      clusters.push_back(t);
+      clusterMisses = 0;
+      cache.flush();
+    }
+    for (int c = 0; c < 3; c++) {
+      clusterMisses += not cache.access(ibo[3 * t + c]);
+    }
+  }
+  clusters.push_back(nbTriangles);
+  const size_t nbClusters = clusters.size() - 1;
+  if (nbClusters < 2) {
+    return;
+  }
+
+  // occlusion potential: clusters facing outwards of the mesh are drawn first
+  glm::vec3 meshCentroid(0);
+  for (size_t k = 0; k < 3 * nbTriangles; k++) {
+    meshCentroid += positions[ibo[k]];
+  }
+  meshCentroid /= float(3 * nbTriangles);
+  std::vector<float> potentials(nbClusters);
+  for (size_t c = 0; c < nbClusters; c++) {
+    glm::vec3 centroid(0);
+    glm::vec3 normal(0);
+    float area = 0;
+    for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+      const glm::vec3 & x0 = positions[ibo[3 * t]];
+      const glm::vec3 & x1 = positions[ibo[3 * t + 1]];
+      const glm::vec3 & x2 = positions[ibo[3 * t + 2]];
+      glm::vec3 n = glm::cross(x1 - x0, x2 - x0);
+      float a = glm::length(n);
+      centroid += a * (x0 + x1 + x2) / 3.f;
+      normal += n;
+      area += a;
+    }
+    float normalLength = glm::length(normal);
+    potentials[c] = (area > 0 and normalLength > 0) ? glm::dot(centroid / area - meshCentroid, normal / normalLength) : 0;
+  }
+  std::vector<size_t> order(nbClusters);
+  for (size_t c = 0; c < nbClusters; c++) {
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&potentials](size_t a, size_t b) { return potentials[a] > potentials[b]; });
+
+  std::vector<unsigned int> output;
+  output.reserve(ibo.size());
+  for (size_t c : order) {
+    output.insert(output.end(), ibo.begin() + 3 * clusters[c], ibo.begin() + 3 * clusters[c + 1]);
+  }
+  ibo.swap(output);
+}
+
+void IndexOptimizer::optimizeVertexFetch(std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices, std::vector<unsigned int> & remap)
+{
+  const unsigned int unused = std::numeric_limits<unsigned int>::max();
+  remap.assign(nbVertices, unused);
+  unsigned int next = 0;
+  for (std::vector<unsigned int> & ibo : ibos) {
+    for (unsigned int & index : ibo) {
+      if (remap[index] == unused) {
+        remap[index] = next++;
+      }
+      index = remap[index];
+    }
+  }
+  for (unsigned int & index : remap) {
+    if (index == unused) {
+      index = next++;
+    }
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef __GLITTER_INDEXOPTIMIZER_H__
+#define __GLITTER_INDEXOPTIMIZER_H__
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief Reorders indexed triangle lists for the GPU post-transform vertex cache
+ *
+ * The following passes are available:
+ *	+ vertex cache ordering: Tipsify (Sander et al. 2007), a linear time greedy
+ *	  fanning of the triangles around the vertices most likely to stay in a FIFO cache
+ *	+ overdraw ordering: the Tipsify order is split into clusters at its dead-ends
+ *	  (as long as the cache efficiency of the cluster is preserved), then the clusters
+ *	  are sorted so that the ones facing outwards of the mesh are drawn first
+ *	+ vertex fetch ordering: vertices are renumbered in order of first use, so
+ *	  that the vertex arrays are read (almost) sequentially
+ *
+ * The cache efficiency is measured by simulating a FIFO cache, in terms of
+ * ACMR (average cache miss ratio, i.e. transformed vertices per triangle,
+ * between 0.5 and 3) and ATVR (average transformed vertex ratio, i.e.
+ * transformed vertices per referenced vertex, 1 being optimal).
+ */
+class IndexOptimizer {
+public:
+  /// The index orders available
+  enum Order
+  {
+    FileOrder,        ///< triangles are kept as they are
+    VertexCacheOrder, ///< vertex cache ordering, then vertex fetch ordering
+    OverdrawOrder     ///< vertex cache ordering, overdraw ordering, then vertex fetch ordering
+  };
+
+  /// @brief Vertex cache statistics of a set of IBOs
+  struct Statistics {
+    size_t nbTriangles; ///< number of triangles
+    size_t nbVertices;  ///< number of distinct referenced vertices
+    size_t nbMisses;    ///< number of cache misses (i.e. transformed vertices)
+    double acmr;        ///< average cache miss ratio (misses per triangle)
+    double atvr;        ///< average transformed vertex ratio (misses per referenced vertex)
+  };
+
+  /// @brief the FIFO cache size used by default, both for optimization and analysis
+  static const unsigned int defaultCacheSize = 16;
+
+  /**
+   * @brief simulates a FIFO vertex cache (flushed between IBOs)
+   * @param ibos the triangle lists
+   * @param nbVertices the number of vertices referenced by the IBOs
+   * @param cacheSize the number of entries of the FIFO cache
+   */
+  static Statistics analyze(const std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices, unsigned int cacheSize = defaultCacheSize);
+
+  /**
+   * @brief reorders the triangles of an IBO for the vertex cache (Tipsify)
+   * @param ibo the triangle list
+   * @param nbVertices the number of vertices referenced by the IBO
+   * @param cacheSize the number of entries of the targeted FIFO cache
+   * @param deadEnds if not null, filled with the positions (in triangles) of the dead-ends of the new order
+   */
+  static void optimizeVertexCache(std::vector<unsigned int> & ibo, size_t nbVertices, unsigned int cacheSize = defaultCacheSize, std::vector<size_t> * deadEnds = nullptr);
+
+  /**
+   * @brief reorders clusters of triangles to reduce overdraw
+   * @param ibo the triangle list, in vertex cache order
+   * @param deadEnds the dead-ends of the vertex cache order (see optimizeVertexCache)
+   * @param positions the vertex positions
+   * @param cacheSize the number of entries of the targeted FIFO cache
+   * @param threshold the cluster ACMR allowed, relatively to the ACMR of the whole IBO
+   */
+  static void optimizeOverdraw(std::vector<unsigned int> & ibo, const std::vector<size_t> & deadEnds, const std::vector<glm::vec3> & positions, unsigned int cacheSize = defaultCacheSize,
+                               float threshold = 1.05f);
+
+  /**
+   * @brief renumbers the vertices in order of first use
+   * @param ibos the triangle lists, remapped in place
+   * @param nbVertices the number of vertices
+   * @param remap for each vertex, its new index (unreferenced vertices are moved at the end)
+   */
+  static void optimizeVertexFetch(std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices, std::vector<unsigned int> & remap);
+
+  /**
+   * @brief applies a vertex renumbering to an attribute array
+   * @param values the attribute array
+   * @param remap the renumbering computed by optimizeVertexFetch
+   */
+  template <typename T> static void permute(std::vector<T> & values, const std::vector<unsigned int> & remap);
+};
+
+/*
+ * Definition of method templates
+ */
+template <typename T> void IndexOptimizer::permute(std::vector<T> & values, const std::vector<unsigned int> & remap)
+{
+  std::vector<T> permuted(values.size());
+  for (size_t k = 0; k < values.size(); k++) {
+    permuted[remap[k]] = values[k];
+  }
+  values.swap(permuted);
+}
+
+#endif // !defined(__GLITTER_INDEXOPTIMIZER_H__)
@@ -0,0 +1,280 @@
+#include "MeshCache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include "utils.hpp"
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+const std::uint64_t prime1 = 0x9E3779B185EBCA87ull; ///< multipliers of the hash (from xxHash)
+const std::uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+const size_t readSize = 1 << 20; ///< files are hashed by blocks of 1 MB
+
+std::mutex statisticsMutex;
+MeshCache::Statistics processStatistics = {0, 0, 0, 0, 0};
+
+void count(size_t MeshCache::Statistics::*counter)
+{
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  processStatistics.*counter += 1;
+}
+
+/// @brief hash of the content of a file, false if it cannot be read
+bool hashFile(const std::string & filename, std::uint64_t & value)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  if (not file) {
+    return false;
+  }
+  std::vector<char> buffer(readSize);
+  value = 0;
+  do {
+    file.read(buffer.data(), buffer.size());
+    value = MeshCache::hash(buffer.data(), size_t(file.gcount()), value);
+  } while (file);
+  return true;
+}
+
+std::string toHex(std::uint64_t value)
+{
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+  return hex;
+}
+
+/// @brief dependency line: the hash of the file ("missing" if it cannot be read) and its name
+std::string dependencyLine(const std::string & filename)
+{
+  std::uint64_t value;
+  return (hashFile(filename, value) ? toHex(value) : std::string("missing")) + " " + filename;
+}
+} // namespace
+
+void MeshCache::Statistics::print(std::ostream & out) const
+{
+  out << hits << " hits, " << misses << " misses, " << invalidations << " invalidations, " << insertions << " insertions, " << evictions << " evictions";
+}
+
+MeshCache::MeshCache(const std::string & directory, size_t capacity) : m_capacity(capacity)
+{
+#ifndef _WIN32
+  if (not directory.empty() and makeDirectories(directory)) {
+    m_directory = directory;
+    if (m_directory.back() != '/') {
+      m_directory += '/';
+    }
+  }
+#endif
+}
+
+bool MeshCache::valid() const
+{
+  return not m_directory.empty();
+}
+
+std::uint64_t MeshCache::hash(const void * data, size_t size, std::uint64_t seed)
+{
+  // a word at a time (the last one padded with zeros), then a final avalanche
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  std::uint64_t value = seed ^ (size * prime1);
+  for (size_t k = 0; k < size; k += 8) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, bytes + k, std::min<size_t>(8, size - k));
+    word *= prime2;
+    value = (value ^ (word ^ (word >> 31))) * prime1;
+  }
+  value ^= value >> 33;
+  value *= prime2;
+  value ^= value >> 29;
+  return value;
+}
+
+std::string MeshCache::key(const std::string & filename, const std::string & signature)
+{
+  std::uint64_t value;
+  if (not hashFile(filename, value)) {
+    return std::string();
+  }
+  std::string salt = signature + " version " + std::to_string(version);
+  return toHex(hash(salt.data(), salt.size(), value));
+}
+
+std::string MeshCache::find(const std::string & key)
+{
+  const std::string glitterName = entryName(key, ".glitter");
+  bool stale = false;
+  if (key.empty() or not valid() or not readDependencies(key, stale)) {
+    if (stale) {
+      remove(key);
+      count(&Statistics::invalidations);
+    }
+    count(&Statistics::misses);
+    return std::string();
+  }
+#ifndef _WIN32
+  // the modification time is the access time of the LRU policy
+  utime(glitterName.c_str(), nullptr);
+#endif
+  count(&Statistics::hits);
+  return glitterName;
+}
+
+std::string MeshCache::temporaryName(const std::string & key) const
+{
+#ifndef _WIN32
+  return entryName(key, ".glitter") + "." + std::to_string(getpid()) + ".tmp";
+#else
+  return entryName(key, ".glitter.tmp");
+#endif
+}
+
+bool MeshCache::insert(const std::string & key, const std::vector<std::string> & dependencies)
+{
+  const std::string temporary = temporaryName(key);
+  if (key.empty() or not valid()) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  // the dependencies are renamed first, so that a complete .glitter file always has its .deps
+  const std::string temporaryDependencies = temporary + ".deps";
+  if (not writeDependencies(temporaryDependencies, key, dependencies) or std::rename(temporaryDependencies.c_str(), entryName(key, ".deps").c_str()) != 0 or
+      std::rename(temporary.c_str(), entryName(key, ".glitter").c_str()) != 0) {
+    std::remove(temporaryDependencies.c_str());
+    std::remove(temporary.c_str());
+    remove(key);
+    return false;
+  }
+  count(&Statistics::insertions);
+  evict(key);
+  return true;
+}
+
+bool MeshCache::writeDependencies(const std::string & filename, const std::string & key, const std::vector<std::string> & dependencies)
+{
+  std::ofstream file(filename.c_str());
+  file << "key " << key << "\n";
+  for (const std::string & dependency : dependencies) {
+    file << dependencyLine(dependency) << "\n";
+  }
+  return bool(file);
+}
+
+bool MeshCache::checkDependencies(const std::string & filename, const std::string & key)
+{
+  std::ifstream file(filename.c_str());
+  std::string line;
+  if (not std::getline(file, line) or line != "key " + key) {
+    return false;
+  }
+  while (std::getline(file, line)) {
+    size_t space = line.find(' ');
+    if (space == std::string::npos or dependencyLine(line.substr(space + 1)) != line) {
+      return false;
+    }
+  }
+  return true;
+}
+
+MeshCache::Statistics MeshCache::statistics()
+{
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  return processStatistics;
+}
+
+std::string MeshCache::defaultDirectory()
+{
+  const char * cacheHome = std::getenv("XDG_CACHE_HOME");
+  if (cacheHome and *cacheHome) {
+    return std::string(cacheHome) + "/glitter";
+  }
+  const char * home = std::getenv("HOME");
+  if (home and *home) {
+    return std::string(home) + "/.cache/glitter";
+  }
+  return std::string();
+}
+
+std::string MeshCache::entryName(const std::string & key, const char * extension) const
+{
+  return m_directory + key + extension;
+}
+
+bool MeshCache::readDependencies(const std::string & key, bool & stale) const
+{
+  const std::string dependencies = entryName(key, ".deps");
+  const bool hasDependencies = bool(std::ifstream(dependencies.c_str()));
+  if (not hasDependencies or not std::ifstream(entryName(key, ".glitter").c_str())) {
+    // a lone .deps (or .glitter) file is left by an interrupted insertion
+    stale = hasDependencies;
+    return false;
+  }
+  stale = not checkDependencies(dependencies, key);
+  return not stale;
+}
+
+void MeshCache::remove(const std::string & key) const
+{
+  std::remove(entryName(key, ".glitter").c_str());
+  std::remove(entryName(key, ".deps").c_str());
+}
+
+void MeshCache::evict(const std::string & kept)
+{
+#ifndef _WIN32
+  struct Entry {
+    std::string key;
+    size_t size;
+    time_t accessTime;
+  };
+  std::vector<Entry> entries;
+  size_t total = 0;
+  DIR * directory = opendir(m_directory.c_str());
+  if (not directory) {
+    return;
+  }
+  while (dirent * file = readdir(directory)) {
+    std::string name = file->d_name;
+    const std::string extension = ".glitter";
+    if (name.size() <= extension.size() or name.compare(name.size() - extension.size(), extension.size(), extension)) {
+      continue;
+    }
+    Entry entry = {name.substr(0, name.size() - extension.size()), 0, 0};
+    struct stat status;
+    if (stat((m_directory + name).c_str(), &status) == 0) {
+      entry.size = size_t(status.st_size);
+      entry.accessTime = status.st_mtime;
+    }
+    if (stat(entryName(entry.key, ".deps").c_str(), &status) == 0) {
+      entry.size += size_t(status.st_size);
+    }
+    total += entry.size;
+    entries.push_back(entry);
+  }
+  closedir(directory);
+  std::sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b) { return a.accessTime < b.accessTime or (a.accessTime == b.accessTime and a.key < b.key); });
+  for (const Entry & entry : entries) {
+    if (total <= m_capacity) {
+      break;
+    }
+    if (entry.key == kept) {
+      continue;
+    }
+    remove(entry.key);
+    total -= entry.size;
+    count(&Statistics::evictions);
+  }
+#else
+  (void)kept;
+#endif
+}
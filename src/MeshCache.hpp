@@ -0,0 +1,124 @@
+#ifndef __GLITTER_MESHCACHE_H__
+#define __GLITTER_MESHCACHE_H__
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * @brief An on-disk cache of processed wavefront files, in the .glitter v2 form
+ *
+ * An entry is keyed by a hash of the content of the .obj file and of a
+ * signature of the loading options (see ObjLoader::Options::cacheDirectory).
+ * It is made of two files in the cache directory:
+ *	+ <key>.glitter, the processed mesh, read through GlitterMesh
+ *	+ <key>.deps, the files the mesh depends on besides the .obj (material
+ *	  libraries, textures), one per line with the hash of their content,
+ *	  after the key (see writeDependencies)
+ * A lookup hashes the .obj file and the dependencies of the entry: an entry
+ * whose dependencies changed (or disappeared) is stale, and removed.
+ *
+ * The cache is bounded in size: after an insertion, the least recently used
+ * entries (the access time being the modification time of the .glitter file,
+ * updated by each hit) are evicted until the directory fits in the capacity.
+ *
+ * The entries are written under a temporary name then renamed, so that
+ * concurrent processes never read a partial entry.
+ *
+ * @note the cache is not available on Windows (every lookup is a miss, nothing is stored)
+ */
+class MeshCache {
+public:
+  /// The lookups and insertions of all the caches of the process
+  struct Statistics {
+    size_t hits;          ///< lookups finding a valid entry
+    size_t misses;        ///< lookups finding no valid entry
+    size_t invalidations; ///< stale entries removed by a lookup
+    size_t insertions;    ///< entries added
+    size_t evictions;     ///< entries evicted to keep the cache within its capacity
+
+    /// @brief prints the statistics on one line
+    void print(std::ostream & out) const;
+  };
+
+  /// @brief version of the processing, part of every key: bumping it invalidates all the entries
+  static const unsigned int version = 2;
+
+  /**
+   * @brief Constructor
+   * @param directory the cache directory, created if needed
+   * @param capacity the maximal size of the entries, in bytes
+   */
+  MeshCache(const std::string & directory, size_t capacity);
+
+  /// @brief false if the directory could not be created (every lookup is then a miss)
+  bool valid() const;
+
+  /**
+   * @brief key of a wavefront file
+   * @param filename the .obj file
+   * @param signature the loading options, and anything else the processed mesh depends on
+   * @return the key, or an empty string if the file cannot be read
+   */
+  static std::string key(const std::string & filename, const std::string & signature);
+
+  /**
+   * @brief looks an entry up
+   * @param key the key of the entry
+   * @return the name of the .glitter file of the entry, or an empty string if it is missing or stale
+   */
+  std::string find(const std::string & key);
+
+  /// @brief name of the temporary file a processed mesh is written to, before insert
+  std::string temporaryName(const std::string & key) const;
+
+  /**
+   * @brief moves a written temporary file into the cache, then evicts the least recently used entries
+   * @param key the key of the entry
+   * @param dependencies the files the mesh depends on besides the .obj (may be missing files)
+   * @return false on failure (the temporary file is removed)
+   */
+  bool insert(const std::string & key, const std::vector<std::string> & dependencies);
+
+  /**
+   * @brief writes a dependency file, recording the content of some files
+   * @param filename the dependency file
+   * @param key the key of the content the files were processed into (the first line of the file)
+   * @param dependencies the files (may be missing files)
+   * @return false if the dependency file could not be written
+   */
+  static bool writeDependencies(const std::string & filename, const std::string & key, const std::vector<std::string> & dependencies);
+
+  /**
+   * @brief checks a dependency file written by writeDependencies (all its files are hashed)
+   * @return true if the file exists, records @p key, and none of its files changed (nor appeared, for the missing ones)
+   */
+  static bool checkDependencies(const std::string & filename, const std::string & key);
+
+  /// @brief the statistics of all the caches of the process
+  static Statistics statistics();
+
+  /// @brief the default cache directory: $XDG_CACHE_HOME/glitter, or $HOME/.cache/glitter (empty if neither is set)
+  static std::string defaultDirectory();
+
+  /**
+   * @brief 64-bit hash of a buffer (not cryptographic)
+   * @param data the bytes
+   * @param size the number of bytes
+   * @param seed the initial value, to chain several buffers
+   */
+  static std::uint64_t hash(const void * data, size_t size, std::uint64_t seed = 0);
+
+private:
+  std::string entryName(const std::string & key, const char * extension) const;
+  bool readDependencies(const std::string & key, bool & stale) const;
+  void remove(const std::string & key) const;
+  void evict(const std::string & kept);
+
+private:
+  std::string m_directory; ///< the cache directory, with a trailing separator (empty if unavailable)
+  size_t m_capacity;       ///< maximal size of the entries, in bytes
+};
+
+#endif // !defined(__GLITTER_MESHCACHE_H__)
@@ -0,0 +1,471 @@
+#include "MeshSimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace
+{
+/// @brief symmetric quadric x^T A x + 2 b^T x + c, with the total weight of its planes
+struct Quadric {
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double weight;
+
+  Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0), weight(0) {}
+
+  /// adds the squared distance to the plane n.x + d = 0 (n being a unit vector)
+  void addPlane(const glm::vec3 & n, float d, float w)
+  {
+    a00 += w * n.x * n.x;
+    a01 += w * n.x * n.y;
+    a02 += w * n.x * n.z;
+    a11 += w * n.y * n.y;
+    a12 += w * n.y * n.z;
+    a22 += w * n.z * n.z;
+    b0 += w * n.x * d;
+    b1 += w * n.y * d;
+    b2 += w * n.z * d;
+    c += w * d * d;
+    weight += w;
+  }
+
+  Quadric & operator+=(const Quadric & q)
+  {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a11 += q.a11;
+    a12 += q.a12;
+    a22 += q.a22;
+    b0 += q.b0;
+    b1 += q.b1;
+    b2 += q.b2;
+    c += q.c;
+    weight += q.weight;
+    return *this;
+  }
+
+  double evaluate(const glm::vec3 & p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    double e = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::max(0., e);
+  }
+};
+
+/// @brief geometric vertex classification, see MeshSimplifier
+enum VertexKind
+{
+  InteriorVertex,
+  BorderVertex,
+  SeamVertex,
+  LockedVertex
+};
+
+/// @brief geometric edge classification
+enum EdgeKind
+{
+  InteriorEdge,
+  BorderEdge,
+  SeamEdge,
+  ComplexEdge
+};
+
+/// @brief a triangle side, between geometric vertices a < b
+struct HalfEdge {
+  std::uint64_t key;   ///< (a, b) packed
+  unsigned int wedgeA; ///< the wedge of a in the triangle
+  unsigned int wedgeB; ///< the wedge of b in the triangle
+  bool operator<(const HalfEdge & other) const { return key < other.key; }
+};
+
+struct Collapse {
+  unsigned int from; ///< geometric vertex removed
+  unsigned int to;   ///< geometric vertex kept
+  double cost;
+  bool operator<(const Collapse & other) const { return cost < other.cost; }
+};
+
+/// relative weight of the quadrics preserving the borders and the seams
+const float boundaryWeight = 10.f;
+} // namespace
+
+MeshSimplifier::MeshSimplifier(const std::vector<glm::vec3> & positions) : m_positions(positions), m_geometricVertices(positions.size())
+{
+  std::vector<unsigned int> order(positions.size());
+  for (size_t k = 0; k < order.size(); k++) {
+    order[k] = k;
+  }
+  auto lexicographic = [&positions](unsigned int a, unsigned int b) {
+    const glm::vec3 & pa = positions[a];
+    const glm::vec3 & pb = positions[b];
+    if (pa.x != pb.x) {
+      return pa.x < pb.x;
+    }
+    if (pa.y != pb.y) {
+      return pa.y < pb.y;
+    }
+    if (pa.z != pb.z) {
+      return pa.z < pb.z;
+    }
+    return a < b;
+  };
+  std::sort(order.begin(), order.end(), lexicographic);
+  for (size_t k = 0; k < order.size(); k++) {
+    bool same = (k > 0) and positions[order[k]] == positions[order[k - 1]];
+    m_geometricVertices[order[k]] = same ? m_geometricVertices[order[k - 1]] : order[k];
+  }
+}
+
+std::vector<unsigned int> MeshSimplifier::simplify(const std::vector<unsigned int> & ibo, size_t targetTriangles, float & error) const
+{
+  const std::vector<unsigned int> & geometric = m_geometricVertices;
+  const size_t nbVertices = m_positions.size();
+  auto isDegenerate = [&geometric](const unsigned int * t) { return geometric[t[0]] == geometric[t[1]] or geometric[t[1]] == geometric[t[2]] or geometric[t[2]] == geometric[t[0]]; };
+
+  std::vector<unsigned int> indices;
+  indices.reserve(ibo.size());
+  for (size_t k = 0; k + 2 < ibo.size(); k += 3) {
+    if (not isDegenerate(&ibo[k])) {
+      indices.insert(indices.end(), ibo.begin() + k, ibo.begin() + k + 3);
+    }
+  }
+  error = 0;
+
+  std::vector<Quadric> quadrics(nbVertices);
+  std::vector<unsigned int> wedgeRemap(nbVertices);
+  for (size_t k = 0; k < nbVertices; k++) {
+    wedgeRemap[k] = k;
+  }
+  std::vector<HalfEdge> halfEdges;
+  std::vector<EdgeKind> edgeKinds;
+  std::vector<VertexKind> kinds(nbVertices);
+  std::vector<unsigned int> wedgeCounts(nbVertices);
+  std::vector<unsigned int> borderCounts(nbVertices);
+  std::vector<unsigned int> seamCounts(nbVertices);
+  std::vector<bool> usedWedges(nbVertices);
+  std::vector<unsigned int> offsets(nbVertices + 1);
+  std::vector<unsigned int> adjacency;
+  std::vector<bool> locked(nbVertices);
+  std::vector<Collapse> candidates;
+
+  for (int pass = 0;; pass++) {
+    const size_t nbTriangles = indices.size() / 3;
+    if (nbTriangles <= targetTriangles) {
+      break;
+    }
+
+    // half-edges sorted by geometric edge
+    halfEdges.clear();
+    for (size_t t = 0; t < nbTriangles; t++) {
+      for (int c = 0; c < 3; c++) {
+        unsigned int wa = indices[3 * t + c];
+        unsigned int wb = indices[3 * t + (c + 1) % 3];
+        unsigned int a = geometric[wa];
+        unsigned int b = geometric[wb];
+        if (a > b) {
+          std::swap(a, b);
+          std::swap(wa, wb);
+        }
+        halfEdges.push_back(HalfEdge{(std::uint64_t(a) << 32) | b, wa, wb});
+      }
+    }
+    std::sort(halfEdges.begin(), halfEdges.end());
+
+    // edge and vertex classification
+    std::fill(wedgeCounts.begin(), wedgeCounts.end(), 0);
+    std::fill(borderCounts.begin(), borderCounts.end(), 0);
+    std::fill(seamCounts.begin(), seamCounts.end(), 0);
+    std::fill(usedWedges.begin(), usedWedges.end(), false);
+    std::fill(kinds.begin(), kinds.end(), InteriorVertex);
+    for (unsigned int w : indices) {
+      if (not usedWedges[w]) {
+        usedWedges[w] = true;
+        wedgeCounts[geometric[w]]++;
+      }
+    }
+    edgeKinds.clear();
+    for (size_t begin = 0, end = 0; begin < halfEdges.size(); begin = end) {
+      while (end < halfEdges.size() and halfEdges[end].key == halfEdges[begin].key) {
+        end++;
+      }
+      unsigned int a = halfEdges[begin].key >> 32;
+      unsigned int b = halfEdges[begin].key & 0xffffffff;
+      EdgeKind kind = ComplexEdge;
+      if (end - begin == 1) {
+        kind = BorderEdge;
+      } else if (end - begin == 2) {
+        bool sameWedges = halfEdges[begin].wedgeA == halfEdges[begin + 1].wedgeA and halfEdges[begin].wedgeB == halfEdges[begin + 1].wedgeB;
+        kind = sameWedges ? InteriorEdge : SeamEdge;
+      }
+      edgeKinds.push_back(kind);
+      if (kind == BorderEdge) {
+        borderCounts[a]++;
+        borderCounts[b]++;
+      } else if (kind == SeamEdge) {
+        seamCounts[a]++;
+        seamCounts[b]++;
+      } else if (kind == ComplexEdge) {
+        kinds[a] = kinds[b] = LockedVertex;
+      }
+    }
+    for (size_t v = 0; v < nbVertices; v++) {
+      if (kinds[v] == LockedVertex or wedgeCounts[v] == 0) {
+        continue;
+      }
+      if (wedgeCounts[v] == 1 and borderCounts[v] == 0 and seamCounts[v] == 0) {
+        kinds[v] = InteriorVertex;
+      } else if (wedgeCounts[v] == 1 and borderCounts[v] == 2 and seamCounts[v] == 0) {
+        kinds[v] = BorderVertex;
+      } else if (wedgeCounts[v] == 2 and borderCounts[v] == 0 and seamCounts[v] == 2) {
+        kinds[v] = SeamVertex;
+      } else {
+        kinds[v] = LockedVertex;
+      }
+    }
+    if (pass == 0) {
+      // face quadrics, and constraint planes orthogonal to the faces along borders and seams
+      for (size_t t = 0; t < nbTriangles; t++) {
+        unsigned int g[3] = {geometric[indices[3 * t]], geometric[indices[3 * t + 1]], geometric[indices[3 * t + 2]]};
+        const glm::vec3 & p0 = m_positions[g[0]];
+        glm::vec3 normal = glm::cross(m_positions[g[1]] - p0, m_positions[g[2]] - p0);
+        float length = glm::length(normal);
+        if (not(length > 0)) {
+          continue;
+        }
+        normal /= length;
+        Quadric face;
+        face.addPlane(normal, -glm::dot(normal, p0), 0.5f * length);
+        for (int c = 0; c < 3; c++) {
+          quadrics[g[c]] += face;
+        }
+        for (int c = 0; c < 3; c++) {
+          unsigned int a = std::min(g[c], g[(c + 1) % 3]);
+          unsigned int b = std::max(g[c], g[(c + 1) % 3]);
+          HalfEdge key = {(std::uint64_t(a) << 32) | b, 0, 0};
+          size_t e = std::lower_bound(halfEdges.begin(), halfEdges.end(), key) - halfEdges.begin();
+          bool constrained = false;
+          size_t count = 0;
+          while (e + count < halfEdges.size() and halfEdges[e + count].key == key.key) {
+            count++;
+          }
+          if (count == 1) {
+            constrained = true;
+          } else if (count == 2) {
+            constrained = not(halfEdges[e].wedgeA == halfEdges[e + 1].wedgeA and halfEdges[e].wedgeB == halfEdges[e + 1].wedgeB);
+          }
+          if (not constrained) {
+            continue;
+          }
+          const glm::vec3 & pa = m_positions[a];
+          glm::vec3 edge = m_positions[b] - pa;
+          glm::vec3 planeNormal = glm::cross(edge, normal);
+          float planeLength = glm::length(planeNormal);
+          if (not(planeLength > 0)) {
+            continue;
+          }
+          planeNormal /= planeLength;
+          Quadric constraint;
+          constraint.addPlane(planeNormal, -glm::dot(planeNormal, pa), boundaryWeight * glm::dot(edge, edge));
+          quadrics[a] += constraint;
+          quadrics[b] += constraint;
+        }
+      }
+    }
+
+    // vertex to triangles adjacency
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (unsigned int w : indices) {
+      offsets[geometric[w] + 1]++;
+    }
+    for (size_t v = 0; v < nbVertices; v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    adjacency.resize(indices.size());
+    {
+      std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+      for (size_t k = 0; k < indices.size(); k++) {
+        adjacency[fill[geometric[indices[k]]]++] = k / 3;
+      }
+    }
+
+    // collapse candidates, both directions of each edge
+    candidates.clear();
+    size_t edgeIndex = 0;
+    for (size_t begin = 0, end = 0; begin < halfEdges.size(); begin = end, edgeIndex++) {
+      while (end < halfEdges.size() and halfEdges[end].key == halfEdges[begin].key) {
+        end++;
+      }
+      unsigned int ends[2] = {static_cast<unsigned int>(halfEdges[begin].key >> 32), static_cast<unsigned int>(halfEdges[begin].key & 0xffffffff)};
+      EdgeKind edgeKind = edgeKinds[edgeIndex];
+      for (int d = 0; d < 2; d++) {
+        unsigned int from = ends[d];
+        unsigned int to = ends[1 - d];
+        bool allowed = (kinds[from] == InteriorVertex) or (kinds[from] == BorderVertex and edgeKind == BorderEdge) or (kinds[from] == SeamVertex and edgeKind == SeamEdge);
+        if (allowed) {
+          Quadric q = quadrics[from];
+          q += quadrics[to];
+          candidates.push_back(Collapse{from, to, q.evaluate(m_positions[to])});
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    if (candidates.empty()) {
+      break;
+    }
+    // a pass does not go much beyond the cost of the collapses needed to reach the target (about 2 triangles per collapse),
+    // so that expensive collapses are postponed to the next passes, where cheaper ones may have appeared
+    size_t goal = std::min(candidates.size() - 1, (nbTriangles - targetTriangles) / 2);
+    const double costLimit = 1.5 * candidates[goal].cost;
+
+    // independent set of collapses
+    std::fill(locked.begin(), locked.end(), false);
+    size_t remaining = nbTriangles;
+    size_t nbCollapses = 0;
+    for (const Collapse & collapse : candidates) {
+      if (remaining <= targetTriangles or collapse.cost > costLimit) {
+        break;
+      }
+      const unsigned int from = collapse.from;
+      const unsigned int to = collapse.to;
+      if (locked[from] or locked[to]) {
+        continue;
+      }
+      const glm::vec3 & target = m_positions[to];
+
+      // wedge pairing along the collapsed edge, and flip check of the other triangles
+      unsigned int pairs[2][2];
+      int nbPairs = 0;
+      bool valid = true;
+      size_t removed = 0;
+      for (unsigned int a = offsets[from]; a < offsets[from + 1] and valid; a++) {
+        const unsigned int * t = &indices[3 * adjacency[a]];
+        int cFrom = (geometric[t[0]] == from) ? 0 : (geometric[t[1]] == from) ? 1 : 2;
+        int cTo = -1;
+        for (int c = 0; c < 3; c++) {
+          if (geometric[t[c]] == to) {
+            cTo = c;
+          }
+        }
+        if (cTo >= 0) {
+          removed++;
+          bool known = false;
+          for (int p = 0; p < nbPairs; p++) {
+            if (pairs[p][0] == t[cFrom]) {
+              known = true;
+              valid = valid and pairs[p][1] == t[cTo];
+            }
+          }
+          if (not known) {
+            if (nbPairs == 2) {
+              valid = false;
+            } else {
+              pairs[nbPairs][0] = t[cFrom];
+              pairs[nbPairs][1] = t[cTo];
+              nbPairs++;
+            }
+          }
+          continue;
+        }
+        const glm::vec3 & p0 = m_positions[geometric[t[0]]];
+        const glm::vec3 & p1 = m_positions[geometric[t[1]]];
+        const glm::vec3 & p2 = m_positions[geometric[t[2]]];
+        glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+        glm::vec3 moved[3] = {p0, p1, p2};
+        moved[cFrom] = target;
+        glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+      }
+      // every wedge of the removed vertex must have a counterpart
+      valid = valid and nbPairs == static_cast<int>(wedgeCounts[from]);
+      if (not valid) {
+        continue;
+      }
+
+      for (int p = 0; p < nbPairs; p++) {
+        wedgeRemap[pairs[p][0]] = pairs[p][1];
+      }
+      quadrics[to] += quadrics[from];
+      error = std::max(error, static_cast<float>(std::sqrt(collapse.cost / std::max(quadrics[to].weight, 1e-30))));
+      for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++) {
+        const unsigned int * t = &indices[3 * adjacency[a]];
+        locked[geometric[t[0]]] = locked[geometric[t[1]]] = locked[geometric[t[2]]] = true;
+      }
+      remaining -= removed;
+      nbCollapses++;
+    }
+    if (nbCollapses == 0) {
+      break;
+    }
+
+    // applies the collapses, and removes the degenerate triangles
+    size_t kept = 0;
+    for (size_t t = 0; t < nbTriangles; t++) {
+      unsigned int triangle[3];
+      for (int c = 0; c < 3; c++) {
+        unsigned int w = indices[3 * t + c];
+        while (wedgeRemap[w] != w) {
+          w = wedgeRemap[w];
+        }
+        triangle[c] = w;
+      }
+      if (not isDegenerate(triangle)) {
+        indices[3 * kept] = triangle[0];
+        indices[3 * kept + 1] = triangle[1];
+        indices[3 * kept + 2] = triangle[2];
+        kept++;
+      }
+    }
+    indices.resize(3 * kept);
+  }
+  return indices;
+}
+
+std::vector<MeshSimplifier::Level> MeshSimplifier::buildChain(const std::vector<unsigned int> & ibo, unsigned int nbLevels, float ratio) const
+{
+  std::vector<Level> levels;
+  const std::vector<unsigned int> * previous = &ibo;
+  float previousError = 0;
+  for (unsigned int l = 0; l < nbLevels; l++) {
+    size_t previousTriangles = previous->size() / 3;
+    size_t target = static_cast<size_t>(previousTriangles * ratio);
+    if (target == 0) {
+      break;
+    }
+    Level level;
+    level.ibo = simplify(*previous, target, level.error);
+    // simplification stalled (typically, most vertices are locked): the level would not be worth its memory
+    if (level.ibo.empty() or level.ibo.size() / 3 > 0.8 * previousTriangles) {
+      break;
+    }
+    // the error is measured against the previous level: accumulated, it bounds the distance to the full resolution mesh (triangle inequality)
+    level.error += previousError;
+    previousError = level.error;
+    levels.push_back(std::move(level));
+    previous = &levels.back().ibo;
+  }
+  return levels;
+}
+
+float MeshSimplifier::pixelsPerUnit(const glm::mat4 & proj, const glm::mat4 & modelView, const glm::vec3 & center, float radius, float viewportHeight)
+{
+  glm::vec3 centerInView = glm::vec3(modelView * glm::vec4(center, 1));
+  float scale = std::max(glm::length(glm::vec3(modelView[0])), std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+  float distance = glm::length(centerInView) - scale * radius;
+  if (not(distance > 0)) {
+    return std::numeric_limits<float>::infinity(); // the camera is inside the bounding sphere
+  }
+  return scale * std::fabs(proj[1][1]) * 0.5f * viewportHeight / distance;
+}
+
+size_t MeshSimplifier::selectLevel(const std::vector<float> & errors, float pixelsPerUnit, float maxPixels)
+{
+  for (size_t l = errors.size(); l-- > 1;) {
+    if (errors[l] * pixelsPerUnit <= maxPixels) {
+      return l;
+    }
+  }
+  return 0;
+}
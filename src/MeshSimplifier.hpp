@@ -0,0 +1,87 @@
+#ifndef __GLITTER_MESHSIMPLIFIER_H__
+#define __GLITTER_MESHSIMPLIFIER_H__
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief Quadric error metric simplification of indexed triangle lists
+ *
+ * The simplifier performs edge collapses of a vertex onto one of its
+ * neighbours (half-edge collapses), so that the simplified triangle lists
+ * reference the original vertices: all the levels of detail of a mesh share
+ * the same vertex buffers.
+ *
+ * Vertices sharing the same position (e.g. on uv seams) are handled as a
+ * single geometric vertex with several "wedges". Geometric vertices are
+ * classified from the topology:
+ *	+ interior vertices (a single wedge) may collapse along any edge
+ *	+ border vertices may only collapse along the border
+ *	+ seam vertices (two wedges) may only collapse along the seam
+ *	+ other vertices (corners, non-manifold, ...) are locked
+ * The error of a collapse is given by the quadrics of Garland and Heckbert,
+ * area-weighted, with additional quadrics keeping the borders and the seams
+ * in place. Collapses flipping a triangle are rejected.
+ *
+ * Collapses are performed in passes: the candidates are sorted by error,
+ * then an independent set of collapses is applied, until the targeted number
+ * of triangles is reached or no collapse is possible.
+ */
+class MeshSimplifier {
+public:
+  /**
+   * @brief A level of detail of a triangle list
+   */
+  struct Level {
+    std::vector<unsigned int> ibo; ///< the triangle list
+    float error;                   ///< the geometric error (object space distance) with the full resolution mesh, an upper bound
+  };
+
+  /**
+   * @brief Constructor
+   * @param positions the vertex positions shared by all the triangle lists
+   */
+  MeshSimplifier(const std::vector<glm::vec3> & positions);
+
+  /**
+   * @brief simplifies a triangle list
+   * @param ibo the triangle list
+   * @param targetTriangles the targeted number of triangles
+   * @param error the geometric error of the simplified triangle list (object space distance)
+   * @return the simplified triangle list (which may have more triangles than targeted)
+   */
+  std::vector<unsigned int> simplify(const std::vector<unsigned int> & ibo, size_t targetTriangles, float & error) const;
+
+  /**
+   * @brief builds a chain of levels of detail
+   * @param ibo the full resolution triangle list (level 0, not included in the chain)
+   * @param nbLevels the maximum number of levels
+   * @param ratio the ratio of triangles kept from one level to the next
+   * @return the levels, each one simplified from the previous one, its error adding up the errors of the previous simplifications (the chain stops early when simplification stalls)
+   */
+  std::vector<Level> buildChain(const std::vector<unsigned int> & ibo, unsigned int nbLevels, float ratio = 0.5f) const;
+
+  /**
+   * @brief number of pixels covered by an object space unit at the distance of a bounding sphere
+   * @param proj the projection matrix
+   * @param modelView the model to view transform
+   * @param center the center of the bounding sphere (object space)
+   * @param radius the radius of the bounding sphere (object space)
+   * @param viewportHeight the viewport height in pixels
+   */
+  static float pixelsPerUnit(const glm::mat4 & proj, const glm::mat4 & modelView, const glm::vec3 & center, float radius, float viewportHeight);
+
+  /**
+   * @brief selects the coarsest level whose projected error is acceptable
+   * @param errors the errors of the levels, in increasing order (level 0 being the full resolution)
+   * @param pixelsPerUnit see MeshSimplifier::pixelsPerUnit
+   * @param maxPixels the largest acceptable screen space error
+   * @return the selected level
+   */
+  static size_t selectLevel(const std::vector<float> & errors, float pixelsPerUnit, float maxPixels = 1.f);
+
+private:
+  const std::vector<glm::vec3> & m_positions;
+  std::vector<unsigned int> m_geometricVertices; ///< for each vertex, the first vertex with the same position
+};
+
+#endif // !defined(__GLITTER_MESHSIMPLIFIER_H__)
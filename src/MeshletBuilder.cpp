@@ -0,0 +1,172 @@
+#include "MeshletBuilder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+std::vector<MeshletBuilder::Meshlet> MeshletBuilder::build(std::vector<unsigned int> & ibo, const std::vector<glm::vec3> & positions, unsigned int maxVertices, unsigned int maxTriangles)
+{
+  const size_t nbTriangles = ibo.size() / 3;
+  const size_t nbVertices = positions.size();
+  std::vector<Meshlet> meshlets;
+  if (nbTriangles == 0) {
+    return meshlets;
+  }
+
+  // vertex to triangles adjacency
+  std::vector<unsigned int> offsets(nbVertices + 1, 0);
+  for (size_t k = 0; k < 3 * nbTriangles; k++) {
+    offsets[ibo[k] + 1]++;
+  }
+  for (size_t v = 0; v < nbVertices; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+  std::vector<unsigned int> adjacency(3 * nbTriangles);
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t k = 0; k < 3 * nbTriangles; k++) {
+    adjacency[fill[ibo[k]]++] = k / 3;
+  }
+
+  std::vector<bool> emitted(nbTriangles, false);
+  std::vector<unsigned int> stamps(nbVertices, 0); // 1 + index of the last meshlet referencing the vertex
+  std::vector<unsigned int> candidates;
+  std::vector<unsigned int> output;
+  output.reserve(3 * nbTriangles);
+  size_t cursor = 0; // seeds are taken in input order
+
+  while (true) {
+    while (cursor < nbTriangles and emitted[cursor]) {
+      cursor++;
+    }
+    if (cursor == nbTriangles) {
+      break;
+    }
+    Meshlet meshlet;
+    meshlet.firstTriangle = output.size() / 3;
+    meshlet.nbTriangles = 0;
+    meshlet.nbVertices = 0;
+    const unsigned int stamp = meshlets.size() + 1;
+    candidates.assign(1, cursor);
+
+    while (meshlet.nbTriangles < maxTriangles) {
+      // the candidate adding the fewest vertices, emitted candidates being removed on the fly
+      long best = -1;
+      unsigned int bestNew = 4;
+      for (size_t c = 0; c < candidates.size() and bestNew > 0;) {
+        unsigned int triangle = candidates[c];
+        if (emitted[triangle]) {
+          candidates[c] = candidates.back();
+          candidates.pop_back();
+          continue;
+        }
+        unsigned int nbNew = 0;
+        for (int i = 0; i < 3; i++) {
+          nbNew += stamps[ibo[3 * triangle + i]] != stamp;
+        }
+        if (nbNew < bestNew) {
+          bestNew = nbNew;
+          best = triangle;
+        }
+        c++;
+      }
+      if (best < 0) {
+        // the connected component is exhausted: continue with the next triangle in input order
+        while (cursor < nbTriangles and emitted[cursor]) {
+          cursor++;
+        }
+        if (cursor == nbTriangles) {
+          break;
+        }
+        best = cursor;
+        bestNew = 0;
+        for (int i = 0; i < 3; i++) {
+          bestNew += stamps[ibo[3 * cursor + i]] != stamp;
+        }
+      }
+      if (meshlet.nbVertices + bestNew > maxVertices) {
+        break;
+      }
+
+      emitted[best] = true;
+      meshlet.nbTriangles++;
+      for (int i = 0; i < 3; i++) {
+        unsigned int v = ibo[3 * best + i];
+        output.push_back(v);
+        if (stamps[v] == stamp) {
+          continue;
+        }
+        stamps[v] = stamp;
+        meshlet.nbVertices++;
+        for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++) {
+          if (not emitted[adjacency[a]]) {
+            candidates.push_back(adjacency[a]);
+          }
+        }
+      }
+    }
+    meshlets.push_back(meshlet);
+  }
+  ibo.swap(output);
+
+  for (Meshlet & meshlet : meshlets) {
+    computeBounds(meshlet, ibo, positions);
+  }
+  return meshlets;
+}
+
+void MeshletBuilder::computeBounds(Meshlet & meshlet, const std::vector<unsigned int> & ibo, const std::vector<glm::vec3> & positions)
+{
+  const size_t first = 3 * size_t(meshlet.firstTriangle);
+  const size_t last = first + 3 * size_t(meshlet.nbTriangles);
+
+  // bounding sphere centered on the bounding box
+  glm::vec3 lower = positions[ibo[first]];
+  glm::vec3 upper = lower;
+  for (size_t k = first; k < last; k++) {
+    lower = glm::min(lower, positions[ibo[k]]);
+    upper = glm::max(upper, positions[ibo[k]]);
+  }
+  meshlet.center = 0.5f * (lower + upper);
+  meshlet.radius = 0;
+  for (size_t k = first; k < last; k++) {
+    meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, positions[ibo[k]]));
+  }
+
+  // normal cone: the axis is the average unit normal, the spread the largest deviation from it
+  std::vector<std::pair<glm::vec3, glm::vec3>> planes; // a point and the unit normal of each triangle
+  planes.reserve(meshlet.nbTriangles);
+  glm::vec3 axis(0);
+  for (size_t k = first; k < last; k += 3) {
+    const glm::vec3 & p0 = positions[ibo[k]];
+    glm::vec3 n = glm::cross(positions[ibo[k + 1]] - p0, positions[ibo[k + 2]] - p0);
+    float length = glm::length(n);
+    if (length > 0) {
+      planes.push_back(std::make_pair(p0, n / length));
+      axis += n / length;
+    }
+  }
+  meshlet.coneApex = meshlet.center;
+  meshlet.coneAxis = glm::vec3(0, 0, 1);
+  meshlet.coneCutoff = 1;
+  float axisLength = glm::length(axis);
+  if (not(axisLength > 0)) {
+    return;
+  }
+  axis /= axisLength;
+  meshlet.coneAxis = axis;
+  float minDot = 1;
+  for (const auto & plane : planes) {
+    minDot = std::min(minDot, glm::dot(axis, plane.second));
+  }
+  // wide cones are useless, and their apex is unstable
+  if (minDot <= 0.1f) {
+    return;
+  }
+
+  // the apex is moved back along the axis until it is behind all the triangle planes
+  float maxT = 0;
+  for (const auto & plane : planes) {
+    maxT = std::max(maxT, glm::dot(meshlet.center - plane.first, plane.second) / glm::dot(axis, plane.second));
+  }
+  meshlet.coneApex = meshlet.center - maxT * axis;
+  meshlet.coneCutoff = std::sqrt(1 - minDot * minDot);
+}
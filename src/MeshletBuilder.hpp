@@ -0,0 +1,66 @@
+#ifndef __GLITTER_MESHLETBUILDER_H__
+#define __GLITTER_MESHLETBUILDER_H__
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief Partitions indexed triangle lists into small clusters (meshlets)
+ *
+ * The triangles of an IBO are reordered so that each meshlet is a contiguous
+ * range of the IBO, referencing at most maxVertices vertices. Meshlets are
+ * grown greedily from a seed triangle, adding first the adjacent triangles
+ * introducing the fewest new vertices; seeds follow the input order, so that
+ * the vertex cache order of the IBO is mostly preserved.
+ *
+ * Each meshlet has bounds for culling:
+ *	+ a bounding sphere, for frustum culling
+ *	+ a normal cone (Shirman and Abi-Ezzi), for backface culling of the whole
+ *	  meshlet: it is invisible when seen from inside the cone of apex coneApex,
+ *	  of axis -coneAxis and whose half-angle cosine is coneCutoff, i.e. when
+ *	  dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+ *
+ * @see MeshletCuller
+ */
+class MeshletBuilder {
+public:
+  /// @brief the default maximal number of vertices of a meshlet
+  static const unsigned int defaultMaxVertices = 64;
+
+  /// @brief the default maximal number of triangles of a meshlet
+  static const unsigned int defaultMaxTriangles = 124;
+
+  /**
+   * @brief A cluster of triangles, contiguous in its IBO
+   */
+  struct Meshlet {
+    unsigned int firstTriangle; ///< position of the first triangle in the IBO (in triangles)
+    unsigned int nbTriangles;   ///< number of triangles
+    unsigned int nbVertices;    ///< number of distinct vertices referenced
+    glm::vec3 center;           ///< bounding sphere center (object space)
+    float radius;               ///< bounding sphere radius (object space)
+    glm::vec3 coneApex;         ///< apex of the normal cone (object space)
+    glm::vec3 coneAxis;         ///< average normal of the triangles
+    float coneCutoff;           ///< sine of the normal cone spread, 1 when the meshlet cannot be backface culled
+  };
+
+  /**
+   * @brief builds the meshlets of a triangle list
+   * @param ibo the triangle list, reordered in place so that meshlets are contiguous
+   * @param positions the vertex positions
+   * @param maxVertices the maximal number of vertices of a meshlet
+   * @param maxTriangles the maximal number of triangles of a meshlet
+   * @return the meshlets, in IBO order
+   */
+  static std::vector<Meshlet> build(std::vector<unsigned int> & ibo, const std::vector<glm::vec3> & positions, unsigned int maxVertices = defaultMaxVertices,
+                                    unsigned int maxTriangles = defaultMaxTriangles);
+
+  /**
+   * @brief computes the bounding sphere and the normal cone of a meshlet
+   * @param meshlet the meshlet, whose range is already set
+   * @param ibo the triangle list
+   * @param positions the vertex positions
+   */
+  static void computeBounds(Meshlet & meshlet, const std::vector<unsigned int> & ibo, const std::vector<glm::vec3> & positions);
+};
+
+#endif // !defined(__GLITTER_MESHLETBUILDER_H__)
@@ -0,0 +1,71 @@
+#include "MeshletCuller.hpp"
+
+MeshletCuller::MeshletCuller(const glm::mat4 & modelViewProjection, const glm::vec3 & cameraInObject) : m_camera(cameraInObject)
+{
+  // rows of the matrix (glm matrices are column major)
+  glm::vec4 rows[4];
+  for (int r = 0; r < 4; r++) {
+    rows[r] = glm::vec4(modelViewProjection[0][r], modelViewProjection[1][r], modelViewProjection[2][r], modelViewProjection[3][r]);
+  }
+  for (int r = 0; r < 3; r++) {
+    m_planes[2 * r] = rows[3] + rows[r];
+    m_planes[2 * r + 1] = rows[3] - rows[r];
+  }
+  for (glm::vec4 & plane : m_planes) {
+    float length = glm::length(glm::vec3(plane));
+    if (length > 0) {
+      plane /= length;
+    }
+  }
+}
+
+bool MeshletCuller::visible(const MeshletBuilder::Meshlet & meshlet) const
+{
+  for (const glm::vec4 & plane : m_planes) {
+    if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+      return false;
+    }
+  }
+  if (meshlet.coneCutoff < 1) {
+    glm::vec3 direction = meshlet.coneApex - m_camera;
+    float distance = glm::length(direction);
+    if (distance > 0 and glm::dot(direction, meshlet.coneAxis) >= meshlet.coneCutoff * distance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t MeshletCuller::compact(const std::vector<MeshletBuilder::Meshlet> & meshlets, const std::vector<unsigned int> & ibo, std::vector<unsigned int> & indices) const
+{
+  indices.clear();
+  size_t nbVisible = 0;
+  for (const MeshletBuilder::Meshlet & meshlet : meshlets) {
+    if (visible(meshlet)) {
+      nbVisible++;
+      indices.insert(indices.end(), ibo.begin() + 3 * size_t(meshlet.firstTriangle), ibo.begin() + 3 * size_t(meshlet.firstTriangle + meshlet.nbTriangles));
+    }
+  }
+  return nbVisible;
+}
+
+size_t MeshletCuller::ranges(const std::vector<MeshletBuilder::Meshlet> & meshlets, std::vector<unsigned int> & firsts, std::vector<unsigned int> & counts) const
+{
+  firsts.clear();
+  counts.clear();
+  size_t nbVisible = 0;
+  for (const MeshletBuilder::Meshlet & meshlet : meshlets) {
+    if (not visible(meshlet)) {
+      continue;
+    }
+    nbVisible++;
+    const unsigned int first = 3 * meshlet.firstTriangle;
+    if (not firsts.empty() and firsts.back() + counts.back() == first) {
+      counts.back() += 3 * meshlet.nbTriangles;
+    } else {
+      firsts.push_back(first);
+      counts.push_back(3 * meshlet.nbTriangles);
+    }
+  }
+  return nbVisible;
+}
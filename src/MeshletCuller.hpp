@@ -0,0 +1,56 @@
+#ifndef __GLITTER_MESHLETCULLER_H__
+#define __GLITTER_MESHLETCULLER_H__
+#include <glm/glm.hpp>
+#include <vector>
+#include "MeshletBuilder.hpp"
+
+/**
+ * @brief CPU culling of meshlets against the view frustum and by normal cones
+ *
+ * The frustum planes are extracted from the model view projection matrix
+ * (Gribb and Hartmann), so that the tests are performed in object space,
+ * where the meshlet bounds are expressed.
+ *
+ * The visible meshlets are output either:
+ *	+ as a compacted index list, to be uploaded in a dynamic IBO and drawn with a single glDrawElements
+ *	+ as ranges of the original IBO (adjacent visible meshlets being merged), to be drawn with glMultiDrawElements
+ */
+class MeshletCuller {
+public:
+  /**
+   * @brief Constructor
+   * @param modelViewProjection the object to clip space transform
+   * @param cameraInObject the camera position in object space
+   */
+  MeshletCuller(const glm::mat4 & modelViewProjection, const glm::vec3 & cameraInObject);
+
+  /**
+   * @brief tests the bounds of a meshlet
+   * @return false if the meshlet is outside the frustum or all its triangles are backfacing
+   */
+  bool visible(const MeshletBuilder::Meshlet & meshlet) const;
+
+  /**
+   * @brief builds the index list of the visible meshlets
+   * @param meshlets the meshlets of @p ibo
+   * @param ibo the triangle list
+   * @param indices the indices of the visible triangles (previous content is discarded)
+   * @return the number of visible meshlets
+   */
+  size_t compact(const std::vector<MeshletBuilder::Meshlet> & meshlets, const std::vector<unsigned int> & ibo, std::vector<unsigned int> & indices) const;
+
+  /**
+   * @brief builds the ranges of the IBO covered by the visible meshlets
+   * @param meshlets the meshlets of the IBO
+   * @param firsts the first index of each range (previous content is discarded)
+   * @param counts the number of indices of each range (previous content is discarded)
+   * @return the number of visible meshlets
+   */
+  size_t ranges(const std::vector<MeshletBuilder::Meshlet> & meshlets, std::vector<unsigned int> & firsts, std::vector<unsigned int> & counts) const;
+
+private:
+  glm::vec4 m_planes[6]; ///< frustum planes (object space), normals pointing inwards
+  glm::vec3 m_camera;    ///< camera position (object space)
+};
+
+#endif // !defined(__GLITTER_MESHLETCULLER_H__)
@@ -1,10 +1,21 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "ObjLoader.hpp"
+#include "GlitterMesh.hpp"
+#include "MeshCache.hpp"
+#include "ObjParser.hpp"
 #include "Serialize.hpp"
+#include "TangentGenerator.hpp"
+#include "ThreadPool.hpp"
+#include "VertexWelder.hpp"
 #include "utils.hpp"
 
 static glm::vec3 calcNormal(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 & v2)
@@ -21,7 +32,13 @@ std::string ObjLoader::defaultNormalName = "OBL:default_normal";
 unsigned char ObjLoader::bluish[4] = {128, 128, 255, 255};
 unsigned char ObjLoader::white[4] = {255, 255, 255, 255};
 
-ObjLoader::ObjLoader(const std::string & filename)
+ObjLoader::Options::Options()
+    : parser(NativeParser), input(FileInput), nbThreads(1), weldVertices(true), tangents(TangentGenerator::FaceTangents), indexOrder(IndexOptimizer::FileOrder), nbLods(0), meshlets(false), images(true),
+      cacheCapacity(size_t(1) << 30)
+{
+}
+
+ObjLoader::ObjLoader(const std::string & filename, const Options & options) : m_options(options)
 {
   std::string absolutepath = absolutename(filename);
   m_rootDir = basename(absolutepath);
@@ -29,6 +46,8 @@ ObjLoader::ObjLoader(const std::string & filename)
   m_images.add(defaultNormalName, Image<>(bluish, 1, 1, 4));
   if (endsWith(absolutepath, ".glitter")) {
     loadBinaryFile(absolutepath);
+  } else if (not m_options.cacheDirectory.empty() and m_options.parser == Options::NativeParser) {
+    loadCachedFile(absolutepath);
   } else {
     parseFile(absolutepath);
   }
@@ -44,6 +63,16 @@ Image<> ObjLoader::image(const std::string & name) const
   return m_images[name];
 }
 
+std::vector<std::string> ObjLoader::imageNames() const
+{
+  return m_images.names();
+}
+
+const std::vector<std::string> & ObjLoader::sourceFiles() const
+{
+  return m_sourceFiles;
+}
+
 size_t ObjLoader::nbIBOs() const
 {
   return m_ibos.size();
@@ -74,36 +103,307 @@ const std::vector<glm::vec3> & ObjLoader::vertexTangents() const
   return m_vertexTangents;
 }
 
+std::vector<unsigned char> ObjLoader::interleavedVertices() const
+{
+  return VertexLayout::interleave(m_vertexPositions, m_vertexUVs, m_vertexNormals, m_vertexTangents);
+}
+
 const std::vector<unsigned int> & ObjLoader::ibo(unsigned int materialIndex) const
 {
   return m_ibos[materialIndex];
 }
 
-void ObjLoader::loadImage(std::string texture_filename)
+CompactIndices ObjLoader::compactIbo(unsigned int materialIndex) const
+{
+  return CompactIndices(m_ibos[materialIndex]);
+}
+
+size_t ObjLoader::nbLods(unsigned int materialIndex) const
+{
+  return 1 + (m_lods.empty() ? 0 : m_lods[materialIndex].size());
+}
+
+const std::vector<unsigned int> & ObjLoader::lodIbo(unsigned int materialIndex, unsigned int level) const
+{
+  return level == 0 ? m_ibos[materialIndex] : m_lods[materialIndex][level - 1].ibo;
+}
+
+float ObjLoader::lodError(unsigned int materialIndex, unsigned int level) const
+{
+  return level == 0 ? 0.f : m_lods[materialIndex][level - 1].error;
+}
+
+const std::vector<MeshletBuilder::Meshlet> & ObjLoader::meshlets(unsigned int materialIndex) const
+{
+  static const std::vector<MeshletBuilder::Meshlet> none;
+  return m_meshlets.empty() ? none : m_meshlets[materialIndex];
+}
+
+Image<> ObjLoader::loadImage(const std::string & texture_filename)
+{
+  Image<> image;
+  image.depth = 1;
+  image.data = stbi_load(texture_filename.c_str(), &image.width, &image.height, &image.channels, STBI_default);
+  return image;
+}
+
+ObjLoader::ImageDecodes ObjLoader::decodeImages(ThreadPool & pool) const
 {
-  std::string key = texture_filename;
-  if (texture_filename.length() > 0) {
-    // Only load the texture if it is not already loaded
-    if (not m_images.find(key)) {
-      texture_filename = m_rootDir + texture_filename;
+  ImageDecodes decodes;
+  std::unordered_set<std::string> submitted;
+  for (const SimpleMaterial & material : m_materials) {
+    for (const std::string * key : {&material.diffuseTexName, &material.normalTexName, &material.specularTexName}) {
+      // Only load the texture if it is not already loaded (or being loaded)
+      if (key->empty() or m_images.find(*key) or not submitted.insert(*key).second) {
+        continue;
+      }
+      std::string texture_filename = m_rootDir + *key;
       if (!fileExists(texture_filename)) {
         std::cerr << "Unable to find file: " << texture_filename << std::endl;
         exit(1);
       }
+      decodes.emplace_back(*key, pool.submit([texture_filename]() { return loadImage(texture_filename); }));
+    }
+  }
+  return decodes;
+}
 
-      Image<> image;
-      image.depth = 1;
-      image.data = stbi_load(texture_filename.c_str(), &image.width, &image.height, &image.channels, STBI_default);
-      if (!image.data) {
-        std::cerr << "Unable to load texture: " << texture_filename << std::endl;
-        exit(1);
-      }
-      m_images.add(key, image);
+void ObjLoader::addImages(ImageDecodes & decodes)
+{
+  // joined in submission order, so that the images are added as by a serial decoding
+  for (auto & decode : decodes) {
+    Image<> image = decode.second.get();
+    if (!image.data) {
+      std::cerr << "Unable to load texture: " << m_rootDir + decode.first << std::endl;
+      exit(1);
     }
+    m_images.add(decode.first, image);
+    m_sourceFiles.push_back(m_rootDir + decode.first);
   }
 }
 
 void ObjLoader::parseFile(const std::string & filename)
+{
+  // the textures are decoded in the background while the geometry is processed
+  ThreadPool pool(m_options.nbThreads);
+  ImageDecodes decodes;
+  bool welded = false;
+  switch (m_options.parser) {
+  case Options::TinyObjParser:
+    parseFileTinyObj(filename);
+    decodes = decodeImages(pool);
+    break;
+  case Options::NativeParser:
+  default:
+    welded = parseFileNative(filename, pool, decodes);
+    break;
+  }
+  if (not welded) {
+    computeTangents();
+    if (m_options.weldVertices) {
+      cleanUpDuplicates();
+    }
+  }
+  optimizeIndices(m_options.indexOrder);
+  if (m_options.meshlets) {
+    buildMeshlets();
+  }
+  if (m_options.nbLods > 0) {
+    generateLods(m_options.nbLods);
+  }
+  addImages(decodes);
+}
+
+void ObjLoader::generateLods(unsigned int nbLevels, float ratio)
+{
+  MeshSimplifier simplifier(m_vertexPositions);
+  m_lods.resize(m_ibos.size());
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    m_lods[k] = simplifier.buildChain(m_ibos[k], nbLevels, ratio);
+    if (m_options.indexOrder != IndexOptimizer::FileOrder) {
+      for (MeshSimplifier::Level & level : m_lods[k]) {
+        IndexOptimizer::optimizeVertexCache(level.ibo, m_vertexPositions.size());
+      }
+    }
+  }
+}
+
+void ObjLoader::buildMeshlets(unsigned int maxVertices, unsigned int maxTriangles)
+{
+  m_meshlets.resize(m_ibos.size());
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    m_meshlets[k] = MeshletBuilder::build(m_ibos[k], m_vertexPositions, maxVertices, maxTriangles);
+  }
+}
+
+void ObjLoader::optimizeIndices(IndexOptimizer::Order order)
+{
+  if (order == IndexOptimizer::FileOrder) {
+    return;
+  }
+  for (auto & ibo : m_ibos) {
+    std::vector<size_t> deadEnds;
+    IndexOptimizer::optimizeVertexCache(ibo, m_vertexPositions.size(), IndexOptimizer::defaultCacheSize, &deadEnds);
+    if (order == IndexOptimizer::OverdrawOrder) {
+      IndexOptimizer::optimizeOverdraw(ibo, deadEnds, m_vertexPositions);
+    }
+  }
+  for (auto & levels : m_lods) {
+    for (MeshSimplifier::Level & level : levels) {
+      IndexOptimizer::optimizeVertexCache(level.ibo, m_vertexPositions.size());
+    }
+  }
+  std::vector<unsigned int> remap;
+  IndexOptimizer::optimizeVertexFetch(m_ibos, m_vertexPositions.size(), remap);
+  for (auto & levels : m_lods) {
+    for (MeshSimplifier::Level & level : levels) {
+      for (unsigned int & index : level.ibo) {
+        index = remap[index];
+      }
+    }
+  }
+  IndexOptimizer::permute(m_vertexPositions, remap);
+  IndexOptimizer::permute(m_vertexNormals, remap);
+  IndexOptimizer::permute(m_vertexTangents, remap);
+  IndexOptimizer::permute(m_vertexColors, remap);
+  IndexOptimizer::permute(m_vertexUVs, remap);
+  // the meshlets no longer match the reordered triangles
+  if (not m_meshlets.empty()) {
+    buildMeshlets();
+  }
+}
+
+IndexOptimizer::Statistics ObjLoader::cacheStatistics(unsigned int cacheSize) const
+{
+  return IndexOptimizer::analyze(m_ibos, m_vertexPositions.size(), cacheSize);
+}
+
+void ObjLoader::addMaterial(SimpleMaterial material)
+{
+  if (not m_options.images) {
+    useDefaultTextures(material);
+  }
+  if (material.diffuseTexName.empty()) {
+    material.diffuseTexName = defaultDiffuseName;
+  }
+  if (material.normalTexName.empty()) {
+    material.normalTexName = defaultNormalName;
+  }
+  if (material.specularTexName.empty()) {
+    material.specularTexName = defaultDiffuseName;
+  }
+  m_materials.push_back(material);
+}
+
+bool ObjLoader::parseFileNative(const std::string & filename, ThreadPool & pool, ImageDecodes & decodes)
+{
+  ObjParser parser;
+  unsigned int nbThreads = m_options.nbThreads ? m_options.nbThreads : std::thread::hardware_concurrency();
+  if (not parser.parseFile(filename, m_rootDir, nbThreads)) {
+    exit(1);
+  }
+  m_sourceFiles = parser.materialLibraries();
+
+  // Loop over materials, the default material is added as the last one
+  for (const SimpleMaterial & material : parser.materials()) {
+    addMaterial(material);
+  }
+  SimpleMaterial defaultMaterial;
+  defaultMaterial.name = "default_material";
+  defaultMaterial.ambient = glm::vec3(0.1);
+  defaultMaterial.diffuse = glm::vec3(0.3);
+  defaultMaterial.specular = glm::vec3(0.2);
+  defaultMaterial.shininess = 1;
+  addMaterial(defaultMaterial);
+  decodes = decodeImages(pool);
+
+  const std::vector<glm::vec3> & positions = parser.positions();
+  const std::vector<glm::vec4> & colors = parser.colors();
+  const std::vector<glm::vec2> & uvs = parser.uvs();
+  const std::vector<glm::vec3> & normals = parser.normals();
+  const std::vector<ObjParser::Corner> & corners = parser.corners();
+  const std::vector<int> & triangleMaterials = parser.triangleMaterials();
+  const int defaultMaterialId = m_materials.size() - 1;
+
+  // Size the IBOs once for all
+  m_ibos.resize(m_materials.size());
+  std::vector<size_t> iboSizes(m_materials.size(), 0);
+  for (int materialId : triangleMaterials) {
+    iboSizes[(materialId < 0) ? defaultMaterialId : materialId] += 3;
+  }
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    m_ibos[k].reserve(iboSizes[k]);
+  }
+
+  // expands the corners of triangle t into the vertices [first, first + 3) of the attribute arrays
+  auto expandTriangle = [&](size_t t, size_t first, std::vector<glm::vec3> & vertexPositions, std::vector<glm::vec4> & vertexColors, std::vector<glm::vec2> & vertexUVs,
+                            std::vector<glm::vec3> & vertexNormals) {
+    bool hasNormals = true;
+    for (size_t c = 0; c < 3; c++) {
+      const ObjParser::Corner & corner = corners[3 * t + c];
+      vertexPositions[first + c] = positions[corner.position];
+      vertexColors[first + c] = colors.empty() ? glm::vec4(1) : colors[corner.position];
+      vertexUVs[first + c] = (corner.uv < 0) ? glm::vec2(0, 0) : uvs[corner.uv];
+      if (corner.normal < 0) {
+        hasNormals = false;
+      } else {
+        vertexNormals[first + c] = -normals[corner.normal];
+      }
+    }
+    // Compute the geometric normal if not specified.
+    if (not hasNormals) {
+      glm::vec3 normal = calcNormal(vertexPositions[first], vertexPositions[first + 1], vertexPositions[first + 2]);
+      vertexNormals[first] = vertexNormals[first + 1] = vertexNormals[first + 2] = normal;
+    }
+  };
+
+  const size_t nbTriangles = triangleMaterials.size();
+  if (m_options.weldVertices and m_options.tangents == TangentGenerator::FaceTangents) {
+    // The face tangents only depend on their triangle: the corners are expanded, given their tangents
+    // and welded by blocks, so that the unwelded vertices (one per corner) are never all held.
+    // The blocks being a multiple of the kernel width, the result is the one of the whole arrays.
+    const size_t blockTriangles = 4096;
+    TangentGenerator generator(m_options.tangents);
+    VertexWelder::Incremental welder;
+    std::vector<glm::vec3> blockPositions, blockNormals, blockTangents;
+    std::vector<glm::vec4> blockColors;
+    std::vector<glm::vec2> blockUVs;
+    for (size_t firstTriangle = 0; firstTriangle < nbTriangles; firstTriangle += blockTriangles) {
+      const size_t nbBlockCorners = 3 * (std::min(firstTriangle + blockTriangles, nbTriangles) - firstTriangle);
+      blockPositions.resize(nbBlockCorners);
+      blockColors.resize(nbBlockCorners);
+      blockUVs.resize(nbBlockCorners);
+      blockNormals.resize(nbBlockCorners);
+      for (size_t k = 0; k < nbBlockCorners; k += 3) {
+        expandTriangle(firstTriangle + k / 3, k, blockPositions, blockColors, blockUVs, blockNormals);
+      }
+      generator.compute(blockPositions, blockNormals, blockUVs, blockColors, blockTangents);
+      for (size_t k = 0; k < nbBlockCorners; k++) {
+        const int materialId = triangleMaterials[firstTriangle + k / 3];
+        m_ibos[(materialId < 0) ? defaultMaterialId : materialId].push_back(welder.add(blockPositions[k], blockNormals[k], blockTangents[k], blockColors[k], blockUVs[k]));
+      }
+    }
+    welder.release(m_vertexPositions, m_vertexNormals, m_vertexTangents, m_vertexColors, m_vertexUVs);
+    return true;
+  }
+
+  // one vertex per triangle corner, sized once for all
+  const size_t nbCorners = corners.size();
+  m_vertexPositions.resize(nbCorners);
+  m_vertexColors.resize(nbCorners);
+  m_vertexUVs.resize(nbCorners);
+  m_vertexNormals.resize(nbCorners);
+  for (size_t t = 0; t < nbTriangles; t++) {
+    const int materialId = (triangleMaterials[t] < 0) ? defaultMaterialId : triangleMaterials[t];
+    expandTriangle(t, 3 * t, m_vertexPositions, m_vertexColors, m_vertexUVs, m_vertexNormals);
+    for (size_t k = 3 * t; k < 3 * t + 3; k++) {
+      m_ibos[materialId].push_back(k);
+    }
+  }
+  return false;
+}
+
+void ObjLoader::parseFileTinyObj(const std::string & filename)
 {
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
@@ -133,13 +433,10 @@ void ObjLoader::parseFile(const std::string & filename)
     material.diffuse = *reinterpret_cast<glm::vec3 *>(mp->diffuse);
     material.specular = *reinterpret_cast<glm::vec3 *>(mp->specular);
     material.shininess = mp->shininess;
-    material.diffuseTexName = (mp->diffuse_texname != "") ? mp->diffuse_texname : defaultDiffuseName;
-    material.normalTexName = (mp->normal_texname != "") ? mp->normal_texname : defaultNormalName;
-    material.specularTexName = (mp->normal_texname != "") ? mp->specular_texname : defaultDiffuseName;
-    loadImage(mp->diffuse_texname);
-    loadImage(mp->normal_texname);
-    loadImage(mp->specular_texname);
-    m_materials.push_back(material);
+    material.diffuseTexName = mp->diffuse_texname;
+    material.normalTexName = mp->normal_texname;
+    material.specularTexName = mp->specular_texname;
+    addMaterial(material);
   }
 
   m_ibos.resize(m_materials.size());
@@ -197,14 +494,17 @@ void ObjLoader::parseFile(const std::string & filename)
       }
     }
   }
-  computeTangents();
-  cleanUpDuplicates();
 }
 
-void ObjLoader::saveBinaryFile(const std::string & filename) const
+void ObjLoader::saveBinaryFile(const std::string & filename, unsigned int version, bool compressed) const
 {
+  if (version >= 2) {
+    GlitterMesh::save(filename, *this, compressed);
+    return;
+  }
 #define GLITTER_BINFILE_MAGIC "GLITTER_BIN_OBJ\n"
-  std::ofstream file(filename.c_str());
+  FileSink sink(filename);
+  BufferedWriter file(sink);
   file.write(GLITTER_BINFILE_MAGIC, strlen(GLITTER_BINFILE_MAGIC));
 
   write(std::string("[VertexPositions]"), file);
@@ -218,12 +518,21 @@ void ObjLoader::saveBinaryFile(const std::string & filename) const
   write(std::string("[VertexTangents]"), file);
   write(m_vertexTangents, file);
 
-  write(std::string("[IBOS]"), file);
-  // IBOs
+  write(std::string("[CompactIBOs]"), file);
+  // IBOs, each one with its index size, base vertex and narrowed indices
   std::uint64_t count = m_ibos.size();
   write(count, file);
-  for (const IBO & ibo : m_ibos) {
-    write(ibo, file);
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    CompactIndices indices = compactIbo(k);
+    write(glm::uint32(indices.indexSize()), file);
+    write(glm::uint32(indices.baseVertex()), file);
+    if (indices.indexSize() == 1) {
+      write(indices.indices8(), file);
+    } else if (indices.indexSize() == 2) {
+      write(indices.indices16(), file);
+    } else {
+      write(indices.indices32(), file);
+    }
   }
 
   write(std::string("[NamedTextureImages]"), file);
@@ -261,11 +570,71 @@ void ObjLoader::saveBinaryFile(const std::string & filename) const
     write(material.normalTexName, file);
     write(material.specularTexName, file);
   }
+
+  // optional section, absent from the files written without levels of detail
+  if (not m_lods.empty()) {
+    write(std::string("[LODs]"), file);
+    count = m_lods.size();
+    write(count, file);
+    for (const auto & levels : m_lods) {
+      count = levels.size();
+      write(count, file);
+      for (const MeshSimplifier::Level & level : levels) {
+        write(level.error, file);
+        write(level.ibo, file);
+      }
+    }
+  }
+
+  // optional section, absent from the files written without meshlets
+  if (not m_meshlets.empty()) {
+    write(std::string("[Meshlets]"), file);
+    count = m_meshlets.size();
+    write(count, file);
+    for (const auto & meshlets : m_meshlets) {
+      std::vector<unsigned int> ranges; // first triangle, triangles, vertices
+      std::vector<glm::vec4> spheres;   // center, radius
+      std::vector<glm::vec4> cones;     // axis, cutoff
+      std::vector<glm::vec3> apexes;
+      for (const MeshletBuilder::Meshlet & meshlet : meshlets) {
+        ranges.insert(ranges.end(), {meshlet.firstTriangle, meshlet.nbTriangles, meshlet.nbVertices});
+        spheres.push_back(glm::vec4(meshlet.center, meshlet.radius));
+        cones.push_back(glm::vec4(meshlet.coneAxis, meshlet.coneCutoff));
+        apexes.push_back(meshlet.coneApex);
+      }
+      write(ranges, file);
+      write(spheres, file);
+      write(cones, file);
+      write(apexes, file);
+    }
+  }
 }
 
 void ObjLoader::loadBinaryFile(const std::string & filename)
 {
-  std::ifstream file(filename.c_str());
+  if (GlitterFile::isGlitterFile(filename)) {
+    if (not loadMappedFile(filename)) {
+      exit(1);
+    }
+    return;
+  }
+  std::ifstream stream;
+  std::unique_ptr<ByteSource> source;
+  switch (m_options.input) {
+  case Options::MappedInput:
+    source.reset(new MappedSource(filename));
+    break;
+  case Options::UringInput:
+    source.reset(new UringSource(filename));
+    break;
+  case Options::StreamInput:
+    stream.open(filename.c_str(), std::ios::binary);
+    source.reset(new StreamSource(stream));
+    break;
+  default:
+    source.reset(new FileSource(filename));
+  }
+  BufferedReader file(*source);
   char magicBuffer[255];
   memset(magicBuffer, 0, 255);
   file.read(magicBuffer, strlen(GLITTER_BINFILE_MAGIC));
@@ -294,13 +663,33 @@ void ObjLoader::loadBinaryFile(const std::string & filename)
   read(m_vertexTangents, file);
 
   read(magic, file);
-  assert((magic == "[IBOS]") && "ObjLoader::loadBinaryFile(): Tag not found");
-  // IBOs
+  assert((magic == "[IBOS]" or magic == "[CompactIBOs]") && "ObjLoader::loadBinaryFile(): Tag not found");
+  // IBOs (32-bit indices in the files written before CompactIndices)
   std::uint64_t count;
   read(count, file);
   m_ibos.resize(count);
   for (IBO & ibo : m_ibos) {
-    read(ibo, file);
+    if (magic == "[IBOS]") {
+      read(ibo, file);
+      continue;
+    }
+    glm::uint32 indexSize, baseVertex;
+    read(indexSize, file);
+    read(baseVertex, file);
+    if (indexSize == 1) {
+      std::vector<glm::uint8> indices;
+      read(indices, file);
+      ibo.assign(indices.begin(), indices.end());
+    } else if (indexSize == 2) {
+      std::vector<glm::uint16> indices;
+      read(indices, file);
+      ibo.assign(indices.begin(), indices.end());
+    } else {
+      read(ibo, file);
+    }
+    for (unsigned int & index : ibo) {
+      index += baseVertex;
+    }
   }
 
   read(magic, file);
@@ -323,6 +712,10 @@ void ObjLoader::loadBinaryFile(const std::string & filename)
     read(value, file);
     image.channels = value;
     size_t dataSize = image.width * image.height * image.depth * image.channels;
+    if (not m_options.images) {
+      file.skip(dataSize * sizeof(Image<>::value_type));
+      continue;
+    }
     image.data = new Image<>::value_type[dataSize];
     file.read(reinterpret_cast<char *>(image.data), dataSize * sizeof(Image<>::value_type));
     m_images.add(name, image);
@@ -344,148 +737,156 @@ void ObjLoader::loadBinaryFile(const std::string & filename)
     read(material.diffuseTexName, file);
     read(material.normalTexName, file);
     read(material.specularTexName, file);
+    if (not m_options.images) {
+      useDefaultTextures(material);
+    }
+  }
+
+  // optional sections
+  while (not file.atEnd()) {
+    read(magic, file);
+    if (magic == "[LODs]") {
+      read(count, file);
+      m_lods.resize(count);
+      for (auto & levels : m_lods) {
+        read(count, file);
+        levels.resize(count);
+        for (MeshSimplifier::Level & level : levels) {
+          read(level.error, file);
+          read(level.ibo, file);
+        }
+      }
+    } else if (magic == "[Meshlets]") {
+      read(count, file);
+      m_meshlets.resize(count);
+      for (auto & meshlets : m_meshlets) {
+        std::vector<unsigned int> ranges;
+        std::vector<glm::vec4> spheres;
+        std::vector<glm::vec4> cones;
+        std::vector<glm::vec3> apexes;
+        read(ranges, file);
+        read(spheres, file);
+        read(cones, file);
+        read(apexes, file);
+        assert(ranges.size() == 3 * apexes.size() and spheres.size() == apexes.size() and cones.size() == apexes.size() && "ObjLoader::loadBinaryFile(): Inconsistent meshlets");
+        meshlets.resize(apexes.size());
+        for (size_t m = 0; m < meshlets.size(); m++) {
+          meshlets[m].firstTriangle = ranges[3 * m];
+          meshlets[m].nbTriangles = ranges[3 * m + 1];
+          meshlets[m].nbVertices = ranges[3 * m + 2];
+          meshlets[m].center = glm::vec3(spheres[m]);
+          meshlets[m].radius = spheres[m].w;
+          meshlets[m].coneAxis = glm::vec3(cones[m]);
+          meshlets[m].coneCutoff = cones[m].w;
+          meshlets[m].coneApex = apexes[m];
+        }
+      }
+    } else {
+      assert(false && "ObjLoader::loadBinaryFile(): Unknown section");
+      break;
+    }
   }
 }
 
-void ObjLoader::computeTangents()
+bool ObjLoader::loadMappedFile(const std::string & filename)
 {
-  //! note: in barycentric form the tangent is parameterized as:
-  //! t = x0 + t1(x1-x0) + t2(x2-x0)
-  //! then to get t1 and t2, t is characterized by:
-  //! u(x0+t) = u(x_0)+1 and bilinear interp says that u(x0+t) = u(x_0) + t1\delta u1 + t2\delta u2
-  //! v(x0+t) = v(x_0) and bilinear interp says that v(x0+t) = v(x_0) + t1\delta v1 + t2\delta v2
-  //! Solving this 2x2 linear system with Cramer's rule gives:
-  //! t1 = det([1, delta u2; 0, delta v2]) /  det([delta u1, delta u2; delta v1, delta v2])
-  //! t2 = det([delta u1, 1; delta v1, 0]) /  det([delta u1, delta u2; delta v1, delta v2])
-  glm::vec3 tangent;
-  for (unsigned int i = 0; i < m_vertexPositions.size(); i += 3) {
-    glm::vec2 & uv0 = m_vertexUVs[i + 0];
-    glm::vec2 & uv1 = m_vertexUVs[i + 1];
-    glm::vec2 & uv2 = m_vertexUVs[i + 2];
-    // UV delta
-    glm::vec2 deltaUV1 = uv1 - uv0;
-    glm::vec2 deltaUV2 = uv2 - uv0;
-    float detDenom = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
-    if (detDenom != 0) {
-      // Shortcuts for m_vertexPositions
-      glm::vec3 & x0 = m_vertexPositions[i + 0];
-      glm::vec3 & x1 = m_vertexPositions[i + 1];
-      glm::vec3 & x2 = m_vertexPositions[i + 2];
-      // Edges of the triangle : postion delta
-      glm::vec3 deltaPos1 = x1 - x0;
-      glm::vec3 deltaPos2 = x2 - x0;
-      float r = 1.0f / detDenom;
-      tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+  m_mappedFile = std::make_shared<GlitterMesh>();
+  if (not m_mappedFile->open(filename, m_options.nbThreads)) {
+    m_mappedFile.reset();
+    return false;
+  }
+  const GlitterMesh & mesh = *m_mappedFile;
+  m_vertexPositions = mesh.vertexPositions().toVector();
+  m_vertexColors = mesh.vertexColors().toVector();
+  m_vertexUVs = mesh.vertexUVs().toVector();
+  m_vertexNormals = mesh.vertexNormals().toVector();
+  m_vertexTangents = mesh.vertexTangents().toVector();
+  m_ibos.resize(mesh.nbIBOs());
+  m_lods.clear();
+  m_meshlets.clear();
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    m_ibos[k] = mesh.compactIbo(k).expand();
+    if (mesh.nbLods(k) > 1) {
+      m_lods.resize(m_ibos.size());
+      for (unsigned int l = 1; l < mesh.nbLods(k); l++) {
+        MeshSimplifier::Level level;
+        level.ibo = mesh.lodIbo(k, l).expand();
+        level.error = mesh.lodError(k, l);
+        m_lods[k].push_back(level);
+      }
+    }
+    if (not mesh.meshlets(k).empty()) {
+      m_meshlets.resize(m_ibos.size());
+      m_meshlets[k] = mesh.meshlets(k).toVector();
     }
-    // Set the same tangent for all three vertices of the triangle.
-    m_vertexTangents.push_back(tangent);
-    m_vertexTangents.push_back(tangent);
-    m_vertexTangents.push_back(tangent);
   }
-
-  for (unsigned int i = 0; i < m_vertexPositions.size(); i += 1) {
-    glm::vec3 & n = m_vertexNormals[i];
-    glm::vec3 & t = m_vertexTangents[i];
-    // Gram-Schmidt orthogonalize
-    t = glm::normalize(t - n * glm::dot(n, t));
+  m_materials = mesh.materials();
+  if (not m_options.images) {
+    for (SimpleMaterial & material : m_materials) {
+      useDefaultTextures(material);
+    }
+    return true;
+  }
+  // the pixels are not copied: they stay in the mapping, which lives as long as the loader
+  for (const std::string & name : mesh.imageNames()) {
+    m_images.add(name, mesh.image(name), false);
   }
+  return true;
 }
 
-struct PackedVertexPNTCUV {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec3 tangent;
-  glm::vec4 color;
-  glm::vec2 uv;
-
-  PackedVertexPNTCUV(const glm::vec3 & position = glm::vec3(), const glm::vec3 & normal = glm::vec3(), const glm::vec3 & tangent = glm::vec3(), const glm::vec4 & color = glm::vec4(1),
-                     const glm::vec2 & uv = glm::vec2())
-      : position(position), normal(normal), tangent(tangent), color(color), uv(uv)
-  {
+void ObjLoader::loadCachedFile(const std::string & filename)
+{
+  MeshCache cache(m_options.cacheDirectory, m_options.cacheCapacity);
+  const std::string key = MeshCache::key(filename, optionsSignature());
+  const std::string cachedName = cache.find(key);
+  if (not cachedName.empty() and loadMappedFile(cachedName)) {
+    return;
   }
-  bool operator==(const PackedVertexPNTCUV & other) const
-  {
-    return is_near(position, other.position) and is_near(normal, other.normal) and is_near(tangent, other.tangent) and is_near(uv, other.uv) and is_near(color, other.color);
+  parseFile(filename);
+  if (cache.valid() and not key.empty()) {
+    saveBinaryFile(cache.temporaryName(key), 2);
+    cache.insert(key, m_sourceFiles);
   }
+}
 
-  static bool is_near(float v1, float v2, float epsilon = 1e-2) { return fabs(v1 - v2) < epsilon; }
-
-  static bool is_near(const glm::vec2 & vecA, const glm::vec2 & vecB) { return is_near(vecA[0], vecB[0]) and is_near(vecA[1], vecB[1]); }
-
-  static bool is_near(const glm::vec3 & vecA, const glm::vec3 & vecB) { return is_near(vecA[0], vecB[0]) and is_near(vecA[1], vecB[1]) and is_near(vecA[2], vecB[2]); }
+std::string ObjLoader::optionsSignature() const
+{
+  // the options changing the processed mesh (but not nbThreads, the parsing being deterministic)
+  std::ostringstream signature;
+  signature << "parser " << m_options.parser << " weld " << m_options.weldVertices << " tangents " << m_options.tangents << " order " << m_options.indexOrder << " lods "
+            << m_options.nbLods << " meshlets " << m_options.meshlets << " images " << m_options.images;
+  return signature.str();
+}
 
-  static bool is_near(const glm::vec4 & vecA, const glm::vec4 & vecB)
-  {
-    const float epsilon = 1 / 256.f;
-    return is_near(vecA[0], vecB[0], epsilon) and is_near(vecA[1], vecB[1], epsilon) and is_near(vecA[2], vecB[2], epsilon) and is_near(vecA[3], vecB[3], epsilon);
-  }
-};
+void ObjLoader::useDefaultTextures(SimpleMaterial & material)
+{
+  material.diffuseTexName = defaultDiffuseName;
+  material.normalTexName = defaultNormalName;
+  material.specularTexName = defaultDiffuseName;
+}
 
-// Template specialization of std::hash
-namespace std
+void ObjLoader::computeTangents()
 {
-template <> struct hash<PackedVertexPNTCUV> {
-public:
-  std::size_t operator()(const PackedVertexPNTCUV & v) const
-  {
-    std::size_t hashes[] = {std::hash<float>()(v.position.x), std::hash<float>()(v.position.y), std::hash<float>()(v.position.z), std::hash<float>()(v.normal.x),  std::hash<float>()(v.normal.y),
-                            std::hash<float>()(v.normal.z),   std::hash<float>()(v.tangent.x),  std::hash<float>()(v.tangent.y),  std::hash<float>()(v.tangent.z), std::hash<float>()(v.color.x),
-                            std::hash<float>()(v.color.y),    std::hash<float>()(v.color.z),    std::hash<float>()(v.color.w),    std::hash<float>()(v.uv.x),      std::hash<float>()(v.uv.y)};
-    std::size_t seed = 0;
-    for (std::size_t h : hashes) {
-      // from boost::hash_combine
-      seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-    }
-    return seed;
-  }
-};
-} // namespace std
+  TangentGenerator generator(m_options.tangents);
+  generator.compute(m_vertexPositions, m_vertexNormals, m_vertexUVs, m_vertexColors, m_vertexTangents);
+}
 
 void ObjLoader::cleanUpDuplicates()
 {
-  std::vector<unsigned int> cleanIBO;
-  std::vector<glm::vec3> cleanPositions;
-  std::vector<glm::vec3> cleanNormals;
-  std::vector<glm::vec3> cleanTangents;
-  std::vector<glm::vec4> cleanColors;
-  std::vector<glm::vec2> cleanUVs;
-  std::unordered_map<PackedVertexPNTCUV, size_t> uniqueVertexIndices;
-  std::vector<size_t> vertexNewIndices;
-  for (size_t k = 0; k < m_vertexPositions.size(); k++) {
-    const glm::vec3 & position = m_vertexPositions[k];
-    const glm::vec3 & normal = m_vertexNormals[k];
-    const glm::vec3 & tangent = m_vertexTangents[k];
-    const glm::vec4 & color = m_vertexColors[k];
-    const glm::vec2 & uv = m_vertexUVs[k];
-    PackedVertexPNTCUV vertex(position, normal, tangent, color, uv);
-    auto uniqueIndexIterator = uniqueVertexIndices.find(vertex);
-    bool found = (uniqueIndexIterator != uniqueVertexIndices.end());
-    if (found) {
-      size_t index = uniqueIndexIterator->second;
-      vertexNewIndices.push_back(index);
-    } else {
-      cleanPositions.push_back(position);
-      cleanNormals.push_back(normal);
-      cleanTangents.push_back(tangent);
-      cleanColors.push_back(color);
-      cleanUVs.push_back(uv);
-      size_t index = cleanPositions.size() - 1;
-      uniqueVertexIndices[vertex] = index;
-      vertexNewIndices.push_back(index);
-    }
-  }
+  VertexWelder welder;
+  std::vector<unsigned int> vertexNewIndices;
+  size_t nbWelded = welder.weld(m_vertexPositions, m_vertexNormals, m_vertexTangents, m_vertexColors, m_vertexUVs, vertexNewIndices);
+  // The IBOs are remapped, and the attributes are compacted in place (no copy)
   for (auto & ibo : m_ibos) {
-    std::vector<unsigned int> cleanIBO;
-    for (unsigned int oldIndex : ibo) {
-      cleanIBO.push_back(vertexNewIndices[oldIndex]);
+    for (unsigned int & index : ibo) {
+      index = vertexNewIndices[index];
     }
-    ibo = cleanIBO;
   }
-  m_vertexPositions = cleanPositions;
-  m_vertexNormals = cleanNormals;
-  m_vertexTangents = cleanTangents;
-  m_vertexColors = cleanColors;
-  m_vertexUVs = cleanUVs;
+  VertexWelder::compact(m_vertexPositions, vertexNewIndices, nbWelded);
+  VertexWelder::compact(m_vertexNormals, vertexNewIndices, nbWelded);
+  VertexWelder::compact(m_vertexTangents, vertexNewIndices, nbWelded);
+  VertexWelder::compact(m_vertexColors, vertexNewIndices, nbWelded);
+  VertexWelder::compact(m_vertexUVs, vertexNewIndices, nbWelded);
 }
 
 bool ObjLoader::NamedTextureImages::find(const std::string & name) const
@@ -493,9 +894,10 @@ bool ObjLoader::NamedTextureImages::find(const std::string & name) const
   return m_images.find(name) != m_images.end();
 }
 
-void ObjLoader::NamedTextureImages::add(const std::string & name, const Image<> & image)
+void ObjLoader::NamedTextureImages::add(const std::string & name, const Image<> & image, bool owned)
 {
   m_images[name] = image;
+  m_owned[name] = owned;
 }
 
 const Image<> & ObjLoader::NamedTextureImages::operator[](const std::string & name) const
@@ -511,7 +913,7 @@ const Image<> & ObjLoader::NamedTextureImages::operator[](const std::string & na
 ObjLoader::NamedTextureImages::~NamedTextureImages()
 {
   for (auto namedImage : m_images) {
-    if (namedImage.first == defaultDiffuseName or namedImage.first == defaultNormalName) {
+    if (namedImage.first == defaultDiffuseName or namedImage.first == defaultNormalName or not m_owned.at(namedImage.first)) {
       continue;
     }
     unsigned char * imgData = namedImage.second.data;
@@ -1,15 +1,26 @@
 #ifndef __GLITTER_OBJLOADER_H__
 #define __GLITTER_OBJLOADER_H__
+#include <future>
 #include <glm/glm.hpp>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include "AttributeProperties.hpp"
+#include "CompactIndices.hpp"
 #include "Image.hpp"
+#include "IndexOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshletBuilder.hpp"
 #include "SimpleMaterial.hpp"
+#include "TangentGenerator.hpp"
 #include "tiny_obj_loader.h"
 typedef unsigned int uint;
 
+// forward declarations
+class GlitterMesh;
+class ThreadPool;
+
 /**
  * @brief A facade class for loading wavefront files (.obj)
  *
@@ -31,20 +42,93 @@ typedef unsigned int uint;
  */
 class ObjLoader {
 public:
+  /**
+   * @brief The loading options
+   */
+  struct Options {
+    /// The wavefront parsers available
+    enum Parser
+    {
+      NativeParser, ///< single pass, in place tokenizer (see ObjParser)
+      TinyObjParser ///< legacy parser, going through the tinyobjloader structures
+    };
+
+    /// The ways of reading the legacy (version 1) .glitter files (see ByteStreams.hpp)
+    enum Input
+    {
+      MappedInput, ///< memory mapping, read without copy (see MappedSource)
+      FileInput,   ///< blocks read from a file descriptor (see FileSource)
+      UringInput,  ///< blocks read ahead with io_uring, on Linux (see UringSource)
+      StreamInput  ///< std::ifstream (see StreamSource)
+    };
+
+    /// @brief Default options
+    Options();
+
+    Parser parser;                    ///< the parser used for wavefront files (NativeParser by default)
+    Input input;                      ///< the way the version 1 .glitter files are read (FileInput by default)
+    unsigned int nbThreads;           ///< number of threads used by the native parser, the texture decoding and the .glitter decompression (1 by default, 0 for the hardware concurrency)
+    bool weldVertices;                ///< merges the near-identical vertices (true by default, see VertexWelder)
+    TangentGenerator::Mode tangents;  ///< per face or per welded vertex tangents (FaceTangents by default)
+    IndexOptimizer::Order indexOrder; ///< the order of the triangles in the IBOs (FileOrder by default)
+    unsigned int nbLods;              ///< number of levels of detail generated per IBO, besides the full resolution (0 by default)
+    bool meshlets;                    ///< partitions the IBOs into meshlets (false by default, see MeshletBuilder)
+    bool images;                      ///< loads the textures (true by default), the materials using the default ones otherwise
+    std::string cacheDirectory;       ///< directory of the cache of processed wavefront files (empty by default: no cache, see MeshCache), only used by the native parser
+    size_t cacheCapacity;             ///< maximal size of the cache, in bytes (1 GB by default)
+  };
+
   /**
    * @brief Constructor from a wavefront filename
    * @param filename the file to be parsed.
+   * @param options the loading options
    *
    * The parsing is performed at construction time.
    * Then all the exposed attributes are accessible through getters.
    */
-  ObjLoader(const std::string & filename);
+  ObjLoader(const std::string & filename, const Options & options = Options());
+
+  /**
+   * @brief Reorders the IBOs and the vertex attributes for the GPU vertex cache
+   * @param order the targeted index order (see IndexOptimizer)
+   *
+   * This is performed at construction time when Options::indexOrder is set.
+   */
+  void optimizeIndices(IndexOptimizer::Order order);
+
+  /**
+   * @brief Generates the levels of detail of each IBO (see MeshSimplifier)
+   * @param nbLevels the maximum number of levels, besides the full resolution
+   * @param ratio the ratio of triangles kept from one level to the next
+   *
+   * This is performed at construction time when Options::nbLods is set.
+   * The levels reference the same vertex attributes as the full resolution IBOs.
+   */
+  void generateLods(unsigned int nbLevels, float ratio = 0.5f);
+
+  /**
+   * @brief Partitions each IBO into meshlets (see MeshletBuilder)
+   * @param maxVertices the maximal number of vertices of a meshlet
+   * @param maxTriangles the maximal number of triangles of a meshlet
+   *
+   * This is performed at construction time when Options::meshlets is set.
+   * The triangles of the IBOs are reordered so that each meshlet is contiguous.
+   */
+  void buildMeshlets(unsigned int maxVertices = MeshletBuilder::defaultMaxVertices, unsigned int maxTriangles = MeshletBuilder::defaultMaxTriangles);
+
+  /**
+   * @brief Post-transform vertex cache statistics of the IBOs
+   * @param cacheSize the number of entries of the simulated FIFO cache
+   */
+  IndexOptimizer::Statistics cacheStatistics(unsigned int cacheSize = IndexOptimizer::defaultCacheSize) const;
 
   /**
    * @brief Serialize the object in a .glitter file.
    * @param filename
+   * @param version the file layout: 2 (memory-mappable chunks, see GlitterMesh) or 1 (legacy tagged sections)
+   * @param compressed if true, the chunks of a version 2 file are compressed, and decoded at loading instead of being mapped
    */
-  void saveBinaryFile(const std::string & filename) const;
+  void saveBinaryFile(const std::string & filename, unsigned int version = 2, bool compressed = false) const;
 
   /**
    * @brief getter for vertex positions
@@ -76,6 +160,17 @@ public:
    */
   const std::vector<glm::vec3> & vertexTangents() const;
 
+  /// Layout of the interleaved vertices: position, uv, normal and tangent (44 bytes)
+  typedef InterleavedLayout<glm::vec3, glm::vec2, glm::vec3, glm::vec3> VertexLayout;
+
+  /**
+   * @brief interleaved vertex attributes, to be sent with VAO::setInterleavedVBO<ObjLoader::VertexLayout>
+   * @return the vertices, VertexLayout::stride bytes each
+   *
+   * @note colors are left out, the shaders not using them.
+   */
+  std::vector<unsigned char> interleavedVertices() const;
+
   /**
    * @brief getter for a given IBO
    * @param materialIndex index of the material associated with the desired IBO.
@@ -83,6 +178,41 @@ public:
    */
   const std::vector<unsigned int> & ibo(unsigned int materialIndex = 0) const;
 
+  /**
+   * @brief a given IBO with the narrowest index type addressing its vertices
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the indices, relative to their base vertex
+   */
+  CompactIndices compactIbo(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief number of levels of detail of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the number of levels, including the full resolution (level 0)
+   */
+  size_t nbLods(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief getter for a level of detail of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @param level the level of detail (0 is the full resolution, i.e. ibo(materialIndex))
+   */
+  const std::vector<unsigned int> & lodIbo(unsigned int materialIndex, unsigned int level) const;
+
+  /**
+   * @brief getter for the geometric error of a level of detail (object space distance)
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @param level the level of detail (the full resolution having no error)
+   */
+  float lodError(unsigned int materialIndex, unsigned int level) const;
+
+  /**
+   * @brief getter for the meshlets of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the meshlets, empty if they were not built
+   */
+  const std::vector<MeshletBuilder::Meshlet> & meshlets(unsigned int materialIndex = 0) const;
+
   /**
    * @brief getter for the materials
    * @return the list of materials.
@@ -96,6 +226,18 @@ public:
    */
   Image<> image(const std::string & name) const;
 
+  /**
+   * @brief getter for the names of the images
+   * @return the aliases of all the images, including the default ones
+   */
+  std::vector<std::string> imageNames() const;
+
+  /**
+   * @brief getter for the files read besides the wavefront file
+   * @return the material libraries and the textures (including the missing material libraries)
+   */
+  const std::vector<std::string> & sourceFiles() const;
+
   /**
    * @brief provides the number of IBOs available after parsing
    * @return the number of IBOS.
@@ -109,22 +251,30 @@ private:
     NamedTextureImages(const NamedTextureImages &) = delete;
     NamedTextureImages & operator=(const NamedTextureImages &) = delete;
     bool find(const std::string & name) const;
-    void add(const std::string & name, const Image<> & image);
+    void add(const std::string & name, const Image<> & image, bool owned = true);
     const Image<> & operator[](const std::string & name) const;
     ~NamedTextureImages();
     std::vector<std::string> names() const;
 
   private:
     std::unordered_map<std::string, Image<>> m_images;
+    std::unordered_map<std::string, bool> m_owned; ///< whether the pixels of each image are freed with the images
   };
 
 private:
   void parseFile(const std::string & filename);
+  void parseFileTinyObj(const std::string & filename);
+  void addMaterial(SimpleMaterial material);
   void loadBinaryFile(const std::string & filename);
+  bool loadMappedFile(const std::string & filename);
+  void loadCachedFile(const std::string & filename);
+  std::string optionsSignature() const;
+  static void useDefaultTextures(SimpleMaterial & material);
   void cleanUpDuplicates();
   void computeTangents();
 
 private:
+  Options m_options;
   std::string m_rootDir;
   std::vector<glm::vec3> m_vertexPositions;
   std::vector<glm::vec4> m_vertexColors;
@@ -133,9 +283,22 @@ private:
   std::vector<glm::vec3> m_vertexTangents;
   typedef std::vector<unsigned int> IBO;
   std::vector<IBO> m_ibos;
+  std::vector<std::vector<MeshSimplifier::Level>> m_lods;       ///< levels of detail of each IBO (empty, or one entry per IBO)
+  std::vector<std::vector<MeshletBuilder::Meshlet>> m_meshlets; ///< meshlets of each IBO (empty, or one entry per IBO)
   NamedTextureImages m_images;
+  std::shared_ptr<GlitterMesh> m_mappedFile; ///< the .glitter v2 file the images point into
   std::vector<SimpleMaterial> m_materials;
-  void loadImage(std::string texture_filename);
+  std::vector<std::string> m_sourceFiles; ///< the files read besides the wavefront file (material libraries, textures), on which a cache entry depends
+  /// The textures being decoded, with their names
+  typedef std::vector<std::pair<std::string, std::future<Image<>>>> ImageDecodes;
+  /// @brief decodes a texture (the data being null on failure)
+  static Image<> loadImage(const std::string & texture_filename);
+  /// @brief submits the decoding of the textures of the materials not loaded yet, each texture once
+  ImageDecodes decodeImages(ThreadPool & pool) const;
+  /// @brief waits for the decoded textures and adds them to the images
+  void addImages(ImageDecodes & decodes);
+  /// @brief parses with ObjParser, submitting the decoding of the textures once the materials are known, true if the vertices were welded (and given their tangents)
+  bool parseFileNative(const std::string & filename, ThreadPool & pool, ImageDecodes & decodes);
   static unsigned char white[4];
   static unsigned char bluish[4];
   static std::string defaultDiffuseName;
@@ -0,0 +1,624 @@
+#include "ObjParser.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "ThreadPool.hpp"
+
+/*
+ * Low level tokenizing helpers.
+ *
+ * The parsed buffers always end with "\n\0", so that scanning a line never
+ * needs to check for the end of the buffer: a line ends at the first '\n'.
+ */
+static inline bool isSpace(char c)
+{
+  return c == ' ' or c == '\t' or c == '\r';
+}
+
+static inline bool isEndOfLine(char c)
+{
+  return c == '\n' or c == '\0';
+}
+
+static inline bool isDigit(char c)
+{
+  return c >= '0' and c <= '9';
+}
+
+static inline void skipSpaces(const char *& p)
+{
+  while (isSpace(*p)) {
+    ++p;
+  }
+}
+
+static inline void skipLine(const char *& p)
+{
+  while (not isEndOfLine(*p)) {
+    ++p;
+  }
+}
+
+static inline bool startsWithToken(const char * p, const char * token)
+{
+  while (*token) {
+    if (*p++ != *token++) {
+      return false;
+    }
+  }
+  return isSpace(*p) or isEndOfLine(*p);
+}
+
+/// reads a (possibly signed) integer, returns false if no digit was found
+static inline bool parseInt(const char *& p, int & value)
+{
+  bool negative = false;
+  if (*p == '-' or *p == '+') {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (not isDigit(*p)) {
+    return false;
+  }
+  int result = 0;
+  while (isDigit(*p)) {
+    result = 10 * result + (*p - '0');
+    ++p;
+  }
+  value = negative ? -result : result;
+  return true;
+}
+
+/// reads a floating point value, returns false if no number was found
+static inline bool parseReal(const char *& p, float & value)
+{
+  static const double powersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char * start = p;
+  bool negative = false;
+  if (*p == '-' or *p == '+') {
+    negative = (*p == '-');
+    ++p;
+  }
+  std::uint64_t mantissa = 0;
+  int significantDigits = 0;
+  int exponent = 0;
+  bool hasDigits = false;
+  for (; isDigit(*p); ++p) {
+    hasDigits = true;
+    if (significantDigits < 19) {
+      mantissa = 10 * mantissa + (*p - '0');
+      significantDigits += (mantissa != 0);
+    } else {
+      ++exponent;
+    }
+  }
+  if (*p == '.') {
+    for (++p; isDigit(*p); ++p) {
+      hasDigits = true;
+      if (significantDigits < 19) {
+        mantissa = 10 * mantissa + (*p - '0');
+        significantDigits += (mantissa != 0);
+        --exponent;
+      }
+    }
+  }
+  if (not hasDigits) {
+    // nan and inf spellings are left to the C library
+    if (*p != 'n' and *p != 'N' and *p != 'i' and *p != 'I') {
+      p = start;
+      return false;
+    }
+    char * stop;
+    value = std::strtof(start, &stop);
+    p = (stop != start) ? stop : start;
+    return stop != start;
+  }
+  if (*p == 'e' or *p == 'E') {
+    const char * exponentStart = p++;
+    int explicitExponent;
+    if (parseInt(p, explicitExponent)) {
+      exponent += explicitExponent;
+    } else {
+      p = exponentStart;
+    }
+  }
+  double result = static_cast<double>(mantissa);
+  if (exponent < 0) {
+    result = (exponent >= -22) ? result / powersOf10[-exponent] : result * std::pow(10., exponent);
+  } else if (exponent > 0) {
+    result = (exponent <= 22) ? result * powersOf10[exponent] : result * std::pow(10., exponent);
+  }
+  value = static_cast<float>(negative ? -result : result);
+  return true;
+}
+
+static inline void parseVec3(const char *& p, glm::vec3 & v)
+{
+  for (int k = 0; k < 3; k++) {
+    skipSpaces(p);
+    if (not parseReal(p, v[k])) {
+      v[k] = 0;
+    }
+  }
+}
+
+/// reads the remainder of the line, stripped from its surrounding spaces
+static inline std::string parseRestOfLine(const char *& p)
+{
+  skipSpaces(p);
+  const char * begin = p;
+  skipLine(p);
+  const char * end = p;
+  while (end > begin and isSpace(end[-1])) {
+    --end;
+  }
+  return std::string(begin, end);
+}
+
+/// reads the last token of the line (texture statements may start with options such as -bm 0.5)
+static inline std::string parseLastToken(const char *& p)
+{
+  std::string line = parseRestOfLine(p);
+  size_t pos = line.find_last_of(" \t");
+  return (pos == std::string::npos) ? line : line.substr(pos + 1);
+}
+
+ObjParser::ObjParser() : m_buffer(nullptr) {}
+
+ObjParser::Chunk::Chunk() : error(nullptr) {}
+
+const std::vector<glm::vec3> & ObjParser::positions() const
+{
+  return m_positions;
+}
+
+const std::vector<glm::vec4> & ObjParser::colors() const
+{
+  return m_colors;
+}
+
+const std::vector<glm::vec2> & ObjParser::uvs() const
+{
+  return m_uvs;
+}
+
+const std::vector<glm::vec3> & ObjParser::normals() const
+{
+  return m_normals;
+}
+
+const std::vector<ObjParser::Corner> & ObjParser::corners() const
+{
+  return m_corners;
+}
+
+const std::vector<int> & ObjParser::triangleMaterials() const
+{
+  return m_triangleMaterials;
+}
+
+const std::vector<SimpleMaterial> & ObjParser::materials() const
+{
+  return m_materials;
+}
+
+const std::vector<std::string> & ObjParser::materialLibraries() const
+{
+  return m_materialLibraries;
+}
+
+bool ObjParser::readFile(const std::string & filename, std::vector<char> & buffer)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  if (not file) {
+    return false;
+  }
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  file.seekg(0, std::ios::beg);
+  buffer.resize(static_cast<size_t>(size) + 2);
+  file.read(buffer.data(), size);
+  buffer[size] = '\n';
+  buffer[size + 1] = '\0';
+  return static_cast<bool>(file);
+}
+
+ObjParser::RecordCount ObjParser::countRecords(const char * begin, const char * end)
+{
+  RecordCount count = {0, 0, 0, 0};
+  const char * p = begin;
+  while (p < end) {
+    skipSpaces(p);
+    if (p[0] == 'v') {
+      if (isSpace(p[1])) {
+        count.positions++;
+      } else if (p[1] == 't' and isSpace(p[2])) {
+        count.uvs++;
+      } else if (p[1] == 'n' and isSpace(p[2])) {
+        count.normals++;
+      }
+    } else if (p[0] == 'f' and isSpace(p[1])) {
+      // count the corners of the polygon: a fan of n corners holds n-2 triangles
+      size_t nbCorners = 0;
+      ++p;
+      while (true) {
+        skipSpaces(p);
+        if (isEndOfLine(*p)) {
+          break;
+        }
+        nbCorners++;
+        while (not isSpace(*p) and not isEndOfLine(*p)) {
+          ++p;
+        }
+      }
+      if (nbCorners >= 3) {
+        count.triangles += nbCorners - 2;
+      }
+    }
+    skipLine(p);
+    ++p;
+  }
+  return count;
+}
+
+bool ObjParser::parseFile(const std::string & filename, const std::string & rootDir, unsigned int nbThreads)
+{
+  m_filename = filename;
+  m_rootDir = rootDir;
+  std::vector<char> buffer;
+  if (not readFile(filename, buffer)) {
+    std::cerr << "Unable to read file: " << filename << std::endl;
+    return false;
+  }
+  m_buffer = buffer.data();
+  const char * begin = buffer.data();
+  const char * end = begin + buffer.size() - 1; // do not parse the final '\0'
+
+  // Split the buffer in line-aligned chunks, a few per thread to balance the load
+  const size_t minChunkSize = 1 << 16;
+  const size_t size = end - begin;
+  const size_t nbChunks = (nbThreads <= 1) ? 1 : std::min<size_t>(4 * nbThreads, size / minChunkSize + 1);
+  std::vector<const char *> bounds(nbChunks + 1, end);
+  bounds[0] = begin;
+  for (size_t k = 1; k < nbChunks; k++) {
+    const char * p = std::max(bounds[k - 1], begin + k * (size / nbChunks));
+    const char * newLine = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    bounds[k] = newLine ? newLine + 1 : end;
+  }
+
+  std::vector<Chunk> chunks(nbChunks);
+  bool success;
+  if (nbChunks == 1) {
+    parseChunk(begin, end, chunks[0]);
+    success = stitch(chunks, nullptr);
+  } else {
+    ThreadPool pool(nbThreads);
+    pool.parallelFor(nbChunks, [&](size_t k) { parseChunk(bounds[k], bounds[k + 1], chunks[k]); });
+    success = stitch(chunks, &pool);
+  }
+  m_buffer = nullptr;
+  return success;
+}
+
+void ObjParser::parseChunk(const char * begin, const char * end, Chunk & chunk)
+{
+  RecordCount count = countRecords(begin, end);
+  chunk.positions.reserve(count.positions);
+  chunk.uvs.reserve(count.uvs);
+  chunk.normals.reserve(count.normals);
+  chunk.corners.reserve(3 * count.triangles);
+
+  std::vector<PolygonCorner> polygon;
+  const char * p = begin;
+  while (p < end) {
+    const char * line = p;
+    skipSpaces(p);
+    if (p[0] == 'v' and isSpace(p[1])) {
+      p += 1;
+      glm::vec3 position;
+      parseVec3(p, position);
+      chunk.positions.push_back(position);
+      // optional vertex color
+      glm::vec4 color(1);
+      int nbComponents = 0;
+      skipSpaces(p);
+      while (nbComponents < 4 and parseReal(p, color[nbComponents])) {
+        nbComponents++;
+        skipSpaces(p);
+      }
+      if (nbComponents >= 3) {
+        if (chunk.colors.empty()) {
+          chunk.colors.reserve(chunk.positions.capacity());
+        }
+        chunk.colors.resize(chunk.positions.size() - 1, glm::vec4(1));
+        chunk.colors.push_back(color);
+      }
+    } else if (p[0] == 'v' and p[1] == 't' and isSpace(p[2])) {
+      p += 2;
+      glm::vec2 uv;
+      for (int k = 0; k < 2; k++) {
+        skipSpaces(p);
+        if (not parseReal(p, uv[k])) {
+          uv[k] = 0;
+        }
+      }
+      chunk.uvs.push_back(uv);
+    } else if (p[0] == 'v' and p[1] == 'n' and isSpace(p[2])) {
+      p += 2;
+      glm::vec3 normal;
+      parseVec3(p, normal);
+      chunk.normals.push_back(normal);
+    } else if (p[0] == 'f' and isSpace(p[1])) {
+      p += 1;
+      if (not parseFace(p, chunk, polygon)) {
+        chunk.error = line;
+        return;
+      }
+    } else if (startsWithToken(p, "usemtl")) {
+      p += 6;
+      MaterialRun run = {chunk.corners.size() / 3, parseRestOfLine(p)};
+      chunk.materialRuns.push_back(run);
+    } else if (startsWithToken(p, "mtllib")) {
+      p += 6;
+      parseMaterialLibraries(p, chunk);
+    }
+    skipLine(p);
+    ++p;
+  }
+}
+
+bool ObjParser::parseFace(const char *& p, Chunk & chunk, std::vector<PolygonCorner> & polygon)
+{
+  const size_t poolSizes[3] = {chunk.positions.size(), chunk.uvs.size(), chunk.normals.size()};
+  polygon.clear();
+  while (true) {
+    skipSpaces(p);
+    if (isEndOfLine(*p)) {
+      break;
+    }
+    // v, v/vt, v//vn or v/vt/vn (0 stands for a missing index)
+    int raw[3] = {0, 0, 0};
+    if (not parseInt(p, raw[0]) or raw[0] == 0) {
+      return false;
+    }
+    if (*p == '/') {
+      ++p;
+      if (*p != '/' and (not parseInt(p, raw[1]) or raw[1] == 0)) {
+        return false;
+      }
+      if (*p == '/') {
+        ++p;
+        if (not parseInt(p, raw[2]) or raw[2] == 0) {
+          return false;
+        }
+      }
+    }
+    if (not isSpace(*p) and not isEndOfLine(*p)) {
+      return false;
+    }
+    // OBJ indices are 1-based, negative values are relative to the current end of the pool
+    PolygonCorner polygonCorner;
+    polygonCorner.relativeMask = 0;
+    int * indices[3] = {&polygonCorner.corner.position, &polygonCorner.corner.uv, &polygonCorner.corner.normal};
+    for (int k = 0; k < 3; k++) {
+      if (raw[k] > 0) {
+        *indices[k] = raw[k] - 1;
+      } else if (raw[k] < 0) {
+        *indices[k] = static_cast<int>(poolSizes[k]) + raw[k];
+        polygonCorner.relativeMask |= 1u << k;
+      } else {
+        *indices[k] = -1;
+      }
+    }
+    polygon.push_back(polygonCorner);
+  }
+  // triangulate the polygon as a fan
+  for (size_t k = 1; k + 1 < polygon.size(); k++) {
+    const PolygonCorner * triangle[3] = {&polygon[0], &polygon[k], &polygon[k + 1]};
+    for (const PolygonCorner * polygonCorner : triangle) {
+      for (unsigned int a = 0; a < 3; a++) {
+        if (polygonCorner->relativeMask & (1u << a)) {
+          chunk.relativeSlots.push_back(3 * chunk.corners.size() + a);
+        }
+      }
+      chunk.corners.push_back(polygonCorner->corner);
+    }
+  }
+  return true;
+}
+
+void ObjParser::parseMaterialLibraries(const char *& p, Chunk & chunk)
+{
+  while (true) {
+    skipSpaces(p);
+    if (isEndOfLine(*p)) {
+      break;
+    }
+    const char * begin = p;
+    while (not isSpace(*p) and not isEndOfLine(*p)) {
+      ++p;
+    }
+    chunk.materialLibraries.push_back(std::string(begin, p));
+  }
+}
+
+size_t ObjParser::lineNumber(const char * position) const
+{
+  return std::count(m_buffer, position, '\n') + 1;
+}
+
+bool ObjParser::stitch(std::vector<Chunk> & chunks, ThreadPool * pool)
+{
+  const size_t nbChunks = chunks.size();
+  // errors are reported on the first ill-formed line of the file
+  for (const Chunk & chunk : chunks) {
+    if (chunk.error) {
+      std::cerr << m_filename << ":" << lineNumber(chunk.error) << ": ill-formed face" << std::endl;
+      return false;
+    }
+  }
+
+  // Material libraries, in order of appearance
+  for (const Chunk & chunk : chunks) {
+    for (const std::string & library : chunk.materialLibraries) {
+      m_materialLibraries.push_back(m_rootDir + library);
+      parseMaterialFile(m_rootDir + library);
+    }
+  }
+
+  // Offsets of each chunk in the stitched pools
+  struct Offsets {
+    size_t positions;
+    size_t uvs;
+    size_t normals;
+    size_t corners;
+  };
+  std::vector<Offsets> offsets(nbChunks + 1);
+  offsets[0] = {0, 0, 0, 0};
+  bool hasColors = false;
+  for (size_t k = 0; k < nbChunks; k++) {
+    offsets[k + 1].positions = offsets[k].positions + chunks[k].positions.size();
+    offsets[k + 1].uvs = offsets[k].uvs + chunks[k].uvs.size();
+    offsets[k + 1].normals = offsets[k].normals + chunks[k].normals.size();
+    offsets[k + 1].corners = offsets[k].corners + chunks[k].corners.size();
+    hasColors = hasColors or not chunks[k].colors.empty();
+  }
+  const Offsets & totals = offsets[nbChunks];
+
+  // Triangle materials: a chunk starts with the last material of the previous one
+  m_triangleMaterials.resize(totals.corners / 3);
+  int currentMaterial = -1;
+  for (size_t k = 0; k < nbChunks; k++) {
+    std::vector<int>::iterator first = m_triangleMaterials.begin() + offsets[k].corners / 3;
+    std::vector<int>::iterator last = m_triangleMaterials.begin() + offsets[k + 1].corners / 3;
+    for (const MaterialRun & run : chunks[k].materialRuns) {
+      std::fill(first, m_triangleMaterials.begin() + offsets[k].corners / 3 + run.firstTriangle, currentMaterial);
+      first = m_triangleMaterials.begin() + offsets[k].corners / 3 + run.firstTriangle;
+      auto found = m_materialIndices.find(run.name);
+      currentMaterial = (found != m_materialIndices.end()) ? found->second : -1;
+    }
+    std::fill(first, last, currentMaterial);
+  }
+
+  // Gather the pools, and turn the chunk-relative indices into absolute ones
+  if (nbChunks == 1) {
+    m_positions.swap(chunks[0].positions);
+    m_uvs.swap(chunks[0].uvs);
+    m_normals.swap(chunks[0].normals);
+    m_corners.swap(chunks[0].corners);
+  } else {
+    m_positions.resize(totals.positions);
+    m_uvs.resize(totals.uvs);
+    m_normals.resize(totals.normals);
+    m_corners.resize(totals.corners);
+  }
+  if (hasColors) {
+    m_colors.resize(totals.positions, glm::vec4(1));
+  }
+  std::vector<char> valid(nbChunks, true);
+  auto gather = [&](size_t k) {
+    Chunk & chunk = chunks[k];
+    const Offsets & offset = offsets[k];
+    if (nbChunks > 1) {
+      std::copy(chunk.positions.begin(), chunk.positions.end(), m_positions.begin() + offset.positions);
+      std::copy(chunk.uvs.begin(), chunk.uvs.end(), m_uvs.begin() + offset.uvs);
+      std::copy(chunk.normals.begin(), chunk.normals.end(), m_normals.begin() + offset.normals);
+      std::copy(chunk.corners.begin(), chunk.corners.end(), m_corners.begin() + offset.corners);
+    }
+    std::copy(chunk.colors.begin(), chunk.colors.end(), m_colors.begin() + offset.positions);
+    const int bases[3] = {static_cast<int>(offset.positions), static_cast<int>(offset.uvs), static_cast<int>(offset.normals)};
+    for (size_t slot : chunk.relativeSlots) {
+      Corner & corner = m_corners[offset.corners + slot / 3];
+      int * indices[3] = {&corner.position, &corner.uv, &corner.normal};
+      int & index = *indices[slot % 3];
+      index += bases[slot % 3];
+      if (index < 0) {
+        valid[k] = false;
+      }
+    }
+    valid[k] = valid[k] and checkIndices(offset.corners, offsets[k + 1].corners);
+    chunk = Chunk();
+  };
+  if (pool) {
+    pool->parallelFor(nbChunks, gather);
+  } else {
+    gather(0);
+  }
+  if (std::find(valid.begin(), valid.end(), false) != valid.end()) {
+    std::cerr << m_filename << ": face index out of range" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ObjParser::checkIndices(size_t begin, size_t end) const
+{
+  const int nbPositions = m_positions.size();
+  const int nbUVs = m_uvs.size();
+  const int nbNormals = m_normals.size();
+  for (size_t k = begin; k < end; k++) {
+    const Corner & corner = m_corners[k];
+    if (corner.position < 0 or corner.position >= nbPositions or corner.uv < -1 or corner.uv >= nbUVs or corner.normal < -1 or corner.normal >= nbNormals) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ObjParser::parseMaterialFile(const std::string & filename)
+{
+  std::vector<char> buffer;
+  if (not readFile(filename, buffer)) {
+    std::cerr << "Material file [ " << filename << " ] not found." << std::endl;
+    return;
+  }
+  SimpleMaterial * material = nullptr;
+  const char * p = buffer.data();
+  const char * end = p + buffer.size() - 1;
+  while (p < end) {
+    skipSpaces(p);
+    if (startsWithToken(p, "newmtl")) {
+      p += 6;
+      SimpleMaterial newMaterial;
+      newMaterial.name = parseRestOfLine(p);
+      newMaterial.ambient = glm::vec3(0);
+      newMaterial.diffuse = glm::vec3(0);
+      newMaterial.specular = glm::vec3(0);
+      newMaterial.shininess = 1;
+      m_materialIndices[newMaterial.name] = static_cast<int>(m_materials.size());
+      m_materials.push_back(newMaterial);
+      material = &m_materials.back();
+    } else if (material == nullptr) {
+      // statements before the first newmtl are ignored
+    } else if (startsWithToken(p, "Ka")) {
+      p += 2;
+      parseVec3(p, material->ambient);
+    } else if (startsWithToken(p, "Kd")) {
+      p += 2;
+      parseVec3(p, material->diffuse);
+    } else if (startsWithToken(p, "Ks")) {
+      p += 2;
+      parseVec3(p, material->specular);
+    } else if (startsWithToken(p, "Ns")) {
+      p += 2;
+      skipSpaces(p);
+      parseReal(p, material->shininess);
+    } else if (startsWithToken(p, "map_Kd")) {
+      p += 6;
+      material->diffuseTexName = parseLastToken(p);
+    } else if (startsWithToken(p, "map_Ks")) {
+      p += 6;
+      material->specularTexName = parseLastToken(p);
+    } else if (startsWithToken(p, "norm")) {
+      p += 4;
+      material->normalTexName = parseLastToken(p);
+    }
+    skipLine(p);
+    ++p;
+  }
+}
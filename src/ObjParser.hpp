@@ -0,0 +1,147 @@
+#ifndef __GLITTER_OBJPARSER_H__
+#define __GLITTER_OBJPARSER_H__
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SimpleMaterial.hpp"
+
+class ThreadPool;
+
+/**
+ * @brief A streaming tokenizer for wavefront files (.obj) and their material libraries (.mtl)
+ *
+ * The whole file is read in a single buffer and tokenized in place: no
+ * intermediate string is built, and numbers are parsed by hand. A first
+ * (cheap) pass counts the records so that all the output arrays are sized
+ * once and for all before the actual parsing pass.
+ *
+ * The following records are handled:
+ *	+ vertex attributes (v, vt, vn), with optional vertex colors (v x y z r g b [a])
+ *	+ faces (f), triangulated as fans, with 1-based or negative (relative) indices
+ *	+ material libraries (mtllib) and per face material affectations (usemtl)
+ * Any other record (comments, groups, smoothing groups, ...) is ignored.
+ *
+ * The buffer may be split into line-aligned chunks parsed concurrently. Each
+ * chunk is parsed independently, then the chunks are stitched back in order:
+ * relative indices are offset, material runs are carried from one chunk to the
+ * next, and material names are resolved once all the libraries are known. The
+ * serial parser is simply the single chunk case, so that the result does not
+ * depend on the number of threads.
+ *
+ * @note the parser only exposes the raw attribute pools and the triangle corners
+ * (triplets of indices into these pools). Building the vertex attributes per corner
+ * is the job of ObjLoader.
+ */
+class ObjParser {
+public:
+  /**
+   * @brief A triangle corner: indices into the attribute pools (-1 if absent)
+   */
+  struct Corner {
+    int position; ///< index in positions()
+    int uv;       ///< index in uvs(), or -1
+    int normal;   ///< index in normals(), or -1
+  };
+
+  ObjParser();
+  ObjParser(const ObjParser &) = delete;
+  ObjParser & operator=(const ObjParser &) = delete;
+
+  /**
+   * @brief Parses a wavefront file
+   * @param filename the absolute name of the .obj file
+   * @param rootDir the directory used to resolve the material libraries
+   * @param nbThreads number of threads parsing the file concurrently
+   * @return false if the file could not be read or is ill-formed (an error message is printed)
+   */
+  bool parseFile(const std::string & filename, const std::string & rootDir, unsigned int nbThreads = 1);
+
+  /// @brief getter for the vertex positions pool
+  const std::vector<glm::vec3> & positions() const;
+
+  /// @brief getter for the vertex colors pool (empty if no vertex specifies a color)
+  const std::vector<glm::vec4> & colors() const;
+
+  /// @brief getter for the texture coordinates pool
+  const std::vector<glm::vec2> & uvs() const;
+
+  /// @brief getter for the vertex normals pool
+  const std::vector<glm::vec3> & normals() const;
+
+  /// @brief getter for the triangle corners (3 consecutive corners per triangle)
+  const std::vector<Corner> & corners() const;
+
+  /// @brief getter for the material index of each triangle (-1 if none applies)
+  const std::vector<int> & triangleMaterials() const;
+
+  /**
+   * @brief getter for the materials found in the material libraries
+   * @return the list of materials, texture names are left empty if not specified.
+   */
+  const std::vector<SimpleMaterial> & materials() const;
+
+  /// @brief getter for the names of the material libraries referenced by the file (including the missing ones)
+  const std::vector<std::string> & materialLibraries() const;
+
+private:
+  /// @brief number of records of each kind, used to size the output arrays
+  struct RecordCount {
+    size_t positions;
+    size_t uvs;
+    size_t normals;
+    size_t triangles;
+  };
+
+  /// @brief a usemtl statement, applying to all the following triangles
+  struct MaterialRun {
+    size_t firstTriangle; ///< index of the first triangle of the run (in the chunk)
+    std::string name;     ///< material name
+  };
+
+  /// @brief a polygon corner, before triangulation
+  struct PolygonCorner {
+    Corner corner;
+    unsigned int relativeMask; ///< bit k is set if the k-th index is relative to the end of the chunk pools
+  };
+
+  /// @brief the result of parsing a line-aligned range of the file
+  struct Chunk {
+    Chunk();
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec4> colors; ///< only sized up to the last vertex with a color
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<Corner> corners;
+    std::vector<size_t> relativeSlots; ///< corner slots (3 * corner + attribute) holding chunk-relative indices
+    std::vector<MaterialRun> materialRuns;
+    std::vector<std::string> materialLibraries;
+    const char * error; ///< start of the first ill-formed line, or nullptr
+  };
+
+  static bool readFile(const std::string & filename, std::vector<char> & buffer);
+  static RecordCount countRecords(const char * begin, const char * end);
+  static void parseChunk(const char * begin, const char * end, Chunk & chunk);
+  static bool parseFace(const char *& p, Chunk & chunk, std::vector<PolygonCorner> & polygon);
+  static void parseMaterialLibraries(const char *& p, Chunk & chunk);
+  bool stitch(std::vector<Chunk> & chunks, ThreadPool * pool);
+  bool checkIndices(size_t begin, size_t end) const;
+  void parseMaterialFile(const std::string & filename);
+  size_t lineNumber(const char * position) const;
+
+private:
+  std::string m_filename;
+  std::string m_rootDir;
+  const char * m_buffer; ///< the file content, valid during parseFile
+  std::vector<glm::vec3> m_positions;
+  std::vector<glm::vec4> m_colors;
+  std::vector<glm::vec2> m_uvs;
+  std::vector<glm::vec3> m_normals;
+  std::vector<Corner> m_corners;
+  std::vector<int> m_triangleMaterials;
+  std::vector<SimpleMaterial> m_materials;
+  std::vector<std::string> m_materialLibraries;
+  std::unordered_map<std::string, int> m_materialIndices;
+};
+
+#endif // !defined(__GLITTER_OBJPARSER_H__)
@@ -0,0 +1,166 @@
+#include "RenderQueue.hpp"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+const unsigned int radixBits = 8;              ///< bits of a digit of the radix sort
+const unsigned int radixSize = 1 << radixBits; ///< values of a digit
+const unsigned int nbDigits = 64 / radixBits;  ///< digits of a sort key
+const unsigned int programBits = 12;           ///< bits of the program name in a sort key
+const unsigned int textureBits = 16;           ///< bits of the texture set hash in a sort key
+const unsigned int vaoBits = 16;               ///< bits of the VAO name in a sort key
+const unsigned int depthBits = 20;             ///< bits of the depth in a sort key
+
+/// @brief the bits of a name kept in a sort key field
+std::uint64_t field(unsigned int name, unsigned int bits)
+{
+  return name & ((std::uint64_t(1) << bits) - 1);
+}
+} // namespace
+
+RenderQueue::Packet::Packet(const Drawable * drawable, const Program * program, const VAO * vao, float depth) : drawable(drawable), program(program), vao(vao), depth(depth)
+{
+  for (unsigned int unit = 0; unit < maxTextures; unit++) {
+    textures[unit] = nullptr;
+    samplers[unit] = nullptr;
+  }
+}
+
+void RenderQueue::Statistics::print(std::ostream & out) const
+{
+  out << packets << " packets, " << programChanges << " programs, " << textureChanges << " textures and samplers, " << vaoChanges << " VAOs";
+}
+
+RenderQueue::RenderQueue() : m_statistics()
+{
+}
+
+void RenderQueue::clear()
+{
+  m_packets.clear();
+  m_entries.clear();
+}
+
+void RenderQueue::submit(const Packet & packet)
+{
+  assert(packet.drawable and packet.program);
+  m_entries.push_back({sortKey(packet), std::uint32_t(m_packets.size())});
+  m_packets.push_back(packet);
+}
+
+size_t RenderQueue::size() const
+{
+  return m_packets.size();
+}
+
+void RenderQueue::sort()
+{
+  const size_t size = m_entries.size();
+  if (size < 2) {
+    return;
+  }
+  // least significant digit first, the histograms of all the digits being counted in one pass
+  std::vector<size_t> counts(nbDigits * radixSize, 0);
+  for (const Entry & entry : m_entries) {
+    for (unsigned int digit = 0; digit < nbDigits; digit++) {
+      counts[digit * radixSize + ((entry.key >> (digit * radixBits)) & (radixSize - 1))]++;
+    }
+  }
+  m_scratch.resize(size);
+  for (unsigned int digit = 0; digit < nbDigits; digit++) {
+    const unsigned int shift = digit * radixBits;
+    size_t * count = &counts[digit * radixSize];
+    // a digit shared by all the keys (e.g. the upper bits of the names) leaves the order unchanged
+    if (count[(m_entries[0].key >> shift) & (radixSize - 1)] == size) {
+      continue;
+    }
+    size_t offset = 0;
+    for (unsigned int value = 0; value < radixSize; value++) {
+      const size_t n = count[value];
+      count[value] = offset;
+      offset += n;
+    }
+    for (const Entry & entry : m_entries) {
+      m_scratch[count[(entry.key >> shift) & (radixSize - 1)]++] = entry;
+    }
+    std::swap(m_entries, m_scratch);
+  }
+}
+
+void RenderQueue::execute()
+{
+  m_statistics = Statistics();
+  m_statistics.packets = m_entries.size();
+  const Program * program = nullptr;
+  const VAO * vao = nullptr;
+  const Texture * textures[maxTextures] = {};
+  const Sampler * samplers[maxTextures] = {};
+  // the samplers left bound by the previous frame are unknown
+  bool first = true;
+  for (const Entry & entry : m_entries) {
+    const Packet & packet = m_packets[entry.index];
+    if (packet.program != program) {
+      program = packet.program;
+      program->bind();
+      m_statistics.programChanges++;
+    }
+    for (unsigned int unit = 0; unit < maxTextures; unit++) {
+      if (first or packet.samplers[unit] != samplers[unit]) {
+        samplers[unit] = packet.samplers[unit];
+        if (samplers[unit]) {
+          samplers[unit]->bind();
+        } else {
+          GLState::bindSampler(unit, 0);
+        }
+        m_statistics.textureChanges++;
+      }
+      if (packet.textures[unit] and packet.textures[unit] != textures[unit]) {
+        textures[unit] = packet.textures[unit];
+        GLState::activeTexture(unit);
+        textures[unit]->bind();
+        m_statistics.textureChanges++;
+      }
+    }
+    if (packet.vao != vao) {
+      vao = packet.vao;
+      m_statistics.vaoChanges++;
+    }
+    packet.drawable->draw();
+    first = false;
+  }
+  if (program) {
+    program->unbind();
+  }
+  for (unsigned int unit = 0; unit < maxTextures; unit++) {
+    if (samplers[unit]) {
+      samplers[unit]->unbind();
+    }
+  }
+  if (GLState::unbindsToZero()) {
+    GLState::activeTexture(0);
+  }
+}
+
+const RenderQueue::Statistics & RenderQueue::statistics() const
+{
+  return m_statistics;
+}
+
+std::uint64_t RenderQueue::sortKey(const Packet & packet)
+{
+  // FNV-1a hash of the texture and sampler names, folded to its field
+  std::uint32_t hash = 2166136261u;
+  for (unsigned int unit = 0; unit < maxTextures; unit++) {
+    hash = (hash ^ (packet.textures[unit] ? packet.textures[unit]->location() : 0)) * 16777619u;
+    hash = (hash ^ (packet.samplers[unit] ? packet.samplers[unit]->location() : 0)) * 16777619u;
+  }
+  // the bits of a positive float are ordered as its value
+  const float depth = packet.depth > 0 ? packet.depth : 0.f;
+  std::uint32_t depthValue;
+  std::memcpy(&depthValue, &depth, sizeof(depth));
+  return field(packet.program->location(), programBits) << (textureBits + vaoBits + depthBits) | field(hash ^ (hash >> textureBits), textureBits) << (vaoBits + depthBits) |
+         field(packet.vao ? packet.vao->location() : 0, vaoBits) << depthBits | depthValue >> (32 - depthBits);
+}
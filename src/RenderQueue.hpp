@@ -0,0 +1,111 @@
+#ifndef __GLITTER_RENDERQUEUE_H__
+#define __GLITTER_RENDERQUEUE_H__
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include "glApi.hpp"
+
+/**
+ * @brief Queue of the draws of a frame, sorted so that the draws sharing their state follow each other
+ *
+ * The parts submit a packet per draw: its state (program, textures and
+ * samplers, VAO), its depth and the object issuing the draw call. Once the
+ * frame is submitted, the packets are sorted on a 64-bit key (see sortKey)
+ * by a radix sort, and executed: the program, the textures and the samplers
+ * are bound only when they differ from the ones of the previous packet.
+ *
+ * The key orders the packets by program, then by texture set, by VAO and by
+ * depth (front to back, for the early depth test). The sort is stable: the
+ * packets of equal keys are executed in submission order.
+ *
+ * The objects referenced by the packets must live until the queue is
+ * executed. The program of a packet is left bound to its draw call, which
+ * must not unbind it.
+ */
+class RenderQueue {
+public:
+  static const unsigned int maxTextures = 4; ///< number of textures of a packet, bound to the texture units 0 to maxTextures - 1
+
+  /// The issuer of the draw call of a packet
+  class Drawable {
+  public:
+    /// @brief sets the uniforms of the draw and issues it, the state of its packet being bound
+    virtual void draw() const = 0;
+
+    virtual ~Drawable() {}
+  };
+
+  /// A draw, and its state
+  struct Packet {
+    const Drawable * drawable;             ///< issues the draw call
+    const Program * program;               ///< the program drawing
+    const VAO * vao;                       ///< the VAO drawn (bound by the draw call, only sorted on)
+    const Texture * textures[maxTextures]; ///< texture of each unit (null: none)
+    const Sampler * samplers[maxTextures]; ///< sampler of each unit, whose texture unit must be its index in the array (null: none)
+    float depth;                           ///< view space distance to the camera (only the positive distances are ordered)
+
+    /// @brief Constructor, a packet without textures
+    Packet(const Drawable * drawable, const Program * program, const VAO * vao, float depth);
+  };
+
+  /// Numbers of a frame, by execute
+  struct Statistics {
+    size_t packets;        ///< packets executed
+    size_t programChanges; ///< programs bound
+    size_t textureChanges; ///< textures and samplers bound
+    size_t vaoChanges;     ///< draws whose VAO differs from the one of the previous draw
+
+    /// @brief prints the statistics on one line
+    void print(std::ostream & out) const;
+  };
+
+  /// @brief Constructor
+  RenderQueue();
+
+  RenderQueue(const RenderQueue &) = delete;
+  RenderQueue & operator=(const RenderQueue &) = delete;
+
+  /// @brief removes the packets of the previous frame
+  void clear();
+
+  /// @brief queues a packet
+  void submit(const Packet & packet);
+
+  /// @brief number of queued packets
+  size_t size() const;
+
+  /// @brief sorts the queued packets on their keys (without it, they are executed in submission order)
+  void sort();
+
+  /// @brief binds the state of each packet, when it differs from the one of the previous packet, and issues its draw call
+  void execute();
+
+  /// @brief the statistics of the last execute
+  const Statistics & statistics() const;
+
+  /**
+   * @brief the sort key of a packet
+   *
+   * From the most significant bits: the program name (12 bits), a hash of
+   * the texture and sampler names (16 bits), the VAO name (16 bits) and the
+   * upper bits of the depth (20 bits). The names above the field sizes only
+   * share the key of other objects: their draws may be interleaved, but are
+   * still correct.
+   */
+  static std::uint64_t sortKey(const Packet & packet);
+
+private:
+  /// A packet to execute
+  struct Entry {
+    std::uint64_t key;   ///< sort key of the packet
+    std::uint32_t index; ///< index of the packet in m_packets
+  };
+
+private:
+  std::vector<Packet> m_packets; ///< the packets, in submission order
+  std::vector<Entry> m_entries;  ///< the packets, in execution order
+  std::vector<Entry> m_scratch;  ///< the destination of the radix sort passes
+  Statistics m_statistics;       ///< numbers of the last execute
+};
+
+#endif // !defined(__GLITTER_RENDERQUEUE_H__)
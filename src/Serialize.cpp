@@ -1,92 +1,229 @@
 #include "Serialize.hpp"
+#include <algorithm>
 #include <cstring>
 
-#ifdef IS_LITTLE_ENDIAN
-void swapEndianness(glm::int16 &) {}
-void swapEndianness(glm::int32 &) {}
-void swapEndianness(glm::uint32 &) {}
-void swapEndianness(glm::float32 &) {}
-void swapEndianness(glm::vec2 &) {}
-void swapEndianness(glm::vec3 &) {}
-void swapEndianness(glm::vec4 &) {}
-void swapEndianness(uint64_t &) {}
-#else
-void swapEndianness(glm::int16 & value)
+#if defined(__GNUC__) && defined(__SSE2__)
+#define GLITTER_SWAP_SSE
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#endif
+
+namespace
 {
-  glm::int16 v = value;
-  value = 0;
-  value |= (v & 0xFF00) >> 8;
-  value |= (v & 0xFF) << 8;
+inline std::uint16_t byteSwap(std::uint16_t v)
+{
+  return std::uint16_t((v >> 8) | (v << 8));
 }
 
-void swapEndianness(glm::int32 & value)
+inline std::uint32_t byteSwap(std::uint32_t v)
 {
-  glm::int32 v = value;
-  value = 0;
-  value |= (v & 0xFF000000) >> 24;
-  value |= (v & 0x00FF0000) >> 8;
-  value |= (v & 0x0000FF00) << 8;
-  value |= (v & 0x000000FF) << 24;
+#ifdef __GNUC__
+  return __builtin_bswap32(v);
+#else
+  return (v >> 24) | ((v >> 8) & 0x0000FF00u) | ((v << 8) & 0x00FF0000u) | (v << 24);
+#endif
 }
 
-void swapEndianness(glm::uint32 &)
+inline std::uint64_t byteSwap(std::uint64_t v)
 {
-  glm::uint32 v = value;
-  value = 0;
-  value |= (v & 0xFF000000) >> 24;
-  value |= (v & 0x00FF0000) >> 8;
-  value |= (v & 0x0000FF00) << 8;
-  value |= (v & 0x000000FF) << 24;
+#ifdef __GNUC__
+  return __builtin_bswap64(v);
+#else
+  return (std::uint64_t(byteSwap(std::uint32_t(v))) << 32) | byteSwap(std::uint32_t(v >> 32));
+#endif
 }
 
-void swapEndianness(glm::float32 & value)
+#ifdef GLITTER_SWAP_SSE
+/// @brief swaps the bytes of the Size-bytes scalars of a 16-bytes block
+template <size_t Size> __m128i swapBlock(__m128i x);
+
+#if defined(__SSSE3__)
+// a single byte shuffle
+template <> inline __m128i swapBlock<2>(__m128i x)
 {
-  glm::int32 & intValue = reinterpret_cast<glm::int32 &>(value);
-  glm::int32 v = intValue;
-  intValue = 0;
-  intValue |= (v & 0xFF000000) >> 24;
-  intValue |= (v & 0x00FF0000) >> 8;
-  intValue |= (v & 0x0000FF00) << 8;
-  intValue |= (v & 0x000000FF) << 24;
+  return _mm_shuffle_epi8(x, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
 }
 
-void swapEndianness(glm::vec2 & v)
+template <> inline __m128i swapBlock<4>(__m128i x)
 {
-  swapEndianness(v.x);
-  swapEndianness(v.y);
+  return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
 }
 
-void swapEndianness(glm::vec3 & v)
+template <> inline __m128i swapBlock<8>(__m128i x)
 {
-  swapEndianness(v.x);
-  swapEndianness(v.y);
-  swapEndianness(v.z);
+  return _mm_shuffle_epi8(x, _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+}
+#else
+// SSE2 (the x86-64 baseline): the bytes of the 16-bit words are swapped by shifts, then the words are shuffled
+template <> inline __m128i swapBlock<2>(__m128i x)
+{
+  return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
 }
 
-void swapEndianness(glm::vec4 & v)
+template <> inline __m128i swapBlock<4>(__m128i x)
 {
-  swapEndianness(v.x);
-  swapEndianness(v.y);
-  swapEndianness(v.z);
-  swapEndianness(v.w);
+  x = swapBlock<2>(x);
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
 }
 
-void swapEndianness(uint64_t & value)
+template <> inline __m128i swapBlock<8>(__m128i x)
 {
-  std::uint64_t v = value;
-  value = 0;
-  value |= (v & 0xFF00000000000000) >> 48;
-  value |= (v & 0x00FF000000000000) >> 32;
-  value |= (v & 0x0000FF0000000000) >> 16;
-  value |= (v & 0x000000FF00000000) >> 8;
-  value |= (v & 0x00000000FF000000) << 8;
-  value |= (v & 0x0000000000FF0000) << 16;
-  value |= (v & 0x000000000000FF00) << 32;
-  value |= (v & 0x00000000000000FF) << 48;
+  x = swapBlock<2>(x);
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
 }
 #endif
+#endif
+
+/// @brief swaps the bytes of @p count scalars of type Word, stored at any alignment
+template <typename Word> void swapWords(unsigned char * bytes, size_t count)
+{
+  size_t k = 0;
+#ifdef GLITTER_SWAP_SSE
+  // 4 blocks per iteration, to hide the latency of the loads
+  const size_t perBlock = 16 / sizeof(Word);
+  for (; k + 4 * perBlock <= count; k += 4 * perBlock) {
+    __m128i * p = reinterpret_cast<__m128i *>(bytes + k * sizeof(Word));
+    __m128i x0 = _mm_loadu_si128(p);
+    __m128i x1 = _mm_loadu_si128(p + 1);
+    __m128i x2 = _mm_loadu_si128(p + 2);
+    __m128i x3 = _mm_loadu_si128(p + 3);
+    _mm_storeu_si128(p, swapBlock<sizeof(Word)>(x0));
+    _mm_storeu_si128(p + 1, swapBlock<sizeof(Word)>(x1));
+    _mm_storeu_si128(p + 2, swapBlock<sizeof(Word)>(x2));
+    _mm_storeu_si128(p + 3, swapBlock<sizeof(Word)>(x3));
+  }
+  for (; k + perBlock <= count; k += perBlock) {
+    __m128i * p = reinterpret_cast<__m128i *>(bytes + k * sizeof(Word));
+    _mm_storeu_si128(p, swapBlock<sizeof(Word)>(_mm_loadu_si128(p)));
+  }
+#endif
+  for (; k < count; k++) {
+    Word word;
+    std::memcpy(&word, bytes + k * sizeof(Word), sizeof(Word));
+    word = byteSwap(word);
+    std::memcpy(bytes + k * sizeof(Word), &word, sizeof(Word));
+  }
+}
+} // namespace
+
+void swapBytes(void * data, size_t count, size_t size)
+{
+  unsigned char * bytes = static_cast<unsigned char *>(data);
+  switch (size) {
+  case 1:
+    break;
+  case 2:
+    swapWords<std::uint16_t>(bytes, count);
+    break;
+  case 4:
+    swapWords<std::uint32_t>(bytes, count);
+    break;
+  case 8:
+    swapWords<std::uint64_t>(bytes, count);
+    break;
+  default:
+    assert(false && "swapBytes(): Unsupported scalar size");
+  }
+}
+
+BufferedWriter::BufferedWriter(ByteSink & sink, size_t capacity) : m_sink(sink), m_buffer(std::max<size_t>(capacity, 16)), m_size(0), m_good(true) {}
+
+BufferedWriter::~BufferedWriter()
+{
+  flush();
+}
+
+void BufferedWriter::flush()
+{
+  if (m_size > 0) {
+    m_good = m_sink.write(m_buffer.data(), m_size) and m_good;
+    m_size = 0;
+  }
+}
+
+bool BufferedWriter::good() const
+{
+  return m_good;
+}
+
+void BufferedWriter::writeLarge(const char * data, size_t size, size_t swapSize)
+{
+  flush();
+  if (size <= m_buffer.size()) {
+    write(data, size, swapSize);
+  } else if (swapSize <= 1) {
+    m_good = m_sink.write(data, size) and m_good;
+  } else {
+    // the values are swapped in the buffer, a block of whole scalars at a time
+    const size_t blockSize = m_buffer.size() - m_buffer.size() % swapSize;
+    for (size_t offset = 0; offset < size; offset += blockSize) {
+      m_size = std::min(blockSize, size - offset);
+      std::memcpy(m_buffer.data(), data + offset, m_size);
+      swapBytes(m_buffer.data(), m_size / swapSize, swapSize);
+      flush();
+    }
+  }
+}
+
+BufferedReader::BufferedReader(ByteSource & source) : m_source(source), m_window(nullptr), m_size(0), m_position(0), m_good(true) {}
+
+bool BufferedReader::skip(size_t size)
+{
+  const size_t available = m_size - m_position;
+  if (size <= available) {
+    m_position += size;
+    return true;
+  }
+  m_size = m_position = 0;
+  m_good = m_source.skip(size - available) and m_good;
+  return m_good;
+}
+
+bool BufferedReader::atEnd()
+{
+  if (m_position < m_size) {
+    return false;
+  }
+  m_position = 0;
+  m_size = m_source.next(m_window, size_t(-1));
+  return m_size == 0;
+}
+
+bool BufferedReader::good() const
+{
+  return m_good;
+}
+
+bool BufferedReader::readLarge(char * data, size_t size)
+{
+  size_t done = m_size - m_position;
+  if (done > 0) {
+    std::memcpy(data, m_window + m_position, done);
+  }
+  m_size = m_position = 0;
+  if (size - done >= directSize) {
+    done += m_source.read(data + done, size - done);
+  } else {
+    while (done < size) {
+      m_size = m_source.next(m_window, size_t(-1));
+      if (m_size == 0) {
+        break;
+      }
+      m_position = std::min(m_size, size - done);
+      std::memcpy(data + done, m_window, m_position);
+      done += m_position;
+    }
+  }
+  if (done < size) {
+    std::memset(data + done, 0, size - done);
+    m_good = false;
+  }
+  return m_good;
+}
 
-void writeStringLength(uint64_t value, std::ostream & stream)
+void writeStringLength(std::uint64_t value, BufferedWriter & writer)
 {
   /*
    *  Length bits are saved in an array of unsigned char
@@ -94,55 +231,56 @@ void writeStringLength(uint64_t value, std::ostream & stream)
    *  Most significant bit means:
    *    - 1 for more bytes to come
    *    - 0 for the last byte
+   *  The least significant 7 bits come first
    *  (Strings with length <= 127 only have a 1 byte prefix)
    */
-  unsigned char c;
+  unsigned char bytes[10];
+  size_t size = 0;
   while (value > 127) {
-    c = (value & 0x7F) | 128;
-    stream.write(reinterpret_cast<char *>(&c), 1);
+    bytes[size++] = (value & 0x7F) | 128;
     value >>= 7;
   }
-  c = value;
-  stream.write(reinterpret_cast<char *>(&c), 1);
+  bytes[size++] = static_cast<unsigned char>(value);
+  writer.write(bytes, size);
 }
 
-std::uint64_t readStringLength(std::istream & stream)
+std::uint64_t readStringLength(BufferedReader & reader)
 {
   std::uint64_t value = 0;
-  unsigned char c;
+  unsigned int shift = 0;
+  unsigned char c = 0;
   do {
-    stream.read(reinterpret_cast<char *>(&c), 1);
-    value <<= 7;
-    value |= (c & 0x7F);
-  } while (c & 128);
+    if (not reader.read(&c, 1)) {
+      return 0;
+    }
+    value |= std::uint64_t(c & 0x7F) << shift;
+    shift += 7;
+  } while ((c & 128) and shift < 64);
   return value;
 }
 
-void write(const std::vector<std::string> & v, std::ostream & stream)
+void write(const std::vector<std::string> & v, BufferedWriter & writer)
 {
   // Write TAG(4B), SIZE(8B), VALUES...
-  stream.write(SerializationTraits<std::string>::VectorTag(), 4);
-  std::uint64_t size = v.size();
-  swapEndianness(size);
-  stream.write(reinterpret_cast<char *>(&size), sizeof(size));
+  writer.write(SerializationTraits<std::string>::VectorTag(), 4);
+  write(std::uint64_t(v.size()), writer);
   for (const std::string & str : v) {
-    write(str, stream);
+    write(str, writer);
   }
 }
 
-void read(std::vector<std::string> & v, std::istream & stream)
+void read(std::vector<std::string> & v, BufferedReader & reader)
 {
   // Check TAG
   char tag[5] = {0, 0, 0, 0, 0};
-  assert(stream.read(tag, 4) && "Cannot read input file");
+  reader.read(tag, 4);
+  assert(reader.good() && "Cannot read input file");
   assert(!strcmp(tag, SerializationTraits<std::string>::VectorTag()) && "read(): Missing vector tag");
-  std::uint64_t size;
-  stream.read(reinterpret_cast<char *>(&size), sizeof(size));
-  swapEndianness(size);
+  std::uint64_t size = 0;
+  read(size, reader);
   v.clear();
   v.resize(size);
-  std::vector<std::string>::iterator it = v.begin();
-  while (it != v.end()) {
-    read(*it, stream);
+  for (std::string & str : v) {
+    read(str, reader);
   }
 }
@@ -6,186 +6,320 @@
 #define RESOURCE_DIR "."
 #endif
 
+#include <cassert>
 #include <cstdint>
-#include <fstream>
+#include <cstring>
 #include <string>
 #include <vector>
+#include "ByteStreams.hpp"
 #include "glm/glm.hpp"
 
-/// @brief swap bytes of a 2-bytes integer
-void swapEndianness(glm::int16 &);
-
-/// @brief swap bytes of a 4-bytes integer
-void swapEndianness(glm::int32 &);
-
-/// @brief swap bytes of a 4-bytes integer
-void swapEndianness(glm::uint32 &);
-
-/// @brief swap bytes of an 8-bytes unsigned integer
-void swapEndianness(std::uint64_t &);
-
-/// @brief swap bytes of a 4-bytes float
-void swapEndianness(glm::float32 &);
-
-/// @brief swap bytes of a vector of floats
-void swapEndianness(glm::vec2 &);
-
-/// @brief swap bytes of a vector of floats
-void swapEndianness(glm::vec3 &);
-
-/// @brief swap bytes of a vector of floats
-void swapEndianness(glm::vec4 &);
+/*
+ * The serialized values are little-endian: on big-endian hosts, the bytes of
+ * the endianness dependent types are swapped when written and read, in bulk
+ * (see swapBytes).
+ */
 
 template <typename T> struct SerializationTraits {
   static const bool IsSerializable = false;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = sizeof(T); ///< size of the scalars making up a value, whose bytes are swapped
   static const char * VectorTag() { return "VOID"; }
 };
 
+template <> struct SerializationTraits<glm::uint8> {
+  static const bool IsSerializable = true;
+  static const bool IsEndiannessDependent = false;
+  static const size_t ComponentSize = 1;
+  static const char * VectorTag() { return "VU08"; }
+};
+
+template <> struct SerializationTraits<glm::uint16> {
+  static const bool IsSerializable = true;
+  static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 2;
+  static const char * VectorTag() { return "VU16"; }
+};
+
 template <> struct SerializationTraits<glm::int16> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 2;
   static const char * VectorTag() { return "VI16"; }
 };
 
 template <> struct SerializationTraits<glm::int32> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 4;
   static const char * VectorTag() { return "VI32"; }
 };
 
 template <> struct SerializationTraits<glm::uint32> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 4;
   static const char * VectorTag() { return "VU32"; }
 };
 
 template <> struct SerializationTraits<glm::float32> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 4;
   static const char * VectorTag() { return "VF32"; }
 };
 
 template <> struct SerializationTraits<glm::vec2> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 4;
   static const char * VectorTag() { return "VV2F"; }
 };
 
 template <> struct SerializationTraits<glm::vec3> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 4;
   static const char * VectorTag() { return "VV3F"; }
 };
 
 template <> struct SerializationTraits<glm::vec4> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 4;
   static const char * VectorTag() { return "VV4F"; }
 };
 
 template <> struct SerializationTraits<std::string> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = false;
+  static const size_t ComponentSize = 1;
   static const char * VectorTag() { return "VSTR"; }
 };
 
 template <> struct SerializationTraits<std::uint64_t> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
+  static const size_t ComponentSize = 8;
   static const char * VectorTag() { return "VU64"; }
 };
 
-template <typename T> void write(const std::vector<T> & v, std::ostream & stream)
+/**
+ * @brief swaps the bytes of contiguous scalars, in place
+ * @param data the first scalar (no alignment required)
+ * @param count the number of scalars
+ * @param size the size of a scalar: 1 (nothing to do), 2, 4 or 8 bytes
+ *
+ * Whatever the host byte order: the bytes are swapped with SIMD shuffles
+ * (SSSE3, or SSE2 shifts), the remainder with bswap instructions.
+ */
+void swapBytes(void * data, size_t count, size_t size);
+
+/// @brief size of the scalars whose bytes are swapped between the host and the serialized byte orders (1 if none)
+template <typename T> constexpr size_t swappedSize()
 {
-  static_assert(SerializationTraits<T>::IsSerializable, "write(): Vector element type is not serializable");
-
-  // Write TAG(4B), SIZE(8B), VALUES...
-  stream.write(SerializationTraits<T>::VectorTag(), 4);
-  std::uint64_t size = v.size();
-  swapEndianness(size);
-  stream.write(reinterpret_cast<char *>(&size), sizeof(size));
-
-  if (SerializationTraits<T>::IsEndiannessDependent) {
 #ifdef IS_BIG_ENDIAN
-    std::vector<T> duplicate = v;
-    for (T & value : duplicate) {
-      swapEndianness(value);
-    }
-    stream.write(duplicate.data(), duplicate.size() * sizeof(T));
+  return SerializationTraits<T>::IsEndiannessDependent ? SerializationTraits<T>::ComponentSize : 1;
 #else
-    stream.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+  return 1;
 #endif
-  } else {
-    stream.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+}
+
+/// @brief converts values between the host and the serialized byte orders, in place (nothing to do on little-endian hosts)
+template <typename T> inline void swapEndianness(T * values, size_t count)
+{
+  if (swappedSize<T>() > 1) {
+    swapBytes(values, count * sizeof(T) / swappedSize<T>(), swappedSize<T>());
   }
 }
 
-void write(const std::vector<std::string> & v, std::ostream & stream);
+/// @brief converts a value between the host and the serialized byte orders, in place
+template <typename T> inline void swapEndianness(T & value)
+{
+  swapEndianness(&value, 1);
+}
+
+/**
+ * @brief Buffered output of serialized values
+ *
+ * The small writes (tags, scalars, string lengths...) are gathered in a
+ * buffer, written to the sink when full, so that a value costs a copy rather
+ * than a virtual call. The bytes of a value are swapped in the buffer, so
+ * that a big-endian host swaps arrays without copying them first.
+ *
+ * The buffer is flushed by the destructor: the writer must be destroyed (or
+ * flushed) before the sink.
+ */
+class BufferedWriter {
+public:
+  static const size_t defaultCapacity = 1 << 16; ///< default size of the buffer, in bytes
+
+  /// @brief Constructor
+  explicit BufferedWriter(ByteSink & sink, size_t capacity = defaultCapacity);
+
+  BufferedWriter(const BufferedWriter &) = delete;
+  BufferedWriter & operator=(const BufferedWriter &) = delete;
+
+  /// @brief Destructor, flushing the buffer
+  ~BufferedWriter();
+
+  /**
+   * @brief writes bytes
+   * @param data the bytes
+   * @param size the number of bytes
+   * @param swapSize the size of the scalars whose bytes are swapped on the way (1: none, see swapBytes)
+   */
+  void write(const void * data, size_t size, size_t swapSize = 1)
+  {
+    if (size <= m_buffer.size() - m_size) {
+      std::memcpy(m_buffer.data() + m_size, data, size);
+      if (swapSize > 1) {
+        swapBytes(m_buffer.data() + m_size, size / swapSize, swapSize);
+      }
+      m_size += size;
+    } else {
+      writeLarge(static_cast<const char *>(data), size, swapSize);
+    }
+  }
+
+  /// @brief writes the buffer to the sink
+  void flush();
 
-template <typename T> void read(std::vector<T> & v, std::istream & stream)
+  /// @brief false if a write to the sink failed
+  bool good() const;
+
+private:
+  void writeLarge(const char * data, size_t size, size_t swapSize);
+
+private:
+  ByteSink & m_sink;          ///< the destination of the bytes
+  std::vector<char> m_buffer; ///< the buffered bytes
+  size_t m_size;              ///< number of buffered bytes
+  bool m_good;                ///< false once a write failed
+};
+
+/**
+ * @brief Buffered input of serialized values
+ *
+ * The small reads are served from the current window of the source (see
+ * ByteSource::next), the large ones going directly to their destination. A
+ * failed read (past the end of the source) fills the values with zeros and
+ * makes the reader fail, for good (see good).
+ *
+ * The source is consumed by windows: it is left past the bytes read.
+ */
+class BufferedReader {
+public:
+  static const size_t directSize = 1 << 16; ///< size from which the reads do not go through the windows
+
+  /// @brief Constructor
+  explicit BufferedReader(ByteSource & source);
+
+  BufferedReader(const BufferedReader &) = delete;
+  BufferedReader & operator=(const BufferedReader &) = delete;
+
+  /**
+   * @brief reads bytes
+   * @param data the bytes
+   * @param size the number of bytes
+   * @param swapSize the size of the scalars whose bytes are swapped on the way (1: none, see swapBytes)
+   * @return false if the source ended before
+   */
+  bool read(void * data, size_t size, size_t swapSize = 1)
+  {
+    if (size <= m_size - m_position) {
+      std::memcpy(data, m_window + m_position, size);
+      m_position += size;
+    } else if (not readLarge(static_cast<char *>(data), size)) {
+      return false;
+    }
+    if (swapSize > 1) {
+      swapBytes(data, size / swapSize, swapSize);
+    }
+    return true;
+  }
+
+  /// @brief skips bytes, false if the source ended before
+  bool skip(size_t size);
+
+  /// @brief true if all the bytes of the source were read
+  bool atEnd();
+
+  /// @brief false if a read went past the end of the source
+  bool good() const;
+
+private:
+  bool readLarge(char * data, size_t size);
+
+private:
+  ByteSource & m_source; ///< the origin of the bytes
+  const char * m_window; ///< the current window of the source
+  size_t m_size;         ///< number of bytes of the window
+  size_t m_position;     ///< number of bytes of the window consumed
+  bool m_good;           ///< false once a read failed
+};
+
+template <typename T> void write(const std::vector<T> & v, BufferedWriter & writer)
+{
+  static_assert(SerializationTraits<T>::IsSerializable, "write(): Vector element type is not serializable");
+
+  // Write TAG(4B), SIZE(8B), VALUES...
+  writer.write(SerializationTraits<T>::VectorTag(), 4);
+  const std::uint64_t size = v.size();
+  writer.write(&size, sizeof(size), swappedSize<std::uint64_t>());
+  writer.write(v.data(), v.size() * sizeof(T), swappedSize<T>());
+}
+
+void write(const std::vector<std::string> & v, BufferedWriter & writer);
+
+template <typename T> void read(std::vector<T> & v, BufferedReader & reader)
 {
   static_assert(SerializationTraits<T>::IsSerializable, "read(): Vector element type is not serializable");
 
   // Check TAG
   char tag[5] = {0, 0, 0, 0, 0};
-  assert(stream.read(tag, 4) && "Cannot read input file");
+  reader.read(tag, 4);
+  assert(reader.good() && "Cannot read input file");
   assert(!strcmp(tag, SerializationTraits<T>::VectorTag()) && "read(): Missing vector tag");
 
-  std::uint64_t size;
-  stream.read(reinterpret_cast<char *>(&size), sizeof(size));
-  swapEndianness(size);
+  std::uint64_t size = 0;
+  reader.read(&size, sizeof(size), swappedSize<std::uint64_t>());
 
   v.clear();
   v.resize(size);
-  assert(stream.read(reinterpret_cast<char *>(v.data()), v.size() * sizeof(T)) && "Cannot read vector data from file");
-
-  if (SerializationTraits<T>::IsEndiannessDependent) {
-#ifdef IS_BIG_ENDIAN
-    for (T & value : v) {
-      swapEndianness(value);
-    }
-#endif
-  }
+  reader.read(v.data(), v.size() * sizeof(T), swappedSize<T>());
+  assert(reader.good() && "Cannot read vector data from file");
 }
 
-void read(std::vector<std::string> & v, std::istream & stream);
+void read(std::vector<std::string> & v, BufferedReader & reader);
 
-void writeStringLength(uint64_t value, std::ostream & stream);
+void writeStringLength(std::uint64_t value, BufferedWriter & writer);
 
-std::uint64_t readStringLength(std::istream & stream);
+std::uint64_t readStringLength(BufferedReader & reader);
 
-template <typename T> inline void write(const T & v, std::ostream & stream)
+template <typename T> inline void write(const T & v, BufferedWriter & writer)
 {
   static_assert(SerializationTraits<T>::IsSerializable, "write(): Type is not serializable");
-  T value = v;
-  if (SerializationTraits<T>::IsEndiannessDependent) {
-    swapEndianness(value);
-  }
-  stream.write(reinterpret_cast<const char *>(&v), sizeof(v));
+  writer.write(&v, sizeof(v), swappedSize<T>());
 }
 
-inline void write(const std::string & str, std::ostream & stream)
+inline void write(const std::string & str, BufferedWriter & writer)
 {
-  writeStringLength(str.length(), stream);
-  stream.write(str.c_str(), str.length());
+  writeStringLength(str.length(), writer);
+  writer.write(str.data(), str.length());
 }
 
-template <typename T> inline void read(T & v, std::istream & stream)
+template <typename T> inline void read(T & v, BufferedReader & reader)
 {
   static_assert(SerializationTraits<T>::IsSerializable, "read(): Type is not serializable");
-  stream.read(reinterpret_cast<char *>(&v), sizeof(v));
-  if (SerializationTraits<T>::IsEndiannessDependent) {
-    swapEndianness(v);
-  }
+  reader.read(&v, sizeof(v), swappedSize<T>());
 }
 
-inline void read(std::string & str, std::istream & stream)
+inline void read(std::string & str, BufferedReader & reader)
 {
-  std::uint64_t size = readStringLength(stream);
-  std::vector<char> v(size);
-  stream.read(v.data(), size);
-  str.assign(v.data(), size);
+  std::uint64_t size = readStringLength(reader);
+  str.resize(size);
+  reader.read(&str[0], size);
 }
 
 #endif // __GLITTER_SERIALIZE_H__
@@ -0,0 +1,72 @@
+#ifndef __GLITTER_SPAN_H__
+#define __GLITTER_SPAN_H__
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief A read-only view of contiguous values (pointer and size)
+ *
+ * Spans are built implicitly from vectors, so that a function taking a Span
+ * accepts both heap arrays and arrays pointing into a memory-mapped file
+ * (see GlitterFile). The viewed values must outlive the span.
+ */
+template <typename T> class Span {
+public:
+  typedef T value_type;
+
+  /// @brief Constructor of an empty span
+  Span() : m_data(nullptr), m_size(0) {}
+
+  /// @brief Constructor from a pointer and a number of values
+  Span(const T * data, size_t size) : m_data(data), m_size(size) {}
+
+  /// @brief Constructor viewing the content of a vector
+  Span(const std::vector<T> & values) : m_data(values.data()), m_size(values.size()) {}
+
+  /// @brief pointer to the first value
+  const T * data() const
+  {
+    return m_data;
+  }
+
+  /// @brief number of values
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  /// @brief true if there is no value
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+
+  const T * begin() const
+  {
+    return m_data;
+  }
+
+  const T * end() const
+  {
+    return m_data + m_size;
+  }
+
+  const T & operator[](size_t k) const
+  {
+    assert(k < m_size);
+    return m_data[k];
+  }
+
+  /// @brief copy of the values
+  std::vector<T> toVector() const
+  {
+    return std::vector<T>(begin(), end());
+  }
+
+private:
+  const T * m_data; ///< the first value
+  size_t m_size;    ///< the number of values
+};
+
+#endif // !defined(__GLITTER_SPAN_H__)
@@ -0,0 +1,78 @@
+#ifndef __STD140_HPP
+#define __STD140_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/*
+ * Compile-time checking of C++ structs against the std140 layout of GLSL
+ * uniform blocks (see UniformBuffer):
+ *
+ *   struct Camera {
+ *     glm::mat4 V;
+ *     glm::vec3 position;
+ *     float time;
+ *   };
+ *   STD140_BLOCK(Camera);
+ *   STD140_MEMBER(Camera, V);
+ *   STD140_MEMBER(Camera, position);
+ *   STD140_MEMBER(Camera, time);
+ *
+ * The C++ alignments of the supported types never exceed their std140 base
+ * alignments and their sizes are the same: when each member lies at a
+ * multiple of its std140 base alignment, the struct has the std140 layout.
+ * All the members must be checked, in order (the padding being explicit).
+ */
+
+/// Traits structure for the std140 layout (unsupported types: bool, mat2, mat3, arrays of scalars or of vec2 / vec3, ...)
+template <typename T> struct Std140 {
+  static const bool supported = false; ///< whether the C++ type has the std140 size
+  static const size_t alignment = 16;  ///< std140 base alignment, in bytes
+};
+
+/// Traits structure for the std140 layout of the supported types
+template <size_t Alignment> struct Std140Supported {
+  static const bool supported = true;        ///< whether the C++ type has the std140 size
+  static const size_t alignment = Alignment; ///< std140 base alignment, in bytes
+};
+
+// scalars (a GLSL bool being set from an int or an unsigned int)
+template <> struct Std140<float> : Std140Supported<4> {};
+template <> struct Std140<int> : Std140Supported<4> {};
+template <> struct Std140<unsigned int> : Std140Supported<4> {};
+
+// vectors, the 3 components ones being aligned as the 4 components ones
+template <> struct Std140<glm::vec2> : Std140Supported<8> {};
+template <> struct Std140<glm::ivec2> : Std140Supported<8> {};
+template <> struct Std140<glm::uvec2> : Std140Supported<8> {};
+template <> struct Std140<glm::vec3> : Std140Supported<16> {};
+template <> struct Std140<glm::ivec3> : Std140Supported<16> {};
+template <> struct Std140<glm::uvec3> : Std140Supported<16> {};
+template <> struct Std140<glm::vec4> : Std140Supported<16> {};
+template <> struct Std140<glm::ivec4> : Std140Supported<16> {};
+template <> struct Std140<glm::uvec4> : Std140Supported<16> {};
+
+// matrices, stored as arrays of columns: only the 4 rows ones have their std140 size
+template <> struct Std140<glm::mat4> : Std140Supported<16> {};
+
+/// Traits structure for the std140 layout (arrays, whose std140 stride is a multiple of 16 bytes)
+template <typename T, size_t N> struct Std140<T[N]> {
+  static const bool supported = Std140<T>::supported and sizeof(T) % 16 == 0; ///< whether the C++ type has the std140 size
+  static const size_t alignment = 16;                                         ///< std140 base alignment, in bytes
+};
+
+/**
+ * @brief declares a struct as a std140 uniform block (or a struct nested in one)
+ *
+ * Its size must be a multiple of 16 bytes, as the std140 size of a nested struct.
+ */
+#define STD140_BLOCK(Block)                                                                                                                                                                            \
+  template <> struct Std140<Block> : Std140Supported<16> {};                                                                                                                                           \
+  static_assert(sizeof(Block) % 16 == 0, #Block " must be padded to a multiple of 16 bytes (std140)")
+
+/// @brief checks the std140 offset of a member of a struct declared by STD140_BLOCK
+#define STD140_MEMBER(Block, member)                                                                                                                                                                   \
+  static_assert(Std140<decltype(Block::member)>::supported, #Block "::" #member " has no std140 equivalent");                                                                                          \
+  static_assert(offsetof(Block, member) % Std140<decltype(Block::member)>::alignment == 0, #Block "::" #member " is not aligned as in std140 (add padding before it)")
+
+#endif // !defined(__STD140_HPP)
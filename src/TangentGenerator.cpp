@@ -0,0 +1,193 @@
+#include "TangentGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include "TangentKernels.hpp"
+#include "VertexWelder.hpp"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define GLITTER_TANGENTS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+/// Scalar lanes: the reference implementation of the kernel
+struct ScalarLanes {
+  typedef float Real;
+  typedef bool Mask;
+  static const int width = 1;
+
+  static Real broadcast(float x) { return x; }
+  static Real gather(const float * p, int) { return *p; }
+  static void store(float * p, Real x) { *p = x; }
+  static Mask nonZero(Real x) { return x != 0; }
+  static Real select(Mask m, Real a, Real b) { return m ? a : b; }
+  static Real sqrt(Real x) { return std::sqrt(x); }
+  static Real copySign1(Real x) { return std::copysign(1.f, x); }
+};
+
+#ifdef GLITTER_TANGENTS_SSE
+/// SSE2 lanes (part of the x86-64 baseline)
+struct SSELanes {
+  typedef __m128 Real;
+  typedef __m128 Mask;
+  static const int width = 4;
+
+  static Real broadcast(float x) { return _mm_set1_ps(x); }
+  static Real gather(const float * p, int stride) { return _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]); }
+  static void store(float * p, Real x) { _mm_storeu_ps(p, x); }
+  static Mask nonZero(Real x) { return _mm_cmpneq_ps(x, _mm_setzero_ps()); }
+  static Real select(Mask m, Real a, Real b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+  static Real sqrt(Real x) { return _mm_sqrt_ps(x); }
+  static Real copySign1(Real x) { return _mm_or_ps(_mm_and_ps(x, _mm_set1_ps(-0.f)), _mm_set1_ps(1.f)); }
+};
+#endif
+} // namespace
+
+TangentGenerator::TangentGenerator(Mode mode, Isa isa) : m_mode(mode), m_isa(isa)
+{
+  while (not supported(m_isa)) {
+    m_isa = static_cast<Isa>(m_isa - 1);
+  }
+}
+
+TangentGenerator::Isa TangentGenerator::bestIsa()
+{
+  return supported(AVX2Isa) ? AVX2Isa : supported(SSEIsa) ? SSEIsa : ScalarIsa;
+}
+
+bool TangentGenerator::supported(Isa isa)
+{
+  switch (isa) {
+  case ScalarIsa:
+    return true;
+  case SSEIsa:
+#ifdef GLITTER_TANGENTS_SSE
+    return true;
+#else
+    return false;
+#endif
+  case AVX2Isa:
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return tangentKernelAVX2Compiled() and __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  default:
+    return false;
+  }
+}
+
+const char * TangentGenerator::isaName(Isa isa)
+{
+  switch (isa) {
+  case ScalarIsa:
+    return "scalar";
+  case SSEIsa:
+    return "sse";
+  case AVX2Isa:
+    return "avx2";
+  default:
+    return "unknown";
+  }
+}
+
+TangentGenerator::Isa TangentGenerator::isa() const
+{
+  return m_isa;
+}
+
+void TangentGenerator::compute(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs, const std::vector<glm::vec4> & colors,
+                               std::vector<glm::vec3> & tangents) const
+{
+  tangents.resize(positions.size());
+  computeFaceTangents(positions, normals, uvs, tangents);
+  if (m_mode == VertexTangents) {
+    accumulateVertexTangents(positions, normals, uvs, colors, tangents);
+  }
+}
+
+void TangentGenerator::computeFaceTangents(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs,
+                                           std::vector<glm::vec3> & tangents) const
+{
+  const size_t nbTriangles = positions.size() / 3;
+  if (nbTriangles == 0) {
+    return;
+  }
+  const float * p = &positions[0][0];
+  const float * uv = &uvs[0][0];
+  const float * n = &normals[0][0];
+  float * t = &tangents[0][0];
+  size_t done = 0;
+  switch (m_isa) {
+  case AVX2Isa:
+    done = tangentKernelAVX2(p, uv, n, t, nbTriangles);
+    break;
+#ifdef GLITTER_TANGENTS_SSE
+  case SSEIsa:
+    done = tangentRange<SSELanes>(p, uv, n, t, nbTriangles);
+    break;
+#endif
+  default:
+    break;
+  }
+  // remaining triangles
+  tangentRange<ScalarLanes>(p + 9 * done, uv + 6 * done, n + 9 * done, t + 9 * done, nbTriangles - done);
+}
+
+/// angle of triangle (x0, x1, x2) at x0
+static float cornerAngle(const glm::vec3 & x0, const glm::vec3 & x1, const glm::vec3 & x2)
+{
+  glm::vec3 e1 = x1 - x0;
+  glm::vec3 e2 = x2 - x0;
+  float lengths = glm::length(e1) * glm::length(e2);
+  if (not(lengths > 0)) {
+    return 0;
+  }
+  return std::acos(std::max(-1.f, std::min(1.f, glm::dot(e1, e2) / lengths)));
+}
+
+void TangentGenerator::accumulateVertexTangents(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs,
+                                                const std::vector<glm::vec4> & colors, std::vector<glm::vec3> & tangents) const
+{
+  const size_t nbVertices = positions.size();
+  // uv orientation of each face (0 if degenerate), smuggled as the first tangent component so
+  // that the welder keeps mirrored faces apart
+  std::vector<glm::vec3> orientations(nbVertices);
+  for (size_t i = 0; i + 2 < nbVertices; i += 3) {
+    glm::vec2 deltaUV1 = uvs[i + 1] - uvs[i];
+    glm::vec2 deltaUV2 = uvs[i + 2] - uvs[i];
+    float detDenom = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+    float orientation = (detDenom > 0) ? 1 : (detDenom < 0) ? -1 : 0;
+    orientations[i] = orientations[i + 1] = orientations[i + 2] = glm::vec3(orientation, 0, 0);
+  }
+  VertexWelder welder;
+  std::vector<unsigned int> groups;
+  size_t nbGroups = welder.weld(positions, normals, orientations, colors, uvs, groups);
+
+  // angle weighted sums of the face tangents
+  std::vector<glm::vec3> sums(nbGroups, glm::vec3(0));
+  for (size_t i = 0; i + 2 < nbVertices; i += 3) {
+    if (orientations[i].x == 0) {
+      continue;
+    }
+    for (int c = 0; c < 3; c++) {
+      size_t k = i + c;
+      float angle = cornerAngle(positions[k], positions[i + (c + 1) % 3], positions[i + (c + 2) % 3]);
+      sums[groups[k]] += angle * tangents[k];
+    }
+  }
+
+  for (size_t k = 0; k < nbVertices; k++) {
+    const glm::vec3 & n = normals[k];
+    const glm::vec3 & sum = sums[groups[k]];
+    // Gram-Schmidt orthogonalize, the normals of a group being only nearly equal
+    glm::vec3 t = sum - n * glm::dot(n, sum);
+    float length2 = glm::dot(t, t);
+    if (length2 > 1e-20f) {
+      tangents[k] = t / std::sqrt(length2);
+    }
+    // otherwise, the face tangent is kept
+  }
+}
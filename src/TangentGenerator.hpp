@@ -0,0 +1,80 @@
+#ifndef __GLITTER_TANGENTGENERATOR_H__
+#define __GLITTER_TANGENTGENERATOR_H__
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief Tangent frame generation for triangle soups (3 consecutive vertices per triangle)
+ *
+ * The per face tangents are computed by a SoA kernel processing several
+ * triangles per iteration (4 with SSE, 8 with AVX2), selected at runtime
+ * depending on the processor, with a scalar fallback. The orthogonalization
+ * against the vertex normals is performed in the same pass.
+ *
+ * Two modes are available:
+ *	+ FaceTangents: each vertex gets the tangent of its face
+ *	+ VertexTangents: in the spirit of MikkTSpace, the face tangents are
+ *	  accumulated (weighted by the corner angles) over the vertices that will be
+ *	  welded together, faces with opposite uv orientations being kept apart.
+ *
+ * The tangents are always unit vectors orthogonal to the normals: if the uv
+ * mapping of a face is degenerate, an arbitrary orthogonal vector is used.
+ */
+class TangentGenerator {
+public:
+  /// The instruction sets of the per face kernel
+  enum Isa
+  {
+    ScalarIsa, ///< portable fallback, one triangle at a time
+    SSEIsa,    ///< 4 triangles at a time
+    AVX2Isa    ///< 8 triangles at a time
+  };
+
+  /// The tangent generation modes
+  enum Mode
+  {
+    FaceTangents,  ///< one tangent per face
+    VertexTangents ///< tangents accumulated per welded vertex
+  };
+
+  /**
+   * @brief Constructor
+   * @param mode the tangent generation mode
+   * @param isa the instruction set of the kernel, downgraded if not supported
+   */
+  explicit TangentGenerator(Mode mode = FaceTangents, Isa isa = bestIsa());
+
+  /// @brief the best instruction set supported by the compiler and the processor
+  static Isa bestIsa();
+
+  /// @brief true if @p isa is supported by the compiler and the processor
+  static bool supported(Isa isa);
+
+  /// @brief a printable name for @p isa
+  static const char * isaName(Isa isa);
+
+  /// @brief the instruction set actually used
+  Isa isa() const;
+
+  /**
+   * @brief computes the tangents of a triangle soup
+   * @param positions vertex positions (3 consecutive vertices per triangle)
+   * @param normals unit vertex normals (same size as positions)
+   * @param uvs vertex texture coordinates (same size as positions)
+   * @param colors vertex colors (same size as positions, only used to find the welded vertices)
+   * @param tangents the computed tangents (resized to the size of positions)
+   */
+  void compute(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs, const std::vector<glm::vec4> & colors,
+               std::vector<glm::vec3> & tangents) const;
+
+private:
+  void computeFaceTangents(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & tangents) const;
+  void accumulateVertexTangents(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs, const std::vector<glm::vec4> & colors,
+                                std::vector<glm::vec3> & tangents) const;
+
+private:
+  Mode m_mode;
+  Isa m_isa;
+};
+
+#endif // !defined(__GLITTER_TANGENTGENERATOR_H__)
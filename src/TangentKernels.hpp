@@ -0,0 +1,106 @@
+#ifndef __GLITTER_TANGENTKERNELS_H__
+#define __GLITTER_TANGENTKERNELS_H__
+#include <cstddef>
+
+/*
+ * Internal header of TangentGenerator: the per face tangent kernel, written
+ * once for any "lane" type processing Lanes::width triangles at a time.
+ *
+ * A Lanes type provides:
+ *	+ Real, a pack of width floats supporting +, -, *, /
+ *	+ Mask, the result of a comparison
+ *	+ broadcast(x), gather(p, stride) (p[k * stride] in lane k), store(p, x)
+ *	+ nonZero(x) (unordered comparison, i.e. true for NaN), select(m, a, b), sqrt(x)
+ *	+ copySign1(x) (+1 or -1 with the sign of x)
+ *
+ * The arrays are triangle soups: 9 floats of positions, 6 floats of uvs,
+ * 9 floats of normals and 9 floats of tangents per triangle.
+ */
+
+/**
+ * @brief computes the tangents of Lanes::width consecutive triangles
+ *
+ * The tangent is the uv-compatible direction of the face, orthogonalized
+ * against the normal of each corner (Gram-Schmidt) and normalized. If the
+ * uv mapping of the face is degenerate, an arbitrary unit vector orthogonal
+ * to the normal is used (branchless basis of Duff et al. 2017).
+ */
+template <typename Lanes> inline void tangentBatch(const float * positions, const float * uvs, const float * normals, float * tangents)
+{
+  typedef typename Lanes::Real Real;
+  typedef typename Lanes::Mask Mask;
+  Real p[9];
+  Real uv[6];
+  Real n[9];
+  for (int k = 0; k < 9; k++) {
+    p[k] = Lanes::gather(positions + k, 9);
+    n[k] = Lanes::gather(normals + k, 9);
+  }
+  for (int k = 0; k < 6; k++) {
+    uv[k] = Lanes::gather(uvs + k, 6);
+  }
+  const Real one = Lanes::broadcast(1.f);
+
+  //! note: in barycentric form the tangent is parameterized as:
+  //! t = x0 + t1(x1-x0) + t2(x2-x0)
+  //! then to get t1 and t2, t is characterized by:
+  //! u(x0+t) = u(x_0)+1 and bilinear interp says that u(x0+t) = u(x_0) + t1\delta u1 + t2\delta u2
+  //! v(x0+t) = v(x_0) and bilinear interp says that v(x0+t) = v(x_0) + t1\delta v1 + t2\delta v2
+  //! Solving this 2x2 linear system with Cramer's rule gives:
+  //! t1 = det([1, delta u2; 0, delta v2]) /  det([delta u1, delta u2; delta v1, delta v2])
+  //! t2 = det([delta u1, 1; delta v1, 0]) /  det([delta u1, delta u2; delta v1, delta v2])
+  Real du1 = uv[2] - uv[0];
+  Real dv1 = uv[3] - uv[1];
+  Real du2 = uv[4] - uv[0];
+  Real dv2 = uv[5] - uv[1];
+  Real det = du1 * dv2 - dv1 * du2;
+  Mask valid = Lanes::nonZero(det);
+  Real r = one / Lanes::select(valid, det, one);
+  Real t[3];
+  for (int a = 0; a < 3; a++) {
+    t[a] = ((p[3 + a] - p[a]) * dv2 - (p[6 + a] - p[a]) * dv1) * r;
+  }
+
+  float out[9][Lanes::width];
+  for (int c = 0; c < 3; c++) {
+    const Real * nc = n + 3 * c;
+    // Gram-Schmidt orthogonalization
+    Real d = nc[0] * t[0] + nc[1] * t[1] + nc[2] * t[2];
+    Real o[3] = {t[0] - nc[0] * d, t[1] - nc[1] * d, t[2] - nc[2] * d};
+    Real invLength = one / Lanes::sqrt(o[0] * o[0] + o[1] * o[1] + o[2] * o[2]);
+    // fallback for degenerate uvs
+    Real sign = Lanes::copySign1(nc[2]);
+    Real sa = -one / (sign + nc[2]);
+    Real b = nc[0] * nc[1] * sa;
+    Real f[3] = {one + sign * nc[0] * nc[0] * sa, sign * b, -sign * nc[0]};
+    for (int a = 0; a < 3; a++) {
+      Lanes::store(out[3 * c + a], Lanes::select(valid, o[a] * invLength, f[a]));
+    }
+  }
+  for (int l = 0; l < Lanes::width; l++) {
+    for (int k = 0; k < 9; k++) {
+      tangents[9 * l + k] = out[k][l];
+    }
+  }
+}
+
+/**
+ * @brief computes the tangents of the largest multiple of Lanes::width triangles
+ * @return the number of triangles processed
+ */
+template <typename Lanes> inline size_t tangentRange(const float * positions, const float * uvs, const float * normals, float * tangents, size_t nbTriangles)
+{
+  size_t end = nbTriangles - nbTriangles % Lanes::width;
+  for (size_t t = 0; t < end; t += Lanes::width) {
+    tangentBatch<Lanes>(positions + 9 * t, uvs + 6 * t, normals + 9 * t, tangents + 9 * t);
+  }
+  return end;
+}
+
+/// @brief true if the AVX2 kernel was compiled in (it still needs to be supported at runtime)
+bool tangentKernelAVX2Compiled();
+
+/// @brief AVX2 kernel (8 triangles per iteration), see tangentRange
+size_t tangentKernelAVX2(const float * positions, const float * uvs, const float * normals, float * tangents, size_t nbTriangles);
+
+#endif // !defined(__GLITTER_TANGENTKERNELS_H__)
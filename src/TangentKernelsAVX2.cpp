@@ -0,0 +1,52 @@
+// This file is compiled with -mavx2 (see CMakeLists.txt): it must not define
+// (nor instantiate) anything shared with other translation units, except for
+// the entry points declared in TangentKernels.hpp.
+#include "TangentKernels.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+struct AVX2Lanes {
+  typedef __m256 Real;
+  typedef __m256 Mask;
+  static const int width = 8;
+
+  static Real broadcast(float x) { return _mm256_set1_ps(x); }
+  static Real gather(const float * p, int stride)
+  {
+    const __m256i indices = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+    return _mm256_i32gather_ps(p, indices, 4);
+  }
+  static void store(float * p, Real x) { _mm256_storeu_ps(p, x); }
+  static Mask nonZero(Real x) { return _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NEQ_UQ); }
+  static Real select(Mask m, Real a, Real b) { return _mm256_blendv_ps(b, a, m); }
+  static Real sqrt(Real x) { return _mm256_sqrt_ps(x); }
+  static Real copySign1(Real x) { return _mm256_or_ps(_mm256_and_ps(x, _mm256_set1_ps(-0.f)), _mm256_set1_ps(1.f)); }
+};
+} // namespace
+
+bool tangentKernelAVX2Compiled()
+{
+  return true;
+}
+
+size_t tangentKernelAVX2(const float * positions, const float * uvs, const float * normals, float * tangents, size_t nbTriangles)
+{
+  return tangentRange<AVX2Lanes>(positions, uvs, normals, tangents, nbTriangles);
+}
+
+#else
+
+bool tangentKernelAVX2Compiled()
+{
+  return false;
+}
+
+size_t tangentKernelAVX2(const float *, const float *, const float *, float *, size_t)
+{
+  return 0;
+}
+
+#endif
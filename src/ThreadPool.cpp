@@ -0,0 +1,58 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int nbThreads) : m_stopping(false)
+{
+  if (nbThreads == 0) {
+    nbThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned int k = 0; k < nbThreads; k++) {
+    m_workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+  for (std::thread & worker : m_workers) {
+    worker.join();
+  }
+}
+
+unsigned int ThreadPool::size() const
+{
+  return m_workers.size();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> & body)
+{
+  std::vector<std::future<void>> results;
+  results.reserve(count);
+  for (size_t k = 0; k < count; k++) {
+    results.push_back(submit([&body, k]() { body(k); }));
+  }
+  for (std::future<void> & result : results) {
+    result.get();
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_stopping or not m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return; // stopping, and nothing left to do
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef __GLITTER_THREADPOOL_H__
+#define __GLITTER_THREADPOOL_H__
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A minimal fixed-size pool of worker threads
+ *
+ * Tasks are executed in submission order by the first available worker.
+ * The destructor waits for all the submitted tasks to be completed.
+ * Copy constructor and assignment operator are disabled.
+ *
+ * @note waiting for a task from within another task of the same pool may deadlock.
+ */
+class ThreadPool {
+public:
+  /**
+   * @brief Constructor
+   * @param nbThreads number of worker threads (the hardware concurrency if 0)
+   */
+  explicit ThreadPool(unsigned int nbThreads = 0);
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief Destructor, waits for all pending tasks
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief number of worker threads
+   */
+  unsigned int size() const;
+
+  /**
+   * @brief queues a task
+   * @param function the task to be executed
+   * @return a future holding the result of the task
+   */
+  template <typename Function> std::future<typename std::result_of<Function()>::type> submit(Function function);
+
+  /**
+   * @brief runs @p body(k) for all k in [0, @p count) and waits for their completion
+   * @param count the number of iterations
+   * @param body the loop body
+   */
+  void parallelFor(size_t count, const std::function<void(size_t)> & body);
+
+private:
+  void workerLoop();
+
+private:
+  std::vector<std::thread> m_workers;        ///< worker threads
+  std::queue<std::function<void()>> m_tasks; ///< pending tasks
+  std::mutex m_mutex;                        ///< protects the task queue
+  std::condition_variable m_condition;       ///< signals new tasks (or stopping)
+  bool m_stopping;                           ///< set at destruction
+};
+
+/*
+ * Definition of method templates
+ */
+template <typename Function> std::future<typename std::result_of<Function()>::type> ThreadPool::submit(Function function)
+{
+  typedef typename std::result_of<Function()>::type Result;
+  std::shared_ptr<std::packaged_task<Result()>> task(new std::packaged_task<Result()>(function));
+  std::future<Result> result = task->get_future();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push([task]() { (*task)(); });
+  }
+  m_condition.notify_one();
+  return result;
+}
+
+#endif // !defined(__GLITTER_THREADPOOL_H__)
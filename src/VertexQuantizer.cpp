@@ -0,0 +1,191 @@
+#include "VertexQuantizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+/**
+ * @brief octahedral encoding in signed normalized integers
+ *
+ * The 4 grid points around the exact encoding are tried, the one decoding to
+ * the closest direction being kept (which halves the largest error compared
+ * to rounding).
+ */
+template <typename Encoded> std::vector<Encoded> encodeDirections(Span<glm::vec3> directions, float maxValue)
+{
+  std::vector<Encoded> encoded(directions.size());
+  for (size_t k = 0; k < directions.size(); k++) {
+    float length = glm::length(directions[k]);
+    glm::vec3 direction = length > 0 ? directions[k] / length : glm::vec3(0, 0, 1);
+    glm::vec2 base = glm::floor(VertexQuantizer::octahedralEncode(direction) * maxValue);
+    float bestDot = -2;
+    for (int c = 0; c < 4; c++) {
+      glm::vec2 candidate = glm::clamp(base + glm::vec2(c & 1, c >> 1), -maxValue, maxValue);
+      float dot = glm::dot(direction, VertexQuantizer::octahedralDecode(candidate / maxValue));
+      if (dot > bestDot) {
+        bestDot = dot;
+        encoded[k] = Encoded(int(candidate.x), int(candidate.y));
+      }
+    }
+  }
+  return encoded;
+}
+
+/// @brief angle between two directions, in degrees (acos is not accurate for small angles)
+float angle(const glm::vec3 & a, const glm::vec3 & b)
+{
+  return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+} // namespace
+
+VertexQuantizer::VertexQuantizer(Span<glm::vec3> positions) : m_offset(0), m_scale(1)
+{
+  if (positions.empty()) {
+    return;
+  }
+  glm::vec3 lower = positions[0];
+  glm::vec3 upper = positions[0];
+  for (const glm::vec3 & position : positions) {
+    lower = glm::min(lower, position);
+    upper = glm::max(upper, position);
+  }
+  m_offset = lower;
+  for (int c = 0; c < 3; c++) {
+    m_scale[c] = upper[c] > lower[c] ? upper[c] - lower[c] : 1.f;
+  }
+}
+
+const glm::vec3 & VertexQuantizer::positionOffset() const
+{
+  return m_offset;
+}
+
+const glm::vec3 & VertexQuantizer::positionScale() const
+{
+  return m_scale;
+}
+
+std::vector<glm::u16vec4> VertexQuantizer::encodePositions(Span<glm::vec3> positions) const
+{
+  std::vector<glm::u16vec4> encoded(positions.size());
+  for (size_t k = 0; k < positions.size(); k++) {
+    glm::vec3 q = glm::round(glm::clamp((positions[k] - m_offset) / m_scale, 0.f, 1.f) * 65535.f);
+    encoded[k] = glm::u16vec4(q.x, q.y, q.z, 0);
+  }
+  return encoded;
+}
+
+glm::vec3 VertexQuantizer::decodePosition(const glm::u16vec4 & position) const
+{
+  return m_offset + m_scale * glm::vec3(position.x, position.y, position.z) / 65535.f;
+}
+
+std::vector<glm::i16vec2> VertexQuantizer::encodeDirections16(Span<glm::vec3> directions)
+{
+  return encodeDirections<glm::i16vec2>(directions, 32767.f);
+}
+
+std::vector<glm::i8vec2> VertexQuantizer::encodeDirections8(Span<glm::vec3> directions)
+{
+  return encodeDirections<glm::i8vec2>(directions, 127.f);
+}
+
+std::vector<Half2> VertexQuantizer::encodeUVs(Span<glm::vec2> uvs)
+{
+  std::vector<Half2> encoded(uvs.size());
+  for (size_t k = 0; k < uvs.size(); k++) {
+    encoded[k].x = glm::packHalf1x16(uvs[k].x);
+    encoded[k].y = glm::packHalf1x16(uvs[k].y);
+  }
+  return encoded;
+}
+
+std::vector<glm::u8vec4> VertexQuantizer::encodeColors(Span<glm::vec4> colors)
+{
+  std::vector<glm::u8vec4> encoded(colors.size());
+  for (size_t k = 0; k < colors.size(); k++) {
+    glm::vec4 q = glm::round(glm::clamp(colors[k], 0.f, 1.f) * 255.f);
+    encoded[k] = glm::u8vec4(q.x, q.y, q.z, q.w);
+  }
+  return encoded;
+}
+
+glm::vec2 VertexQuantizer::octahedralEncode(const glm::vec3 & direction)
+{
+  float norm = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+  if (not(norm > 0)) {
+    return glm::vec2(0);
+  }
+  glm::vec3 n = direction / norm;
+  if (n.z >= 0) {
+    return glm::vec2(n.x, n.y);
+  }
+  // the lower hemisphere is folded over the diagonals
+  return glm::vec2((1 - std::fabs(n.y)) * (n.x >= 0 ? 1.f : -1.f), (1 - std::fabs(n.x)) * (n.y >= 0 ? 1.f : -1.f));
+}
+
+glm::vec3 VertexQuantizer::octahedralDecode(const glm::vec2 & coordinates)
+{
+  glm::vec3 n(coordinates.x, coordinates.y, 1 - std::fabs(coordinates.x) - std::fabs(coordinates.y));
+  float t = std::max(-n.z, 0.f);
+  n.x += n.x >= 0 ? -t : t;
+  n.y += n.y >= 0 ? -t : t;
+  return glm::normalize(n);
+}
+
+size_t VertexQuantizer::vertexSize(DirectionFormat directions)
+{
+  size_t directionSize = directions == Octahedral16 ? sizeof(glm::i16vec2) : sizeof(glm::i8vec2);
+  return sizeof(glm::u16vec4) + 2 * directionSize + sizeof(Half2) + sizeof(glm::u8vec4);
+}
+
+VertexQuantizer::Errors VertexQuantizer::measure(Span<glm::vec3> positions, Span<glm::vec3> normals, Span<glm::vec3> tangents, Span<glm::vec2> uvs, Span<glm::vec4> colors,
+                                                 DirectionFormat directions) const
+{
+  Errors errors = {0, 0, 0, 0, 0};
+  std::vector<glm::u16vec4> encodedPositions = encodePositions(positions);
+  for (size_t k = 0; k < positions.size(); k++) {
+    errors.position = std::max(errors.position, glm::distance(positions[k], decodePosition(encodedPositions[k])));
+  }
+  errors.position /= glm::length(m_scale);
+
+  // directions are compared after normalization, null vectors being skipped
+  const Span<glm::vec3> * attributes[2] = {&normals, &tangents};
+  float * attributeErrors[2] = {&errors.normal, &errors.tangent};
+  for (int a = 0; a < 2; a++) {
+    Span<glm::vec3> values = *attributes[a];
+    std::vector<glm::vec2> decoded(values.size());
+    if (directions == Octahedral16) {
+      std::vector<glm::i16vec2> encoded = encodeDirections16(values);
+      for (size_t k = 0; k < values.size(); k++) {
+        decoded[k] = glm::max(glm::vec2(encoded[k].x, encoded[k].y) / 32767.f, glm::vec2(-1));
+      }
+    } else {
+      std::vector<glm::i8vec2> encoded = encodeDirections8(values);
+      for (size_t k = 0; k < values.size(); k++) {
+        decoded[k] = glm::max(glm::vec2(encoded[k].x, encoded[k].y) / 127.f, glm::vec2(-1));
+      }
+    }
+    for (size_t k = 0; k < values.size(); k++) {
+      float length = glm::length(values[k]);
+      if (length > 0) {
+        *attributeErrors[a] = std::max(*attributeErrors[a], angle(values[k] / length, octahedralDecode(decoded[k])));
+      }
+    }
+  }
+
+  std::vector<Half2> encodedUVs = encodeUVs(uvs);
+  for (size_t k = 0; k < uvs.size(); k++) {
+    glm::vec2 decoded(glm::unpackHalf1x16(encodedUVs[k].x), glm::unpackHalf1x16(encodedUVs[k].y));
+    errors.uv = std::max(errors.uv, std::max(std::fabs(decoded.x - uvs[k].x), std::fabs(decoded.y - uvs[k].y)));
+  }
+
+  std::vector<glm::u8vec4> encodedColors = encodeColors(colors);
+  for (size_t k = 0; k < colors.size(); k++) {
+    for (int c = 0; c < 4; c++) {
+      errors.color = std::max(errors.color, std::fabs(encodedColors[k][c] / 255.f - glm::clamp(colors[k][c], 0.f, 1.f)));
+    }
+  }
+  return errors;
+}
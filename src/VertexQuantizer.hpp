@@ -0,0 +1,108 @@
+#ifndef __GLITTER_VERTEXQUANTIZER_H__
+#define __GLITTER_VERTEXQUANTIZER_H__
+#include <glm/glm.hpp>
+#include <vector>
+#include "AttributeProperties.hpp"
+#include "Span.hpp"
+
+/**
+ * @brief Compact vertex formats
+ *
+ * The float32 vertex attributes produced by ObjLoader take 60 bytes per
+ * vertex. The following encodings reduce it to 24 bytes (20 bytes with
+ * 8-bit directions), all of them being decoded by the vertex fetch hardware
+ * (normalized integers and half floats) or by a few shader instructions:
+ *	+ positions: 16-bit normalized integers relative to the bounding box of
+ *	  the mesh, decoded with the positionOffset and positionScale uniforms
+ *	  (the fourth component pads the attribute to 8 bytes)
+ *	+ normals and tangents: octahedral encoding (Meyer et al. 2010) in 2 signed
+ *	  normalized 16-bit or 8-bit integers, decoded when the octahedralDirections
+ *	  uniform is set
+ *	+ uvs: half floats
+ *	+ colors: RGBA8 normalized integers
+ *
+ * @see shaders/simplemat.v.glsl
+ */
+class VertexQuantizer {
+public:
+  /// The encodings available for unit vectors
+  enum DirectionFormat
+  {
+    Octahedral16, ///< 2 x 16-bit signed normalized integers (4 bytes)
+    Octahedral8   ///< 2 x 8-bit signed normalized integers (2 bytes)
+  };
+
+  /**
+   * @brief Largest decoding errors of a set of attributes
+   */
+  struct Errors {
+    float position; ///< largest distance, relative to the bounding box diagonal
+    float normal;   ///< largest angle, in degrees
+    float tangent;  ///< largest angle, in degrees
+    float uv;       ///< largest absolute difference of a component
+    float color;    ///< largest absolute difference of a component
+  };
+
+  /**
+   * @brief Constructor
+   * @param positions the vertex positions, whose bounding box is used for quantization
+   */
+  VertexQuantizer(Span<glm::vec3> positions);
+
+  /// @brief offset of the position decoding (the lower corner of the bounding box)
+  const glm::vec3 & positionOffset() const;
+
+  /// @brief scale of the position decoding (the extent of the bounding box)
+  const glm::vec3 & positionScale() const;
+
+  /// @brief 16-bit normalized positions relative to the bounding box
+  std::vector<glm::u16vec4> encodePositions(Span<glm::vec3> positions) const;
+
+  /// @brief decodes a position encoded with encodePositions
+  glm::vec3 decodePosition(const glm::u16vec4 & position) const;
+
+  /// @brief octahedral encoding of unit vectors in 16-bit integers
+  static std::vector<glm::i16vec2> encodeDirections16(Span<glm::vec3> directions);
+
+  /// @brief octahedral encoding of unit vectors in 8-bit integers
+  static std::vector<glm::i8vec2> encodeDirections8(Span<glm::vec3> directions);
+
+  /// @brief half float uvs
+  static std::vector<Half2> encodeUVs(Span<glm::vec2> uvs);
+
+  /// @brief RGBA8 colors
+  static std::vector<glm::u8vec4> encodeColors(Span<glm::vec4> colors);
+
+  /**
+   * @brief octahedral projection of a direction
+   * @param direction the direction (not necessarily normalized, the null vector being mapped to +z)
+   * @return the coordinates in the [-1, 1] square
+   */
+  static glm::vec2 octahedralEncode(const glm::vec3 & direction);
+
+  /// @brief unit vector of octahedral coordinates
+  static glm::vec3 octahedralDecode(const glm::vec2 & coordinates);
+
+  /**
+   * @brief size of a vertex with all the attributes encoded
+   * @param directions the encoding of normals and tangents
+   */
+  static size_t vertexSize(DirectionFormat directions);
+
+  /**
+   * @brief measures the decoding errors of all the attributes
+   * @param positions the vertex positions
+   * @param normals the vertex normals
+   * @param tangents the vertex tangents
+   * @param uvs the vertex uvs
+   * @param colors the vertex colors
+   * @param directions the encoding of normals and tangents
+   */
+  Errors measure(Span<glm::vec3> positions, Span<glm::vec3> normals, Span<glm::vec3> tangents, Span<glm::vec2> uvs, Span<glm::vec4> colors, DirectionFormat directions) const;
+
+private:
+  glm::vec3 m_offset; ///< lower corner of the bounding box
+  glm::vec3 m_scale;  ///< extent of the bounding box (1 along flat dimensions)
+};
+
+#endif // !defined(__GLITTER_VERTEXQUANTIZER_H__)
@@ -0,0 +1,191 @@
+#include "VertexWelder.hpp"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+VertexWelder::Tolerances::Tolerances() : position(1e-2), normal(1e-2), tangent(1e-2), color(1 / 256.f), uv(1e-2) {}
+
+VertexWelder::VertexWelder(const Tolerances & tolerances) : m_tolerances(tolerances) {}
+
+template <typename Vec> static inline bool isNear(const Vec & a, const Vec & b, float tolerance)
+{
+  for (int k = 0; k < Vec::length(); k++) {
+    if (not(std::fabs(a[k] - b[k]) < tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// packs 3 (wrapped) cell coordinates in a 64 bits key
+static inline std::uint64_t cellKey(std::int64_t x, std::int64_t y, std::int64_t z)
+{
+  const std::uint64_t mask = (1ull << 21) - 1;
+  return (static_cast<std::uint64_t>(x) & mask) | ((static_cast<std::uint64_t>(y) & mask) << 21) | ((static_cast<std::uint64_t>(z) & mask) << 42);
+}
+
+static inline std::uint64_t mixHash(std::uint64_t key)
+{
+  // finalizer of MurmurHash3
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ull;
+  key ^= key >> 33;
+  return key;
+}
+
+namespace
+{
+const unsigned int empty = std::numeric_limits<unsigned int>::max(); ///< representative of the free entries of the spatial hash
+} // namespace
+
+bool VertexWelder::overlappedCells(const glm::vec3 & position, float tolerance, std::int64_t cells[3][2])
+{
+  // the tolerance box of the vertex overlaps its own cell, and one neighbour per axis
+  const float cellSize = 2 * tolerance;
+  const double maxCell = 1e15; // keeps the cell coordinates representable
+  for (int a = 0; a < 3; a++) {
+    double scaled = position[a] / cellSize;
+    if (not(std::fabs(scaled) < maxCell)) {
+      return false;
+    }
+    double cell = std::floor(scaled);
+    cells[a][0] = static_cast<std::int64_t>(cell);
+    cells[a][1] = cells[a][0] + ((scaled - cell < 0.5) ? -1 : 1);
+  }
+  return true;
+}
+
+template <typename Near> unsigned int VertexWelder::findRepresentative(const std::vector<CellEntry> & table, const std::int64_t cells[3][2], Near near)
+{
+  // the first (i.e. smallest) matching representative wins
+  const size_t mask = table.size() - 1;
+  unsigned int match = empty;
+  for (int neighbour = 0; neighbour < 8; neighbour++) {
+    std::uint64_t key = cellKey(cells[0][neighbour & 1], cells[1][(neighbour >> 1) & 1], cells[2][(neighbour >> 2) & 1]);
+    for (size_t slot = mixHash(key) & mask; table[slot].representative != empty; slot = (slot + 1) & mask) {
+      const unsigned int candidate = table[slot].representative;
+      if (table[slot].key == key and candidate < match and near(candidate)) {
+        match = candidate;
+      }
+    }
+  }
+  return match;
+}
+
+void VertexWelder::insertRepresentative(std::vector<CellEntry> & table, const std::int64_t cells[3][2], unsigned int representative)
+{
+  const size_t mask = table.size() - 1;
+  std::uint64_t key = cellKey(cells[0][0], cells[1][0], cells[2][0]);
+  size_t slot = mixHash(key) & mask;
+  while (table[slot].representative != empty) {
+    slot = (slot + 1) & mask;
+  }
+  table[slot].key = key;
+  table[slot].representative = representative;
+}
+
+size_t VertexWelder::weld(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec3> & tangents, const std::vector<glm::vec4> & colors,
+                          const std::vector<glm::vec2> & uvs, std::vector<unsigned int> & remap) const
+{
+  const size_t nbVertices = positions.size();
+  remap.resize(nbVertices);
+
+  // Open-addressing table of (cell key, representative) entries, with a load factor below 1/2
+  size_t capacity = 16;
+  while (capacity < 2 * nbVertices) {
+    capacity *= 2;
+  }
+  std::vector<CellEntry> table(capacity, CellEntry{0, empty});
+
+  size_t count = 0;
+  for (size_t k = 0; k < nbVertices; k++) {
+    std::int64_t cells[3][2];
+    const bool finite = overlappedCells(positions[k], m_tolerances.position, cells);
+    unsigned int match = empty;
+    if (finite) {
+      match = findRepresentative(table, cells, [&](unsigned int candidate) {
+        return isNear(positions[candidate], positions[k], m_tolerances.position) and isNear(normals[candidate], normals[k], m_tolerances.normal) and
+               isNear(tangents[candidate], tangents[k], m_tolerances.tangent) and isNear(uvs[candidate], uvs[k], m_tolerances.uv) and
+               isNear(colors[candidate], colors[k], m_tolerances.color);
+      });
+    }
+
+    if (match != empty) {
+      remap[k] = remap[match];
+    } else {
+      remap[k] = count++;
+      if (finite) {
+        insertRepresentative(table, cells, k);
+      }
+    }
+  }
+  return count;
+}
+
+VertexWelder::Incremental::Incremental(const Tolerances & tolerances) : m_tolerances(tolerances), m_table(16, CellEntry{0, empty}) {}
+
+unsigned int VertexWelder::Incremental::add(const glm::vec3 & position, const glm::vec3 & normal, const glm::vec3 & tangent, const glm::vec4 & color, const glm::vec2 & uv)
+{
+  // the representatives are the welded vertices themselves, so the matches are the same as the ones of weld
+  std::int64_t cells[3][2];
+  const bool finite = overlappedCells(position, m_tolerances.position, cells);
+  if (finite) {
+    unsigned int match = findRepresentative(m_table, cells, [&](unsigned int candidate) {
+      return isNear(m_positions[candidate], position, m_tolerances.position) and isNear(m_normals[candidate], normal, m_tolerances.normal) and
+             isNear(m_tangents[candidate], tangent, m_tolerances.tangent) and isNear(m_uvs[candidate], uv, m_tolerances.uv) and isNear(m_colors[candidate], color, m_tolerances.color);
+    });
+    if (match != empty) {
+      return match;
+    }
+  }
+
+  const unsigned int index = static_cast<unsigned int>(m_positions.size());
+  m_positions.push_back(position);
+  m_normals.push_back(normal);
+  m_tangents.push_back(tangent);
+  m_colors.push_back(color);
+  m_uvs.push_back(uv);
+  if (finite) {
+    // doubled to keep the load factor below 1/2, the entries being reinserted in slot order
+    if (2 * (index + 1) > m_table.size()) {
+      std::vector<CellEntry> table(2 * m_table.size(), CellEntry{0, empty});
+      const size_t mask = table.size() - 1;
+      for (const CellEntry & entry : m_table) {
+        if (entry.representative != empty) {
+          size_t slot = mixHash(entry.key) & mask;
+          while (table[slot].representative != empty) {
+            slot = (slot + 1) & mask;
+          }
+          table[slot] = entry;
+        }
+      }
+      m_table.swap(table);
+    }
+    insertRepresentative(m_table, cells, index);
+  }
+  return index;
+}
+
+size_t VertexWelder::Incremental::size() const
+{
+  return m_positions.size();
+}
+
+void VertexWelder::Incremental::release(std::vector<glm::vec3> & positions, std::vector<glm::vec3> & normals, std::vector<glm::vec3> & tangents, std::vector<glm::vec4> & colors,
+                                        std::vector<glm::vec2> & uvs)
+{
+  positions = std::move(m_positions);
+  normals = std::move(m_normals);
+  tangents = std::move(m_tangents);
+  colors = std::move(m_colors);
+  uvs = std::move(m_uvs);
+  m_positions.clear();
+  m_normals.clear();
+  m_tangents.clear();
+  m_colors.clear();
+  m_uvs.clear();
+  m_table.assign(16, CellEntry{0, empty});
+}
@@ -0,0 +1,138 @@
+#ifndef __GLITTER_VERTEXWELDER_H__
+#define __GLITTER_VERTEXWELDER_H__
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief Merges near-identical vertices (a.k.a. vertex welding)
+ *
+ * Two vertices are welded if all their attributes are closer than a per
+ * attribute tolerance (component-wise). Vertices are processed in order: a
+ * vertex is either welded to the first matching representative, or becomes a
+ * new representative itself. The result is therefore deterministic.
+ *
+ * Representatives are looked up in a spatial hash: positions are quantized
+ * on a grid whose cells are twice the position tolerance, so that all the
+ * candidates of a vertex lie in the (at most) 8 cells overlapped by its
+ * tolerance box. The hash is an open-addressing flat table sized once for all
+ * from the number of vertices.
+ *
+ * The vertices may also be welded as they are produced (see Incremental),
+ * without holding the unwelded vertices.
+ */
+class VertexWelder {
+private:
+  /// An entry of the spatial hash: a representative and the key of the cell of its position
+  struct CellEntry {
+    std::uint64_t key;
+    unsigned int representative;
+  };
+
+public:
+  /**
+   * @brief Per attribute tolerances
+   */
+  struct Tolerances {
+    /// @brief Default tolerances (1e-2, and 1/256 for colors)
+    Tolerances();
+
+    float position; ///< tolerance on positions
+    float normal;   ///< tolerance on normals
+    float tangent;  ///< tolerance on tangents
+    float color;    ///< tolerance on colors
+    float uv;       ///< tolerance on texture coordinates
+  };
+
+  /**
+   * @brief Incremental welding of vertices produced one at a time
+   *
+   * Adding the vertices of a set in order welds them exactly as VertexWelder::weld,
+   * but only the welded vertices are stored: the spatial hash references them,
+   * and grows with their number instead of being sized from the number of vertices.
+   */
+  class Incremental {
+  public:
+    /**
+     * @brief Constructor
+     * @param tolerances the welding tolerances
+     */
+    explicit Incremental(const Tolerances & tolerances = Tolerances());
+
+    /**
+     * @brief adds a vertex
+     * @return the index of its welded vertex (welded vertices are numbered in order of first appearance)
+     */
+    unsigned int add(const glm::vec3 & position, const glm::vec3 & normal, const glm::vec3 & tangent, const glm::vec4 & color, const glm::vec2 & uv);
+
+    /// @brief number of welded vertices
+    size_t size() const;
+
+    /// @brief moves the attributes of the welded vertices out (the welder is then empty)
+    void release(std::vector<glm::vec3> & positions, std::vector<glm::vec3> & normals, std::vector<glm::vec3> & tangents, std::vector<glm::vec4> & colors, std::vector<glm::vec2> & uvs);
+
+  private:
+    Tolerances m_tolerances;            ///< the welding tolerances
+    std::vector<CellEntry> m_table;     ///< spatial hash of the welded vertices
+    std::vector<glm::vec3> m_positions; ///< attributes of the welded vertices
+    std::vector<glm::vec3> m_normals;
+    std::vector<glm::vec3> m_tangents;
+    std::vector<glm::vec4> m_colors;
+    std::vector<glm::vec2> m_uvs;
+  };
+
+  /**
+   * @brief Constructor
+   * @param tolerances the welding tolerances
+   */
+  VertexWelder(const Tolerances & tolerances = Tolerances());
+
+  /**
+   * @brief computes the welding of a set of vertices
+   * @param positions vertex positions
+   * @param normals vertex normals (same size as positions)
+   * @param tangents vertex tangents (same size as positions)
+   * @param colors vertex colors (same size as positions)
+   * @param uvs vertex texture coordinates (same size as positions)
+   * @param remap for each vertex, the index of its welded vertex
+   * @return the number of welded vertices
+   *
+   * Welded vertices are numbered in order of first appearance, so that
+   * remap[k] <= k, and the attributes can be compacted in place with VertexWelder::compact.
+   */
+  size_t weld(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> & normals, const std::vector<glm::vec3> & tangents, const std::vector<glm::vec4> & colors,
+              const std::vector<glm::vec2> & uvs, std::vector<unsigned int> & remap) const;
+
+  /**
+   * @brief compacts an attribute array in place, keeping the first occurrence of each welded vertex
+   * @param values the attribute array
+   * @param remap the remapping computed by VertexWelder::weld
+   * @param count the number of welded vertices
+   */
+  template <typename T> static void compact(std::vector<T> & values, const std::vector<unsigned int> & remap, size_t count);
+
+private:
+  static bool overlappedCells(const glm::vec3 & position, float tolerance, std::int64_t cells[3][2]);
+  template <typename Near> static unsigned int findRepresentative(const std::vector<CellEntry> & table, const std::int64_t cells[3][2], Near near);
+  static void insertRepresentative(std::vector<CellEntry> & table, const std::int64_t cells[3][2], unsigned int representative);
+
+private:
+  Tolerances m_tolerances;
+};
+
+/*
+ * Definition of method templates
+ */
+template <typename T> void VertexWelder::compact(std::vector<T> & values, const std::vector<unsigned int> & remap, size_t count)
+{
+  // remap[k] <= k, and the first occurrence of welded vertex w is the first k such that remap[k] == w
+  unsigned int next = 0;
+  for (size_t k = 0; k < remap.size(); k++) {
+    if (remap[k] == next) {
+      values[next++] = values[k];
+    }
+  }
+  values.resize(count);
+}
+
+#endif // !defined(__GLITTER_VERTEXWELDER_H__)
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -6,24 +8,32 @@
 #include "glApi.hpp"
 #include "utils.hpp"
 
-Buffer::Buffer(GLenum target) : m_location(0), m_target(target), m_attributeSize(0)
+Buffer::Buffer(GLenum target) : m_location(0), m_target(target), m_attributeSize(0), m_attributeNormalized(GL_FALSE)
 {
   glGenBuffers(1, &this->m_location);
 }
 
 Buffer::~Buffer()
 {
-  glDeleteBuffers(1, &this->m_location);
+  GLState::deleteBuffer(this->m_location);
 }
 
 void Buffer::bind() const
 {
-  glBindBuffer(this->m_target, this->m_location);
+  GLState::bindBuffer(this->m_target, this->m_location);
 }
 
 void Buffer::unbind() const
 {
-  glBindBuffer(this->m_target, 0);
+  GLState::unbindBuffer(this->m_target);
+}
+
+void Buffer::streamData(const void * data, size_t size)
+{
+  this->bind();
+  glBufferData(this->m_target, size, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(this->m_target, 0, size, data);
+  this->unbind();
 }
 
 template <> void Buffer::setData(const std::vector<char> & values)
@@ -37,6 +47,7 @@ template <> void Buffer::setData(const std::vector<char> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<unsigned char> & values)
@@ -50,6 +61,7 @@ template <> void Buffer::setData(const std::vector<unsigned char> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<short> & values)
@@ -63,6 +75,7 @@ template <> void Buffer::setData(const std::vector<short> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<unsigned short> & values)
@@ -76,6 +89,7 @@ template <> void Buffer::setData(const std::vector<unsigned short> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<int> & values)
@@ -89,6 +103,7 @@ template <> void Buffer::setData(const std::vector<int> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<unsigned int> & values)
@@ -102,6 +117,7 @@ template <> void Buffer::setData(const std::vector<unsigned int> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<float> & values)
@@ -115,6 +131,7 @@ template <> void Buffer::setData(const std::vector<float> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<double> & values)
@@ -128,6 +145,7 @@ template <> void Buffer::setData(const std::vector<double> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<glm::vec2> & values)
@@ -141,6 +159,7 @@ template <> void Buffer::setData(const std::vector<glm::vec2> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<glm::vec3> & values)
@@ -154,6 +173,7 @@ template <> void Buffer::setData(const std::vector<glm::vec3> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 template <> void Buffer::setData(const std::vector<glm::vec4> & values)
@@ -167,6 +187,77 @@ template <> void Buffer::setData(const std::vector<glm::vec4> & values)
   this->m_attributeCount = values.size();
   this->m_attributeSize  = properties.components;
   this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
+}
+
+template <> void Buffer::setData(const std::vector<glm::u8vec4> & values)
+{
+  AttributeProperties<glm::u8vec4> properties;
+
+  this->bind();
+  glBufferData(this->m_target, sizeof(glm::u8vec4)*values.size(), &values[0], GL_STATIC_DRAW);
+  this->unbind();
+
+  this->m_attributeCount = values.size();
+  this->m_attributeSize  = properties.components;
+  this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
+}
+
+template <> void Buffer::setData(const std::vector<glm::i8vec2> & values)
+{
+  AttributeProperties<glm::i8vec2> properties;
+
+  this->bind();
+  glBufferData(this->m_target, sizeof(glm::i8vec2)*values.size(), &values[0], GL_STATIC_DRAW);
+  this->unbind();
+
+  this->m_attributeCount = values.size();
+  this->m_attributeSize  = properties.components;
+  this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
+}
+
+template <> void Buffer::setData(const std::vector<glm::i16vec2> & values)
+{
+  AttributeProperties<glm::i16vec2> properties;
+
+  this->bind();
+  glBufferData(this->m_target, sizeof(glm::i16vec2)*values.size(), &values[0], GL_STATIC_DRAW);
+  this->unbind();
+
+  this->m_attributeCount = values.size();
+  this->m_attributeSize  = properties.components;
+  this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
+}
+
+template <> void Buffer::setData(const std::vector<glm::u16vec4> & values)
+{
+  AttributeProperties<glm::u16vec4> properties;
+
+  this->bind();
+  glBufferData(this->m_target, sizeof(glm::u16vec4)*values.size(), &values[0], GL_STATIC_DRAW);
+  this->unbind();
+
+  this->m_attributeCount = values.size();
+  this->m_attributeSize  = properties.components;
+  this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
+}
+
+template <> void Buffer::setData(const std::vector<Half2> & values)
+{
+  AttributeProperties<Half2> properties;
+
+  this->bind();
+  glBufferData(this->m_target, sizeof(Half2)*values.size(), &values[0], GL_STATIC_DRAW);
+  this->unbind();
+
+  this->m_attributeCount = values.size();
+  this->m_attributeSize  = properties.components;
+  this->m_attributeType  = properties.typeEnum;
+  this->m_attributeNormalized = properties.normalized;
 }
 
 uint Buffer::attributeCount() const
@@ -184,7 +275,12 @@ uint Buffer::attributeSize() const
   return m_attributeSize;
 }
 
-VAO::VAO(uint nbVBO) : m_location(0), m_vbos(nbVBO), m_ibo(GL_ELEMENT_ARRAY_BUFFER)
+GLboolean Buffer::attributeNormalized() const
+{
+  return m_attributeNormalized;
+}
+
+VAO::VAO(uint nbVBO) : m_location(0), m_vbos(nbVBO), m_formats(nbVBO), m_strides(nbVBO, 0), m_divisors(nbVBO, 0), m_ibo(GL_ELEMENT_ARRAY_BUFFER), m_baseVertex(0)
 {
   for (auto & vbo : m_vbos) {
     vbo = std::shared_ptr<Buffer>(new Buffer(GL_ARRAY_BUFFER));
@@ -195,17 +291,22 @@ VAO::VAO(uint nbVBO) : m_location(0), m_vbos(nbVBO), m_ibo(GL_ELEMENT_ARRAY_BUFF
 
 VAO::~VAO()
 {
-  glDeleteVertexArrays(1, &this->m_location);
+  GLState::deleteVertexArray(this->m_location);
 }
 
 void VAO::bind() const
 {
-  glBindVertexArray(this->m_location);
+  GLState::bindVertexArray(this->m_location);
 }
 
 void VAO::unbind() const
 {
-  glBindVertexArray(0);
+  GLState::unbindVertexArray();
+}
+
+uint VAO::location() const
+{
+  return m_location;
 }
 
 void VAO::encapsulateVBO(unsigned int attributeIndex) const
@@ -216,7 +317,13 @@ void VAO::encapsulateVBO(unsigned int attributeIndex) const
   vbo->bind();
   
   glEnableVertexAttribArray(attributeIndex);
-  glVertexAttribPointer(attributeIndex, vbo->attributeSize(), vbo->attributeType(), GL_FALSE, 0, nullptr);
+  if (this->m_strides[attributeIndex] != 0) {
+    const AttributeFormat & format = this->m_formats[attributeIndex];
+    glVertexAttribPointer(attributeIndex, format.components, format.typeEnum, format.normalized, this->m_strides[attributeIndex], reinterpret_cast<const void *>(size_t(format.offset)));
+  } else {
+    glVertexAttribPointer(attributeIndex, vbo->attributeSize(), vbo->attributeType(), vbo->attributeNormalized(), 0, nullptr);
+  }
+  glVertexAttribDivisor(attributeIndex, this->m_divisors[attributeIndex]);
 
   /*
    * glVertexArrayAttribFormat(this->m_location, attributeIndex,
@@ -228,11 +335,87 @@ void VAO::encapsulateVBO(unsigned int attributeIndex) const
   this->unbind();
 }
 
+void VAO::setInterleavedVBO(uint firstAttributeIndex, const std::vector<unsigned char> & vertices, const std::vector<AttributeFormat> & formats, GLsizei stride)
+{
+  assert(firstAttributeIndex + formats.size() <= this->m_vbos.size());
+  std::shared_ptr<Buffer> vbo = this->m_vbos[firstAttributeIndex];
+  vbo->setData(vertices);
+  for (uint k = 0; k < formats.size(); k++) {
+    uint attributeIndex = firstAttributeIndex + k;
+    this->m_vbos[attributeIndex] = vbo;
+    this->m_formats[attributeIndex] = formats[k];
+    this->m_strides[attributeIndex] = stride;
+    this->m_divisors[attributeIndex] = 0;
+    this->encapsulateVBO(attributeIndex);
+  }
+}
+
+void VAO::setInstanceVBO(uint firstAttributeIndex, Span<glm::mat4> matrices)
+{
+  // the columns of a matrix, as vec4 attributes
+  std::vector<AttributeFormat> formats;
+  for (GLuint column = 0; column < 4; column++) {
+    formats.push_back({GL_FLOAT, 4, GL_FALSE, GLuint(column * sizeof(glm::vec4))});
+  }
+  this->setInstanceVBO(firstAttributeIndex, matrices.data(), sizeof(glm::mat4) * matrices.size(), formats, sizeof(glm::mat4));
+}
+
+void VAO::setInstanceVBO(uint firstAttributeIndex, const void * data, size_t size, const std::vector<AttributeFormat> & formats, GLsizei stride)
+{
+  assert(firstAttributeIndex + formats.size() <= this->m_vbos.size());
+  if (this->m_divisors[firstAttributeIndex] == 1 and this->m_strides[firstAttributeIndex] == stride) {
+    // already set up: the new values replace the ones of the VBO
+    this->m_vbos[firstAttributeIndex]->streamData(data, size);
+    return;
+  }
+  std::shared_ptr<Buffer> vbo(new Buffer(GL_ARRAY_BUFFER));
+  vbo->streamData(data, size);
+  for (uint k = 0; k < formats.size(); k++) {
+    uint attributeIndex = firstAttributeIndex + k;
+    this->m_vbos[attributeIndex] = vbo;
+    this->m_formats[attributeIndex] = formats[k];
+    this->m_strides[attributeIndex] = stride;
+    this->m_divisors[attributeIndex] = 1;
+    this->encapsulateVBO(attributeIndex);
+  }
+}
+
+void VAO::setIBO(const std::vector<uint> & values)
+{
+  this->setIBO(CompactIndices(values));
+}
+
+void VAO::setIBO(const CompactIndices & indices)
+{
+  this->setIBO(indices.view());
+}
+
+void VAO::setIBO(const IndexSpan & indices)
+{
+  this->bind();
+  switch (indices.indexSize) {
+  case 1:
+    this->m_ibo.setData(Span<glm::uint8>(indices.bytes.data(), indices.size()));
+    break;
+  case 2:
+    this->m_ibo.setData(Span<glm::uint16>(reinterpret_cast<const glm::uint16 *>(indices.bytes.data()), indices.size()));
+    break;
+  default:
+    this->m_ibo.setData(Span<glm::uint32>(reinterpret_cast<const glm::uint32 *>(indices.bytes.data()), indices.size()));
+  }
+  this->m_ibo.bind();
+  this->unbind();
+  this->m_baseVertex = indices.baseVertex;
+}
+
 std::shared_ptr<VAO> VAO::makeSlaveVAO() const
 {
   unsigned int nbVBO = m_vbos.size();
   std::shared_ptr<VAO> slave(new VAO(nbVBO));
   slave->m_vbos = m_vbos;
+  slave->m_formats = m_formats;
+  slave->m_strides = m_strides;
+  slave->m_divisors = m_divisors;
   slave->bind();
   for (unsigned int attributeIndex = 0; attributeIndex < nbVBO; attributeIndex++) {
     slave->encapsulateVBO(attributeIndex);
@@ -244,7 +427,44 @@ std::shared_ptr<VAO> VAO::makeSlaveVAO() const
 void VAO::draw(GLenum mode) const
 {
   this->bind();
-  glDrawElements(mode, this->m_ibo.attributeCount(), this->m_ibo.attributeType(), nullptr);
+  if (this->m_baseVertex != 0) {
+    glDrawElementsBaseVertex(mode, this->m_ibo.attributeCount(), this->m_ibo.attributeType(), nullptr, this->m_baseVertex);
+  } else {
+    glDrawElements(mode, this->m_ibo.attributeCount(), this->m_ibo.attributeType(), nullptr);
+  }
+  this->unbind();
+}
+
+void VAO::draw(const std::vector<uint> & firsts, const std::vector<uint> & counts, GLenum mode) const
+{
+  assert(firsts.size() == counts.size());
+  if (firsts.empty()) {
+    return;
+  }
+  GLenum type = this->m_ibo.attributeType();
+  size_t indexSize = type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+  std::vector<const void *> offsets(firsts.size());
+  for (size_t k = 0; k < firsts.size(); k++) {
+    offsets[k] = reinterpret_cast<const void *>(firsts[k] * indexSize);
+  }
+  this->bind();
+  if (this->m_baseVertex != 0) {
+    std::vector<GLint> baseVertices(firsts.size(), this->m_baseVertex);
+    glMultiDrawElementsBaseVertex(mode, reinterpret_cast<const GLsizei *>(counts.data()), type, offsets.data(), GLsizei(counts.size()), baseVertices.data());
+  } else {
+    glMultiDrawElements(mode, reinterpret_cast<const GLsizei *>(counts.data()), type, offsets.data(), GLsizei(counts.size()));
+  }
+  this->unbind();
+}
+
+void VAO::drawInstanced(GLsizei nbInstances, GLenum mode) const
+{
+  this->bind();
+  if (this->m_baseVertex != 0) {
+    glDrawElementsInstancedBaseVertex(mode, this->m_ibo.attributeCount(), this->m_ibo.attributeType(), nullptr, nbInstances, this->m_baseVertex);
+  } else {
+    glDrawElementsInstanced(mode, this->m_ibo.attributeCount(), this->m_ibo.attributeType(), nullptr, nbInstances);
+  }
   this->unbind();
 }
 
@@ -288,6 +508,19 @@ uint Shader::location() const
   return m_location;
 }
 
+namespace
+{
+/// @brief FNV-1a hash of a uniform name
+size_t uniformHash(const char * name)
+{
+  size_t hash = size_t(14695981039346656037ull);
+  for (; *name != '\0'; name++) {
+    hash = (hash ^ (unsigned char)(*name)) * size_t(1099511628211ull);
+  }
+  return hash;
+}
+} // namespace
+
 Program::Program(const std::string & vname, const std::string & fname) : m_location(0), m_vshader(GL_VERTEX_SHADER, vname), m_fshader(GL_FRAGMENT_SHADER, fname)
 {
   this->m_location = glCreateProgram();
@@ -299,29 +532,129 @@ Program::Program(const std::string & vname, const std::string & fname) : m_locat
 
   glDetachShader(this->m_location, this->m_vshader.location());
   glDetachShader(this->m_location, this->m_fshader.location());
+
+  reflectUniforms();
 }
 
 Program::~Program()
 {
-  glDeleteProgram(this->m_location);
+  GLState::deleteProgram(this->m_location);
 }
 
 void Program::bind() const
 {
-  glUseProgram(this->m_location);
+  GLState::useProgram(this->m_location);
 }
 
 void Program::unbind() const
 {
-  glUseProgram(0);
+  GLState::unbindProgram();
+}
+
+uint Program::location() const
+{
+  return m_location;
+}
+
+Program::Uniform Program::uniform(const std::string & name) const
+{
+  int location;
+  if (getUniformLocation(name.c_str(), location)) {
+    return Uniform(location, this->m_location);
+  }
+  return Uniform();
 }
 
-bool Program::getUniformLocation(const std::string & name, int & location) const
+bool Program::getUniformLocation(const char * name, int & location) const
 {
-  location = glGetUniformLocation(this->m_location, name.c_str());
+  location = -1;
+  if (m_uniforms.empty()) {
+    return false;
+  }
+  const size_t mask = m_uniforms.size() - 1;
+  const size_t hash = uniformHash(name);
+  for (size_t k = hash & mask; not m_uniforms[k].name.empty(); k = (k + 1) & mask) {
+    if (m_uniforms[k].hash == hash and m_uniforms[k].name == name) {
+      location = m_uniforms[k].location;
+      break;
+    }
+  }
   return location != -1;
 }
 
+void Program::reflectUniforms()
+{
+  GLint nbUniforms = 0, maxLength = 0;
+  glGetProgramiv(this->m_location, GL_ACTIVE_UNIFORMS, &nbUniforms);
+  glGetProgramiv(this->m_location, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+  // list the names first, to size the table (at most half full)
+  std::vector<std::pair<std::string, int>> uniforms;
+  std::vector<char> buffer(std::max(maxLength, 1));
+  for (GLint k = 0; k < nbUniforms; k++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(this->m_location, k, buffer.size(), &length, &size, &type, buffer.data());
+    std::string name(buffer.data(), length);
+    const int location = glGetUniformLocation(this->m_location, name.c_str());
+    if (location == -1) {
+      // member of a uniform block
+      continue;
+    }
+    uniforms.emplace_back(name, location);
+    // an array of basic types is listed as its first element, "name[0]"
+    const size_t bracket = name.size() > 3 ? name.size() - 3 : std::string::npos;
+    if (bracket != std::string::npos and name.compare(bracket, 3, "[0]") == 0) {
+      const std::string arrayName = name.substr(0, bracket);
+      uniforms.emplace_back(arrayName, location);
+      for (GLint e = 1; e < size; e++) {
+        const std::string element = arrayName + "[" + std::to_string(e) + "]";
+        uniforms.emplace_back(element, glGetUniformLocation(this->m_location, element.c_str()));
+      }
+    }
+  }
+
+  size_t nbSlots = 1;
+  while (nbSlots < 2 * uniforms.size()) {
+    nbSlots *= 2;
+  }
+  m_uniforms.assign(uniforms.empty() ? 0 : nbSlots, UniformSlot{std::string(), 0, -1});
+  for (const std::pair<std::string, int> & uniform : uniforms) {
+    addUniform(uniform.first, uniform.second);
+  }
+}
+
+void Program::addUniform(const std::string & name, int location)
+{
+  const size_t mask = m_uniforms.size() - 1;
+  const size_t hash = uniformHash(name.c_str());
+  size_t k = hash & mask;
+  while (not m_uniforms[k].name.empty() and m_uniforms[k].name != name) {
+    k = (k + 1) & mask;
+  }
+  m_uniforms[k] = UniformSlot{name, hash, location};
+}
+
+bool Program::bindUniformBlock(const std::string & blockName, uint bindingPoint) const
+{
+  const GLuint index = glGetUniformBlockIndex(this->m_location, blockName.c_str());
+  if (index == GL_INVALID_INDEX) {
+    return false;
+  }
+  glUniformBlockBinding(this->m_location, index, bindingPoint);
+  return true;
+}
+
+void Program::reportUniformFailure(const char * name) const
+{
+  if (not bound()) {
+    std::cerr << "===== Program is not attached (for uniform '" << name << "')\n";
+  } else {
+    std::cerr << "=====" << name << " uniform was queried but does not exist\n";
+  }
+}
+
 template <> void Program::uniformDispatcher(int location, const int & val)
 {
   glUniform1i(location, val);
@@ -374,9 +707,89 @@ template <> void Program::uniformDispatcher(int location, const glm::mat4 & val)
 
 bool Program::bound() const
 {
-  int currentProgram;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-  return m_location == (GLuint)currentProgram;
+  return GLState::program() == m_location;
+}
+
+UniformBuffer::UniformBuffer(uint bindingPoint, size_t blockSize, uint nbSlots, UpdateMethod method)
+    : m_location(0), m_bindingPoint(bindingPoint), m_blockSize(blockSize), m_slotSize(0), m_method(method), m_slot(0), m_fences(std::max(nbSlots, 1u), nullptr)
+{
+  GLint alignment = 1;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  alignment = std::max(alignment, 1);
+  this->m_slotSize = (blockSize + alignment - 1) / alignment * alignment;
+
+  glGenBuffers(1, &this->m_location);
+  this->bind();
+  glBufferData(GL_UNIFORM_BUFFER, this->m_slotSize * this->m_fences.size(), nullptr, GL_DYNAMIC_DRAW);
+  this->unbind();
+  GLState::bindBufferRange(GL_UNIFORM_BUFFER, this->m_bindingPoint, this->m_location, 0, this->m_blockSize);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+  for (GLsync fence : this->m_fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  GLState::deleteBuffer(this->m_location);
+}
+
+void UniformBuffer::bind() const
+{
+  GLState::bindBuffer(GL_UNIFORM_BUFFER, this->m_location);
+}
+
+void UniformBuffer::unbind() const
+{
+  GLState::unbindBuffer(GL_UNIFORM_BUFFER);
+}
+
+uint UniformBuffer::bindingPoint() const
+{
+  return this->m_bindingPoint;
+}
+
+void UniformBuffer::attachToProgram(const Program & prog, const std::string & blockName) const
+{
+  if (not prog.bindUniformBlock(blockName, this->m_bindingPoint)) {
+    std::cerr << "=====" << blockName << " uniform block was attached but does not exist\n";
+  }
+}
+
+void UniformBuffer::updateBytes(const void * data, size_t size)
+{
+  // the commands issued since the last update read the current slot
+  GLsync & current = this->m_fences[this->m_slot];
+  if (current) {
+    glDeleteSync(current);
+  }
+  current = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  this->m_slot = (this->m_slot + 1) % this->m_fences.size();
+  GLsync & next = this->m_fences[this->m_slot];
+  if (next) {
+    // a no-op unless the GPU lags behind by as many updates as there are slots
+    glClientWaitSync(next, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+    glDeleteSync(next);
+    next = nullptr;
+  }
+
+  const size_t offset = this->m_slot * this->m_slotSize;
+  this->bind();
+  if (this->m_method == MapRange) {
+    void * slot = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (slot) {
+      std::memcpy(slot, data, size);
+      glUnmapBuffer(GL_UNIFORM_BUFFER);
+    } else {
+      glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+  } else {
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+  }
+  this->unbind();
+  GLState::bindBufferRange(GL_UNIFORM_BUFFER, this->m_bindingPoint, this->m_location, offset, this->m_blockSize);
 }
 
 Texture::Texture(GLenum target) : m_location(0), m_target(target)
@@ -386,17 +799,22 @@ Texture::Texture(GLenum target) : m_location(0), m_target(target)
 
 Texture::~Texture()
 {
-  glDeleteTextures(1, &this->m_location);
+  GLState::deleteTexture(this->m_location);
 }
 
 void Texture::bind() const
 {
-  glBindTexture(this->m_target, this->m_location);
+  GLState::bindTexture(this->m_target, this->m_location);
 }
 
 void Texture::unbind() const
 {
-  glBindTexture(this->m_target, 0);
+  GLState::unbindTexture(this->m_target);
+}
+
+uint Texture::location() const
+{
+  return m_location;
 }
 
 template <> void Texture::setData<GLubyte>(const Image<GLubyte> & image, bool mipmaps) const
@@ -454,17 +872,22 @@ Sampler::Sampler(int texUnit) : m_location(0), m_texUnit(texUnit)
 
 Sampler::~Sampler()
 {
-  glDeleteSamplers(1, &this->m_location);
+  GLState::deleteSampler(this->m_location);
 }
 
 void Sampler::bind() const
 {
-  glBindSampler(this->m_texUnit, this->m_location);
+  GLState::bindSampler(this->m_texUnit, this->m_location);
 }
 
 void Sampler::unbind() const
 {
-  glBindSampler(this->m_texUnit, 0);
+  GLState::unbindSampler(this->m_texUnit);
+}
+
+uint Sampler::location() const
+{
+  return m_location;
 }
 
 void Sampler::attachToProgram(const Program & prog, const std::string & samplerName, BindOption bindOption) const
@@ -482,9 +905,11 @@ void Sampler::attachToProgram(const Program & prog, const std::string & samplerN
 
 void Sampler::attachTexture(const Texture & texture) const
 {
-  glActiveTexture(GL_TEXTURE0+this->m_texUnit);
+  GLState::activeTexture(this->m_texUnit);
   texture.bind();
-  glActiveTexture(GL_TEXTURE0);
+  if (GLState::unbindsToZero()) {
+    GLState::activeTexture(0);
+  }
 }
 
 template <> void Sampler::setParameter<int>(GLenum paramName, const int & value) const
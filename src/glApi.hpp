@@ -9,7 +9,10 @@
 typedef GLuint uint;
 
 #include "AttributeProperties.hpp"
+#include "CompactIndices.hpp"
+#include "GLState.hpp"
 #include "Image.hpp"
+#include "Std140.hpp"
 
 #define FAIL_BECAUSE_INCOMPLETE                                                                                                                                                                        \
   std::cerr << "Failure in file " << __FILE__ << ":" << __LINE__ << std::endl;                                                                                                                         \
@@ -20,7 +23,9 @@ typedef GLuint uint;
  * @brief Tiny abstraction for OpenGL objects that can be bound to
  * the current openGL state (like VBOs, VAOs, Programs, Textures, ...)
  *
- * This interface exposes bind / unbind mechanisms.
+ * This interface exposes bind / unbind mechanisms. The bindings go through
+ * the GLState cache, which drops the redundant ones (and the unbinds, when
+ * they are lazy).
  */
 class OGLStateObject {
 public:
@@ -94,6 +99,22 @@ public:
    */
   template <typename T> void setData(const std::vector<T> & values);
 
+  /**
+   * @brief sends data to the GPU memory from a view (e.g. on a memory-mapped file, see GlitterFile)
+   * @param values the values to be sent, no intermediate copy being made
+   */
+  template <typename T> void setData(Span<T> values);
+
+  /**
+   * @brief replaces the content of this buffer, e.g. every frame (its formatting being left unchanged)
+   * @param data the bytes to be sent
+   * @param size the number of bytes
+   *
+   * The storage is orphaned (GL_STREAM_DRAW), so that the draws still reading
+   * the previous content are not waited for.
+   */
+  void streamData(const void * data, size_t size);
+
   /**
    * @brief attributeCount
    * @return the number of attributes
@@ -112,12 +133,19 @@ public:
    */
   GLenum attributeSize() const;
 
+  /**
+   * @brief attributeNormalized
+   * @return whether integer attributes are normalized when read by the shaders
+   */
+  GLboolean attributeNormalized() const;
+
 private:
-  uint m_location;        ///< GPU location of the buffer
-  GLenum m_target;        ///< Type of buffer (VBO or IBO)
-  uint m_attributeCount;  ///< Buffer formatting : number of attributes
-  GLenum m_attributeType; ///< Buffer formatting : type of attributes
-  uint m_attributeSize;   ///< Buffer formatting : components per attribute
+  uint m_location;                 ///< GPU location of the buffer
+  GLenum m_target;                 ///< Type of buffer (VBO or IBO)
+  uint m_attributeCount;           ///< Buffer formatting : number of attributes
+  GLenum m_attributeType;          ///< Buffer formatting : type of attributes
+  uint m_attributeSize;            ///< Buffer formatting : components per attribute
+  GLboolean m_attributeNormalized; ///< Buffer formatting : integer attributes normalized
 };
 
 /**
@@ -165,6 +193,12 @@ public:
    */
   void unbind() const override;
 
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
   /**
    * @brief sets up a given VBO.
    * @param attributeIndex the anchor point of the VBO to set-up
@@ -179,6 +213,42 @@ public:
    */
   template <typename T> void setVBO(uint attributeIndex, const std::vector<T> & values);
 
+  /**
+   * @brief sets up a given VBO from a view (e.g. on a memory-mapped file, see GlitterFile)
+   * @param attributeIndex the anchor point of the VBO to set-up
+   * @param values the values to be sent to the VBO location.
+   */
+  template <typename T> void setVBO(uint attributeIndex, Span<T> values);
+
+  /**
+   * @brief sets up a single VBO holding several interleaved attributes
+   * @tparam Layout the InterleavedLayout of the vertices
+   * @param firstAttributeIndex the anchor point of the first attribute, the others following in the layout order
+   * @param vertices the interleaved vertices (see InterleavedLayout::interleave)
+   *
+   * All the attributes share the VBO of @p firstAttributeIndex, each one being
+   * encapsulated with the layout stride and its own offset.
+   */
+  template <typename Layout> void setInterleavedVBO(uint firstAttributeIndex, const std::vector<unsigned char> & vertices);
+
+  /**
+   * @brief sets up a VBO of per-instance attributes, advancing once per instance (glVertexAttribDivisor)
+   * @param attributeIndex the anchor point of the attribute
+   * @param values a value per instance
+   *
+   * The first call sets up the anchor point, the next ones only replace the
+   * content of the VBO (see Buffer::streamData): the values can be streamed
+   * every frame.
+   */
+  template <typename T> void setInstanceVBO(uint attributeIndex, Span<T> values);
+
+  /**
+   * @brief sets up a VBO of per-instance matrices (e.g. modelWorld), a mat4 vertex attribute taking 4 anchor points (one per column)
+   * @param firstAttributeIndex the anchor point of the first column, the 3 others following
+   * @param matrices a matrix per instance
+   */
+  void setInstanceVBO(uint firstAttributeIndex, Span<glm::mat4> matrices);
+
   /**
    * @brief sets up the IBO
    * @param values the values to be sent to the IBO location.
@@ -191,6 +261,26 @@ public:
    */
   template <typename T> void setIBO(const std::vector<T> & values);
 
+  /**
+   * @brief sets up the IBO with the narrowest index type addressing its vertices (see CompactIndices)
+   * @param values the 32-bit indices
+   *
+   * The draw calls use the stored index type and base vertex.
+   */
+  void setIBO(const std::vector<uint> & values);
+
+  /**
+   * @brief sets up the IBO from narrowed indices
+   * @param indices the indices, with their base vertex
+   */
+  void setIBO(const CompactIndices & indices);
+
+  /**
+   * @brief sets up the IBO from a view of narrowed indices (e.g. on a memory-mapped file, see GlitterMesh)
+   * @param indices the indices, with their base vertex
+   */
+  void setIBO(const IndexSpan & indices);
+
   /**
    * @brief makes a VAO sharing the same VBOs and with an empty IBO
    * @return the slave VAO
@@ -207,6 +297,21 @@ public:
    */
   void draw(GLenum mode = GL_TRIANGLES) const;
 
+  /**
+   * @brief Make a single draw call rendering ranges of the IBO (glMultiDrawElements)
+   * @param firsts the first index of each range
+   * @param counts the number of indices of each range
+   * @param mode primitive type
+   */
+  void draw(const std::vector<uint> & firsts, const std::vector<uint> & counts, GLenum mode = GL_TRIANGLES) const;
+
+  /**
+   * @brief Make a single draw call rendering instances of the VAO (glDrawElementsInstanced)
+   * @param nbInstances number of instances, the per-instance attributes advancing once per instance (see setInstanceVBO)
+   * @param mode primitive type
+   */
+  void drawInstanced(GLsizei nbInstances, GLenum mode = GL_TRIANGLES) const;
+
 private:
   /**
    * @brief encapsulates the VBO in this VAO
@@ -223,10 +328,33 @@ private:
    */
   void encapsulateVBO(unsigned int attributeIndex) const;
 
+  /**
+   * @brief sets up an interleaved VBO from the formats of its attributes
+   * @param firstAttributeIndex the anchor point of the first attribute
+   * @param vertices the interleaved vertices
+   * @param formats the format of each attribute
+   * @param stride the size of a vertex (in bytes)
+   */
+  void setInterleavedVBO(uint firstAttributeIndex, const std::vector<unsigned char> & vertices, const std::vector<AttributeFormat> & formats, GLsizei stride);
+
+  /**
+   * @brief sets up a VBO of per-instance attributes from the formats of its attributes
+   * @param firstAttributeIndex the anchor point of the first attribute
+   * @param data the interleaved attributes of the instances
+   * @param size the number of bytes of @p data
+   * @param formats the format of each attribute
+   * @param stride the size of the attributes of an instance (in bytes)
+   */
+  void setInstanceVBO(uint firstAttributeIndex, const void * data, size_t size, const std::vector<AttributeFormat> & formats, GLsizei stride);
+
 private:
   uint m_location;                             ///< GPU location of the VAO
   std::vector<std::shared_ptr<Buffer>> m_vbos; ///< List of the VBOs
+  std::vector<AttributeFormat> m_formats;      ///< Formats of the interleaved attributes
+  std::vector<GLsizei> m_strides;              ///< Strides of the interleaved attributes (0 if the attribute has its own VBO)
+  std::vector<GLuint> m_divisors;              ///< Instance divisors of the attributes (0 for the per-vertex ones)
   Buffer m_ibo;                                ///< IBO
+  GLint m_baseVertex;                          ///< vertex added to each index of the IBO
 };
 
 /**
@@ -315,6 +443,41 @@ public:
    */
   void unbind() const override;
 
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
+  /**
+   * @brief A uniform variable of a Program, resolved once (see Program::uniform)
+   *
+   * Kept by the callers setting the variable often (every frame, every
+   * object...), so that setting it costs no name lookup.
+   */
+  class Uniform {
+  public:
+    /// @brief Constructs an invalid handle (setting it does nothing)
+    Uniform() : m_location(-1), m_program(0) {}
+
+    /// @brief false if the program has no such active uniform
+    bool isValid() const { return m_location != -1; }
+
+  private:
+    friend class Program;
+    Uniform(int location, uint program) : m_location(location), m_program(program) {}
+
+    int m_location; ///< GPU location of the uniform (-1 if it does not exist)
+    uint m_program; ///< GPU location of the program the uniform belongs to
+  };
+
+  /**
+   * @brief resolves a uniform variable of this program
+   * @param name the uniform variable name (an element of an array being named as in GLSL, e.g. "lights[1].color")
+   * @return the handle of the variable, invalid if the program has no such active uniform
+   */
+  Uniform uniform(const std::string & name) const;
+
   /**
    * @brief assigns the value of a uniform variable of this program
    * @param name the uniform variable name
@@ -324,6 +487,24 @@ public:
    */
   template <typename T> void setUniform(const std::string & name, const T & val) const;
 
+  /// @brief assigns the value of a uniform variable of this program, by name (without building a std::string)
+  template <typename T> void setUniform(const char * name, const T & val) const;
+
+  /**
+   * @brief assigns the value of a resolved uniform variable of this program
+   * @param uniform the handle of the variable (see Program::uniform), nothing being done if it is invalid
+   * @param val the value to be assign
+   */
+  template <typename T> void setUniform(Uniform uniform, const T & val) const;
+
+  /**
+   * @brief connects a uniform block of this program to a binding point (see UniformBuffer)
+   * @param blockName the name of the uniform block
+   * @param bindingPoint the binding point
+   * @return false if the program has no such active uniform block
+   */
+  bool bindUniformBlock(const std::string & blockName, uint bindingPoint) const;
+
 private:
   /**
    * @brief a template wrapper for glUniform functions
@@ -342,7 +523,17 @@ private:
    *
    * @note PA2
    */
-  bool getUniformLocation(const std::string & name, int & location) const;
+  bool getUniformLocation(const char * name, int & location) const;
+
+  /**
+   * @brief lists the active uniforms of the linked program in the table of locations (see m_uniforms)
+   *
+   * The arrays of basic types are listed under their name, and under the name of each of their elements.
+   */
+  void reflectUniforms();
+
+  /// @brief adds a uniform to the table of locations
+  void addUniform(const std::string & name, int location);
 
   /**
    * @brief bound
@@ -350,10 +541,21 @@ private:
    */
   bool bound() const;
 
+  /// @brief reports a uniform which could not be set (program not bound, or no such uniform)
+  void reportUniformFailure(const char * name) const;
+
 private:
-  uint m_location;  ///< GPU location of the program
-  Shader m_vshader; ///< Vertex shader
-  Shader m_fshader; ///< Fragment shader
+  /// An entry of the table of locations
+  struct UniformSlot {
+    std::string name; ///< name of the uniform (empty for a free slot)
+    size_t hash;      ///< hash of the name
+    int location;     ///< GPU location of the uniform
+  };
+
+  uint m_location;                     ///< GPU location of the program
+  Shader m_vshader;                    ///< Vertex shader
+  Shader m_fshader;                    ///< Fragment shader
+  std::vector<UniformSlot> m_uniforms; ///< locations of the active uniforms, by name (open addressing with linear probing, a power of two slots)
 };
 
 /**
@@ -395,6 +597,12 @@ public:
    */
   void unbind() const override;
 
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
   /**
    * @brief Sends data to the GPU location attached to this instance.
    * @param image the data to be sent
@@ -461,6 +669,12 @@ public:
    */
   void unbind() const override;
 
+  /**
+   * @brief location
+   * @return the GPU location of this instance
+   */
+  uint location() const;
+
   /**
    * @brief attaches this sampler to a program
    * @param prog the target program
@@ -478,7 +692,7 @@ public:
    * @param texture the target texture
    *
    * @note PA4 (part 3): this method must activate this Sampler texture unit, and bind the Texture given
-   * in parameter
+   * in parameter (texture unit 0 being made active again, unless the unbinds are lazy, see GLState)
    */
   void attachTexture(const Texture & texture) const;
 
@@ -503,6 +717,82 @@ private:
   int m_texUnit;   ///< texture unit
 };
 
+/**
+ * @brief The UniformBuffer class.
+ *
+ * A buffer holding the values of a GLSL uniform block, bound to a binding
+ * point that the programs share (see attachToProgram): the values are
+ * uploaded once for all these programs.
+ *
+ * The buffer is a ring of slots, each update writing the next one, so that
+ * the values of the previous frames can still be read by the GPU while
+ * being overwritten. A fence guards each slot, waited for before the slot
+ * is written again (if the GPU is that late).
+ *
+ * The blocks are C++ structs with the std140 layout, checked at compile
+ * time (see Std140.hpp).
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class UniformBuffer : public OGLStateObject {
+public:
+  /// How the slots are written
+  enum UpdateMethod
+  {
+    SubData, ///< glBufferSubData
+    MapRange ///< glMapBufferRange, unsynchronized (the fences synchronizing the writes)
+  };
+
+  /**
+   * @brief Constructor
+   * @param bindingPoint the binding point of the buffer
+   * @param blockSize the size of the uniform block (sizeof the C++ struct)
+   * @param nbSlots the number of slots of the ring, i.e. the number of updates the GPU may lag behind
+   * @param method how the slots are written
+   */
+  UniformBuffer(uint bindingPoint, size_t blockSize, uint nbSlots = 3, UpdateMethod method = MapRange);
+
+  UniformBuffer(const UniformBuffer &) = delete;
+  UniformBuffer & operator=(const UniformBuffer &) = delete;
+
+  /// @brief Destructor
+  ~UniformBuffer();
+
+  /// @brief binds this buffer to the GL_UNIFORM_BUFFER target
+  void bind() const override;
+
+  /// @brief unbinds this buffer from the GL_UNIFORM_BUFFER target
+  void unbind() const override;
+
+  /// @brief the binding point of this buffer
+  uint bindingPoint() const;
+
+  /**
+   * @brief connects a uniform block of a program to the binding point of this buffer
+   * @param prog the target program
+   * @param blockName the name of the uniform block
+   */
+  void attachToProgram(const Program & prog, const std::string & blockName) const;
+
+  /**
+   * @brief writes the values of the block in the next slot, and binds the slot to the binding point
+   * @param block the values, whose type is declared by STD140_BLOCK
+   */
+  template <typename Block> void update(const Block & block);
+
+private:
+  void updateBytes(const void * data, size_t size);
+
+private:
+  uint m_location;              ///< GPU location of the buffer
+  uint m_bindingPoint;          ///< binding point of the buffer
+  size_t m_blockSize;           ///< size of the uniform block
+  size_t m_slotSize;            ///< distance between the slots (the block size, rounded to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+  UpdateMethod m_method;        ///< how the slots are written
+  uint m_slot;                  ///< the slot bound to the binding point
+  std::vector<GLsync> m_fences; ///< fence of each slot, set once the next slot is written (null until then)
+};
+
 /*
  * Definition of method templates
  */
@@ -523,9 +813,40 @@ template <typename T> void Buffer::setData(const std::vector<T> & values)
    *
    * @see VAO::encapsulateVBO
    */
+template <typename T> void Buffer::setData(Span<T> values)
+{
+  this->bind();
+  glBufferData(this->m_target, sizeof(T) * values.size(), values.data(), GL_STATIC_DRAW);
+  this->unbind();
+
+  this->m_attributeCount = values.size();
+  this->m_attributeSize = AttributeProperties<T>::components;
+  this->m_attributeType = AttributeProperties<T>::typeEnum;
+  this->m_attributeNormalized = AttributeProperties<T>::normalized;
+}
+
+template <typename T> void VAO::setVBO(uint attributeIndex, Span<T> values)
+{
+  assert(attributeIndex < this->m_vbos.size());
+  if (this->m_strides[attributeIndex] != 0) {
+    // the attribute leaves the interleaved (or per-instance) VBO it shares with others
+    this->m_vbos[attributeIndex] = std::shared_ptr<Buffer>(new Buffer(GL_ARRAY_BUFFER));
+    this->m_strides[attributeIndex] = 0;
+    this->m_divisors[attributeIndex] = 0;
+  }
+  this->m_vbos[attributeIndex]->setData(values);
+  this->encapsulateVBO(attributeIndex);
+}
+
 template <typename T> void VAO::setVBO(uint attributeIndex, const std::vector<T> & values)
 {
   if (attributeIndex < this->m_vbos.size()) {
+    if (this->m_strides[attributeIndex] != 0) {
+      // the attribute leaves the interleaved (or per-instance) VBO it shares with others
+      this->m_vbos[attributeIndex] = std::shared_ptr<Buffer>(new Buffer(GL_ARRAY_BUFFER));
+      this->m_strides[attributeIndex] = 0;
+      this->m_divisors[attributeIndex] = 0;
+    }
     std::shared_ptr<Buffer> vbo = this->m_vbos[attributeIndex];
     vbo->setData(values);
     this->encapsulateVBO(attributeIndex);
@@ -534,6 +855,17 @@ template <typename T> void VAO::setVBO(uint attributeIndex, const std::vector<T>
   }
 }
 
+template <typename Layout> void VAO::setInterleavedVBO(uint firstAttributeIndex, const std::vector<unsigned char> & vertices)
+{
+  this->setInterleavedVBO(firstAttributeIndex, vertices, Layout::formats(), Layout::stride);
+}
+
+template <typename T> void VAO::setInstanceVBO(uint attributeIndex, Span<T> values)
+{
+  const AttributeFormat format = {AttributeProperties<T>::typeEnum, AttributeProperties<T>::components, AttributeProperties<T>::normalized, 0};
+  this->setInstanceVBO(attributeIndex, values.data(), sizeof(T) * values.size(), std::vector<AttributeFormat>(1, format), sizeof(T));
+}
+
   /**
    * @brief sets up the IBO
    * @param values the values to be sent to the IBO location.
@@ -550,18 +882,39 @@ template <typename T> void VAO::setIBO(const std::vector<T> & values)
   this->m_ibo.setData(values);
   this->m_ibo.bind();
   this->unbind();
+  this->m_baseVertex = 0;
 }
 
 template <typename T> void Program::setUniform(const std::string & name, const T & val) const
+{
+  setUniform(name.c_str(), val);
+}
+
+template <typename T> void Program::setUniform(const char * name, const T & val) const
 {
   int location;
   if (getUniformLocation(name, location) and bound()) {
     uniformDispatcher<T>(location, val);
-  } else if (not bound()) {
-    std::cerr << "===== Program is not attached (for uniform '" << name << "')\n";
   } else {
-    std::cerr << "=====" << name << " uniform was queried but does not exist\n";
+    reportUniformFailure(name);
+  }
+}
+
+template <typename T> void Program::setUniform(Uniform uniform, const T & val) const
+{
+  assert((not uniform.isValid() or uniform.m_program == m_location) && "setUniform(): the uniform belongs to another program");
+  if (uniform.isValid() and bound()) {
+    uniformDispatcher<T>(uniform.m_location, val);
+  } else if (not bound()) {
+    reportUniformFailure("(resolved uniform)");
   }
 }
 
+template <typename Block> void UniformBuffer::update(const Block & block)
+{
+  static_assert(Std140<Block>::supported, "update(): the block must be declared by STD140_BLOCK");
+  assert(sizeof(Block) == m_blockSize && "update(): the block does not have the size of the buffer");
+  updateBytes(&block, sizeof(Block));
+}
+
 #endif /* end of include guard: __GLAPI__HPP */
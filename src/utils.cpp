@@ -4,6 +4,11 @@
 #include <GL/glew.h>
 #include <fstream>
 #include <iostream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 /*
  * OpenGL Error checking
@@ -81,6 +86,24 @@ std::string basename(const std::string & filepath)
   return basedir;
 }
 
+bool makeDirectories(const std::string & directory)
+{
+  // every prefix ending with a separator, then the whole path (the existing ones are skipped by the failing calls)
+  for (size_t separator = directory.find_first_of("/\\", 1); separator != std::string::npos; separator = directory.find_first_of("/\\", separator + 1)) {
+#ifdef _WIN32
+    _mkdir(directory.substr(0, separator).c_str());
+#else
+    mkdir(directory.substr(0, separator).c_str(), 0755);
+#endif
+  }
+#ifdef _WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0755);
+#endif
+  struct stat status;
+  return stat(directory.c_str(), &status) == 0 and (status.st_mode & S_IFMT) == S_IFDIR;
+}
 
 bool endsWith(const std::string & str, const std::string & suffix)
 {
@@ -26,6 +26,9 @@ std::string absolutename(const std::string & filename);
 /// @brief retrieves the basename of a file
 std::string basename(const std::string & filepath);
 
+/// @brief creates a directory and its parents, false if it does not exist afterwards
+bool makeDirectories(const std::string & directory);
+
 /// @brief check whether a string ends with a given suffix
 bool endsWith(const std::string & str, const std::string & suffix);
 